@@ -19,39 +19,30 @@ static const char *page =
 
 static char output[1024];
 
+// How long a reading is reused for.
+#define ADC_CACHE_MS 250
 
-bool AdcWebapp::matches(const char *verb, const char *path)
+
+void AdcWebapp::addRoutes(Router &router)
 {
-    bool accept = false;
-    if (strcmp(verb, "GET") == 0)
-    {
-        accept =
-            strncmp(path, "/adc", 4) == 0 ||
-            strncmp(path, "/adcdata", 8) == 0 ||
-            false;
-        ;
-    }
-    return accept;
+    router.exact("GET", "/adc", this, PAGE);
+    router.exact("GET", "/adcdata", this, DATA);
 }
 
 void AdcWebapp::process(HttpRequest &request, HttpResponse &response)
 {
 
-    const char *body;
+    const char *body = page;
 
-    if (strncmp(request.path(), "/adcdata", 8) == 0)
+    if (request.route() == DATA)
     {
         sprintf(output, "ADC Counts: %u", (int) adc.read());
         body = output;
-    }
-    else if (strncmp(request.path(), "/adc", 4) == 0)
-    {
-        body = page;
+        response.cacheFor(ADC_CACHE_MS);  // all the panels polling get the same reading.
     }
 
     response.setStatus(200, "OK");
-    response.addHeader("Server", "PicoW");
-    response.addHeader("Access-Control-Allow-Origin", "*");
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
 
     response.setBody(body);
 }
\ No newline at end of file
@@ -7,8 +7,16 @@ class AdcWebapp : public WebApp
 {
     static char* id(char* pos, const char* name);
     static char* value(char* pos, uint64_t value);
+
+    // Route tags.
+    enum
+    {
+        PAGE,
+        DATA
+    };
+
 public:
-    virtual bool matches(const char *verb, const char *path);
+    virtual void addRoutes(Router &router);
     virtual void process(HttpRequest &request, HttpResponse &response);
 };
 
@@ -5,96 +5,79 @@
 extern BcdDisplay display;
 extern Tick ticker;
 
-bool ClockWebapp::matches(const char *verb, const char *path)
+struct ClockParams
 {
-    bool accept = false;
-    if (strcmp(verb, "GET") == 0)
-    {
-        accept =
-            strncmp(path, "/digits", 7) == 0 || // inc digitshsv
-            strncmp(path, "/colons", 7) == 0 || // inc colonshsv
-            strncmp(path, "/notify1", 8) == 0 ||
-            strncmp(path, "/notify2", 8) == 0 ||
-            strncmp(path, "/autobright", 11) == 0 ||
-            strncmp(path, "/tick", 5) == 0 ||
-            false;
-        ;
-    }
-    return accept;
+    uint32_t rgb;
+    float h;
+    float s;
+    float v;
+    bool on;
+};
+
+static const ParamSpec specs[] = {
+    {"rgb", ParamType::RGB, 0, 0, 0, offsetof(ClockParams, rgb)},
+    {"h", ParamType::FLOAT, 0, 1, 0, offsetof(ClockParams, h)},
+    {"s", ParamType::FLOAT, 0, 1, 0, offsetof(ClockParams, s)},
+    {"v", ParamType::FLOAT, 0, 1, 0, offsetof(ClockParams, v)},
+    {"on", ParamType::BOOL, 0, 0, 0, offsetof(ClockParams, on)},
+};
+
+static const ParamSchema schema(specs, sizeof(specs) / sizeof(specs[0]), sizeof(ClockParams));
+
+void ClockWebapp::addRoutes(Router &router)
+{
+    router.exact("GET", "/digits", this, DIGITS, &schema);
+    router.exact("GET", "/digitshsv", this, DIGITS_HSV, &schema);
+    router.exact("GET", "/colons", this, COLONS, &schema);
+    router.exact("GET", "/colonshsv", this, COLONS_HSV, &schema);
+    router.exact("GET", "/notify1", this, NOTIFY1, &schema);
+    router.exact("GET", "/notify2", this, NOTIFY2, &schema);
+    router.exact("GET", "/autobright", this, AUTOBRIGHT, &schema);
+    router.exact("GET", "/tick", this, TICK, &schema);
 }
 
 void ClockWebapp::process(HttpRequest &request, HttpResponse &response)
 {
 
-    uint32_t rgb = 0;
-    float h = 0;
-    float s = 0;
-    float v = 0;
-    bool on = false;
-    BlockListIter<Parameter> iter = request.Parameters().iter();
-    Parameter *p;
-    while (p = iter.next())
-    {
-        if (strcmp(p->name(), "rgb") == 0)
-        {
-            rgb = p->asRgb();
-        }
-        else if (strcmp(p->name(), "h") == 0)
-        {
-            h = p->asFloat();
-        }
-        else if (strcmp(p->name(), "s") == 0)
-        {
-            s = p->asFloat();
-        }
-        else if (strcmp(p->name(), "v") == 0)
-        {
-            v = p->asFloat();
-        }
-        else if (strcmp(p->name(), "on") == 0)
-        {
-            on = strcmp(p->value(), "true") == 0;
-        }
-    }
+    const ClockParams &params = request.params<ClockParams>();
+    uint32_t rgb = params.rgb;
+    float h = params.h;
+    float s = params.s;
+    float v = params.v;
+    bool on = params.on;
 
-    if (strncmp(request.path(), "/digitshsv", 10) == 0)
+    switch (request.route())
     {
+    case DIGITS_HSV:
         display.setDigitColour(h, s, v);
         display.redraw();
-    }
-    else if (strncmp(request.path(), "/colonshsv", 10) == 0)
-    {
+        break;
+    case COLONS_HSV:
         display.setColonColour(h, s, v);
         display.redraw();
-    }
-    else if (strncmp(request.path(), "/digits", 7) == 0)
-    {
+        break;
+    case DIGITS:
         display.setDigitColour(rgb);
         display.redraw();
-    }
-    else if (strncmp(request.path(), "/colons", 7) == 0)
-    {
+        break;
+    case COLONS:
         display.setColonColour(rgb);
         display.redraw();
-    }
-    else if (strncmp(request.path(), "/notify1", 8) == 0)
-    {
+        break;
+    case NOTIFY1:
         display.setNotify1(rgb);
-    }
-    else if (strncmp(request.path(), "/notify2", 8) == 0)
-    {
+        break;
+    case NOTIFY2:
         display.setNotify2(rgb);
-    }
-    else if (strncmp(request.path(), "/autobright", 11) == 0)
-    {
+        break;
+    case AUTOBRIGHT:
         display.setAutoBrightness(on);
-    }
-    else if (strncmp(request.path(), "/tick", 5) == 0)
-    {
+        break;
+    case TICK:
         ticker.enable(on);
+        break;
     }
 
     response.setStatus(200, "OK");
-    response.addHeader("Server", "PicoW");
-    response.addHeader("Access-Control-Allow-Origin", "*");
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
 }
\ No newline at end of file
@@ -4,8 +4,21 @@
 
 class ClockWebapp : public WebApp
 {
+    // Route tags.
+    enum
+    {
+        DIGITS,
+        DIGITS_HSV,
+        COLONS,
+        COLONS_HSV,
+        NOTIFY1,
+        NOTIFY2,
+        AUTOBRIGHT,
+        TICK
+    };
+
 public:
-    virtual bool matches(const char *verb, const char *path);
+    virtual void addRoutes(Router &router);
     virtual void process(HttpRequest &request, HttpResponse &response);
 };
 #endif
\ No newline at end of file
@@ -1,12 +1,14 @@
 #include "history.hpp"
 
 History::History()
-: minute(0), minuteBit(0), hourBit(0){
+: minute(0), minuteBit(0), hourBit(0), changeCount(0){
     for(int i=0; i<24; ++i) hours[i] = 0;
 }
 
 void History::add(bool active) {
 
+    uint64_t before = minute;
+    bool promoted = false;
     if(minuteBit == 60){
         // Promote to hour
         if(hourBit == 60) { // minutes in hour
@@ -18,6 +20,7 @@ void History::add(bool active) {
         // Record if anything happened this minute (i.e. minute is non zero) in the
         // correct minute of the current hour.
         hours[hourOfDay] |=  uint64_t( (minute != 0) ? 1 : 0) << hourBit;
+        promoted = minute != 0;
         ++hourBit;
 
         // reset minute count, don't reset minute - always has last 60 secs of data.
@@ -28,5 +31,7 @@ void History::add(bool active) {
     minute &= ~0xF000000000000000; // 60 bits only
     minute |= active ? 1 : 0;      // and fold in this one.
     ++minuteBit;
+
+    if(minute != before || promoted) ++changeCount;
 }
 
@@ -12,12 +12,15 @@ class History {
   int hourBit;
   int hourOfDay;
 
+  uint32_t changeCount; // bumped whenever the history changes.
+
   public:
   History();  
   void add(bool active);  
 
   uint64_t current(){ return minute;}
   uint64_t* past() { return hours;}
+  const uint32_t* changes() const { return &changeCount;}
   
 };
 
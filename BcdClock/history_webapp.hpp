@@ -4,10 +4,8 @@
 
 class HistoryWebapp : public WebApp
 {
-    static char* id(char* pos, const char* name);
-    static char* value(char* pos, uint64_t value);
 public:
-    virtual bool matches(const char *verb, const char *path);
+    virtual void addRoutes(Router &router);
     virtual void process(HttpRequest &request, HttpResponse &response);
 };
 #endif
\ No newline at end of file
@@ -9,7 +9,7 @@ extern "C"
 #include "../WebServer/server.hpp"
 #include "../WebServer/webserver.hpp"
 #include "../WebServer/teapot.hpp"
-#include "index.hpp"
+#include "../WebServer/static_asset.hpp"
 #include "clock_webapp.hpp"
 #include "ntp_client.hpp"
 #include "clock.hpp"
@@ -21,14 +21,25 @@ extern "C"
 #include "history_webapp.hpp"
 #include "adc.hpp"
 #include "adc_webapp.hpp"
+#include "../WebServer/event_channel.hpp"
+#include "../WebServer/metrics_webapp.hpp"
+#include "../WebServer/trace_webapp.hpp"
+#include "../WebServer/json_writer.hpp"
+#include "../WebServer/udp_publisher.hpp"
 
 WifiStation station;
 Webserver webserver;
 Teapot teapot; // respondes to /coffee with 418...
-IndexPage indexPage;
+StaticAssetWebapp staticPages(webAssets, webAssetCount, "/form.html");
 ClockWebapp clockPage;
 HistoryWebapp historyPage;
 AdcWebapp adcPage;
+EventChannel events(webserver, "/events"); // live sensor data.
+ResponseCache cache;                       // historydata and adcdata for several panels.
+ServerMetrics metrics;
+MetricsWebapp metricsPage(webserver);      // /metrics for Prometheus.
+TraceWebapp tracePage;                     // /trace for what the server has been doing.
+UdpPublisher sensors;                      // readings multicast to the LAN each second.
 
 Clock ntpClock;
 NtpClient ntp(&ntpClock);
@@ -40,6 +51,37 @@ Adc adc(28); // GPIO 28 - channel 2
 
 // TODO GET /favicon.ico HTTP/1.1
 
+// Reading ids in the SENSOR_SOURCE_BCDCLOCK frames.
+enum ClockReading : uint8_t
+{
+    READING_MOVEMENT = 1, // history.current(), a bit per second of the last minute.
+    READING_LIGHT = 2
+};
+
+// Pushes the latest sensor readings to anyone subscribed to /events and, once
+// a second, to the LAN.
+static void publishSensors(uint16_t light)
+{
+    if (sensors.due())
+    {
+        SensorFrame frame(SENSOR_SOURCE_BCDCLOCK);
+        frame.add(READING_MOVEMENT, history.current()).add(READING_LIGHT, (uint32_t)light);
+        sensors.publish(frame);
+    }
+
+    if (!events.subscribed())
+        return;
+
+    char text[48];
+    JsonWriter historyJson(text, sizeof(text));
+    historyJson.beginObject().key("lastMin").hex(history.current(), 15).endObject();
+    events.publish("history", historyJson.c_str());
+
+    JsonWriter adcJson(text, sizeof(text));
+    adcJson.beginObject().field("light", light).endObject();
+    events.publish("adc", adcJson.c_str());
+}
+
 #if LWIP_MDNS_RESPONDER
 static void
 // void (*)(netif *netif, u8_t result, s8_t slot)
@@ -86,7 +128,12 @@ int main()
             webserver.addApplication(&teapot);
             webserver.addApplication(&historyPage);
             webserver.addApplication(&adcPage);
-            webserver.addApplication(&indexPage);
+            webserver.addApplication(&staticPages);
+            webserver.addApplication(&events);
+            webserver.addApplication(&metricsPage);
+            webserver.addApplication(&tracePage);
+            webserver.setCache(&cache);
+            webserver.setMetrics(&metrics);
 
             TcpServer server(&webserver);
             if (server.open(80))
@@ -97,6 +144,11 @@ int main()
                 mdns_resp_add_netif(netif_default, CYW43_HOST_NAME);
                 mdns_resp_announce(netif_default); // I'm here!
 
+                if (!sensors.open())
+                {
+                    printf("Unable to multicast readings to %s\n", SENSOR_GROUP);
+                }
+
                 int ntpDelay = 0;
                 while (true)
                 {
@@ -115,6 +167,7 @@ int main()
 
                     uint16_t light = adc.read();
                     display.setLightLevel(light);
+                    publishSensors(light);
 
                     time_t now = ntpClock.now();
                     // struct tm *utc = gmtime(&now);
@@ -143,16 +196,18 @@ int main()
                     {
                         cyw43_arch_wait_for_work_until(next);
                         cyw43_arch_poll();
+                        server.service();
                     } while (absolute_time_diff_us(get_absolute_time(), next) > 0);
                 }
             }
 
             mdns_resp_remove_netif(netif_default);
 
+            sensors.close();
             server.close();
         }
         printf("BCDClock Restart\n");
-        sleep_ms(1000);
+        sleep_ms(station.backoff());
         station.restart();
     }
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+// Per frame cost of the colour pipeline (colour.hpp) against the floating
+// point code it replaced, for the 8x8 grid and for a 1000 pixel string.
+//
+// Builds for the Pico (colour_bench target in ../CMakeLists.txt, output on
+// the UART) and for the host (CMakeLists.txt here).  The Pico numbers are the
+// ones that matter: the RP2040 has no FPU so the float path is far slower
+// there than the host suggests.
+//
+// A frame is a two colour ripple: work out each pixel's colour, then turn it
+// into the GRBW words the DMA sends.
+
+#include <math.h>
+#include "pico/stdlib.h"
+#include "../colour.hpp"
+
+#define MAX_PIXELS 1000
+#define BENCH_FRAMES 200
+
+static int base[MAX_PIXELS];
+static Colour16 frame[MAX_PIXELS];
+static uint8_t error[4 * MAX_PIXELS];
+static uint32_t pixels[MAX_PIXELS];
+static float sinfLookup[SINE_LENGTH];
+
+// The previous float path, from NeopixelGrid::hvToRgb and addRgb.
+static uint32_t hvToRgb(float hue, float value){
+    float r, g, b;
+    if(hue > 1.0f) hue = 1.0f;
+    if(value > 1.0f) value = 1.0f;
+    int h = (int)(hue * 6);
+    float f = hue * 6 - h;
+    float p = 0;
+    float q = value * (1 - f);
+    float t = value * f;
+    if(h == 0){ r = value; g = t; b = p;}
+    else if(h == 1){ r = q; g = value; b = p;}
+    else if(h == 2){ r = p; g = value; b = t;}
+    else if(h == 3){ r = p; g = q; b = value;}
+    else if(h == 4){ r = t; g = p; b = value;}
+    else { r = value; g = p; b = q;}
+    return ((int)(r * 255) << 16) + ((int)(g * 255) << 8) + (int)(b * 255);
+}
+
+static uint32_t addRgb(uint32_t c1, uint32_t c2){
+    uint32_t r = (c1 & 0xFF0000) + (c2 & 0xFF0000);
+    uint32_t g = (c1 & 0x00FF00) + (c2 & 0x00FF00);
+    uint32_t b = (c1 & 0x0000FF) + (c2 & 0x0000FF);
+    if(r > 0xFF0000) r = 0xFF0000;
+    if(g > 0x00FF00) g = 0x00FF00;
+    if(b > 0x0000FF) b = 0x0000FF;
+    return r | g | b;
+}
+
+static void floatFrame(int phase, int count){
+    for(int i = 0; i < count; ++i){
+        int idx = base[i] + phase;
+        if(idx >= SINE_LENGTH) idx -= SINE_LENGTH;
+        float v1 = sinfLookup[idx];
+        uint32_t rgb = addRgb(hvToRgb(0.1f, v1 * 0.5f), hvToRgb(0.6f, (1.0f - v1) * 0.5f));
+        uint8_t r = rgb >> 16, g = rgb >> 8, b = rgb;
+        pixels[i] = ((uint32_t)g << 24) | ((uint32_t)r << 16) | ((uint32_t)b << 8);
+    }
+}
+
+static void fixedFrame(int phase, int count){
+    Wave wave = {6554, 39321, true, 0x7FFF, 0};
+    waveColours(wave, base, phase, frame, count);
+    ditherToGrbw(frame, error, pixels, count);
+}
+
+/// @return us per frame.
+static float time(void (*render)(int, int), int count){
+    uint64_t start = time_us_64();
+    for(int f = 0; f < BENCH_FRAMES; ++f){
+        render((f * 7) % SINE_LENGTH, count);
+    }
+    return (float)(time_us_64() - start) / BENCH_FRAMES;
+}
+
+int main(){
+#if PICO_ON_DEVICE
+    stdio_init_all();
+    sleep_ms(2000);
+#endif
+    for(int i = 0; i < SINE_LENGTH; ++i){
+        sinfLookup[i] = (1.0f + sinf(i * 2.0f * (float)M_PI / SINE_LENGTH)) / 2;
+    }
+    for(int i = 0; i < MAX_PIXELS; ++i){
+        base[i] = (i * 37) % SINE_LENGTH;
+    }
+
+    const int counts[] = {64, MAX_PIXELS};
+    printf("pixels   float us/frame   fixed us/frame   fixed max fps\n");
+    for(int count : counts){
+        float f = time(floatFrame, count);
+        float x = time(fixedFrame, count);
+        printf("%6d   %14.1f   %14.1f   %13.0f\n", count, f, x, 1e6f / x);
+    }
+
+    uint32_t check = 0;
+    for(int i = 0; i < MAX_PIXELS; ++i) check += pixels[i];
+    printf("(checksum %08lx)\n", (unsigned long)check);
+    return 0;
+}
@@ -0,0 +1,143 @@
+// Cost of compositing four effect layers (compositor.hpp) over 1000 pixels,
+// against the time 1000 RGBW pixels take to send, plus a few checks of the
+// blending and timeline.
+//
+// Builds for the Pico (compositor_bench target in ../CMakeLists.txt, output
+// on the UART) and for the host (CMakeLists.txt here).
+
+#include "pico/stdlib.h"
+#include "../compositor.hpp"
+
+#define MAX_PIXELS 1000
+#define BENCH_FRAMES 100
+
+static int base[MAX_PIXELS];
+static Colour16 layerFrame[MAX_PIXELS];
+static uint32_t accumulation[4 * MAX_PIXELS];
+static Colour16 frame[MAX_PIXELS];
+static uint8_t error[4 * MAX_PIXELS];
+static uint32_t pixels[MAX_PIXELS];
+static int failures = 0;
+
+// A ripple, as the grid's effects draw them.
+class WaveSource: public LayerSource {
+    Wave wave;
+    int phase;
+    int inc;
+
+    public:
+    WaveSource(uint16_t hue, uint16_t hue2, int inc) : wave{hue, hue2, true, 0xFFFF, 0}, phase(0), inc(inc) {}
+    virtual void render(Colour16* out, int count){
+        phase = (phase + inc + SINE_LENGTH) % SINE_LENGTH;
+        waveColours(wave, base, phase, out, count);
+    }
+};
+
+// The same colour everywhere.
+class SolidSource: public LayerSource {
+    Colour16 colour;
+
+    public:
+    SolidSource(Colour16 colour) : colour(colour) {}
+    virtual void render(Colour16* out, int count){
+        for(int i = 0; i < count; ++i) out[i] = colour;
+    }
+};
+
+static void expect(bool ok, const char* what){
+    if(!ok){
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+static bool near(uint16_t value, uint16_t expected){
+    return value + 2 >= expected && value <= expected + 2;
+}
+
+static void check(){
+    Compositor compositor(1, layerFrame, accumulation);
+    SolidSource red({0xFFFF, 0, 0, 0});
+    SolidSource blue({0, 0, 0xFFFF, 0});
+    SolidSource half({0x8000, 0x8000, 0x8000, 0x8000});
+    Colour16 out;
+
+    // Crossfade red to blue over a second, keyframed.
+    compositor.setSource(0, &red);
+    compositor.setSource(1, &blue);
+    compositor.addKeyframe({1000, 1000, 0, 0, BLEND_ADD});
+    compositor.addKeyframe({1000, 1000, 0xFFFF, 1, BLEND_ADD});
+    compositor.addKeyframe({0, 0, 0, 1, BLEND_ADD});
+    compositor.play(5000, 3000);
+    compositor.composite(5000, &out);
+    expect(out.r == 0xFFFF && out.b == 0, "red before the fade");
+    compositor.composite(6500, &out);
+    expect(near(out.r, 0x8000) && near(out.b, 0x8000), "half way through the fade");
+    compositor.composite(7000, &out);
+    expect(out.r == 0 && out.b == 0xFFFF, "blue after the fade");
+    compositor.composite(8100, &out);
+    expect(out.r == 0 && out.b == 0, "keyframe at 0 runs when looping");
+
+    // Multiply by half, then by nothing at opacity 0.
+    compositor.clear();
+    compositor.setSource(0, &red);
+    compositor.setSource(1, &half);
+    compositor.setBlend(1, BLEND_MULTIPLY);
+    compositor.composite(0, &out);
+    expect(near(out.r, 0x8000) && out.g == 0, "multiply");
+    compositor.fade(1, 0, 0, 0);
+    compositor.composite(0, &out);
+    expect(out.r == 0xFFFF, "multiply at opacity 0");
+
+    // Max and clipping of sums.
+    compositor.fade(1, 0xFFFF, 0, 0);
+    compositor.setBlend(1, BLEND_MAX);
+    compositor.composite(0, &out);
+    expect(out.r == 0xFFFF && near(out.g, 0x8000), "max");
+    compositor.setBlend(1, BLEND_ADD);
+    compositor.composite(0, &out);
+    expect(out.r == 0xFFFF && near(out.w, 0x8000), "add clips");
+
+    printf("compositing %s\n", failures ? "FAILED" : "ok");
+}
+
+int main(){
+#if PICO_ON_DEVICE
+    stdio_init_all();
+    sleep_ms(2000);
+#endif
+    for(int i = 0; i < MAX_PIXELS; ++i){
+        base[i] = (i * 37) % SINE_LENGTH;
+    }
+    check();
+
+    WaveSource ripple(6554, 39321, 7);
+    WaveSource spokes(21845, 52428, -3);
+    SolidSource tint({0xFFFF, 0xC000, 0x8000, 0xFFFF});
+    WaveSource shimmer(0, 32768, 11);
+
+    Compositor compositor(MAX_PIXELS, layerFrame, accumulation);
+    compositor.setSource(0, &ripple);
+    compositor.setSource(1, &spokes);
+    compositor.setSource(2, &shimmer);
+    compositor.setSource(3, &tint);
+    compositor.setBlend(1, BLEND_ADD);
+    compositor.setBlend(2, BLEND_MAX);
+    compositor.setBlend(3, BLEND_MULTIPLY);
+    compositor.fade(0, 0xFFFF, 0, 0);
+    compositor.fade(1, 0, 1000000, 0);      // fading throughout.
+
+    uint64_t start = time_us_64();
+    for(int f = 0; f < BENCH_FRAMES; ++f){
+        compositor.composite(f * 20, frame);
+        ditherToGrbw(frame, error, pixels, MAX_PIXELS);
+    }
+    float us = (float)(time_us_64() - start) / BENCH_FRAMES;
+    printf("4 layers x %d pixels: %.1f us/frame composited and dithered (sending takes %d us)\n",
+        MAX_PIXELS, us, MAX_PIXELS * 32 * 1250 / 1000);
+
+    uint32_t check = 0;
+    for(int i = 0; i < MAX_PIXELS; ++i) check += pixels[i];
+    printf("(checksum %08lx)\n", (unsigned long)check);
+    return failures ? 1 : 0;
+}
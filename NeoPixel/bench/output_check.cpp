@@ -0,0 +1,75 @@
+// Runs a single chain FrameOutput like the grid's and a ParallelStrips side
+// by side on one core for a few seconds and checks both kept up with their
+// refresh rates, i.e. that they share the DMA interrupt and alarm pool
+// (frame_output.hpp) without either stalling the other.
+//
+// Pico only (output_check target in ../CMakeLists.txt, results on the UART).
+// Nothing needs to be wired to the pins, the frames just go nowhere.
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "ws2812.pio.h"
+#include "../frame_output.hpp"
+#include "../parallel_output.hpp"
+
+#define CHAIN_PIN 7             // as the grid.
+#define CHAIN_PIXELS 64
+#define CHAIN_HZ 300
+
+#define STRIPS_PIN 8            // chains on 8 .. 15.
+#define STRIP_PIXELS 250
+#define STRIPS_HZ 60            // 250 RGBW take 10ms to send.
+
+#define CHECK_SECONDS 5
+
+static uint32_t chainBuffers[3 * CHAIN_PIXELS];
+static uint32_t stripBuffers[3 * STRIP_PIXELS * 32 / 4];
+static uint32_t strip[PARALLEL_STRIPS][STRIP_PIXELS];
+
+/// @return true if at least 95% of the refreshes in the check sent a frame.
+static bool keptUp(const char* name, uint32_t sent, uint32_t dropped, uint32_t late, uint32_t hz){
+    uint32_t expected = hz * CHECK_SECONDS;
+    bool ok = sent * 100 >= expected * 95;
+    printf("%s: %lu of %lu frames sent, %lu dropped, %lu late - %s\n", name,
+        (unsigned long)sent, (unsigned long)expected, (unsigned long)dropped, (unsigned long)late,
+        ok ? "ok" : "STALLED");
+    return ok;
+}
+
+int main(){
+    stdio_init_all();
+    sleep_ms(2000);
+
+    pio_sm_claim(pio0, 0);
+    uint offset = pio_add_program(pio0, &ws2812_program);
+    ws2812_program_init(pio0, 0, offset, CHAIN_PIN, 800000, true);
+    FrameOutput chain(pio0, 0, chainBuffers, CHAIN_PIXELS, 32);
+
+    ParallelStrips strips(pio1, 0, STRIPS_PIN, PARALLEL_STRIPS, stripBuffers, STRIP_PIXELS, 32);
+
+    const uint32_t* chains[PARALLEL_STRIPS];
+    for(int s = 0; s < PARALLEL_STRIPS; ++s) chains[s] = strip[s];
+
+    chain.start(CHAIN_HZ);
+    strips.start(STRIPS_HZ);
+
+    // Paced by the faster output; the strips just drop the frames they can't send.
+    uint32_t startSent = chain.framesSent();
+    uint32_t startStrips = strips.framesSent();
+    uint64_t end = time_us_64() + CHECK_SECONDS * 1000000ull;
+    for(uint32_t n = 0; time_us_64() < end; ++n){
+        chain.waitForFrame();
+        uint32_t* pixels = chain.renderBuffer();
+        for(int i = 0; i < CHAIN_PIXELS; ++i) pixels[i] = (n + i) << 24;
+        chain.present();
+
+        for(int s = 0; s < PARALLEL_STRIPS; ++s) strip[s][n % STRIP_PIXELS] = n << 8;
+        strips.show(chains);
+    }
+
+    bool ok = keptUp("chain", chain.framesSent() - startSent, chain.framesDropped(), chain.framesLate(), CHAIN_HZ);
+    ok = keptUp("strips", strips.framesSent() - startStrips, strips.framesDropped(), strips.framesLate(), STRIPS_HZ) && ok;
+    printf("outputs %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
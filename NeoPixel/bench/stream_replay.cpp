@@ -0,0 +1,270 @@
+// Feeds DDP and E1.31 packets to PixelStream (../pixel_stream.hpp) on the
+// host.
+//
+//   stream_replay               checks decoding against packets laid out as
+//                               xLights sends them.
+//   stream_replay capture.pcap  replays a tcpdump / Wireshark capture, e.g.
+//                               tcpdump -w capture.pcap udp port 4048 or 5568
+//                               and prints each frame's first pixels and the
+//                               totals.
+//
+// Host only (CMakeLists.txt here).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../pixel_stream.hpp"
+
+#define REPLAY_PIXELS 64
+#define PACKET_MAX 1500
+
+static uint32_t pixels[REPLAY_PIXELS];
+static int failures = 0;
+
+static void expect(bool ok, const char* what){
+    if(!ok){
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+/// @brief A DDP packet with the 10 byte header.
+static size_t ddpPacket(uint8_t* p, uint8_t flags, uint8_t sequence, uint8_t type, uint32_t offset, const uint8_t* data, uint16_t count){
+    p[0] = 0x40 | flags;
+    p[1] = sequence;
+    p[2] = type;
+    p[3] = 1;
+    p[4] = offset >> 24; p[5] = offset >> 16; p[6] = offset >> 8; p[7] = offset;
+    p[8] = count >> 8; p[9] = count;
+    memcpy(p + 10, data, count);
+    return 10 + count;
+}
+
+static void flagsLength(uint8_t* p, size_t length){
+    p[0] = 0x70 | (length >> 8);
+    p[1] = length;
+}
+
+/// @brief E1.31 root layer common to data and sync packets.
+static void e131Root(uint8_t* p, uint32_t vector, size_t length){
+    memset(p, 0, length);
+    p[1] = 0x10;
+    memcpy(p + 4, "ASC-E1.17", 9);
+    flagsLength(p + 16, length - 16);
+    p[18] = vector >> 24; p[19] = vector >> 16; p[20] = vector >> 8; p[21] = vector;
+    memcpy(p + 22, "stream_replay cid", 16);
+    flagsLength(p + 38, length - 38);
+}
+
+static size_t e131Data(uint8_t* p, uint16_t universe, uint8_t sequence, uint16_t sync, const uint8_t* data, uint16_t count){
+    size_t length = 126 + count;
+    e131Root(p, 4, length);
+    p[43] = 2;
+    strcpy((char*)p + 44, "stream_replay");
+    p[108] = 100;                                   // priority.
+    p[109] = sync >> 8; p[110] = sync;
+    p[111] = sequence;
+    p[113] = universe >> 8; p[114] = universe;
+    flagsLength(p + 115, length - 115);
+    p[117] = 0x02; p[118] = 0xA1;
+    p[122] = 1;                                     // address increment.
+    p[123] = (count + 1) >> 8; p[124] = count + 1;
+    memcpy(p + 126, data, count);
+    return length;
+}
+
+static size_t e131Sync(uint8_t* p, uint8_t sequence, uint16_t sync){
+    e131Root(p, 8, 49);
+    p[43] = 1;
+    p[44] = sequence;
+    p[45] = sync >> 8; p[46] = sync;
+    return 49;
+}
+
+/// @brief Channel data where pixel n is R n, G 0x80 + n, B 0xFF - n (and W n / 2).
+static void pattern(uint8_t* data, int count, int channels){
+    for(int n = 0; n < count; ++n){
+        uint8_t* c = data + n * channels;
+        c[0] = n; c[1] = 0x80 + n; c[2] = 0xFF - n;
+        if(channels == 4) c[3] = n / 2;
+    }
+}
+
+static bool matches(int channels){
+    for(int n = 0; n < REPLAY_PIXELS; ++n){
+        uint32_t expected = ((uint32_t)(0x80 + n) << 24) | ((uint32_t)n << 16) | ((uint32_t)(0xFF - n) << 8);
+        if(channels == 4) expected |= n / 2;
+        if(pixels[n] != expected) return false;
+    }
+    return true;
+}
+
+static void selfCheck(){
+    uint8_t data[REPLAY_PIXELS * 4];
+    uint8_t packet[PACKET_MAX];
+
+    {   // DDP RGB in two packets, split mid-pixel, push on the second.
+        PixelStream stream(REPLAY_PIXELS);
+        stream.setTarget(pixels);
+        memset(pixels, 0, sizeof(pixels));
+        pattern(data, REPLAY_PIXELS, 3);
+        size_t n = ddpPacket(packet, 0, 1, 0x0B, 0, data, 100);
+        expect(!stream.decode(PixelStream::DDP, packet, n), "ddp shown before push");
+        n = ddpPacket(packet, 0x01, 2, 0x0B, 100, data + 100, REPLAY_PIXELS * 3 - 100);
+        expect(stream.decode(PixelStream::DDP, packet, n), "ddp push");
+        expect(matches(3), "ddp rgb pixels");
+        expect(stream.dropped() == 0, "ddp no drops");
+
+        // Sequence 3 and 4 lost.
+        n = ddpPacket(packet, 0x01, 5, 0x0B, 0, data, REPLAY_PIXELS * 3);
+        stream.decode(PixelStream::DDP, packet, n);
+        expect(stream.dropped() == 2, "ddp drops counted");
+
+        // Wraps from 15 to 1.
+        n = ddpPacket(packet, 0x01, 15, 0x0B, 0, data, 3);
+        stream.decode(PixelStream::DDP, packet, n);
+        uint32_t dropped = stream.dropped();
+        n = ddpPacket(packet, 0x01, 1, 0x0B, 0, data, 3);
+        stream.decode(PixelStream::DDP, packet, n);
+        expect(stream.dropped() == dropped, "ddp sequence wrap");
+
+        // Status query is not a frame.
+        n = ddpPacket(packet, 0x02, 0, 0, 0, data, 0);
+        expect(!stream.decode(PixelStream::DDP, packet, n), "ddp query ignored");
+        expect(stream.ignored() == 1, "ddp query counted");
+        expect(stream.frames() == 4, "ddp frames");
+    }
+
+    {   // DDP RGBW from the data type, with a timecode.
+        PixelStream stream(REPLAY_PIXELS);
+        stream.setTarget(pixels);
+        memset(pixels, 0, sizeof(pixels));
+        pattern(data, REPLAY_PIXELS, 4);
+        uint8_t body[4 + sizeof(data)];
+        memset(body, 0, 4);
+        memcpy(body + 4, data, REPLAY_PIXELS * 4);
+        size_t n = ddpPacket(packet, 0x11, 0, 0x1B, 0, body, 4 + REPLAY_PIXELS * 4);
+        packet[8] = (REPLAY_PIXELS * 4) >> 8; packet[9] = (uint8_t)(REPLAY_PIXELS * 4);
+        expect(stream.decode(PixelStream::DDP, packet, n), "ddp rgbw push");
+        expect(matches(4), "ddp rgbw pixels");
+    }
+
+    {   // E1.31 unsynchronised: the only universe completes the frame.
+        PixelStream stream(REPLAY_PIXELS, 3, 1);
+        stream.setTarget(pixels);
+        memset(pixels, 0, sizeof(pixels));
+        pattern(data, REPLAY_PIXELS, 3);
+        size_t n = e131Data(packet, 1, 10, 0, data, REPLAY_PIXELS * 3);
+        expect(stream.decode(PixelStream::E131, packet, n), "e131 frame");
+        expect(matches(3), "e131 rgb pixels");
+
+        n = e131Data(packet, 2, 11, 0, data, REPLAY_PIXELS * 3);
+        expect(!stream.decode(PixelStream::E131, packet, n), "e131 other universe");
+
+        n = e131Data(packet, 1, 9, 0, data, REPLAY_PIXELS * 3);
+        expect(!stream.decode(PixelStream::E131, packet, n), "e131 late packet discarded");
+
+        n = e131Data(packet, 1, 14, 0, data, REPLAY_PIXELS * 3);
+        stream.decode(PixelStream::E131, packet, n);
+        expect(stream.dropped() == 3, "e131 drops counted");
+        expect(stream.ignored() == 2, "e131 ignored");
+
+        // Counting on through 255 to 0.
+        uint32_t dropped = stream.dropped();
+        bool shown = true;
+        for(int sequence = 15; sequence < 260; ++sequence){
+            n = e131Data(packet, 1, (uint8_t)sequence, 0, data, 3);
+            shown = stream.decode(PixelStream::E131, packet, n) && shown;
+        }
+        expect(shown, "e131 sequence wrap");
+        expect(stream.dropped() == dropped, "e131 wrap not a drop");
+    }
+
+    {   // E1.31 synchronised: shown on the sync packet only.
+        PixelStream stream(REPLAY_PIXELS, 4, 7);
+        stream.setTarget(pixels);
+        memset(pixels, 0, sizeof(pixels));
+        pattern(data, REPLAY_PIXELS, 4);
+        size_t n = e131Data(packet, 7, 1, 64214, data, REPLAY_PIXELS * 4);
+        expect(!stream.decode(PixelStream::E131, packet, n), "e131 held for sync");
+        n = e131Sync(packet, 1, 64000);
+        expect(!stream.decode(PixelStream::E131, packet, n), "e131 other sync");
+        n = e131Sync(packet, 2, 64214);
+        expect(stream.decode(PixelStream::E131, packet, n), "e131 sync");
+        expect(matches(4), "e131 rgbw pixels");
+        expect(!stream.decode(PixelStream::E131, packet, n), "e131 repeated sync");
+    }
+
+    printf("stream decoding %s\n", failures ? "FAILED" : "ok");
+}
+
+static uint32_t read32(const uint8_t* p, bool swapped){
+    return swapped ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+                   : ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+/// @brief Replays the UDP packets to the DDP and E1.31 ports in a pcap file
+/// of Ethernet frames.
+static int replay(const char* path){
+    FILE* f = fopen(path, "rb");
+    if(!f){
+        perror(path);
+        return 1;
+    }
+    uint8_t header[24];
+    if(fread(header, 1, sizeof(header), f) != sizeof(header)){
+        printf("%s: too short\n", path);
+        return 1;
+    }
+    bool swapped = header[0] == 0xA1;       // written big endian.
+    if(read32(header, swapped) != 0xA1B2C3D4 || read32(header + 20, swapped) != 1){
+        printf("%s: not a pcap file of Ethernet frames\n", path);
+        return 1;
+    }
+
+    PixelStream stream(REPLAY_PIXELS);
+    stream.setTarget(pixels);
+    uint32_t dropped = 0;
+    static uint8_t frame[65536];
+    uint8_t record[16];
+    while(fread(record, 1, sizeof(record), f) == sizeof(record)){
+        uint32_t length = read32(record + 8, swapped);
+        if(length > sizeof(frame) || fread(frame, 1, length, f) != length) break;
+
+        // Ethernet, IPv4, UDP.
+        if(length < 42 || frame[12] != 0x08 || frame[13] != 0x00 || (frame[14] >> 4) != 4) continue;
+        uint32_t ip = (frame[14] & 0x0F) * 4;
+        if(frame[23] != 17 || 14 + ip + 8 > length) continue;
+        const uint8_t* udp = frame + 14 + ip;
+        uint16_t port = (udp[2] << 8) | udp[3];
+        uint32_t size = ((udp[4] << 8) | udp[5]) - 8;
+        if(14 + ip + 8 + size > length) continue;
+
+        bool shown;
+        if(port == DDP_PORT) shown = stream.decode(PixelStream::DDP, udp + 8, size);
+        else if(port == E131_PORT) shown = stream.decode(PixelStream::E131, udp + 8, size);
+        else continue;
+
+        if(shown){
+            printf("frame %5lu:", (unsigned long)stream.frames());
+            for(int i = 0; i < 4; ++i) printf(" %08lx", (unsigned long)pixels[i]);
+            printf(" ...\n");
+        }
+        if(stream.dropped() != dropped){
+            printf("  %lu packets lost\n", (unsigned long)(stream.dropped() - dropped));
+            dropped = stream.dropped();
+        }
+    }
+    fclose(f);
+    printf("%lu packets, %lu frames, %lu lost, %lu ignored\n", (unsigned long)stream.packets(),
+        (unsigned long)stream.frames(), (unsigned long)stream.dropped(), (unsigned long)stream.ignored());
+    return 0;
+}
+
+int main(int argc, char** argv){
+    if(argc > 1){
+        return replay(argv[1]);
+    }
+    selfCheck();
+    return failures ? 1 : 0;
+}
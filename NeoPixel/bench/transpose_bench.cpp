@@ -0,0 +1,77 @@
+// Checks transposeStrips() (bitplanes.hpp) against a bit at a time version on
+// random frames and times it for 8 chains of 250 RGBW pixels, which at 800kHz
+// take 10ms to send so leave plenty of room for the transpose at 60 fps.
+//
+// Builds for the Pico (transpose_bench target in ../CMakeLists.txt, output on
+// the UART) and for the host (CMakeLists.txt here).
+
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "../bitplanes.hpp"
+
+#define STRIP_PIXELS 250
+#define BENCH_FRAMES 100
+
+static uint32_t strip[PARALLEL_STRIPS][STRIP_PIXELS];
+static uint32_t planes[STRIP_PIXELS * 32 / 4];
+static uint32_t expected[STRIP_PIXELS * 32 / 4];
+
+/// @brief The bit-planes a bit at a time, in the order ws2812_parallel.pio sends them.
+static void reference(const uint32_t* const strips[PARALLEL_STRIPS], int pixels, int bitsPerPixel, uint32_t* out){
+    memset(out, 0, bitplaneWords(pixels, bitsPerPixel) * sizeof(uint32_t));
+    int plane = 0;
+    for(int p = 0; p < pixels; ++p){
+        for(int bit = 31; bit >= 32 - bitsPerPixel; --bit, ++plane){
+            for(int s = 0; s < PARALLEL_STRIPS; ++s){
+                if(strips[s] && (strips[s][p] >> bit) & 1){
+                    out[plane / 4] |= 1u << ((plane % 4) * 8 + s);
+                }
+            }
+        }
+    }
+}
+
+/// @return true if transposeStrips() matches reference() on a random frame.
+static bool check(const uint32_t* const strips[PARALLEL_STRIPS], int bitsPerPixel){
+    for(int s = 0; s < PARALLEL_STRIPS; ++s){
+        for(int p = 0; p < STRIP_PIXELS; ++p){
+            strip[s][p] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        }
+    }
+    transposeStrips(strips, STRIP_PIXELS, bitsPerPixel, planes);
+    reference(strips, STRIP_PIXELS, bitsPerPixel, expected);
+    return memcmp(planes, expected, bitplaneWords(STRIP_PIXELS, bitsPerPixel) * sizeof(uint32_t)) == 0;
+}
+
+int main(){
+#if PICO_ON_DEVICE
+    stdio_init_all();
+    sleep_ms(2000);
+#endif
+    const uint32_t* all[PARALLEL_STRIPS];
+    const uint32_t* some[PARALLEL_STRIPS];
+    for(int s = 0; s < PARALLEL_STRIPS; ++s){
+        all[s] = strip[s];
+        some[s] = (s % 3 == 1) ? 0 : strip[s];
+    }
+
+    bool ok = true;
+    for(int i = 0; i < 10; ++i){
+        ok = ok && check(all, 32) && check(all, 24) && check(some, 32);
+    }
+    printf("transpose %s\n", ok ? "matches" : "DIFFERS");
+
+    uint64_t start = time_us_64();
+    for(int f = 0; f < BENCH_FRAMES; ++f){
+        transposeStrips(all, STRIP_PIXELS, 32, planes);
+    }
+    float us = (float)(time_us_64() - start) / BENCH_FRAMES;
+    printf("%d x %d RGBW pixels: %.1f us/frame (sending takes %d us)\n",
+        PARALLEL_STRIPS, STRIP_PIXELS, us, STRIP_PIXELS * 32 * 1250 / 1000);
+
+    uint32_t sum = 0;
+    for(uint32_t w : planes) sum += w;
+    printf("(checksum %08lx)\n", (unsigned long)sum);
+    return ok ? 0 : 1;
+}
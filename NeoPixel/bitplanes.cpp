@@ -0,0 +1,46 @@
+#include "bitplanes.hpp"
+
+/// @brief Transposes the 8x8 bit matrix in a (rows 0 - 3, row 0 in the top
+/// byte) and b (rows 4 - 7) so row n becomes column n.
+static inline void transpose8(uint32_t& a, uint32_t& b){
+    uint32_t t;
+    t = (a ^ (a >> 7)) & 0x00AA00AA;  a = a ^ t ^ (t << 7);
+    t = (b ^ (b >> 7)) & 0x00AA00AA;  b = b ^ t ^ (t << 7);
+
+    t = (a ^ (a >> 14)) & 0x0000CCCC; a = a ^ t ^ (t << 14);
+    t = (b ^ (b >> 14)) & 0x0000CCCC; b = b ^ t ^ (t << 14);
+
+    t = (a & 0xF0F0F0F0) | ((b >> 4) & 0x0F0F0F0F);
+    b = ((a << 4) & 0xF0F0F0F0) | (b & 0x0F0F0F0F);
+    a = t;
+}
+
+/// @brief Converts a frame to bit-planes.
+/// @param strips holds PARALLEL_STRIPS pointers to pixels, or 0 for none.
+/// @param pixels is the number of pixels in each.
+/// @param bitsPerPixel is 32 or 24.
+/// @param planes gets bitplaneWords(pixels, bitsPerPixel) words.
+void transposeStrips(const uint32_t* const strips[PARALLEL_STRIPS], int pixels, int bitsPerPixel, uint32_t* planes){
+    const int lanes = bitsPerPixel / 8;
+    for(int p = 0; p < pixels; ++p){
+        // Chain 7 first so that, after the transpose, chain n is bit n.
+        uint32_t w[PARALLEL_STRIPS];
+        for(int s = 0; s < PARALLEL_STRIPS; ++s){
+            w[s] = strips[PARALLEL_STRIPS - 1 - s] ? strips[PARALLEL_STRIPS - 1 - s][p] : 0;
+        }
+
+        // Colour bytes in the order they're sent, top byte first.
+        for(int lane = 0, shift = 24; lane < lanes; ++lane, shift -= 8){
+            uint32_t a = ((w[0] >> shift) & 0xFF) << 24 | ((w[1] >> shift) & 0xFF) << 16
+                | ((w[2] >> shift) & 0xFF) << 8 | ((w[3] >> shift) & 0xFF);
+            uint32_t b = ((w[4] >> shift) & 0xFF) << 24 | ((w[5] >> shift) & 0xFF) << 16
+                | ((w[6] >> shift) & 0xFF) << 8 | ((w[7] >> shift) & 0xFF);
+            transpose8(a, b);
+
+            // Plane for the colour's top bit is in a's top byte but is sent
+            // first, from the low byte of the word.
+            *planes++ = __builtin_bswap32(a);
+            *planes++ = __builtin_bswap32(b);
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef BITPLANES_HPP
+#define BITPLANES_HPP
+
+#include <stdint.h>
+
+// Most chains ws2812_parallel.pio drives from one state machine.
+#define PARALLEL_STRIPS 8
+
+// Turns a frame for up to 8 chains (one GRBW or GRB word per pixel, as
+// NeopixelGrid packs them, sent most significant bit first) into the
+// bit-planes ws2812_parallel.pio sends: for each pixel and each bit of it, a
+// byte whose bit n is that bit of chain n.  Four planes are packed to a word,
+// first to be sent in the low byte, so a pixel takes bitsPerPixel / 4 words.
+//
+// Each colour byte of the 8 chains is an 8x8 bit matrix transpose, done 32
+// bits at a time (Hacker's Delight 7-3) as the RP2040 has no 64 bit ALU.
+//
+// No pico headers so it can be checked on the host (bench/transpose_bench.cpp).
+
+/// @brief Words of bit-planes for a frame.
+static inline uint32_t bitplaneWords(uint32_t pixels, uint32_t bitsPerPixel){
+    return pixels * bitsPerPixel / 4;
+}
+
+// strips are the chains' pixels, a null pointer for a chain not fitted.
+// pixels is the length of the longest chain; shorter ones must be padded to it.
+// bitsPerPixel is 32 for GRBW or 24 for GRB (in the top 3 bytes).
+void transposeStrips(const uint32_t* const strips[PARALLEL_STRIPS], int pixels, int bitsPerPixel, uint32_t* planes);
+
+#endif
@@ -0,0 +1,118 @@
+#include "colour.hpp"
+
+// The tables are worked out by the compiler.  <cmath> isn't constexpr, so
+// these are just good enough for 16 bit results over the ranges used.
+
+static constexpr double PI = 3.14159265358979323846;
+static constexpr double LN2 = 0.69314718055994530942;
+
+/// @brief sin(x) by Taylor series after bringing x into -PI .. PI.
+static constexpr double sine(double x){
+    while(x > PI) x -= 2 * PI;
+    while(x < -PI) x += 2 * PI;
+    double term = x;
+    double sum = x;
+    for(int n = 1; n < 20; ++n){
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+/// @brief ln(x) for x > 0: halves or doubles x into 0.5 .. 1 then uses the
+/// atanh series, which converges quickly there.
+static constexpr double logarithm(double x){
+    int k = 0;
+    while(x < 0.5){ x *= 2; --k; }
+    while(x >= 1.0){ x /= 2; ++k; }
+    double y = (x - 1) / (x + 1);
+    double term = y;
+    double sum = 0;
+    for(int n = 1; n < 60; n += 2){
+        sum += term / n;
+        term *= y * y;
+    }
+    return 2 * sum + k * LN2;
+}
+
+/// @brief e^x for x <= 0: series on x / 1024 then squared back up.
+static constexpr double exponential(double x){
+    double y = x / 1024;
+    double term = 1;
+    double sum = 1;
+    for(int n = 1; n < 12; ++n){
+        term *= y / n;
+        sum += term;
+    }
+    for(int i = 0; i < 10; ++i) sum *= sum;
+    return sum;
+}
+
+static constexpr SineTable makeSineTable(){
+    SineTable table{};
+    for(int i = 0; i < SINE_LENGTH; ++i){
+        double v = (1 + sine(i * 2 * PI / SINE_LENGTH)) / 2;
+        table.value[i] = (uint16_t)(v * 0xFFFF + 0.5);
+    }
+    return table;
+}
+
+static constexpr GammaTable makeGammaTable(){
+    GammaTable table{};
+    table.value[0] = 0;
+    for(int i = 1; i < 256; ++i){
+        double v = exponential(COLOUR_GAMMA * logarithm(i / 255.0));
+        table.value[i] = (uint16_t)(v * 0xFF00 + 0.5);
+    }
+    table.value[255] = 0xFF00;
+    table.value[256] = 0xFF00;
+    return table;
+}
+
+extern constexpr SineTable sineTable = makeSineTable();
+extern constexpr GammaTable gammaTable = makeGammaTable();
+
+/// @brief Works out a frame of a Wave.
+/// @param wave is the colours and brightness.
+/// @param base is each pixel's starting index into sineTable, 0 .. SINE_LENGTH - 1.
+/// @param phase is how far the wave has moved on; wrapped into the table either way.
+/// @param out gets count colours.
+/// @param count is the number of pixels.
+void waveColours(const Wave& wave, const int* base, int phase, Colour16* out, int count){
+    for(int i = 0; i < count; ++i){
+        int idx = (base[i] + phase) % SINE_LENGTH;
+        if(idx < 0) idx += SINE_LENGTH;
+
+        uint16_t v1 = sineTable.value[idx];
+        Colour16 c = hvToColour(wave.hue, scale16(v1, wave.value), wave.white);
+        if(wave.twoColours){
+            c = addColour(c, hvToColour(wave.hue2, scale16(0xFFFF - v1, wave.value)));
+        }
+        out[i] = c;
+    }
+}
+
+/// @brief Gamma corrects one channel and adds the fraction left from the
+/// last frame; what's left now is kept for the next.
+static inline uint32_t dither(uint16_t level, uint8_t& error){
+    uint32_t linear = gammaCorrect(level) + error;    // at most 0xFF00 + 0xFF.
+    error = (uint8_t)linear;
+    return linear >> 8;
+}
+
+/// @brief Converts a frame for sending.
+/// @param frame is count colours.
+/// @param error is 4 * count bytes of per pixel dither state.
+/// @param pixels gets count words in the LEDs' GGRRBBWW order.
+/// @param count is the number of pixels.
+void ditherToGrbw(const Colour16* frame, uint8_t* error, uint32_t* pixels, int count){
+    for(int i = 0; i < count; ++i){
+        const Colour16& c = frame[i];
+        uint8_t* e = error + 4 * i;
+        pixels[i] =
+            (dither(c.g, e[0]) << 24) |
+            (dither(c.r, e[1]) << 16) |
+            (dither(c.b, e[2]) << 8) |
+            dither(c.w, e[3]);
+    }
+}
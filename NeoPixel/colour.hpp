@@ -0,0 +1,117 @@
+#ifndef COLOUR_HPP
+#define COLOUR_HPP
+
+#include <stdint.h>
+
+// Integer colour pipeline for the pixel effects.  Effects work in 16 bits per
+// channel (Colour16), perceptual rather than linear, so dim colours keep their
+// hue and fades are smooth.  ditherToGrbw() then gamma corrects each channel
+// to 8.8 fixed point and carries the fraction over to the next frame per
+// pixel (temporal dithering) so that, averaged over a few frames, levels
+// between the 8 bit steps the LEDs can show come out too.  That matters most
+// at low brightness where one step is a visible jump.
+//
+// No floating point and no pico headers, so it is cheap on the RP2040 and the
+// same code builds on the host (bench/colour_bench.cpp).
+
+// Entries in a full cycle of sineTable; effects' phases are indices into it.
+#define SINE_LENGTH 1000
+
+// Exponent used for gammaTable.
+#define COLOUR_GAMMA 2.6
+
+// 16 bits per channel; 0xFFFF is full on.
+struct Colour16 {
+    uint16_t r;
+    uint16_t g;
+    uint16_t b;
+    uint16_t w;
+};
+
+// (1 + sin) / 2 over a cycle, 0 .. 0xFFFF.
+struct SineTable {
+    uint16_t value[SINE_LENGTH];
+};
+
+// Perceptual level (index, in 1/255ths) to linear LED level in 8.8 fixed
+// point.  The extra entry saves a check when interpolating.
+struct GammaTable {
+    uint16_t value[257];
+};
+
+// Both are computed by the compiler and live in flash.
+extern const SineTable sineTable;
+extern const GammaTable gammaTable;
+
+/// @brief a * b where both are fractions of 0xFFFF (0xFFFF * 0xFFFF gives 0xFFFF).
+static inline uint16_t scale16(uint16_t a, uint16_t b){
+    return (uint16_t)(((uint32_t)a * ((uint32_t)b + 1)) >> 16);
+}
+
+/// @brief Fully saturated colour (HSV with S = 1) in fixed point.
+/// @param hue is a full turn in 65536 steps: 0 red, 21845 green, 43690 blue.
+/// @param value is the brightness, 0 .. 0xFFFF.
+/// @param white is copied to the white channel.
+static inline Colour16 hvToColour(uint16_t hue, uint16_t value, uint16_t white = 0){
+    uint32_t h6 = (uint32_t)hue * 6u;
+    uint16_t t = scale16(value, (uint16_t)h6);     // rising edge of the sector.
+    uint16_t q = value - t;                        // falling edge.
+    switch(h6 >> 16){
+        case 0:  return Colour16{value, t, 0, white};
+        case 1:  return Colour16{q, value, 0, white};
+        case 2:  return Colour16{0, value, t, white};
+        case 3:  return Colour16{0, q, value, white};
+        case 4:  return Colour16{t, 0, value, white};
+        default: return Colour16{value, 0, q, white};
+    }
+}
+
+static inline uint16_t addSaturate16(uint16_t a, uint16_t b){
+    uint32_t sum = (uint32_t)a + b;
+    return sum > 0xFFFF ? 0xFFFF : (uint16_t)sum;
+}
+
+/// @brief Adds two colours, clipping each channel at full on.  White is
+/// taken from the first.
+static inline Colour16 addColour(const Colour16& a, const Colour16& b){
+    return Colour16{addSaturate16(a.r, b.r), addSaturate16(a.g, b.g), addSaturate16(a.b, b.b), a.w};
+}
+
+/// @brief Converts an 8 bit 0xRRGGBB colour and white level to Colour16.
+static inline Colour16 colourFromRgb(uint32_t rgb, uint8_t white){
+    return Colour16{
+        (uint16_t)(((rgb >> 16) & 0xFF) * 0x101),
+        (uint16_t)(((rgb >> 8) & 0xFF) * 0x101),
+        (uint16_t)((rgb & 0xFF) * 0x101),
+        (uint16_t)(white * 0x101)};
+}
+
+/// @brief Gamma corrects a level by interpolating gammaTable.
+/// @return the linear level in 8.8 fixed point, 0 .. 0xFF00.
+static inline uint16_t gammaCorrect(uint16_t level){
+    // Rescale 0 .. 0xFFFF to 0 .. 0xFF00 so each 8 bit level (n * 0x101)
+    // lands exactly on entry n.
+    uint32_t position = level - (level >> 8);
+    const uint16_t* g = gammaTable.value + (position >> 8);
+    uint32_t fraction = position & 0xFF;
+    return (uint16_t)(g[0] + (((uint32_t)(g[1] - g[0]) * fraction) >> 8));
+}
+
+// One or two colours rippling through a set of pixels, as used by the ripple,
+// spokes, horizontal and vertical effects.  Each pixel's brightness follows
+// the sine table from its own starting point (base) moved on by the phase.
+struct Wave {
+    uint16_t hue;
+    uint16_t hue2;
+    bool twoColours;    // else hue2 is ignored.
+    uint16_t value;     // overall brightness.
+    uint16_t white;
+};
+
+void waveColours(const Wave& wave, const int* base, int phase, Colour16* out, int count);
+
+// Gamma corrects and dithers a frame into the pixels' GRBW words.
+// error holds 4 bytes per pixel, kept between frames (start it at 0).
+void ditherToGrbw(const Colour16* frame, uint8_t* error, uint32_t* pixels, int count);
+
+#endif
@@ -0,0 +1,174 @@
+#include <string.h>
+#include "compositor.hpp"
+
+/// @param count is the number of pixels.
+/// @param layerBuffer is count colours for rendering each layer.
+/// @param accumulation is 4 * count channels.
+Compositor::Compositor(int count, Colour16* layerBuffer, uint32_t* accumulation)
+: keyframeCount(0)
+, nextKeyframe(0)
+, playing(false)
+, timelineStart(0)
+, loopMs(0)
+, count(count)
+, layerBuffer(layerBuffer)
+, accumulation(accumulation)
+{
+    clear();
+}
+
+/// @brief Puts an effect in a layer, 0 to turn it off.  The opacity is left
+/// as it is.
+void Compositor::setSource(int layer, LayerSource* source){
+    if(layer < 0 || layer >= COMPOSITOR_LAYERS) return;
+    layers[layer].source = source;
+}
+
+void Compositor::setBlend(int layer, BlendMode blend){
+    if(layer < 0 || layer >= COMPOSITOR_LAYERS || blend >= BLEND_MODES) return;
+    layers[layer].blend = blend;
+}
+
+/// @brief Fades a layer from its opacity now to a new one.
+/// @param opacity is 0 .. 0xFFFF.
+/// @param fadeMs is how long to take, 0 for at once.
+/// @param nowMs is when the fade starts.
+void Compositor::fade(int layer, uint16_t opacity, uint32_t fadeMs, uint32_t nowMs){
+    if(layer < 0 || layer >= COMPOSITOR_LAYERS) return;
+    Layer& l = layers[layer];
+    updateOpacity(l, nowMs);
+    l.from = l.opacity;
+    l.to = opacity;
+    l.fadeStart = nowMs;
+    l.fadeMs = fadeMs;
+    if(fadeMs == 0) l.opacity = opacity;
+}
+
+/// @brief Empties every layer (off, add, fully opaque) and the timeline.
+void Compositor::clear(){
+    for(int i = 0; i < COMPOSITOR_LAYERS; ++i){
+        layers[i] = Layer{0, BLEND_ADD, 0xFFFF, 0xFFFF, 0xFFFF, 0, 0};
+    }
+    clearTimeline();
+}
+
+/// @brief Adds a keyframe, keeping the timeline in time order.  Keyframes at
+/// the same time run in the order added.
+/// @return false if the timeline is full or the keyframe isn't valid.
+bool Compositor::addKeyframe(const Keyframe& keyframe){
+    if(keyframeCount == COMPOSITOR_KEYFRAMES || keyframe.layer >= COMPOSITOR_LAYERS || keyframe.blend >= BLEND_MODES){
+        return false;
+    }
+    int i = keyframeCount;
+    while(i > 0 && keyframes[i - 1].atMs > keyframe.atMs){
+        keyframes[i] = keyframes[i - 1];
+        --i;
+    }
+    keyframes[i] = keyframe;
+    ++keyframeCount;
+    if(playing && i < nextKeyframe) ++nextKeyframe;     // already passed.
+    return true;
+}
+
+void Compositor::clearTimeline(){
+    keyframeCount = 0;
+    nextKeyframe = 0;
+    playing = false;
+}
+
+/// @brief Plays the timeline from the start.
+/// @param nowMs is the start.
+/// @param loopMs is the length of the loop, 0 to play once.
+void Compositor::play(uint32_t nowMs, uint32_t loopMs){
+    timelineStart = nowMs;
+    this->loopMs = loopMs;
+    nextKeyframe = 0;
+    playing = true;
+}
+
+/// @brief Applies keyframes that are due, each fading from its own time so
+/// the timeline doesn't drift with the frame rate.
+void Compositor::runTimeline(uint32_t nowMs){
+    while(playing){
+        uint32_t elapsed = nowMs - timelineStart;
+        if(nextKeyframe < keyframeCount){
+            const Keyframe& k = keyframes[nextKeyframe];
+            if(elapsed < k.atMs) return;
+            setBlend(k.layer, (BlendMode)k.blend);
+            fade(k.layer, k.opacity, k.fadeMs, timelineStart + k.atMs);
+            ++nextKeyframe;
+        } else if(loopMs != 0 && elapsed >= loopMs){
+            // After a long gap (not composited for a while) play just the last loop.
+            timelineStart += (elapsed / loopMs >= 2) ? (elapsed / loopMs - 1) * loopMs : loopMs;
+            nextKeyframe = 0;
+        } else {
+            if(loopMs == 0) playing = false;
+            return;
+        }
+    }
+}
+
+void Compositor::updateOpacity(Layer& layer, uint32_t nowMs){
+    uint32_t elapsed = nowMs - layer.fadeStart;
+    if(layer.fadeMs == 0 || elapsed >= layer.fadeMs){
+        layer.opacity = layer.to;
+        return;
+    }
+    int32_t step = (int32_t)(((uint64_t)elapsed << 16) / layer.fadeMs);    // 0 .. 0xFFFF.
+    layer.opacity = (uint16_t)(layer.from + ((int64_t)((int32_t)layer.to - layer.from) * step) / 0x10000);
+}
+
+/// @brief Blends the layer buffer into the accumulation.  A loop per mode
+/// so the mode isn't tested per pixel.
+void Compositor::blend(const Layer& layer){
+    const uint16_t* in = &layerBuffer[0].r;     // Colour16 is 4 packed uint16_t.
+    uint32_t* acc = accumulation;
+    uint32_t scale = (uint32_t)layer.opacity + 1;
+    int channels = 4 * count;
+
+    switch(layer.blend){
+        case BLEND_ADD:
+        for(int i = 0; i < channels; ++i){
+            acc[i] += (in[i] * scale) >> 16;
+        }
+        break;
+
+        case BLEND_MAX:
+        for(int i = 0; i < channels; ++i){
+            uint32_t v = (in[i] * scale) >> 16;
+            if(v > acc[i]) acc[i] = v;
+        }
+        break;
+
+        default:    // BLEND_MULTIPLY: by 1 - opacity + opacity * layer.
+        for(int i = 0; i < channels; ++i){
+            uint32_t factor = 0x10000 - (((0xFFFFu - in[i]) * scale) >> 16);
+            uint32_t below = acc[i] < 0xFFFF ? acc[i] : 0xFFFF;
+            acc[i] = (below * factor) >> 16;
+        }
+        break;
+    }
+}
+
+/// @brief Works out the next frame: runs the timeline then renders and
+/// blends each layer in turn, bottom first.
+/// @param nowMs is the time now.
+/// @param out gets count colours.
+void Compositor::composite(uint32_t nowMs, Colour16* out){
+    static_assert(sizeof(Colour16) == 4 * sizeof(uint16_t), "Colour16 must be 4 packed channels");
+    runTimeline(nowMs);
+    memset(accumulation, 0, 4 * count * sizeof(uint32_t));
+
+    for(int i = 0; i < COMPOSITOR_LAYERS; ++i){
+        Layer& layer = layers[i];
+        updateOpacity(layer, nowMs);
+        if(!layer.source || layer.opacity == 0) continue;
+        layer.source->render(layerBuffer, count);
+        blend(layer);
+    }
+
+    uint16_t* o = &out[0].r;
+    for(int i = 0; i < 4 * count; ++i){
+        o[i] = accumulation[i] < 0xFFFF ? (uint16_t)accumulation[i] : 0xFFFF;
+    }
+}
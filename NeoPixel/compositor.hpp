@@ -0,0 +1,105 @@
+#ifndef COMPOSITOR_HPP
+#define COMPOSITOR_HPP
+
+#include <stdint.h>
+#include "colour.hpp"
+
+// Layers composited, bottom (0) to top.
+#ifndef COMPOSITOR_LAYERS
+#define COMPOSITOR_LAYERS 4
+#endif
+
+// Most keyframes in the timeline.
+#ifndef COMPOSITOR_KEYFRAMES
+#define COMPOSITOR_KEYFRAMES 32
+#endif
+
+// How a layer combines with the layers below it, after scaling by its opacity.
+enum BlendMode : uint8_t {
+    BLEND_ADD,          // sum, so two layers fading in and out crossfade.
+    BLEND_MAX,          // brighter of the two per channel.
+    BLEND_MULTIPLY,     // tints or masks what's below; opacity 0 leaves it alone.
+    BLEND_MODES
+};
+
+// Anything that can draw a frame into a layer.  Called once per composited
+// frame so it should move its animation on a step each time.
+class LayerSource {
+    public:
+    virtual void render(Colour16* out, int count) = 0;
+};
+
+// A change to a layer at a time in the timeline: from atMs its blend mode is
+// set and its opacity fades to the given value over fadeMs.
+struct Keyframe {
+    uint32_t atMs;      // from the start of the timeline.
+    uint32_t fadeMs;    // 0 to change at once.
+    uint16_t opacity;   // 0 .. 0xFFFF.
+    uint8_t layer;
+    uint8_t blend;      // BlendMode.
+};
+
+// Combines up to COMPOSITOR_LAYERS effects into one frame.  Each layer is
+// rendered in turn into a layer buffer then blended into an accumulation
+// buffer of 32 bit channels, one tight loop per layer over the contiguous
+// pixels, so sums above full on aren't clipped until the end.
+//
+// Opacities are changed directly (fade()) or by keyframes, which play back
+// in time order and can loop, e.g. crossfading from ripples to spokes:
+//
+//   compositor.setSource(0, &ripples);
+//   compositor.setSource(1, &spokes);
+//   compositor.addKeyframe({0,     2000, 0xFFFF, 0, BLEND_ADD});
+//   compositor.addKeyframe({0,     2000, 0,      1, BLEND_ADD});
+//   compositor.addKeyframe({5000,  2000, 0,      0, BLEND_ADD});
+//   compositor.addKeyframe({5000,  2000, 0xFFFF, 1, BLEND_ADD});
+//   compositor.play(now, 10000);
+//
+// The loop should be longer than the last keyframe.  Times are in ms from any
+// clock that wraps at 2^32.  The buffers are passed
+// in so they can be statically allocated at the size needed.  No pico
+// headers so bench/compositor_bench.cpp times it on the host as well.
+class Compositor {
+    struct Layer {
+        LayerSource* source;    // 0 if off.
+        BlendMode blend;
+        uint16_t opacity;       // for this frame.
+        uint16_t from;          // fade from and to.
+        uint16_t to;
+        uint32_t fadeStart;
+        uint32_t fadeMs;
+    };
+
+    Layer layers[COMPOSITOR_LAYERS];
+    Keyframe keyframes[COMPOSITOR_KEYFRAMES];   // sorted by atMs.
+    int keyframeCount;
+    int nextKeyframe;
+    bool playing;
+    uint32_t timelineStart;
+    uint32_t loopMs;            // 0 to stop at the end.
+
+    int count;
+    Colour16* layerBuffer;      // count colours.
+    uint32_t* accumulation;     // 4 * count channels.
+
+    void runTimeline(uint32_t nowMs);
+    void updateOpacity(Layer& layer, uint32_t nowMs);
+    void blend(const Layer& layer);
+
+    public:
+    Compositor(int count, Colour16* layerBuffer, uint32_t* accumulation);
+
+    void setSource(int layer, LayerSource* source);
+    void setBlend(int layer, BlendMode blend);
+    void fade(int layer, uint16_t opacity, uint32_t fadeMs, uint32_t nowMs);
+    void clear();
+
+    bool addKeyframe(const Keyframe& keyframe);
+    void clearTimeline();
+    void play(uint32_t nowMs, uint32_t loopMs = 0);
+    void stop() { playing = false;}
+
+    void composite(uint32_t nowMs, Colour16* out);
+};
+
+#endif
@@ -41,6 +41,11 @@ class Dma {
     void fromBufferNow(const volatile void * readAddr, uint32_t transferCount){dma_channel_transfer_from_buffer_now(channel, readAddr, transferCount);}
     void toBufferNow(volatile void * writeAddr, uint32_t transferCount) {dma_channel_transfer_to_buffer_now(channel, writeAddr, transferCount);}
     volatile void waitForFinish(){dma_channel_wait_for_finish_blocking(channel);}
+
+    unsigned int getChannel() {return channel;}
+    void setIrq0Enabled(bool enabled) {dma_channel_set_irq0_enabled(channel, enabled);}
+    bool irq0Status() {return dma_channel_get_irq0_status(channel);}
+    void acknowledgeIrq0() {dma_channel_acknowledge_irq0(channel);}
    
 };
 
@@ -0,0 +1,129 @@
+#include <string.h>
+#include "pico/time.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "frame_output.hpp"
+
+FrameOutput* FrameOutput::byChannel[NUM_DMA_CHANNELS];
+int FrameOutput::irqCore = -1;
+alarm_pool_t* FrameOutput::pool = 0;
+
+/// @brief Sets up the DMA to feed a PIO state machine already running a
+/// WS2812 program.  Nothing is sent until start().
+/// @param pio is the PIO block.
+/// @param sm is the state machine in it.
+/// @param buffers holds 3 frames of words each.
+/// @param words is the length of a frame.
+/// @param bitsPerWord is what the program shifts out of each word (24 or 32).
+FrameOutput::FrameOutput(PIO pio, uint sm, uint32_t* buffers, uint words, uint bitsPerWord)
+: words(words)
+, queued(false)
+, sending(false)
+, sent(0)
+, dropped(0)
+, late(0)
+{
+    for(int i=0; i<3; ++i){
+        frames[i] = buffers + i * words;
+        memset(frames[i], 0, words * sizeof(uint32_t));
+    }
+    latchUs = (WS2812_PIO_WORDS * bitsPerWord * WS2812_BIT_NS + 999) / 1000 + WS2812_RESET_US;
+
+    DmaConfig cfg = dma.getDefaultConfig();
+    cfg.bswap(false);
+    cfg.transferDataSize(DMA_SIZE_32);
+    cfg.dreq(pio_get_dreq(pio, sm, true));
+    cfg.enable(true);
+    cfg.readIncrement(true);
+    cfg.writeIncrement(false);
+    dma.configure(cfg, &pio->txf[sm], frames[IN_FLIGHT], words);
+
+    sem_init(&frameSem, 0, 1);
+}
+
+/// @brief Starts refreshing.  The interrupts are taken on the calling core.
+/// @param refreshHz is the frame rate.  A frame takes bits * 1.25us plus the
+/// latch to send so this must leave time for that.
+void FrameOutput::start(uint32_t refreshHz){
+    // One DMA handler and alarm pool for every output, all on the same core.
+    // The default alarm pool's interrupt is on core 0, hence a pool here.
+    if(irqCore < 0){
+        irqCore = get_core_num();
+        pool = alarm_pool_create_with_unused_hardware_alarm(FRAME_OUTPUT_TIMERS);
+        irq_add_shared_handler(DMA_IRQ_0, dmaHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+    }
+    assert(irqCore == (int)get_core_num());
+    byChannel[dma.getChannel()] = this;
+    dma.setIrq0Enabled(true);
+
+    alarm_pool_add_repeating_timer_us(pool, -(int64_t)(1000000 / refreshHz), refreshHandler, this, &timer);
+}
+
+/// @brief Queues the render buffer to be sent at the next refresh and swaps
+/// in another to draw the next frame into.  Its contents are stale.
+void FrameOutput::present(){
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t* frame = frames[RENDER];
+    frames[RENDER] = frames[QUEUED];
+    frames[QUEUED] = frame;
+    if(queued) ++dropped;
+    queued = true;
+    restore_interrupts(save);
+}
+
+/// @brief Waits for the next refresh, so the caller draws a frame per refresh.
+void FrameOutput::waitForFrame(){
+    sem_acquire_blocking(&frameSem);
+}
+
+/// @brief Each refresh: sends the queued frame if there is a new one and the
+/// line is free.  Runs in the timer interrupt.
+void FrameOutput::refresh(){
+    sem_release(&frameSem);
+    if(sending){
+        if(queued) ++late;
+        return;
+    }
+    if(!queued) return;
+
+    uint32_t* frame = frames[IN_FLIGHT];
+    frames[IN_FLIGHT] = frames[QUEUED];
+    frames[QUEUED] = frame;
+    queued = false;
+    sending = true;
+    dma.setTransCount(words);
+    dma.setReadAddr(frames[IN_FLIGHT], true);
+}
+
+bool FrameOutput::refreshHandler(repeating_timer_t* timer){
+    ((FrameOutput*)timer->user_data)->refresh();
+    return true;
+}
+
+/// @brief DMA done, but the last words are still in the PIO and then the
+/// line must stay low for the LEDs to latch; an alarm says when that's over.
+void __isr FrameOutput::dmaHandler(){
+    for(uint channel = 0; channel < NUM_DMA_CHANNELS; ++channel){
+        FrameOutput* out = byChannel[channel];
+        if(!out || !out->dma.irq0Status()) continue;    // shared with other channels.
+        out->dma.acknowledgeIrq0();
+        // Calls back at once if already past; if the pool is full wait here
+        // rather than leave the output stuck sending.
+        if(alarm_pool_add_alarm_in_us(pool, out->latchUs, latchHandler, out, true) < 0){
+            busy_wait_us_32(out->latchUs);
+            out->latched();
+        }
+    }
+}
+
+int64_t FrameOutput::latchHandler(alarm_id_t id, void* user_data){
+    ((FrameOutput*)user_data)->latched();
+    return 0;   // once.
+}
+
+void FrameOutput::latched(){
+    sending = false;
+    ++sent;
+}
@@ -0,0 +1,91 @@
+#ifndef FRAME_OUTPUT_HPP
+#define FRAME_OUTPUT_HPP
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "hardware/pio.h"
+#include "hardware/timer.h"
+#include "dma.hpp"
+
+// How long the data line must be held low for the LEDs to latch a frame.
+// WS2812B needs 50us or more, SK6812 (the RGBW grid) 80us.
+#ifndef WS2812_RESET_US
+#define WS2812_RESET_US 80
+#endif
+
+// Time to send one bit at 800kHz, in ns.
+#define WS2812_BIT_NS 1250
+
+// Timers in the alarm pool the outputs share: each has a refresh timer and,
+// while a frame latches, a one shot alarm.
+#ifndef FRAME_OUTPUT_TIMERS
+#define FRAME_OUTPUT_TIMERS 8
+#endif
+
+// Words the PIO holds once the DMA has finished: the joined TX FIFO plus the
+// one being shifted out.
+#define WS2812_PIO_WORDS 9
+
+// Sends frames to a chain of LEDs through a PIO state machine at a fixed
+// refresh rate, without the rendering core waiting for anything:
+//
+//   render    - drawn into by the caller (renderBuffer()).
+//   queued    - the last frame present()ed, waiting for the next refresh.
+//   in flight - being sent by the DMA.
+//
+// A repeating timer starts each refresh: if the queued frame is new and the
+// previous one has finished (DMA complete, then the reset latch timed by an
+// alarm) the queued and in flight buffers swap and the DMA starts.
+// present() swaps render and queued, so a frame drawn faster than the refresh
+// replaces the one before it.  Each refresh also releases waitForFrame() so
+// the renderer can pace its animation to the output.
+//
+// The interrupts are handled on the core that calls start(), which should be
+// the one that renders so present() only needs to mask its own interrupts.
+// There can be several outputs (e.g. the grid and a ParallelStrips), each
+// with its own DMA channel, but they must all be started on the same core as
+// they share the DMA_IRQ_0 handler and an alarm pool.  The pool takes one of
+// the RP2040's four hardware alarms however many outputs there are;
+// bench/output_check.cpp runs the two together.
+class FrameOutput {
+    enum { RENDER = 0, QUEUED = 1, IN_FLIGHT = 2 };
+
+    Dma dma;
+    uint32_t* frames[3];
+    uint words;                 // per frame.
+    uint32_t latchUs;           // from DMA complete to the LEDs latching.
+
+    volatile bool queued;       // frames[QUEUED] hasn't been sent.
+    volatile bool sending;      // DMA or latch in progress.
+    repeating_timer_t timer;
+    semaphore_t frameSem;
+
+    volatile uint32_t sent;     // frames latched.
+    volatile uint32_t dropped;  // presented but replaced before being sent.
+    volatile uint32_t late;     // refreshes that found the last frame still going out.
+
+    // For the interrupt handlers to find the output.
+    static FrameOutput* byChannel[NUM_DMA_CHANNELS];
+    static int irqCore;             // taking DMA_IRQ_0, -1 until the first start().
+    static alarm_pool_t* pool;      // refresh timers and latch alarms, on irqCore.
+    static void __isr dmaHandler();
+    static int64_t latchHandler(alarm_id_t id, void* user_data);
+    static bool refreshHandler(repeating_timer_t* timer);
+
+    void refresh();
+    void latched();
+
+    public:
+    FrameOutput(PIO pio, uint sm, uint32_t* buffers, uint words, uint bitsPerWord);
+
+    void start(uint32_t refreshHz);
+    uint32_t* renderBuffer() { return frames[RENDER];}
+    void present();
+    void waitForFrame();
+
+    uint32_t framesSent() const { return sent;}
+    uint32_t framesDropped() const { return dropped;}
+    uint32_t framesLate() const { return late;}
+};
+
+#endif
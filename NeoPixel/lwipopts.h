@@ -47,6 +47,8 @@
 #define LWIP_TCP                    1
 #define LWIP_UDP                    1
 #define LWIP_DNS                    1
+#define LWIP_IGMP                   1 // E1.31 multicast universes
+#define MEMP_NUM_UDP_PCB            6 // DHCP, DNS, DDP and E1.31
 #define LWIP_TCP_KEEPALIVE          1
 #define LWIP_NETIF_TX_SINGLE_PBUF   1
 #define DHCP_DOES_ARP_CHECK         0
@@ -3,18 +3,30 @@ extern "C" {
 #include <cyw43.h>
 }
 #include "pico/multicore.h"
-#include "wifi.hpp"
-#include "server.hpp"
-#include "webserver.hpp"
+#include "../WebServer/wifi.hpp"
+#include "../WebServer/server.hpp"
+#include "../WebServer/webserver.hpp"
 #include "neopixel_webapp.hpp"
-#include "teapot.hpp"
-#include "index.hpp"
+#include "stream_receiver.hpp"
+#include "../WebServer/teapot.hpp"
+#include "../WebServer/static_asset.hpp"
+#include "../WebServer/upload_webapp.hpp"
+#include "../WebServer/metrics_webapp.hpp"
+#include "../WebServer/trace_webapp.hpp"
 
 WifiStation station;
 Webserver webserver;
 NeopixelWebapp webapp;
 Teapot teapot; // respondes to /coffee with 418...
-IndexPage indexPage;
+StaticAssetWebapp staticPages(webAssets, webAssetCount, "/form.html");
+FlashStore store;
+UploadWebapp upload(store, "/asset"); // PUT a page or effect data, GET it back
+ServerMetrics metrics;
+MetricsWebapp metricsPage(webserver); // /metrics for Prometheus.
+TraceWebapp tracePage;                // /trace for what the server has been doing.
+
+extern NeopixelGrid grid;
+StreamReceiver pixelStream(grid);     // frames from a lighting controller by DDP or E1.31.
 
 // TODO GET /favicon.ico HTTP/1.1
 
@@ -47,16 +59,23 @@ int main() {
 
             webserver.addApplication(&webapp);
             webserver.addApplication(&teapot);
-            webserver.addApplication(&indexPage);
+            webserver.addApplication(&staticPages);
+            webserver.addApplication(&upload);
+            webserver.addApplication(&metricsPage);
+            webserver.addApplication(&tracePage);
+            webserver.setMetrics(&metrics);
+
+            pixelStream.open();
 
             TcpServer server(&webserver);
             if(server.open(80)){
                  server.run();
             }
             server.close();
+            pixelStream.close();
         }
         printf("NeoPixel Restart\n");
-        sleep_ms(1000);
+        sleep_ms(station.backoff());
         station.restart();
     }
 }
\ No newline at end of file
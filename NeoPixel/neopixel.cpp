@@ -7,36 +7,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 
 #include "pico/stdlib.h"
 #include "pico/time.h"
+#include "pico/flash.h"
 #include "hardware/clocks.h"
 
 
 #include "ws2812.pio.h"
 #include "neopixel.hpp"
+#include "colour.hpp"
 
 #define IS_RGBW true
 #define WS2812_PIN 7
 
 NeopixelGrid grid;
 
-/// @brief Utility function to add 2 RGB values together.
-/// @param c1 
-/// @param c2 
-/// @return 
-static uint32_t addRgb(uint32_t c1, uint32_t c2){
-
-    uint32_t r = (c1 & 0xFF0000) + (c2 & 0xFF0000);
-    uint32_t g = (c1 & 0x00FF00) + (c2 & 0x00FF00);
-    uint32_t b = (c1 & 0x0000FF) + (c2 & 0x0000FF);
-
-    if(r > 0xFF0000) r = 0xFF0000;
-    if(g > 0x00FF00) g = 0x00FF00;
-    if(b > 0x0000FF) b = 0x0000FF;
-
-    return r | g | b;
+/// @brief Converts a SCALEd fraction from a Command to 0 .. 0xFFFF.
+static uint16_t fraction16(int32_t scaled){
+    if(scaled <= 0) return 0;
+    if(scaled >= (int32_t)SCALE) return 0xFFFF;
+    return (uint16_t)(((int64_t)scaled * 0xFFFF) / (int32_t)SCALE);
 }
 
 class NullAction: public Action {
@@ -45,54 +38,88 @@ class NullAction: public Action {
     virtual void start(NeopixelGrid* grid, Command* cmd) {}
 };
 
-class SetAction: public Action {
+class SetAction: public Action, public LayerSource {
+    Colour16 colour;
+    NeopixelGrid* grid;
+
     public:
-    virtual void tick(){}
-    virtual void start(NeopixelGrid* grid, Command* cmd) {grid->set(cmd->params[0], cmd->params[1]);}
+    virtual void tick();
+    virtual void start(NeopixelGrid* grid, Command* cmd);
+    virtual void render(Colour16* out, int count);
 };
 
+void SetAction::tick(){
+    render(grid->canvas(), PIXEL_COUNT);
+    grid->present();
+}
+
+void SetAction::start(NeopixelGrid* grid, Command* cmd){
+    this->grid = grid;
+    colour = colourFromRgb(cmd->params[0], cmd->params[1]);
+}
+
+void SetAction::render(Colour16* out, int count){
+    for(int i = 0; i < count; ++i){
+        out[i] = colour;
+    }
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-class ColourChangeAction: public Action {
-    float hue;         // current hue
-    float value;       // how bright the RGB is
-    float increment;   // for hue per tick
-    uint8_t white;       // white LED value.
+class ColourChangeAction: public Action, public LayerSource {
+    uint32_t hue;       // current hue, 2^32 to a turn so it wraps by itself.
+    uint32_t increment; // for hue per tick, likewise
+    uint16_t value;     // how bright the RGB is
+    uint16_t white;     // white LED value.
     NeopixelGrid* grid;
 
     public:
     virtual void tick();
     virtual void start(NeopixelGrid* grid, Command* cmd);
+    virtual void render(Colour16* out, int count);
 };
 
 void ColourChangeAction::tick(){
-    hue = hue + increment;
-    if(hue > 1.0) hue = 0;
-    uint32_t rgb = grid->hsvToRgb(hue, 1.0, value);
-    grid->set(rgb, white);
+    render(grid->canvas(), PIXEL_COUNT);
+    grid->present();
+}
+
+void ColourChangeAction::render(Colour16* out, int count){
+    hue += increment;
+    Colour16 c = hvToColour(hue >> 16, value, white);
+    for(int i=0; i<count; ++i){
+        out[i] = c;
+    }
 }
 
 void ColourChangeAction::start(NeopixelGrid* grid, Command* cmd){
     this->grid = grid;
     this->hue = 0;
-    this->value = (1.0f / SCALE) * (float)cmd->params[0];
-    this->increment = (1.0f/ SCALE) * (float)cmd->params[1];
-    this->white = cmd->params[2];
+    this->value = fraction16(cmd->params[0]);
+    this->increment = (uint32_t)(((int64_t)cmd->params[1] * 0x100000000LL) / (int32_t)SCALE);
+    this->white = (uint8_t)cmd->params[2] * 0x101;
 }
 ////////////////////////////////////////////////////////////////////////////////////////////
-class SparkleAction: public Action {
+class SparkleAction: public Action, public LayerSource {
     NeopixelGrid* grid;
     public:
     virtual void tick();
     virtual void start(NeopixelGrid* grid, Command* cmd);
+    virtual void render(Colour16* out, int count);
 };
 
 void SparkleAction::tick(){
-    for (int i = 0; i < PIXEL_COUNT; ++i){
-        grid->setPixel(i, rand() % 16 ? 0 : 0xffffffff, 0);
+    render(grid->canvas(), PIXEL_COUNT);
+    grid->present();
+}
+
+void SparkleAction::render(Colour16* out, int count){
+    const Colour16 off = {0, 0, 0, 0};
+    const Colour16 on = {0xFFFF, 0xFFFF, 0xFFFF, 0};
+    for (int i = 0; i < count; ++i){
+        out[i] = rand() % 16 ? off : on;
     }
-    grid->send();
 }
 
 void SparkleAction::start(NeopixelGrid* grid, Command* cmd){
@@ -101,16 +128,10 @@ void SparkleAction::start(NeopixelGrid* grid, Command* cmd){
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Utility base class for actions
-class ActionBase: public Action {
+class ActionBase: public Action, public LayerSource {
     protected:
-    const static int SINE_LENGTH = 1000;
-    static float sinfLookup[SINE_LENGTH];
-
-    float hue;          // colour to animate.
-    float hue2;          // colour to animate.
-    float value;       // how bright the RGB is 0..1
+    Wave wave;          // colours and brightness.
     float count;        // number of ripples
-    uint8_t white;       // white LED value.
     NeopixelGrid* grid;
     int baseIndices[PIXEL_COUNT]; // precalculated from radius & count.
     int phaseIndex;
@@ -122,45 +143,39 @@ class ActionBase: public Action {
     ActionBase();
     virtual void tick();
     virtual void start(NeopixelGrid* grid, Command* cmd) =0;
+    virtual void render(Colour16* out, int count);
     static void show(); // debug
 };
 
-float ActionBase::sinfLookup[ActionBase::SINE_LENGTH];
-
 ActionBase::ActionBase()
-: hue(0)
-, hue2(1)
-, value(1)
+: wave{0, 0xFFFF, true, 0xFFFF, 0}
 , count(1)
-, white(0)
 , grid(0)
 , phaseIndex(0)
 , inc(0)
 {
-    for(int i=0; i<SINE_LENGTH; ++i){
-        sinfLookup[i] = (1.0f + sinf(i * 2.0f * (float)M_PI / (float)SINE_LENGTH))/2;
-    }
 }
 
 void ActionBase::readParameters(NeopixelGrid* grid, Command* cmd){
     this->grid = grid;
-    this->hue = (1.0f / SCALE) * (float)cmd->params[0];
-    this->hue2 = (1.0f / SCALE) * (float)cmd->params[1];
-    this->value = (1.0f / SCALE) * (float)cmd->params[2];
+    wave.hue = fraction16(cmd->params[0]);
+    wave.hue2 = fraction16(cmd->params[1]);
+    wave.twoColours = cmd->params[1] >= 0;  // a negative hue2 means just the one colour.
+    wave.value = fraction16(cmd->params[2]);
+    wave.white = (uint8_t)cmd->params[5] * 0x101; // truncates as before.
     this->inc  =  cmd->params[3];
     this->count = (1.0f / SCALE) * (float)cmd->params[4];
-    this->white = cmd->params[5];
 
-    if(hue < 0) hue = 0; else if(hue > 1) hue = 1.0f;
-    if(hue2 < 0) hue2 = -1.0f; else if(hue2 > 1) hue2 = 1.0f;
-    if(value < 0) value = 0; else if(value > 1) value = 1.0f;
     if(inc < -500) inc = 500; else if(inc > 500) inc = 500;
     if(count < 0) count = 0; else if(count > 10) count = 10;
-    // ignore white - will truncate anyway.
 }
 
 void ActionBase::tick(){
-  
+    render(grid->canvas(), PIXEL_COUNT);
+    grid->present();
+}
+
+void ActionBase::render(Colour16* out, int count){
     phaseIndex -= inc;
     if(phaseIndex < 0) 
         phaseIndex += SINE_LENGTH;
@@ -169,26 +184,9 @@ void ActionBase::tick(){
 
     // So we've got a lookup in baseIndices of the index for each pixel of where they are 
     // in the sine array before the ripple effect is added. Add phaseIndex (varying) to
-    // get the actual position and then lookup the sine value.  This avoids a lot
-    // of floating point.
-    //absolute_time_t t0 = get_absolute_time();
-    for(int i=0; i<PIXEL_COUNT; ++i){
-        int idx = baseIndices[i] + phaseIndex;
-        while(idx >= SINE_LENGTH) idx -= SINE_LENGTH;
-
-        float v1 = sinfLookup[idx]; // range 0..1
-        float v2 = 1.0f - v1;
-        uint32_t rgb = grid->hvToRgb(hue, v1*value);
-        if(hue2 >= 0){
-            rgb = addRgb(rgb, grid->hvToRgb(hue2, v2*value));
-        }
-        grid->setPixel(i, rgb, white);
-    }
-   //absolute_time_t t1 = get_absolute_time();
-      grid->send();
-   //absolute_time_t t2 = get_absolute_time();
-  
-   //printf("T0-T1: %lu, T1-T2: %lu\n", (unsigned long)absolute_time_diff_us(t0,t1), (unsigned long)absolute_time_diff_us(t1,t2));
+    // get the actual position and then lookup the sine value.  All fixed point; see
+    // bench/colour_bench.cpp for what a frame costs.
+    waveColours(wave, baseIndices, phaseIndex, out, count);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -280,6 +278,48 @@ void SpokesAction::start(NeopixelGrid* grid, Command* cmd){
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////
+// Shows the grid's compositor layers.
+class CompositeAction: public Action {
+    NeopixelGrid* grid;
+    public:
+    virtual void tick() { grid->composite();}
+    virtual void start(NeopixelGrid* grid, Command* cmd) { this->grid = grid;}
+};
+
+// Each compositor layer has its own effects so layers can run the same effect
+// with different settings.
+struct LayerEffects {
+    SetAction set;
+    ColourChangeAction colourChange;
+    SparkleAction sparkle;
+    RipplesAction ripples;
+    SpokesAction spokes;
+    HorizontalAction horizontal;
+    VerticalAction vertical;
+
+    LayerSource* start(NeopixelGrid* grid, Command* cmd);
+};
+
+/// @brief Starts the effect for a command code.
+/// @return the effect or 0 (layer off) if the code isn't one.
+LayerSource* LayerEffects::start(NeopixelGrid* grid, Command* cmd){
+    Action* action;
+    LayerSource* source;
+    switch(cmd->code){
+        case 1: action = &set; source = &set; break;
+        case 3: action = &colourChange; source = &colourChange; break;
+        case 4: action = &ripples; source = &ripples; break;
+        case 5: action = &spokes; source = &spokes; break;
+        case 6: action = &horizontal; source = &horizontal; break;
+        case 7: action = &vertical; source = &vertical; break;
+        case 8: action = &sparkle; source = &sparkle; break;
+        default: return 0;
+    }
+    action->start(grid, cmd);
+    return source;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 
 NullAction nullAction;
@@ -290,6 +330,8 @@ RipplesAction ripplesAction;
 SpokesAction spokesAction;
 HorizontalAction horizontalAction;
 VerticalAction verticalAction;
+CompositeAction compositeAction;
+LayerEffects layerEffects[COMPOSITOR_LAYERS];
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -300,7 +342,8 @@ NeopixelGrid::NeopixelGrid()
 , cycle(1)
 , pio(pio0)
 , sm(0)
-, pixels(buffer)
+, output(pio0, 0, buffer, PIXEL_COUNT, IS_RGBW ? 32 : 24)
+, compositor(PIXEL_COUNT, layerFrame, accumulation)
 {
 
     // Setup PIO
@@ -308,21 +351,16 @@ NeopixelGrid::NeopixelGrid()
     uint offset = pio_add_program(pio, &ws2812_program);
     ws2812_program_init(pio, sm, offset, WS2812_PIN, 800000, IS_RGBW);
 
-    // Setup DMA for writing to pixels.
-    DmaConfig cfg = dma.getDefaultConfig();
-    cfg.bswap(false);
-    cfg.transferDataSize(DMA_SIZE_32);
-    cfg.dreq(pio_get_dreq(pio,sm,true));
-    cfg.enable(true);
-    cfg.readIncrement(true);
-    cfg.writeIncrement(false);
-    dma.configure(cfg, &pio->txf[sm], 0, 64);
-    
-   
-    // Zero the pixel buffer.
-    for(int i=0; i<PIXEL_COUNT*2; ++i){
-        buffer[i] = 0;
-    }
+    pixels = output.renderBuffer();
+    memset(frame, 0, sizeof(frame));
+    memset(dither, 0, sizeof(dither));
+
+    memset(streamFrames, 0, sizeof(streamFrames));
+    streamWriting = 0;
+    streamLatest = 1;
+    streamReading = 2;
+    streamFresh = false;
+    critical_section_init(&streamLock);
 
     queue_init(	&commandQueue, sizeof(Command), 16);
     initialiseCoordinates();
@@ -362,122 +400,29 @@ void NeopixelGrid::initialiseCoordinates(){
    
 }
 
-uint32_t NeopixelGrid::hsvToRgb(float hue, float saturation, float value){
-    float r, g, b;
-
-    if(hue > 1.0) hue = 1.0;
-    if(saturation > 1.0) saturation = 1.0;
-    if(value > 1.0) value = 1.0;
-
-    int h = (int)(hue * 6);
-    float f = hue * 6 - h;
-    float p = value * (1 - saturation);
-    float q = value * (1 - f * saturation);
-    float t = value * (1 - (1 - f) * saturation);
-
-    if (h == 0) {
-        r = value;
-        g = t;
-        b = p;
-    } else if (h == 1) {
-        r = q;
-        g = value;
-        b = p;
-    } else if (h == 2) {
-        r = p;
-        g = value;
-        b = t;
-    } else if (h == 3) {
-        r = p;
-        g = q;
-        b = value;
-    } else if (h == 4) {
-        r = t;
-        g = p;
-        b = value;
-    } else if (h <= 6) {
-        r = value;
-        g = p;
-        b = q;
-    } else {
-        assert(false);
-    }
-
-    uint32_t rgb = 
-        ((int)(r * 255) << 16) +
-        ((int)(g * 255) << 8) +
-        (int (b * 255));
-    return rgb;
-}
-
-uint32_t NeopixelGrid::hvToRgb(float hue, float value){
-    float r, g, b;
-
-    if(hue > 1.0) hue = 1.0;
-    if(value > 1.0) value = 1.0;
-
-    int h = (int)(hue * 6);
-    float f = hue * 6 - h;
-    float p = 0;
-    float q = value * (1 - f );
-    float t = value * f;
-
-    if (h == 0) {
-        r = value;
-        g = t;
-        b = p;
-    } else if (h == 1) {
-        r = q;
-        g = value;
-        b = p;
-    } else if (h == 2) {
-        r = p;
-        g = value;
-        b = t;
-    } else if (h == 3) {
-        r = p;
-        g = q;
-        b = value;
-    } else if (h == 4) {
-        r = t;
-        g = p;
-        b = value;
-    } else if (h <= 6) {
-        r = value;
-        g = p;
-        b = q;
-    } else {
-        assert(false);
-    }
-
-    uint32_t rgb = 
-        ((int)(r * 255) << 16) +
-        ((int)(g * 255) << 8) +
-        (int (b * 255));
-    return rgb;
+/// @brief Starts sending frames.  Call on the core that animates so the
+/// output's interrupts are taken there.
+void NeopixelGrid::start(){
+    output.start(NEOPIXEL_FRAME_HZ);
 }
 
-
-/// @brief Sends the array of pixels to the display.
+/// @brief Queues the pixels to go out at the next refresh.  Every pixel of
+/// the next frame must then be set as the buffer swapped in is stale.
 void NeopixelGrid::send(){
-    while(dma.isBusy()){
-        ::sleep_ms(1);
-    }
-    //dma.waitForFinish();
-    dma.fromBufferNow((void*)pixels, 64);
-    
-    // Flip buffer pointer for double buffering so we don't
-    // write into the memory the DMA is writing.
-    if(pixels == buffer) {
-        pixels = buffer + PIXEL_COUNT;
-    } else {
-        pixels = buffer;
-    }
+    output.present();
+    pixels = output.renderBuffer();
+}
+
+/// @brief Gamma corrects and dithers the canvas into the pixels and sends them.
+void NeopixelGrid::present(){
+    ditherToGrbw(frame, dither, pixels, PIXEL_COUNT);
+    send();
+}
 
-    // Old implementation.
-    // for(int i=0; i<PIXEL_COUNT; ++i){
-    //     pio_sm_put_blocking(pio0, 0, pixels[i]);
-    // }
+/// @brief Works out the next frame of the layers and sends it.
+void NeopixelGrid::composite(){
+    compositor.composite(to_ms_since_boot(get_absolute_time()), frame);
+    present();
 }
 
 void NeopixelGrid::set(uint32_t rgb, uint8_t white){
@@ -516,6 +461,9 @@ void NeopixelGrid::setPixelRaw(int idx, uint32_t rgbw){
 }
 
 void NeopixelGrid::tick() {
+    if(streamFresh){
+        takeStream();
+    }
     if(!queue_is_empty(&commandQueue)){
         Command cmd;
         if(queue_try_remove(&commandQueue,&cmd)){
@@ -563,6 +511,44 @@ void NeopixelGrid::tick() {
                currentAction = &sparkleAction;
                sparkleAction.start(this, &cmd);
                break;
+
+               case 9: {  // effect in a layer: layer, effect code then its parameters.
+               int layer = cmd.params[0];
+               if(layer < 0 || layer >= COMPOSITOR_LAYERS) break;
+               Command effect;
+               effect.code = cmd.params[1];
+               memcpy(effect.params, cmd.params + 2, 6 * sizeof(int32_t));
+               compositor.setSource(layer, layerEffects[layer].start(this, &effect));
+               currentAction = &compositeAction;
+               compositeAction.start(this, &cmd);
+               break;
+               }
+
+               case 10:  // layer blend and opacity: layer, mode, opacity, fade ms.
+               compositor.setBlend(cmd.params[0], (BlendMode)cmd.params[1]);
+               compositor.fade(cmd.params[0], fraction16(cmd.params[2]), cmd.params[3], to_ms_since_boot(get_absolute_time()));
+               currentAction = &compositeAction;
+               compositeAction.start(this, &cmd);
+               break;
+
+               case 11: { // keyframe: at ms, layer, mode, opacity, fade ms.
+               Keyframe k = {(uint32_t)cmd.params[0], (uint32_t)cmd.params[4], fraction16(cmd.params[3]),
+                   (uint8_t)cmd.params[1], (uint8_t)cmd.params[2]};
+               compositor.addKeyframe(k);
+               break;
+               }
+
+               case 12:  // timeline: 0 stop, 1 play with loop ms, 2 clear.
+               if(cmd.params[0] == 1){
+                   compositor.play(to_ms_since_boot(get_absolute_time()), cmd.params[1]);
+                   currentAction = &compositeAction;
+                   compositeAction.start(this, &cmd);
+               } else if(cmd.params[0] == 2){
+                   compositor.clearTimeline();
+               } else {
+                   compositor.stop();
+               }
+               break;
             }
         }
     }
@@ -575,6 +561,20 @@ void NeopixelGrid::tick() {
     }
 }
     
+/// @brief Shows the latest streamed frame, stopping any animation.
+void NeopixelGrid::takeStream(){
+    critical_section_enter_blocking(&streamLock);
+    uint8_t latest = streamLatest;
+    streamLatest = streamReading;
+    streamReading = latest;
+    streamFresh = false;
+    critical_section_exit(&streamLock);
+
+    memcpy(pixels, streamFrames[streamReading], sizeof(streamFrames[0]));
+    currentAction = 0;
+    send();
+}
+
 bool NeopixelGrid::run(Command* cmd){
     bool success = queue_try_add(&commandQueue, cmd);
     return success;
@@ -582,19 +582,33 @@ bool NeopixelGrid::run(Command* cmd){
 
 
 void run_neopixel() {
+    // Let core 0 pause this core while it writes uploads to flash.
+    flash_safe_execute_core_init();
+    grid.start();
     grid.send();
     while(true) {
+        grid.waitForFrame();
         grid.tick();
-        ::sleep_ms(1); 
     }
 }
 
-void NeopixelGrid::setAsync(uint32_t rgb, uint8_t white){
+/// @brief Runs an effect command, in a compositor layer if layer >= 0.
+bool NeopixelGrid::runEffect(Command* cmd, int layer){
+    if(layer < 0) return run(cmd);
+    Command layered;
+    layered.code = 9;  // effect in a layer
+    layered.params[0] = layer;
+    layered.params[1] = cmd->code;
+    memcpy(layered.params + 2, cmd->params, 6 * sizeof(int32_t));
+    return run(&layered);
+}
+
+void NeopixelGrid::setAsync(uint32_t rgb, uint8_t white, int layer){
     Command cmd;
     cmd.code = 1; // set colour
     cmd.params[0] = rgb;
     cmd.params[1] = white;
-    run(&cmd);
+    runEffect(&cmd, layer);
 }
 
 void NeopixelGrid::rateAsync(unsigned int rate){
@@ -605,16 +619,16 @@ void NeopixelGrid::rateAsync(unsigned int rate){
 }
  
 
-void NeopixelGrid::colourChangeAsync(float value, float increment, uint8_t white){
+void NeopixelGrid::colourChangeAsync(float value, float increment, uint8_t white, int layer){
     Command cmd;
     cmd.code = 3;  // colour change
     cmd.params[0] = (int32_t)(value * SCALE);
     cmd.params[1] = (int32_t)(increment * SCALE); 
     cmd.params[2] = white;
-    run(&cmd);
+    runEffect(&cmd, layer);
 }
 
-void NeopixelGrid::sendRippleCmd(uint16_t code, float hue, float hue2, float value, float increment, float count, uint8_t white){
+void NeopixelGrid::sendRippleCmd(uint16_t code, float hue, float hue2, float value, float increment, float count, uint8_t white, int layer){
     Command cmd;
     cmd.code = code;
     cmd.params[0] = (int32_t)(hue * SCALE);
@@ -623,27 +637,96 @@ void NeopixelGrid::sendRippleCmd(uint16_t code, float hue, float hue2, float val
     cmd.params[3] = increment;
     cmd.params[4] = (int32_t)(count * SCALE); 
     cmd.params[5] = white;
-    run(&cmd);
+    runEffect(&cmd, layer);
 }
 
-void NeopixelGrid::rippleAsync(float hue, float hue2, float value, float increment, float count, uint8_t white){
-    sendRippleCmd(4, hue, hue2, value, increment, count, white);
+void NeopixelGrid::rippleAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer){
+    sendRippleCmd(4, hue, hue2, value, increment, count, white, layer);
  }
 
-void NeopixelGrid::spokesAsync(float hue, float hue2, float value, float increment, float count, uint8_t white){
-    sendRippleCmd(5, hue, hue2, value, increment, count, white);
+void NeopixelGrid::spokesAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer){
+    sendRippleCmd(5, hue, hue2, value, increment, count, white, layer);
 }
 
-void NeopixelGrid::horizontalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white){
-    sendRippleCmd(6, hue, hue2, value, increment, count, white);
+void NeopixelGrid::horizontalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer){
+    sendRippleCmd(6, hue, hue2, value, increment, count, white, layer);
 }
 
-void NeopixelGrid::verticalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white){
-    sendRippleCmd(7, hue, hue2, value, increment, count, white);
+void NeopixelGrid::verticalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer){
+    sendRippleCmd(7, hue, hue2, value, increment, count, white, layer);
 }
 
-void NeopixelGrid::sparkleAsync(){
+void NeopixelGrid::sparkleAsync(int layer){
     Command cmd;
     cmd.code = 8;  // sparkle
+    runEffect(&cmd, layer);
+}
+
+void NeopixelGrid::layerOffAsync(int layer){
+    Command cmd;
+    cmd.code = 0;  // no effect
+    runEffect(&cmd, layer);
+}
+
+/// @brief Sets how a layer blends and fades it to a new opacity.
+/// @param opacity is 0 .. 1.
+/// @param fadeSeconds is how long the fade takes, 0 for at once.
+void NeopixelGrid::blendAsync(int layer, BlendMode blend, float opacity, float fadeSeconds){
+    Command cmd;
+    cmd.code = 10; // blend
+    cmd.params[0] = layer;
+    cmd.params[1] = blend;
+    cmd.params[2] = (int32_t)(opacity * SCALE);
+    cmd.params[3] = (int32_t)(fadeSeconds * 1000);
+    run(&cmd);
+}
+
+/// @brief Adds a blendAsync() to the timeline, to happen atSeconds after it starts.
+void NeopixelGrid::keyframeAsync(float atSeconds, int layer, BlendMode blend, float opacity, float fadeSeconds){
+    Command cmd;
+    cmd.code = 11; // keyframe
+    cmd.params[0] = (int32_t)(atSeconds * 1000);
+    cmd.params[1] = layer;
+    cmd.params[2] = blend;
+    cmd.params[3] = (int32_t)(opacity * SCALE);
+    cmd.params[4] = (int32_t)(fadeSeconds * 1000);
+    run(&cmd);
+}
+
+void NeopixelGrid::playAsync(float loopSeconds){
+    Command cmd;
+    cmd.code = 12; // timeline
+    cmd.params[0] = 1;
+    cmd.params[1] = (int32_t)(loopSeconds * 1000);
+    run(&cmd);
+}
+
+void NeopixelGrid::stopAsync(){
+    Command cmd;
+    cmd.code = 12; // timeline
+    cmd.params[0] = 0;
     run(&cmd);
 }
+
+void NeopixelGrid::clearTimelineAsync(){
+    Command cmd;
+    cmd.code = 12; // timeline
+    cmd.params[0] = 2;
+    run(&cmd);
+}
+
+/// @brief Hands the stream buffer to the animation core to show at its next
+/// tick.  If it hasn't taken the previous frame by then, that one is skipped.
+/// streamBuffer() then gives the next buffer to fill.
+void NeopixelGrid::streamAsync(){
+    critical_section_enter_blocking(&streamLock);
+    uint8_t shown = streamWriting;
+    streamWriting = streamLatest;
+    streamLatest = shown;
+    streamFresh = true;
+    critical_section_exit(&streamLock);
+
+    // Senders may only update part of a frame, so carry on from this one.
+    // The animation core may be copying it too, but neither writes it.
+    memcpy(streamFrames[streamWriting], streamFrames[shown], sizeof(streamFrames[0]));
+}
@@ -5,13 +5,22 @@
 #include "pico/stdlib.h"
 #include "pico/util/queue.h"
 #include "hardware/pio.h"
-#include "dma.hpp"
+#include "frame_output.hpp"
+#include "colour.hpp"
+#include "compositor.hpp"
 
 #define GRID_WIDTH (8)
 #define GRID_HEIGHT (8)
 #define PIXEL_COUNT (GRID_WIDTH * GRID_HEIGHT)
 #define SCALE (10000.0f)  // for sending floats via ints
 
+// Frames per second sent to the grid.  64 RGBW pixels take 2.6ms to send so
+// this is close to the most it can do, and about the speed the animations
+// ran at when the loop wasn't paced.
+#ifndef NEOPIXEL_FRAME_HZ
+#define NEOPIXEL_FRAME_HZ 300
+#endif
+
 
    // Pixel format is:  GGRRBBWW
     // With input in top left and words on silk screen in normal orientation
@@ -50,13 +59,31 @@ class NeopixelGrid {
     uint32_t colour;
     uint32_t white;
 
-    uint32_t buffer[2*PIXEL_COUNT]; // Allow for double buffering.
-    uint32_t* pixels;
+    uint32_t buffer[3*PIXEL_COUNT]; // render, queued and in flight frames (see FrameOutput).
+    uint32_t* pixels;               // the one being drawn.
+
+    Colour16 frame[PIXEL_COUNT];    // what animations draw, see present().
+    uint8_t dither[4*PIXEL_COUNT];  // fraction carried to the next frame per channel.
 
     PIO pio; // which PIO is in use to drive the pixels.
     uint sm; // and which statemachine is in use.
 
-    Dma dma; // to shovel pixels to the PIO
+    FrameOutput output; // DMA to the PIO at NEOPIXEL_FRAME_HZ.
+
+    // Frames streamed from the network (see stream_receiver.hpp): the network
+    // core fills one, one is the latest complete frame and the animation core
+    // reads the third, so neither core waits for the other.
+    uint32_t streamFrames[3][PIXEL_COUNT];
+    uint8_t streamWriting;
+    uint8_t streamLatest;
+    uint8_t streamReading;
+    volatile bool streamFresh;      // streamLatest hasn't been shown.
+    critical_section_t streamLock;  // for swapping the indices.
+
+    // Layered effects (see compositor.hpp), shown while compositing.
+    Colour16 layerFrame[PIXEL_COUNT];
+    uint32_t accumulation[4*PIXEL_COUNT];
+    Compositor compositor;
 
     const uint32_t RED = 0x00FF0000;
     const uint32_t GREEN = 0xFF000000;
@@ -83,7 +110,7 @@ class NeopixelGrid {
                 (uint32_t) w;
     }
 
-    uint cycle_time; // for animation etc.
+    uint cycle_time; // frames per animation step.
     uint cycle;
     Action* currentAction;
     queue_t commandQueue;
@@ -91,31 +118,49 @@ class NeopixelGrid {
 
     void initialiseCoordinates();
 
-    void sendRippleCmd(uint16_t code, float hue, float hue2, float value, float increment, float count, uint8_t white );
+    void takeStream();
+
+    void sendRippleCmd(uint16_t code, float hue, float hue2, float value, float increment, float count, uint8_t white, int layer);
+    bool runEffect(Command* cmd, int layer);
 
     public:
     NeopixelGrid();
+    void start();           // on the animation core.
+    void waitForFrame() { output.waitForFrame();}
     void send();
     void set(uint32_t rgb, uint8_t white);  // whole grid
     void setPixel(int idx, uint32_t rgb, uint8_t white);  // single pixel
     void setPixelRaw(int idx, uint32_t rgbw);  // single pixel in Neopixel format
+
+    Colour16* canvas() { return frame;}  // PIXEL_COUNT colours for animations.
+    void present(); // gamma corrects and dithers the canvas then sends it.
+    void composite(); // draws the layers on the canvas and presents it.
     
     void tick(); // to run commands, animate etc.
 
-    static uint32_t hsvToRgb(float h, float s, float v); 
-    static uint32_t hvToRgb(float hue, float value); // assumes s = 1
-   
     const Coordinate& coordinate(int idx) { return coordinates[idx];}
     bool run(Command* cmd); // true if accepted to run.
 
-    void setAsync(uint32_t rgb, uint8_t white);
+    // Effects replace whatever is showing or, given a layer, go in that
+    // compositor layer and show the composite.
+    void setAsync(uint32_t rgb, uint8_t white, int layer = -1);
     void rateAsync(unsigned int rate);
-    void colourChangeAsync(float value, float increment, uint8_t white);
-    void rippleAsync(float hue, float hue2, float value, float increment, float count, uint8_t white);
-    void spokesAsync(float hue, float hue2, float value, float increment, float count, uint8_t white);
-    void horizontalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white);
-    void verticalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white);
-    void sparkleAsync();
+    void colourChangeAsync(float value, float increment, uint8_t white, int layer = -1);
+    void rippleAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer = -1);
+    void spokesAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer = -1);
+    void horizontalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer = -1);
+    void verticalAsync(float hue, float hue2, float value, float increment, float count, uint8_t white, int layer = -1);
+    void sparkleAsync(int layer = -1);
+
+    void layerOffAsync(int layer);
+    void blendAsync(int layer, BlendMode blend, float opacity, float fadeSeconds);
+    void keyframeAsync(float atSeconds, int layer, BlendMode blend, float opacity, float fadeSeconds);
+    void playAsync(float loopSeconds);  // plays the keyframes from the start, 0 for once.
+    void stopAsync();
+    void clearTimelineAsync();
+
+    uint32_t* streamBuffer() { return streamFrames[streamWriting];}   // GRBW words, on the network core.
+    void streamAsync();     // shows the stream buffer and moves on to the next.
 };
 
 
@@ -3,70 +3,132 @@
 
 extern NeopixelGrid grid;  
 
-bool NeopixelWebapp::matches(const char* verb, const char* path){
-    bool accept = false;
-    if(strcmp(verb,"GET") == 0) {
-        accept = 
-            strncmp(path,"/set",4) == 0 ||
-            strncmp(path,"/cycle",6) == 0 ||
-            strncmp(path,"/colour",7) == 0 ||
-            strncmp(path,"/ripples",8) == 0 ||
-            strncmp(path,"/spokes",7) == 0 ||
-            strncmp(path,"/horizontal",11) == 0 ||
-            strncmp(path,"/vertical",9) == 0 ||
-            strncmp(path,"/sparkle",8) == 0 ||
-            strncmp(path,"/show",5) == 0 ||
-            false;
-            ;
-        if(accept) printf("Neopixel Webapp Accepting path %s\n", path);
-    }
-    return accept;
+// Query parameters shared by all the routes.
+struct NeopixelParams {
+    int32_t rate;
+    int32_t white;
+    uint32_t rgb;
+    float increment;
+    float value;
+    float hue;
+    float hue2;     // -1 for none.
+    float count;
+    int32_t layer;  // -1 to replace what's showing.
+    int32_t blend;  // BlendMode.
+    float opacity;
+    float fade;     // seconds.
+    float at;       // seconds into the timeline.
+    float loop;     // seconds, 0 to play once.
+};
+
+static const ParamSpec specs[] = {
+    {"rate",  ParamType::INT,   0, 255,    1,    offsetof(NeopixelParams, rate)},
+    {"white", ParamType::INT,   0, 255,    0,    offsetof(NeopixelParams, white)},
+    {"rgb",   ParamType::RGB,   0, 0,      0,    offsetof(NeopixelParams, rgb)},
+    {"inc",   ParamType::FLOAT, -1000, 1000, 0.1f, offsetof(NeopixelParams, increment)},
+    {"value", ParamType::FLOAT, 0, 1,      0,    offsetof(NeopixelParams, value)},
+    {"hue",   ParamType::FLOAT, 0, 1,      0,    offsetof(NeopixelParams, hue)},
+    {"hue2",  ParamType::FLOAT, -1, 1,     -1,   offsetof(NeopixelParams, hue2)},
+    {"count", ParamType::FLOAT, 0, 1000,   1,    offsetof(NeopixelParams, count)},
+    {"layer", ParamType::INT,   -1, COMPOSITOR_LAYERS - 1, -1, offsetof(NeopixelParams, layer)},
+    {"blend", ParamType::INT,   0, BLEND_MODES - 1, BLEND_ADD, offsetof(NeopixelParams, blend)},
+    {"opacity", ParamType::FLOAT, 0, 1,    1,    offsetof(NeopixelParams, opacity)},
+    {"fade",  ParamType::FLOAT, 0, 3600,   0,    offsetof(NeopixelParams, fade)},
+    {"at",    ParamType::FLOAT, 0, 86400,  0,    offsetof(NeopixelParams, at)},
+    {"loop",  ParamType::FLOAT, 0, 86400,  0,    offsetof(NeopixelParams, loop)},
+};
+
+static const ParamSchema schema(specs, sizeof(specs)/sizeof(specs[0]), sizeof(NeopixelParams));
+
+void NeopixelWebapp::addRoutes(Router& router){
+    router.exact("GET", "/set", this, SET, &schema);
+    router.exact("GET", "/cycle", this, CYCLE, &schema);
+    router.exact("GET", "/colour", this, COLOUR, &schema);
+    router.exact("GET", "/ripples", this, RIPPLES, &schema);
+    router.exact("GET", "/spokes", this, SPOKES, &schema);
+    router.exact("GET", "/horizontal", this, HORIZONTAL, &schema);
+    router.exact("GET", "/vertical", this, VERTICAL, &schema);
+    router.exact("GET", "/sparkle", this, SPARKLE, &schema);
+    router.exact("GET", "/show", this, SHOW);
+
+    // Compositor layers and timeline.
+    router.exact("GET", "/off", this, OFF, &schema);
+    router.exact("GET", "/blend", this, BLEND, &schema);
+    router.exact("GET", "/keyframe", this, KEYFRAME, &schema);
+    router.exact("GET", "/play", this, PLAY, &schema);
+    router.exact("GET", "/stop", this, STOP);
+    router.exact("GET", "/clear", this, CLEAR);
 }
 
 void NeopixelWebapp::process( HttpRequest& request, HttpResponse& response){
 
     printf("Neopixel Webapp Processing request for %s\n",request.path());
-    unsigned int rate = 1;
-    uint32_t rgb = 0;
-    int w = 0;
-    float increment = 0.1f;
-    float value = 0.0f;
-    float hue = 0.0f;
-    float hue2 = -1.0f;
-    float count = 1.0f;
-
-    BlockListIter<Parameter> iter = request.Parameters().iter();
-    Parameter* p;
-    while(p = iter.next()){
-        printf("Parameter %s -> %s\n", p->name(), p->value());
-        if(strcmp(p->name(), "rate") == 0) rate = (unsigned) p->asInt();
-        if(strcmp(p->name(), "white") == 0) w = p->asInt();
-        if(strcmp(p->name(), "rgb") == 0) rgb = p->asRgb();
-        if(strcmp(p->name(), "inc") == 0) increment = p->asFloat();
-        if(strcmp(p->name(), "value") == 0) value = p->asFloat();
-        if(strcmp(p->name(), "hue") == 0) hue = p->asFloat();
-        if(strcmp(p->name(), "hue2") == 0) hue2 = p->asFloat();
-        if(strcmp(p->name(), "count") == 0) count = p->asFloat();
+    const NeopixelParams& params = request.params<NeopixelParams>();
+    unsigned int rate = (unsigned) params.rate;
+    uint32_t rgb = params.rgb;
+    int w = params.white;
+    float increment = params.increment;
+    float value = params.value;
+    float hue = params.hue;
+    float hue2 = params.hue2;
+    float count = params.count;
+    int layer = params.layer;
+    BlendMode blend = (BlendMode)params.blend;
 
+    // These only make sense for a layer, there's no default.
+    int route = request.route();
+    if(layer < 0 && (route == OFF || route == BLEND || route == KEYFRAME)){
+        response.setStatus(400, "Bad Request");
+        response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
+        response.addHeader("Content-Type", "text/plain");
+        response.setBody("A layer is required\r\n");
+        return;
     }
 
-    if(strncmp(request.path(),"/set",4) == 0) {
-         grid.setAsync(rgb, w);
-    } else if(strncmp(request.path(),"/cycle",6) == 0) {
+    switch(route) {
+    case SET:
+        grid.setAsync(rgb, w, layer);
+        break;
+    case CYCLE:
         grid.rateAsync(rate);
-    } else if (strncmp(request.path(),"/colour",7) == 0){
-        grid.colourChangeAsync(value, increment, w);
-    } else if (strncmp(request.path(),"/ripples",8) == 0) {
-        grid.rippleAsync(hue, hue2, value, (int) increment, count, w);
-    } else if (strncmp(request.path(),"/spokes",7) == 0) {
-        grid.spokesAsync(hue, hue2, value, increment, count, w);
-    } else if (strncmp(request.path(),"/horizontal",11) == 0) {
-        grid.horizontalAsync(hue, hue2, value, increment, count, w);
-    } else if (strncmp(request.path(),"/vertical",9) == 0) {
-        grid.verticalAsync(hue, hue2, value, increment, count, w);
-    } else if (strncmp(request.path(),"/sparkle",8) == 0) {
-        grid.sparkleAsync();
-    } else if (strncmp(request.path(),"/show",5) == 0)  {
+        break;
+    case COLOUR:
+        grid.colourChangeAsync(value, increment, w, layer);
+        break;
+    case RIPPLES:
+        grid.rippleAsync(hue, hue2, value, (int) increment, count, w, layer);
+        break;
+    case SPOKES:
+        grid.spokesAsync(hue, hue2, value, increment, count, w, layer);
+        break;
+    case HORIZONTAL:
+        grid.horizontalAsync(hue, hue2, value, increment, count, w, layer);
+        break;
+    case VERTICAL:
+        grid.verticalAsync(hue, hue2, value, increment, count, w, layer);
+        break;
+    case SPARKLE:
+        grid.sparkleAsync(layer);
+        break;
+    case OFF:
+        grid.layerOffAsync(layer);
+        break;
+    case BLEND:
+        grid.blendAsync(layer, blend, params.opacity, params.fade);
+        break;
+    case KEYFRAME:
+        grid.keyframeAsync(params.at, layer, blend, params.opacity, params.fade);
+        break;
+    case PLAY:
+        grid.playAsync(params.loop);
+        break;
+    case STOP:
+        grid.stopAsync();
+        break;
+    case CLEAR:
+        grid.clearTimelineAsync();
+        break;
+    case SHOW: {
         printf("Radius\n");
         int idx = 0;
         for(int iy=0; iy<GRID_HEIGHT; ++iy){
@@ -87,14 +149,12 @@ void NeopixelWebapp::process( HttpRequest& request, HttpResponse& response){
             }
             printf("\n");
         }
- 
-    } else {
-
+        break;
+    }
     }
   
 
     response.setStatus(200,"OK");
-    response.addHeader("Server", "PicoW");
-    response.addHeader("Access-Control-Allow-Origin","*");
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
     
 }
@@ -1,11 +1,15 @@
 #ifndef NEOPIXEL_WEBAPP_HPP
 #define NEOPIXEL_WEBAPP_HPP
 
-#include "webserver.hpp"
+#include "../WebServer/webserver.hpp"
 
 class NeopixelWebapp: public WebApp{
+    // Route tags.
+    enum {SET, CYCLE, COLOUR, RIPPLES, SPOKES, HORIZONTAL, VERTICAL, SPARKLE, SHOW,
+        OFF, BLEND, KEYFRAME, PLAY, STOP, CLEAR};
+
    public:
-    virtual bool matches(const char* verb, const char* path);
+    virtual void addRoutes(Router& router);
     virtual void process(HttpRequest& request, HttpResponse& response);
 
 };
@@ -0,0 +1,27 @@
+#include "parallel_output.hpp"
+#include "ws2812_parallel.pio.h"
+
+/// @brief Claims the state machine and loads the parallel program.
+/// @param pio and sm are the state machine to use.
+/// @param pinBase is the pin for chain 0, chain n is on pinBase + n.
+/// @param pinCount is the number of chains fitted, up to PARALLEL_STRIPS.
+/// @param buffers is 3 * bitplaneWords(pixelsPerStrip, bitsPerPixel) words.
+/// @param pixelsPerStrip is the length of the longest chain.
+/// @param bitsPerPixel is 32 for RGBW, 24 for RGB.
+ParallelStrips::ParallelStrips(PIO pio, uint sm, uint pinBase, uint pinCount, uint32_t* buffers, uint pixelsPerStrip, uint bitsPerPixel)
+: pins(pinCount)
+, pixels(pixelsPerStrip)
+, bitsPerPixel(bitsPerPixel)
+, output(pio, sm, buffers, bitplaneWords(pixelsPerStrip, bitsPerPixel), 4)   // each word is 4 bits of every chain.
+{
+    pio_sm_claim(pio, sm);
+    uint offset = pio_add_program(pio, &ws2812_parallel_program);
+    ws2812_parallel_program_init(pio, sm, offset, pinBase, pinCount, 800000);
+}
+
+/// @brief Converts a frame to bit-planes and queues it for the next refresh.
+/// @param strips is each chain's pixels; null for chains not fitted or to send black.
+void ParallelStrips::show(const uint32_t* const strips[PARALLEL_STRIPS]){
+    transposeStrips(strips, pixels, bitsPerPixel, output.renderBuffer());
+    output.present();
+}
@@ -0,0 +1,48 @@
+#ifndef PARALLEL_OUTPUT_HPP
+#define PARALLEL_OUTPUT_HPP
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "frame_output.hpp"
+#include "bitplanes.hpp"
+
+// Drives up to PARALLEL_STRIPS chains of LEDs on consecutive pins from a
+// single PIO state machine and DMA channel, so 8 chains of n pixels refresh
+// as fast as one chain of n would.  Frames are drawn per chain as usual (one
+// GRBW or GRB word per pixel) and show() transposes them into bit-planes
+// (bitplanes.hpp) in FrameOutput's render buffer, e.g. for 8 x 250 RGBW:
+//
+//   static uint32_t planes[3 * 250 * 32 / 4];
+//   static uint32_t strip[8][250];
+//   ParallelStrips strips(pio1, 0, 2, 8, planes, 250, 32);
+//   strips.start(NEOPIXEL_FRAME_HZ);
+//   while(true){
+//       strips.waitForFrame();
+//       ... draw into strip[0 .. 7] ...
+//       const uint32_t* chains[8] = {strip[0], strip[1], ...};
+//       strips.show(chains);
+//   }
+//
+// It can run alongside the grid's output if started on the same core, on
+// the other PIO (see FrameOutput and bench/output_check.cpp).  All the chains
+// must be the same type of LED; shorter ones are padded to pixelsPerStrip by
+// show() with whatever the caller passes.
+class ParallelStrips {
+    uint pins;                  // chains fitted.
+    uint pixels;                // per chain.
+    uint bitsPerPixel;
+    FrameOutput output;
+
+    public:
+    ParallelStrips(PIO pio, uint sm, uint pinBase, uint pinCount, uint32_t* buffers, uint pixelsPerStrip, uint bitsPerPixel);
+
+    void start(uint32_t refreshHz) { output.start(refreshHz);}
+    void show(const uint32_t* const strips[PARALLEL_STRIPS]);
+    void waitForFrame() { output.waitForFrame();}
+
+    uint32_t framesSent() const { return output.framesSent();}
+    uint32_t framesDropped() const { return output.framesDropped();}
+    uint32_t framesLate() const { return output.framesLate();}
+};
+
+#endif
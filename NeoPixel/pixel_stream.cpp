@@ -0,0 +1,209 @@
+#include <string.h>
+#include "pixel_stream.hpp"
+
+// DDP header, byte 0.
+#define DDP_VERSION_MASK 0xC0
+#define DDP_VERSION_1    0x40
+#define DDP_TIMECODE     0x10
+#define DDP_STORAGE      0x08
+#define DDP_REPLY        0x04
+#define DDP_QUERY        0x02
+#define DDP_PUSH         0x01
+
+#define DDP_HEADER 10
+#define DDP_ID_DISPLAY 1
+
+// DDP data type: bits 5-3 the pixel type, 2-0 the bits per element.
+#define DDP_TYPE_CUSTOM 0x80
+#define DDP_TYPE_RGB    1
+#define DDP_TYPE_RGBW   3
+#define DDP_SIZE_8      3
+
+// E1.31 root and framing layer vectors.
+#define E131_ROOT_DATA      0x00000004
+#define E131_ROOT_EXTENDED  0x00000008
+#define E131_FRAMING_DATA   0x00000002
+#define E131_FRAMING_SYNC   0x00000001
+
+#define E131_PREVIEW        0x80    // framing options.
+#define E131_TERMINATED     0x40
+
+#define E131_DATA_OFFSET    126     // first channel, after the start code.
+#define E131_SYNC_LENGTH    49
+
+// Sequence numbers up to this far behind the last are late, not a new run.
+#define E131_SEQUENCE_WINDOW 20
+
+static const uint8_t ACN_IDENTIFIER[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+
+// Where each of R, G, B and W goes in a GGRRBBWW word.
+static const uint8_t SHIFT[4] = {16, 24, 8, 0};
+
+static inline uint16_t be16(const uint8_t* p){
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t be32(const uint8_t* p){
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/// @brief Sets up the mapping; call setTarget() before decoding.
+/// @param pixelCount is the number of pixels driven.
+/// @param channelsPerPixel is 3 for RGB, 4 for RGBW, used when the packets don't say.
+/// @param firstUniverse is the E1.31 universe holding pixel 0.
+PixelStream::PixelStream(int pixelCount, int channelsPerPixel, uint16_t firstUniverse)
+: pixels(0)
+, pixelCount(pixelCount)
+, channels(channelsPerPixel == 4 ? 4 : 3)
+, firstUniverse(firstUniverse)
+, ddpSequence(0)
+, syncAddress(0)
+, packetCount(0)
+, frameCount(0)
+, droppedCount(0)
+, ignoredCount(0)
+{
+    int perUniverse = E131_CHANNELS / channels;
+    universes = (pixelCount + perUniverse - 1) / perUniverse;
+    if(universes > STREAM_UNIVERSES_MAX) universes = STREAM_UNIVERSES_MAX;
+    memset(e131Sequence, 0, sizeof(e131Sequence));
+    memset(e131Seen, 0, sizeof(e131Seen));
+}
+
+/// @brief Decodes a packet into the target.
+/// @param protocol is what the port it came to carries.
+/// @param packet is the UDP payload.
+/// @param length is its size in bytes.
+/// @return true if a frame is complete and should be shown.
+bool PixelStream::decode(Protocol protocol, const uint8_t* packet, size_t length){
+    ++packetCount;
+    if(!pixels) return ignore();
+    bool complete = protocol == DDP ? ddp(packet, length) : e131(packet, length);
+    if(complete) ++frameCount;
+    return complete;
+}
+
+bool PixelStream::ignore(){
+    ++ignoredCount;
+    return false;
+}
+
+/// @brief Copies channels into the pixels, reordering each pixel's R, G, B
+/// (and W) into place.  Channels past the last pixel are dropped.
+/// @param channel is the first channel's position counting from pixel 0.
+void PixelStream::put(uint32_t channel, const uint8_t* data, uint32_t count, int channelsPerPixel){
+    uint32_t end = (uint32_t)pixelCount * channelsPerPixel;
+    if(channel >= end) return;
+    if(count > end - channel) count = end - channel;
+
+    uint32_t* p = pixels + channel / channelsPerPixel;
+    int c = channel % channelsPerPixel;
+
+    // Packets needn't start or end on a pixel boundary.
+    for(; count && c != 0; --count, ++data){
+        *p = (*p & ~(0xFFu << SHIFT[c])) | ((uint32_t)*data << SHIFT[c]);
+        if(++c == channelsPerPixel){ c = 0; ++p;}
+    }
+
+    if(channelsPerPixel == 3){
+        for(; count >= 3; count -= 3, data += 3){
+            *p++ = ((uint32_t)data[1] << 24) | ((uint32_t)data[0] << 16) | ((uint32_t)data[2] << 8);
+        }
+    } else {
+        for(; count >= 4; count -= 4, data += 4){
+            *p++ = ((uint32_t)data[1] << 24) | ((uint32_t)data[0] << 16) | ((uint32_t)data[2] << 8) | data[3];
+        }
+    }
+
+    for(c = 0; count; --count, ++data, ++c){
+        *p = (*p & ~(0xFFu << SHIFT[c])) | ((uint32_t)*data << SHIFT[c]);
+    }
+}
+
+/// @return true on the push flag.
+bool PixelStream::ddp(const uint8_t* packet, size_t length){
+    if(length < DDP_HEADER) return ignore();
+    uint8_t flags = packet[0];
+    if((flags & DDP_VERSION_MASK) != DDP_VERSION_1) return ignore();
+    if(flags & (DDP_STORAGE | DDP_REPLY | DDP_QUERY)) return ignore();    // config and status aren't supported.
+    if(packet[3] != DDP_ID_DISPLAY) return ignore();
+
+    size_t header = (flags & DDP_TIMECODE) ? DDP_HEADER + 4 : DDP_HEADER;
+    uint32_t offset = be32(packet + 4);
+    uint32_t count = be16(packet + 8);
+    if(length < header || count > length - header) return ignore();
+
+    int channelsPerPixel = channels;
+    uint8_t type = packet[2];
+    if(type != 0 && !(type & DDP_TYPE_CUSTOM)){
+        int pixelType = (type >> 3) & 7;
+        int size = type & 7;
+        if(size != DDP_SIZE_8 && size != 0) return ignore();
+        if(pixelType == DDP_TYPE_RGB) channelsPerPixel = 3;
+        else if(pixelType == DDP_TYPE_RGBW) channelsPerPixel = 4;
+        else if(pixelType != 0) return ignore();
+    }
+
+    // 1 .. 15 then back to 1; 0 means the sender doesn't number packets.
+    uint8_t sequence = packet[1] & 0x0F;
+    if(sequence){
+        if(ddpSequence){
+            int gap = (sequence - (ddpSequence % 15 + 1) + 15) % 15;
+            if(gap < 8) droppedCount += gap;
+        }
+        ddpSequence = sequence;
+    }
+
+    put(offset, packet + header, count, channelsPerPixel);
+    return (flags & DDP_PUSH) != 0;
+}
+
+/// @return true on a matching sync packet or, without sync, the last universe.
+bool PixelStream::e131(const uint8_t* packet, size_t length){
+    if(length < E131_SYNC_LENGTH) return ignore();
+    if(be16(packet) != 0x0010 || be16(packet + 2) != 0 || memcmp(packet + 4, ACN_IDENTIFIER, sizeof(ACN_IDENTIFIER)) != 0){
+        return ignore();
+    }
+
+    uint32_t rootVector = be32(packet + 18);
+    if(rootVector == E131_ROOT_EXTENDED){
+        if(be32(packet + 40) != E131_FRAMING_SYNC) return ignore();
+        uint16_t address = be16(packet + 45);
+        if(syncAddress == 0 || address != syncAddress) return ignore();
+        syncAddress = 0;
+        return true;
+    }
+
+    if(rootVector != E131_ROOT_DATA || length < E131_DATA_OFFSET) return ignore();
+    if(be32(packet + 40) != E131_FRAMING_DATA) return ignore();
+    if(packet[112] & (E131_PREVIEW | E131_TERMINATED)) return ignore();
+    if(packet[117] != 0x02 || packet[118] != 0xA1) return ignore();     // DMP set property, as E1.31 requires.
+    if(packet[125] != 0) return ignore();                               // not dimmer levels.
+
+    int index = be16(packet + 113) - firstUniverse;
+    if(index < 0 || index >= universes) return ignore();
+
+    uint32_t count = be16(packet + 123);                                // start code included.
+    if(count < 1 || count - 1 > length - E131_DATA_OFFSET) return ignore();
+    --count;
+
+    uint8_t sequence = packet[111];
+    if(e131Seen[index]){
+        int gap = (int8_t)(sequence - e131Sequence[index]);
+        if(gap <= 0 && gap > -E131_SEQUENCE_WINDOW) return ignore();
+        if(gap > 1) droppedCount += gap - 1;
+    }
+    e131Seen[index] = true;
+    e131Sequence[index] = sequence;
+
+    uint32_t perUniverse = (E131_CHANNELS / channels) * channels;
+    if(count > perUniverse) count = perUniverse;
+    put(index * perUniverse, packet + E131_DATA_OFFSET, count, channels);
+
+    uint16_t address = be16(packet + 109);
+    if(address != 0){
+        syncAddress = address;
+        return false;
+    }
+    return index == universes - 1;
+}
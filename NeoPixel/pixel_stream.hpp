@@ -0,0 +1,82 @@
+#ifndef PIXEL_STREAM_HPP
+#define PIXEL_STREAM_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Ports controllers such as xLights, Resolume or WLED send frames to.
+#define DDP_PORT 4048
+#define E131_PORT 5568
+
+// DMX channels in an E1.31 universe.
+#define E131_CHANNELS 512
+
+// Most universes one PixelStream follows sequence numbers for (1024 RGBW or
+// 1360 RGB pixels).
+#ifndef STREAM_UNIVERSES_MAX
+#define STREAM_UNIVERSES_MAX 8
+#endif
+
+// Decodes DDP (www.3waylabs.com/ddp) and E1.31 / sACN (ANSI E1.31-2016) data
+// packets into pixel words in the LEDs' GGRRBBWW order, so a lighting
+// controller can stream whole frames instead of sending effect commands.
+//
+// Channels arrive R, G, B (and W if the controller sends 4 channels a pixel)
+// and are written straight into place in the target buffer.  DDP addresses
+// pixels by byte offset; for E1.31 each universe holds as many whole pixels
+// as fit in its 512 channels (170 RGB or 128 RGBW) starting at
+// firstUniverse.
+//
+// A frame is complete, and decode() says so, when:
+//   DDP    - a packet has the push flag set.
+//   E1.31  - a sync packet for the frames' synchronisation address arrives
+//            or, for unsynchronised streams, the last universe of the
+//            mapping arrives.
+//
+// Sequence numbers show lost packets (dropped()).  E1.31 packets that are out
+// of order are discarded as the standard says; for DDP only forward gaps are
+// counted as its 4 bit sequence wraps too quickly to tell late packets from
+// lost ones.
+//
+// No lwIP or pico headers so the same code is checked on the host
+// (bench/stream_replay.cpp); stream_receiver.hpp feeds it on the Pico.
+class PixelStream {
+    uint32_t* pixels;           // being filled.
+    int pixelCount;
+    int channels;               // per pixel sent, 3 or 4.
+    uint16_t firstUniverse;
+    int universes;              // in the E1.31 mapping.
+
+    uint8_t ddpSequence;        // last seen, 0 if none.
+    uint8_t e131Sequence[STREAM_UNIVERSES_MAX];
+    bool e131Seen[STREAM_UNIVERSES_MAX];
+    uint16_t syncAddress;       // E1.31 data is waiting for a sync on this, 0 if none.
+
+    uint32_t packetCount;
+    uint32_t frameCount;
+    uint32_t droppedCount;      // packets lost, from sequence gaps.
+    uint32_t ignoredCount;      // not ours, malformed or out of order.
+
+    void put(uint32_t channel, const uint8_t* data, uint32_t count, int channelsPerPixel);
+    bool ddp(const uint8_t* packet, size_t length);
+    bool e131(const uint8_t* packet, size_t length);
+    bool ignore();
+
+    public:
+    enum Protocol { DDP, E131 };
+
+    PixelStream(int pixelCount, int channelsPerPixel = 3, uint16_t firstUniverse = 1);
+
+    void setTarget(uint32_t* pixels) { this->pixels = pixels;}
+    bool decode(Protocol protocol, const uint8_t* packet, size_t length);
+
+    uint16_t universe(int index) const { return firstUniverse + index;}
+    int universeCount() const { return universes;}
+
+    uint32_t packets() const { return packetCount;}
+    uint32_t frames() const { return frameCount;}
+    uint32_t dropped() const { return droppedCount;}
+    uint32_t ignored() const { return ignoredCount;}
+};
+
+#endif
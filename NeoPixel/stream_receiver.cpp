@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include "lwip/igmp.h"
+#include "stream_receiver.hpp"
+
+/// @brief Creates a receiver for the grid.  Call open() once the network is up.
+/// @param grid is where frames are shown.
+/// @param channelsPerPixel is 3 for RGB or 4 for RGBW.
+/// @param firstUniverse is the E1.31 universe holding pixel 0.
+StreamReceiver::StreamReceiver(NeopixelGrid& grid, int channelsPerPixel, uint16_t firstUniverse)
+: grid(grid)
+, stream(PIXEL_COUNT, channelsPerPixel, firstUniverse)
+, ddp(0)
+, e131(0)
+{}
+
+StreamReceiver::~StreamReceiver(){
+    close();
+}
+
+/// @brief Starts listening for DDP and E1.31 and joins the universes' multicast groups.
+/// @return false if lwIP has no pcb or port free.
+bool StreamReceiver::open(){
+    close();
+    stream.setTarget(grid.streamBuffer());
+    ddp = listen(DDP_PORT);
+    e131 = listen(E131_PORT);
+    if(!ddp || !e131){
+        close();
+        return false;
+    }
+    joinUniverses(true);
+    printf("Streaming pixels by DDP on %d, E1.31 on %d from universe %d\n", DDP_PORT, E131_PORT, stream.universe(0));
+    return true;
+}
+
+void StreamReceiver::close(){
+    if(e131){
+        joinUniverses(false);
+        udp_remove(e131);
+        e131 = 0;
+    }
+    if(ddp){
+        udp_remove(ddp);
+        ddp = 0;
+    }
+}
+
+struct udp_pcb* StreamReceiver::listen(uint16_t port){
+    struct udp_pcb* pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if(!pcb) return 0;
+    if(udp_bind(pcb, IP_ANY_TYPE, port) != ERR_OK){
+        udp_remove(pcb);
+        return 0;
+    }
+    udp_recv(pcb, StreamReceiver::received, this);
+    return pcb;
+}
+
+/// @brief Joins or leaves 239.255.hi.lo for each universe mapped, where
+/// E1.31 senders multicast them.
+void StreamReceiver::joinUniverses(bool join){
+#if LWIP_IGMP
+    for(int i = 0; i < stream.universeCount(); ++i){
+        uint16_t universe = stream.universe(i);
+        ip4_addr_t group;
+        IP4_ADDR(&group, 239, 255, universe >> 8, universe & 0xFF);
+        if(join){
+            igmp_joingroup(IP4_ADDR_ANY4, &group);
+        } else {
+            igmp_leavegroup(IP4_ADDR_ANY4, &group);
+        }
+    }
+#endif
+}
+
+void StreamReceiver::received(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port){
+    static_cast<StreamReceiver*>(arg)->onReceived(pcb, p);
+}
+
+/// @brief Decodes a packet into the stream buffer, handing the frame over
+/// when it's complete.
+void StreamReceiver::onReceived(struct udp_pcb* pcb, struct pbuf* p){
+    if(!p) return;
+    const uint8_t* data = (const uint8_t*)p->payload;
+    size_t length = p->tot_len;
+    if(p->len != p->tot_len){
+        length = pbuf_copy_partial(p, packet, sizeof(packet), 0);
+        data = packet;
+    }
+
+    PixelStream::Protocol protocol = (pcb == ddp) ? PixelStream::DDP : PixelStream::E131;
+    if(stream.decode(protocol, data, length)){
+        grid.streamAsync();
+        stream.setTarget(grid.streamBuffer());
+    }
+    pbuf_free(p);
+}
@@ -0,0 +1,54 @@
+#ifndef STREAM_RECEIVER_HPP
+#define STREAM_RECEIVER_HPP
+
+#include "pico/stdlib.h"
+#include "lwip/udp.h"
+#include "pixel_stream.hpp"
+#include "neopixel.hpp"
+
+// Channels per pixel the controller sends: 3 for RGB (white left off) or 4
+// for RGBW.  DDP packets that give their data type override it.
+#ifndef STREAM_CHANNELS
+#define STREAM_CHANNELS 3
+#endif
+
+// E1.31 universe holding the first pixel.
+#ifndef STREAM_UNIVERSE
+#define STREAM_UNIVERSE 1
+#endif
+
+// Largest UDP payload handled, a full Ethernet frame.
+#define STREAM_PACKET_MAX 1472
+
+// Lets a lighting controller (xLights, Resolume, ...) drive the grid as a
+// pixel node by DDP on port 4048 or E1.31 on port 5568, unicast or multicast.
+// Packets are decoded by PixelStream straight into the grid's stream buffer
+// and each complete frame is handed to the animation core, which shows it
+// in place of any effect until the next effect command.  Set the controller
+// to send PIXEL_COUNT pixels of STREAM_CHANNELS channels from universe
+// STREAM_UNIVERSE, or DDP with offset 0.
+//
+// Uses lwIP so open and close it on the network core.
+class StreamReceiver {
+    NeopixelGrid& grid;
+    PixelStream stream;
+    struct udp_pcb* ddp;
+    struct udp_pcb* e131;
+    uint8_t packet[STREAM_PACKET_MAX];     // for packets lwIP split over pbufs.
+
+    static void received(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port);
+    void onReceived(struct udp_pcb* pcb, struct pbuf* p);
+    struct udp_pcb* listen(uint16_t port);
+    void joinUniverses(bool join);
+
+    public:
+    StreamReceiver(NeopixelGrid& grid, int channelsPerPixel = STREAM_CHANNELS, uint16_t firstUniverse = STREAM_UNIVERSE);
+    ~StreamReceiver();
+
+    bool open();
+    void close();
+
+    const PixelStream& stats() const { return stream;}
+};
+
+#endif
@@ -49,7 +49,9 @@
 
 //------------------------------------------------------------------------------
 /** Set USE_BLOCK_DEVICE_INTERFACE nonzero to use generic block device */
+#ifndef USE_BLOCK_DEVICE_INTERFACE
 #define USE_BLOCK_DEVICE_INTERFACE 0
+#endif
 //------------------------------------------------------------------------------
 #if ENABLE_ARDUINO_FEATURES
 #include "Arduino.h"
@@ -1,5 +1,5 @@
 #include <string.h>
-#include <sstream>
+#include "pico/printf.h"
 #include "index.hpp"
 #include "letterbox.hpp"
 
@@ -29,35 +29,43 @@ static const char* end =
 
 extern Letterbox letterbox;
 
-bool IndexPage::matches(const char* verb, const char* path){
-    bool accept = (strcmp(verb,"GET") == 0) && (
-        strncmp(path, "/",1) == 0 ||
-        strncmp(path, "/index",6) == 0
-        );
-     return accept;
+void IndexPage::addRoutes(Router& router){
+    router.exact("GET", "/", this);
+    router.prefix("GET", "/index", this);
 }
 
+// Room for the readings between start and end.
+#define VALUES_MAX 256
+
 void IndexPage::process( HttpRequest& request, HttpResponse& response){
-    std::ostringstream os;
-    os << start;
-    os << "<div class=\"values\">" << std::endl;
-    os << "<div> Pressure: " << letterbox.pressure << "hPa </div>" << std::endl;
-    os << "<div> Temperature: " << letterbox.primaryTemp << "C </div>" << std::endl;
-    os << "<div> Humidity: " << letterbox.humidity << "% </div>" << std::endl;
-    os << "<div> Light: " << letterbox.lux << "lux </div>" << std::endl;
-    // os << "<div> Temp2: " << letterbox.temp2 << "C </div>" << std::endl;
-    // os << "<div> Temp3: " << letterbox.temp3 << "C </div>" << std::endl;
-    os << "</div>" << std::endl;
-    os << end;
-
-    const char* body = os.str().c_str();
-    if(!os) body = "Bad output stream\n";
-
-    puts(body);
+    // Written into the response's block so it's still there when sent.
+    size_t size = strlen(start) + VALUES_MAX + strlen(end) + 1;
+    char* body = (char*)response.getBlock()->allocate(size);
+    if(!body){
+        response.setStatus(500, "Internal Server Error");
+        response.addStandardHeaders(HttpResponse::SERVER);
+        return;
+    }
+
+    int written = snprintf(body, size,
+        "%s"
+        "<div class=\"values\">\n"
+        "<div> Pressure: %.1fhPa </div>\n"
+        "<div> Temperature: %.1fC </div>\n"
+        "<div> Humidity: %.1f%% </div>\n"
+        "<div> Light: %.1flux </div>\n"
+        "</div>\n"
+        "%s",
+        start, letterbox.pressure, letterbox.primaryTemp, letterbox.humidity, letterbox.lux, end);
+    if(written < 0 || (size_t)written >= size){
+        response.setStatus(500, "Internal Server Error");
+        response.addStandardHeaders(HttpResponse::SERVER);
+        return;
+    }
+
     response.setStatus(200,"OK");
-    response.addHeader("Server", "PicoW");
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
     response.addHeader("Content-Type", "text/html");
-    response.addHeader("Access-Control-Allow-Origin","*");
 
     response.setBody(body);
 }
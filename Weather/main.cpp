@@ -7,17 +7,54 @@ extern "C" {
 #include "../WebServer/server.hpp"
 #include "../WebServer/webserver.hpp"
 #include "../WebServer/teapot.hpp"
+#include "../WebServer/event_channel.hpp"
+#include "../WebServer/async_worker.hpp"
+#include "../WebServer/metrics_webapp.hpp"
+#include "../WebServer/trace_webapp.hpp"
+#include "../WebServer/udp_publisher.hpp"
 #include "index.hpp"
 #include "weather_webapp.hpp"
+#include "letterbox.hpp"
 
 WifiStation station;
 Webserver webserver;
 WeatherWebapp webapp;
 Teapot teapot; // respondes to /coffee with 418...
 IndexPage indexPage;
+EventChannel events(webserver, "/events");  // readings pushed to browsers.
+AsyncWorker worker;     // runs on core 1 between readings.
+ResponseCache cache;    // /data for several clients polling at once.
+ServerMetrics metrics;
+MetricsWebapp metricsPage(webserver);  // /metrics for Prometheus.
+TraceWebapp tracePage;                 // /trace for what the server has been doing.
+UdpPublisher sensors;                  // readings multicast to the LAN each second.
+
+// Reading ids in the SENSOR_SOURCE_WEATHER frames.
+enum WeatherReading : uint8_t {
+    READING_PRESSURE = 1,
+    READING_HUMIDITY = 2,
+    READING_LUX = 3,
+    READING_TEMPERATURE = 4,
+    READING_TEMP2 = 5,
+    READING_TEMP3 = 6
+};
+
+// How often readings are pushed to /events subscribers.
+#define PUBLISH_INTERVAL_MS 2000
 
 // TODO GET /favicon.ico HTTP/1.1
 
+static void publishFrame(){
+    SensorFrame frame(SENSOR_SOURCE_WEATHER);
+    frame.add(READING_PRESSURE, letterbox.pressure)
+        .add(READING_HUMIDITY, letterbox.humidity)
+        .add(READING_LUX, letterbox.lux)
+        .add(READING_TEMPERATURE, letterbox.primaryTemp)
+        .add(READING_TEMP2, letterbox.temp2)
+        .add(READING_TEMP3, letterbox.temp3);
+    sensors.publish(frame);
+}
+
 
 extern void run_weather();
 
@@ -50,15 +87,49 @@ int main() {
             webserver.addApplication(&webapp);
             webserver.addApplication(&teapot);
             webserver.addApplication(&indexPage);
+            webserver.addApplication(&events);
+            webserver.addApplication(&metricsPage);
+            webserver.addApplication(&tracePage);
+            webserver.setWorker(&worker);
+            webserver.setCache(&cache);
+            webserver.setMetrics(&metrics);
 
             TcpServer server(&webserver);
             if(server.open(80)){
-                 server.run();
+                if(!sensors.open()){
+                    printf("Unable to multicast readings to %s\n", SENSOR_GROUP);
+                }
+
+                // As TcpServer::run() but also publishes the readings, which
+                // must be done from this core (the readings are taken on core 1).
+                // Core 1 signals when it has finished a /data request so that
+                // wakes this loop too.
+                absolute_time_t next = make_timeout_time_ms(PUBLISH_INTERVAL_MS);
+                while(server.isRunning()){
+                    absolute_time_t wake = sensors.nextDue();
+                    if(absolute_time_diff_us(next, wake) > 0) wake = next;
+                    cyw43_arch_wait_for_work_until(wake);
+                    cyw43_arch_poll();
+                    server.service();
+                    if(sensors.due()){
+                        publishFrame();
+                    }
+                    if(time_reached(next)){
+                        if(events.subscribed()){
+                            char text[READINGS_JSON_MAX];
+                            JsonWriter json(text, sizeof(text));
+                            WeatherWebapp::writeReadings(json);
+                            events.publish("readings", json.c_str());
+                        }
+                        next = make_timeout_time_ms(PUBLISH_INTERVAL_MS);
+                    }
+                }
             }
+            sensors.close();
             server.close();
         }
         printf("Weather Restart\n");
-        sleep_ms(1000);
+        sleep_ms(station.backoff());
         station.restart();
     }
 }
\ No newline at end of file
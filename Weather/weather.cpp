@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include "pico/stdlib.h"
+#include "pico/flash.h"
 #include "../PicoHardware/i2c.h"
 #include "../Sensors/HDC1080.h"
 #include "../Sensors/BMP280.h"
@@ -10,6 +11,7 @@
 #include "../Sensors/GY30.h"
 
 #include "letterbox.hpp"
+#include "../WebServer/async_worker.hpp"
 
 
 
@@ -21,10 +23,14 @@ const uint8_t I2C_SDA_PIN = 4;
 const uint8_t I2C_SCL_PIN = 5;
 
 Letterbox letterbox;
+extern AsyncWorker worker;  // /data requests, answered between readings.
 
 extern void run_weather() {
 
    printf("Acquisition Starting (core 1)\n");
+
+    // Let core 0 pause this core while it saves the Wi-Fi join to flash.
+    flash_safe_execute_core_init();
  
     bool state = true;
     gpio_init(LED_PIN);
@@ -62,7 +68,7 @@ extern void run_weather() {
 
         printf("TICK: starting read\n");
         hdc1080.trigger();
-        ::sleep_ms(HDC1080_MEASUREMENT_DELAY * 2);
+        worker.runUntil(make_timeout_time_ms(HDC1080_MEASUREMENT_DELAY * 2));
         hdc1080.readCombined();
         letterbox.humidity = hdc1080.humidity();
         letterbox.temp3 = hdc1080.temperature();
@@ -79,6 +85,6 @@ extern void run_weather() {
         //gpio_put(LED_PIN, state ? 1 : 0);
 
         printf("TICK: end\n");
-        ::sleep_ms(1000);
+        worker.runUntil(make_timeout_time_ms(1000));
        } 
 }
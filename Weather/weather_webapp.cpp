@@ -1,46 +1,48 @@
-#include <sstream>
+#include <string.h>
 #include "weather_webapp.hpp"
 #include "letterbox.hpp"
 
+// The readings are taken about once a second so /data is reused for that long.
+#define DATA_CACHE_MS 1000
+
  
 
-bool WeatherWebapp::matches(const char* verb, const char* path){
-    bool accept = false;
-    if(strcmp(verb,"GET") == 0) {
-        accept = 
-            strncmp(path,"/data",5) == 0 ||
-            false;
-            ;
-        if(accept) printf("Weather Webapp Accepting path %s\n", path);
-    }
-    return accept;
+// Writes the latest readings as a single line of JSON.  Used for /data and
+// for the readings event.
+void WeatherWebapp::writeReadings(JsonWriter& json){
+    json.beginObject()
+        .field("pressure", letterbox.pressure)
+        .field("humidity", letterbox.humidity)
+        .field("lux", letterbox.lux)
+        .field("temperature", letterbox.primaryTemp)
+        .field("temp2", letterbox.temp2)
+        .field("temp3", letterbox.temp3)
+        .endObject();
 }
 
-void WeatherWebapp::process( HttpRequest& request, HttpResponse& response){
+void WeatherWebapp::addRoutes(Router& router){
+    router.exact("GET", "/data", this);
+}
 
-    printf("Weather Webapp Processing request for %s\n",request.path());
- 
+// The readings are formatted on core 1 (see run_weather) so the network
+// isn't held up and they can't change half way through.
+void WeatherWebapp::process( HttpRequest& request, HttpResponse& response){
+    response.defer();
+}
 
-    BlockListIter<Parameter> iter = request.Parameters().iter();
-    Parameter* p;
-    while(p = iter.next()){
-        printf("Parameter %s -> %s\n", p->name(), p->value());
-        
+void WeatherWebapp::processAsync( HttpRequest& request, HttpResponse& response){
+    // Written straight into the response's block so it's still there when sent.
+    JsonWriter json(response.getBlock(), READINGS_JSON_MAX);
+    writeReadings(json);
+    if(json.overflowed()){
+        response.setStatus(500, "Internal Server Error");
+        response.addStandardHeaders(HttpResponse::SERVER);
+        return;
     }
 
-    std::ostringstream os;
-    os << "{";
-    os << "\"pressure\" : " << letterbox.pressure << ",";
-    os << "\"humidity\" : " << letterbox.humidity << ",";
-    os << "\"lux\" : "      << letterbox.lux << ",";
-    os << "\"temperature\" : " << letterbox.primaryTemp << ",";
-    os << "\"temp2\" : "    << letterbox.temp2 << ",";
-    os << "\"temp3\" : "    << letterbox.temp3 ;
-    os << "}";
-
     response.setStatus(200,"OK");
-    response.addHeader("Server", "PicoW");
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
     response.addHeader("Content-Type", "application/json");
-    response.addHeader("Access-Control-Allow-Origin","*");
-    response.setBody(os.str().c_str());
+    response.cacheFor(DATA_CACHE_MS);
+    response.setBody(json.c_str());
 }
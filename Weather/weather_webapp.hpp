@@ -2,11 +2,18 @@
 #define WEATHER_WEBAPP_HPP
 
 #include "../WebServer/webserver.hpp"
+#include "../WebServer/json_writer.hpp"
+
+// Longest the readings JSON can be, including the NUL.
+#define READINGS_JSON_MAX 160
 
 class WeatherWebapp: public WebApp{
    public:
-    virtual bool matches(const char* verb, const char* path);
+    static void writeReadings(JsonWriter& json);
+
+    virtual void addRoutes(Router& router);
     virtual void process(HttpRequest& request, HttpResponse& response);
+    virtual void processAsync(HttpRequest& request, HttpResponse& response);
 
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "async_worker.hpp"
+#include "webserver.hpp"
+
+AsyncWorker::AsyncWorker()
+: outstanding(0)
+{
+    queue_init(&requests, sizeof(AsyncJob), ASYNC_QUEUE_LENGTH);
+    // submit() keeps the jobs waiting, being handled and finished to
+    // ASYNC_QUEUE_LENGTH in all, so there's always room for a completion and
+    // the worker never has to wait to hand one back.
+    queue_init(&completions, sizeof(AsyncJob), ASYNC_QUEUE_LENGTH);
+}
+
+/// @brief Passes a request to the worker.  Called by the Webserver.
+/// @param job is the request.
+/// @return true if queued, false if the worker is full.
+bool AsyncWorker::submit(const AsyncJob& job){
+    if(outstanding == ASYNC_QUEUE_LENGTH || !queue_try_add(&requests, &job)) return false;
+    ++outstanding;
+    return true;
+}
+
+/// @brief Collects a request the worker has finished.  Called by the Webserver.
+/// @param job is set to the finished request.
+/// @return true if there was one.
+bool AsyncWorker::completed(AsyncJob& job){
+    if(!queue_try_remove(&completions, &job)) return false;
+    --outstanding;
+    return true;
+}
+
+/// @brief Handles one waiting request, if any.
+/// @return true if a request was handled.
+bool AsyncWorker::runOnce(){
+    AsyncJob job;
+    if(!queue_try_remove(&requests, &job)) return false;
+    job.app->processAsync(job.tx->request(), job.tx->response());
+    queue_add_blocking(&completions, &job);
+    return true;
+}
+
+/// @brief Handles requests as they arrive until the given time e.g. in place
+/// of sleep_ms() in a sampling loop.
+/// @param until is when to return.
+void AsyncWorker::runUntil(absolute_time_t until){
+    while(!time_reached(until)){
+        if(!runOnce()){
+            best_effort_wfe_or_timeout(until);  // woken when a request is queued.
+        }
+    }
+}
+
+/// @brief Handles requests forever.  For a core dedicated to the worker.
+void AsyncWorker::run(){
+    while(true){
+        AsyncJob job;
+        queue_remove_blocking(&requests, &job);
+        job.app->processAsync(job.tx->request(), job.tx->response());
+        queue_add_blocking(&completions, &job);
+    }
+}
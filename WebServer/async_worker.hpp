@@ -0,0 +1,54 @@
+#ifndef ASYNC_WORKER_HPP
+#define ASYNC_WORKER_HPP
+
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+
+// Requests that can be with the worker at once: waiting, being handled or
+// finished but not yet collected by the network loop.
+// When full, further deferred requests get 503 Service Unavailable.
+#ifndef ASYNC_QUEUE_LENGTH
+#define ASYNC_QUEUE_LENGTH 4
+#endif
+
+class WebApp;
+class HttpTransaction;
+class HttpConnection;
+
+// A deferred request on its way to or from the worker.
+struct AsyncJob {
+    WebApp* app;            // calls app->processAsync().
+    HttpTransaction* tx;    // the request and the response to fill in.
+    HttpConnection* hc;     // connection to answer on (network side only).
+};
+
+// Runs WebApp::processAsync() away from the lwIP callbacks, on core 1 or in a
+// loop of its own, so a slow handler doesn't hold up TCP for every other
+// connection.  Jobs go in and out through queue_t which is safe between
+// cores.  The worker never touches lwIP: the finished response goes back to
+// the Webserver which sends it from the network loop (Webserver::service()).
+//
+// Usage:
+//   AsyncWorker worker;
+//   webserver.setWorker(&worker);
+//   multicore_launch_core1([]{ worker.run();});
+// or call worker.runOnce() / worker.runUntil() from an existing core 1 loop.
+class AsyncWorker {
+    queue_t requests;       // network -> worker.
+    queue_t completions;    // worker -> network.
+    int outstanding;        // submitted but not yet collected (network side only).
+
+    public:
+    AsyncWorker();
+
+    // Network side.
+    bool submit(const AsyncJob& job);
+    bool completed(AsyncJob& job);
+
+    // Worker side.
+    bool runOnce();
+    void runUntil(absolute_time_t until);
+    void run();
+};
+
+#endif
@@ -1,28 +1,27 @@
+#include <string.h>
 #include "block_malloc.hpp"
 #ifdef BLOCK_USE_CALLOC
 #include <stdlib.h>
 #endif
- 
+
 #include "pico/stdlib.h"
 #include "pico/printf.h"
 
+// Storage comes from the pool (see init) so a new block is empty.  The pool
+// is static so there's no need to clear anything here.
 Block::Block()
-: allocated(false)
-#ifdef BLOCK_USE_CALLOC
+: guard0(_BLOCK_POOL_GUARD)
 , block(0)
-#endif 
+, guard1(_BLOCK_POOL_GUARD)
+, capacity(0)
 , used_count(0)
-, free_count(BLOCK_SIZE)
-, activeBlock(this)
+, free_count(0)
+, allocated(false)
+, chainLength(0)
 , nextBlock(0)
-, guard0(_BLOCK_POOL_GUARD)
-, guard1(_BLOCK_POOL_GUARD)
+, activeBlock(this)
+, pool(0)
 {
-    #ifdef BLOCK_USE_CALLOC
-    block = (uint8_t*)calloc(BLOCK_SIZE,1);
-    #else
-    for(int i=0; i< BLOCK_SIZE; ++i) block[i] = 0;
-    #endif
  }
 
  Block::~Block(){
@@ -31,6 +30,21 @@ Block::Block()
     #endif
  }
 
+/// @brief Gives the block its storage.  Called once by the pool.
+/// @param pool is the pool that owns the block.
+/// @param storage is the block's memory, 0 to calloc it.
+/// @param capacity is the size of storage.
+void Block::init(BlockPool* pool, uint8_t* storage, uint capacity){
+    #ifdef BLOCK_USE_CALLOC
+    storage = (uint8_t*)calloc(capacity, 1);
+    #endif
+    this->pool = pool;
+    this->block = storage;
+    this->capacity = capacity;
+    this->used_count = 0;
+    this->free_count = capacity;
+}
+
 /// @brief Helper function to allocate from a single block.
 /// @param bytes is the number of bytes wanted.
 /// @return pointer to allocated memory or 0 if this block cannot provide.
@@ -38,7 +52,7 @@ void* Block::localAlloc(size_t bytes) {
     assert(this);
     assert(guard0 == _BLOCK_POOL_GUARD);
     assert(guard1 == _BLOCK_POOL_GUARD);
-    
+
     // Round up to nearest 4 byte aligned value. Otherwise weird things happen.
     bytes = (bytes + 3) & ~3;
     void* mem = 0;
@@ -47,21 +61,21 @@ void* Block::localAlloc(size_t bytes) {
         used_count += bytes;
         free_count -= bytes;
     }
-    assert((( (uint)mem & ~3) == (uint)mem));
+    assert((( (uintptr_t)mem & ~3) == (uintptr_t)mem));
     return mem;
 }
 
 /// @brief Allocate a number of bytes from the chain of blocks.
 /// Note that when a block is allocated, it will pull further blocks
-/// from the pool to satisfy requests.  This is transparent - the 
-/// blocks are linked but allocation requests continue to go to the 
+/// from the pool to satisfy requests.  This is transparent - the
+/// blocks are linked but allocation requests continue to go to the
 /// initial head block.
 /// @param bytes is the number of bytes to allocate.
 /// @return pointer to allocated memory or 0 if cannot allocate.
 void* Block::allocate(size_t bytes){
     assert(this);
-    assert(used_count <= BLOCK_SIZE);
-    assert((used_count + free_count) == BLOCK_SIZE);
+    assert(used_count <= capacity);
+    assert((used_count + free_count) == capacity);
 
     assert(guard0 == _BLOCK_POOL_GUARD);
     assert(guard1 == _BLOCK_POOL_GUARD);
@@ -69,77 +83,194 @@ void* Block::allocate(size_t bytes){
 
     void* mem = activeBlock->localAlloc(bytes);
     if(mem == 0){
-        Block* next = pool->allocate();
+        Block* next = pool->extendChain(this, bytes);
         if(next) {
             activeBlock->nextBlock = next;  // add new block to tail.
             activeBlock = next;             // it's the new block to allocate from.
             mem = activeBlock->localAlloc(bytes);
         }
     }
-    assert(activeBlock->nextBlock == 0);    
-    assert(used_count <= BLOCK_SIZE);
-    assert((used_count + free_count) == BLOCK_SIZE);
+    assert(activeBlock->nextBlock == 0);
+    assert(used_count <= capacity);
+    assert((used_count + free_count) == capacity);
     return mem;
  }
 
+/// @brief Tries to grow the most recent allocation in place.  This only
+/// works if nothing else has been allocated since and there is room left in
+/// the block it came from.
+/// @param mem is the memory returned by the last call to allocate.
+/// @param bytes is the size it was allocated with.
+/// @param newBytes is the size wanted.
+/// @return true if mem is now newBytes long, false if unchanged.
+bool Block::extend(void* mem, size_t bytes, size_t newBytes){
+    assert(this);
+    bytes = (bytes + 3) & ~3;
+    newBytes = (newBytes + 3) & ~3;
+    if(newBytes <= bytes) return true;
+
+    Block* pb = activeBlock;
+    if((uint8_t*)mem + bytes != pb->block + pb->used_count) return false; // not the last allocation
+    size_t extra = newBytes - bytes;
+    if(extra > pb->free_count) return false;
+    pb->used_count += extra;
+    pb->free_count -= extra;
+    return true;
+}
+
 /// @brief  Called when a block is allocated from the pool to reinitialise the block.
-/// @param pool is the source pool for allocation - kept for chaining blocks.
-void Block::allocateBlock(BlockPool* pool){
+void Block::allocateBlock(){
     assert(this);
     assert(!allocated);
     assert(guard0 == _BLOCK_POOL_GUARD);
     assert(guard1 == _BLOCK_POOL_GUARD);
- 
-    this->pool = pool;
+
     this->used_count = 0;
-    this->free_count = BLOCK_SIZE;
+    this->free_count = capacity;
     this->nextBlock = 0;
     this->activeBlock = this; // start of chain
+    this->chainLength = 1;
     this->allocated = true;
 }
 
+/// @brief Empties the block for reuse without returning it to the pool.
+/// Any chained blocks are freed.
+void Block::reset(){
+    assert(this);
+    assert(allocated);
+    if(nextBlock){
+        nextBlock->free();
+        nextBlock = 0;
+    }
+    #ifdef BLOCK_CLEAR_ON_FREE
+    memset(block, 0, used_count);
+    #endif
+    used_count = 0;
+    free_count = capacity;
+    activeBlock = this;
+    chainLength = 1;
+}
+
  /// @brief Frees the block and any chained blocks.
  void Block::free(){
     assert(this);
- 
+
     Block* pb = this;
     while(pb){
         assert(pb->allocated);
-        assert(pb->used_count <= BLOCK_SIZE);
-        assert((pb->used_count + pb->free_count) == BLOCK_SIZE);
+        assert(pb->used_count <= pb->capacity);
+        assert((pb->used_count + pb->free_count) == pb->capacity);
         assert(pb->guard0 == _BLOCK_POOL_GUARD);
         assert(pb->guard1 == _BLOCK_POOL_GUARD);
 
+        #ifdef BLOCK_CLEAR_ON_FREE
+        memset(pb->block, 0, pb->used_count);
+        #endif
+        Block* next = pb->nextBlock;
         pb->allocated = false;
-        for(int i=0; i< BLOCK_SIZE; ++i) pb->block[i] = 0;
         pb->used_count = 0;
-        pb->free_count = BLOCK_SIZE;
-        pb->activeBlock = this;   
-        Block* next = pb->nextBlock;
-        pb->nextBlock = 0;
+        pb->free_count = pb->capacity;
+        pb->activeBlock = pb;
+        pb->pool->release(pb);
         pb = next;
     }
  }
 
 BlockPool::BlockPool()
-:position(0)
+: freeBlocks(0)
+, freeSmallBlocks(0)
+, allocatedCount(0)
+, highWaterMark(0)
+, allocationCount(0)
+, failureCount(0)
+, chainCount(0)
+, longestChainLength(0)
 {
+    critical_section_init(&lock);
+
+    // Every block starts on its free list, lowest first.
+    uint8_t* mem = 0;
+    for(int i=BLOCK_COUNT-1; i>=0; --i){
+        #ifndef BLOCK_USE_CALLOC
+        mem = storage + i * BLOCK_SIZE;
+        #endif
+        blocks[i].init(this, mem, BLOCK_SIZE);
+        blocks[i].nextBlock = freeBlocks;
+        freeBlocks = blocks + i;
+    }
+    #if BLOCK_SMALL_COUNT > 0
+    for(int i=BLOCK_SMALL_COUNT-1; i>=0; --i){
+        #ifndef BLOCK_USE_CALLOC
+        mem = smallStorage + i * BLOCK_SMALL_SIZE;
+        #endif
+        smallBlocks[i].init(this, mem, BLOCK_SMALL_SIZE);
+        smallBlocks[i].nextBlock = freeSmallBlocks;
+        freeSmallBlocks = smallBlocks + i;
+    }
+    #endif
+}
+
+/// @brief Takes the first block from a free list.
+/// @param list is the free list.
+/// @return newly allocated block or 0 if the list is empty.
+Block* BlockPool::take(Block*& list){
+    critical_section_enter_blocking(&lock);
+    Block* found = list;
+    if(found){
+        list = found->nextBlock;
+        found->allocateBlock();
+        ++allocationCount;
+        ++allocatedCount;
+        if(allocatedCount > highWaterMark) highWaterMark = allocatedCount;
+        if(longestChainLength == 0) longestChainLength = 1;
+    }
+    critical_section_exit(&lock);
+    return found;
+}
+
+/// @brief Puts a freed block back on its free list.
+void BlockPool::release(Block* block){
+    critical_section_enter_blocking(&lock);
+    Block** list = &freeBlocks;
+    #if BLOCK_SMALL_COUNT > 0
+    if(block >= smallBlocks && block < smallBlocks + BLOCK_SMALL_COUNT) list = &freeSmallBlocks;
+    #endif
+    block->nextBlock = *list;
+    *list = block;
+    --allocatedCount;
+    critical_section_exit(&lock);
 }
 
-/// @brief Looks for a block marked as unallocated.
+/// @brief Gets a full size block.
 /// @return newly allocated block or 0 if all in use.
 Block* BlockPool::allocate(){
-    Block* found = 0;
-    for(int i=0; i<BLOCK_COUNT; ++i) {
-        if(blocks[position].isAllocated()) {
-            position = (position + 1) % BLOCK_COUNT;
-        } else { // not allocated
-            found = blocks + position;
-            found->allocateBlock(this);
-            position = (position + 1) % BLOCK_COUNT; // for next time
-            break;
-        }
-    }
+    Block* found = take(freeBlocks);
+    if(!found) ++failureCount;
     return found;
 }
 
+/// @brief Gets a small block, or a full size one if there are no small
+/// blocks left.  For allocations that usually need little memory.
+/// @return newly allocated block or 0 if all in use.
+Block* BlockPool::allocateSmall(){
+    Block* found = take(freeSmallBlocks);
+    if(!found) found = take(freeBlocks);
+    if(!found) ++failureCount;
+    return found;
+}
+
+/// @brief Gets another block for a chain that has run out of room.
+/// @param head is the first block in the chain.
+/// @param bytes is the allocation that didn't fit.
+/// @return newly allocated block or 0 if none suitable.
+Block* BlockPool::extendChain(Block* head, size_t bytes){
+    Block* next = (bytes <= BLOCK_SMALL_SIZE) ? allocateSmall() : allocate();
+    if(next){
+        if(head->chainLength < 255) ++head->chainLength;
+        critical_section_enter_blocking(&lock);
+        ++chainCount;
+        if(head->chainLength > longestChainLength) longestChainLength = head->chainLength;
+        critical_section_exit(&lock);
+    }
+    return next;
+}
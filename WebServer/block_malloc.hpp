@@ -1,36 +1,60 @@
 // Block allocator to use for deconstructing "things" (mainly HTTP requests)
 // where there tend to be lots of little "new"s all of which can be deleted
-// at the same time.  
+// at the same time.
 // sizes are fixed could pass in an external array if need be.
 
 #ifndef BLOCK_MALLOC_H
 #define BLOCK_MALLOC_H
 
 #include "pico/stdlib.h"
+#include "pico/critical_section.h"
 
+// Full size blocks.  Pipelined requests are buffered in one and allocations
+// can't be bigger than this.
+#ifndef BLOCK_SIZE
 #define BLOCK_SIZE 4096
-#define BLOCK_COUNT 16
+#endif
+#ifndef BLOCK_COUNT
+#define BLOCK_COUNT 8
+#endif
+
+// Small blocks for transactions - most requests and their responses fit in
+// one.  If not, further blocks are chained on as usual.  Set the count to 0
+// to only have full size blocks.  The defaults use the same 64K as 16 full
+// blocks did but serve more connections; reduce the counts to save RAM.
+#ifndef BLOCK_SMALL_SIZE
+#define BLOCK_SMALL_SIZE 2048
+#endif
+#ifndef BLOCK_SMALL_COUNT
+#define BLOCK_SMALL_COUNT 16
+#endif
 
-// Set this to use calloc to 
+// Set this to use calloc to
 // allocate the main blocks of memory
 // Otherwise just big array.
 //#define BLOCK_USE_CALLOC 1
 
+// Debug builds clear the used part of a block when it is freed so stale data
+// is easier to spot.  Release builds skip it.
+#if !defined(NDEBUG) && !defined(BLOCK_NO_CLEAR)
+#define BLOCK_CLEAR_ON_FREE 1
+#endif
+
 class BlockPool;
 
 #define _BLOCK_POOL_GUARD 0xAAAAAAAA
 class Block {
-    int guard0;
-    #ifdef BLOCK_USE_CALLOC
-    uint8_t* block;
-    #else
-    uint8_t block[BLOCK_SIZE];
-    #endif
-    int guard1;
+    friend class BlockPool;
+
+    uint32_t guard0;
+    uint8_t* block;     // storage, from the pool.
+    uint32_t guard1;
+    uint capacity;      // size of storage.
     uint used_count;
     uint free_count;
     bool allocated;     // whether this block is allocated or free.
-    Block* nextBlock;   // chain if more than BLOCK_SIZE needed
+    uint8_t chainLength;// blocks in the chain (head block only).
+    Block* nextBlock;   // chain if more than capacity needed, or next free block.
     Block* activeBlock; // for chained, points to last block in list where mem allocated from.
     BlockPool* pool;    // Source pool to get new blocks from.
 
@@ -40,18 +64,61 @@ class Block {
     Block();
     ~Block();
 
+    void init(BlockPool* pool, uint8_t* storage, uint capacity);
     void* allocate(size_t bytes);
-    void allocateBlock(BlockPool* pool);
+    bool extend(void* mem, size_t bytes, size_t newBytes);
+    void allocateBlock();
     bool isAllocated() const {return allocated;}
+    uint size() const { return capacity;}
+    void reset();
     void free();
 };
 
+// Fixed pool of blocks.  Free blocks of each size are kept on a list so
+// allocating and freeing a block is O(1).  The lists are locked so blocks can
+// be chained by a request being handled on the other core.
 class BlockPool {
-    Block blocks[BLOCK_COUNT];  
-    int position; // for round-robin allocation.
+    friend class Block;
+
+    critical_section_t lock;
+
+    Block blocks[BLOCK_COUNT];
+    Block* freeBlocks;
+    #if BLOCK_SMALL_COUNT > 0
+    Block smallBlocks[BLOCK_SMALL_COUNT];
+    #endif
+    Block* freeSmallBlocks;
+
+    #ifndef BLOCK_USE_CALLOC
+    uint8_t storage[BLOCK_COUNT * BLOCK_SIZE];
+    #if BLOCK_SMALL_COUNT > 0
+    uint8_t smallStorage[BLOCK_SMALL_COUNT * BLOCK_SMALL_SIZE];
+    #endif
+    #endif
+
+    int allocatedCount; // blocks currently in use.
+    int highWaterMark;  // most blocks ever in use at once.
+    uint32_t allocationCount;   // blocks handed out.
+    uint32_t failureCount;      // requests for a block that found none free.
+    uint32_t chainCount;        // blocks added to an existing chain.
+    int longestChainLength;     // most blocks ever in one chain.
+
+    Block* take(Block*& list);
+    void release(Block* block);
+    Block* extendChain(Block* head, size_t bytes);
+
     public:
     BlockPool();
     Block* allocate();
+    Block* allocateSmall();
+
+    int capacity() const { return BLOCK_COUNT + BLOCK_SMALL_COUNT;}
+    int inUse() const { return allocatedCount;}
+    int highWater() const { return highWaterMark;}
+    uint32_t allocations() const { return allocationCount;}
+    uint32_t failures() const { return failureCount;}
+    uint32_t chained() const { return chainCount;}
+    int longestChain() const { return longestChainLength;}
 };
 
 #endif
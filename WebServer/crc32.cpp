@@ -0,0 +1,69 @@
+#include "crc32.hpp"
+
+// Reflected polynomial for the standard CRC-32.
+#define CRC32_POLYNOMIAL 0xEDB88320u
+
+// tables[0] is the usual byte at a time table.  tables[k][b] is the CRC of
+// byte b followed by k zero bytes, so four table lookups handle a word.
+struct Crc32Tables {
+    uint32_t t[4][256];
+
+    constexpr Crc32Tables() : t() {
+        for(uint32_t i=0; i<256; ++i){
+            uint32_t c = i;
+            for(int j=0; j<8; ++j){
+                c = (c & 1) ? (c >> 1) ^ CRC32_POLYNOMIAL : (c >> 1);
+            }
+            t[0][i] = c;
+        }
+        for(uint32_t i=0; i<256; ++i){
+            for(int k=1; k<4; ++k){
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+// Built by the compiler so it's const data in flash.
+static constexpr Crc32Tables tables;
+
+/// @brief Adds data to the CRC.
+/// @param data is the next piece of data.
+/// @param length is the number of bytes in data.
+void Crc32::update(const void* data, size_t length){
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t c = crc;
+
+    // Byte at a time until word aligned...
+    while(length && ((uintptr_t)p & 3)){
+        c = tables.t[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+        --length;
+    }
+
+    // ...then a (little endian) word at a time...
+    while(length >= 4){
+        c ^= *(const uint32_t*)p;
+        c = tables.t[3][c & 0xFF]
+          ^ tables.t[2][(c >> 8) & 0xFF]
+          ^ tables.t[1][(c >> 16) & 0xFF]
+          ^ tables.t[0][c >> 24];
+        p += 4;
+        length -= 4;
+    }
+
+    // ...and any bytes left over.
+    while(length--){
+        c = tables.t[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    }
+    crc = c;
+}
+
+/// @brief Works out the CRC of a block of data in one go.
+/// @param data is the data.
+/// @param length is the number of bytes in data.
+/// @return the CRC.
+uint32_t Crc32::of(const void* data, size_t length){
+    Crc32 crc;
+    crc.update(data, length);
+    return crc.value();
+}
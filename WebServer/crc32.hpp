@@ -0,0 +1,23 @@
+#ifndef CRC32_HPP
+#define CRC32_HPP
+
+#include <stddef.h>
+#include "pico/stdlib.h"
+
+// Standard (IEEE 802.3 / zlib) CRC-32, as given by crc32 or
+// python3 -c "import zlib,sys;print('%08x'%zlib.crc32(open(sys.argv[1],'rb').read()))".
+// Data can be added a piece at a time as it arrives.  Uses slice-by-4 tables
+// (4K, in flash) so it takes a word at a time rather than a byte.
+class Crc32 {
+    uint32_t crc;
+
+    public:
+    Crc32() : crc(0xFFFFFFFF) {}
+    void reset() { crc = 0xFFFFFFFF;}
+    void update(const void* data, size_t length);
+    uint32_t value() const { return ~crc;}
+
+    static uint32_t of(const void* data, size_t length);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include <string.h>
+#include "event_channel.hpp"
+#include "pico/printf.h"
+
+static const char heartbeat[] = ":\n\n";
+
+static uint32_t nowMs(){
+    return to_ms_since_boot(get_absolute_time());
+}
+
+////////////////////////////////////////////////////////////////////
+// EventSubscriber
+
+EventSubscriber::EventSubscriber(EventChannel* channel, char* buffer)
+: channel(channel)
+, next(0)
+, buffer(buffer)
+, start(0)
+, end(0)
+, lastSent(nowMs())
+, dropped(0)
+{}
+
+/// @brief Queues an event in the wire format:
+///  event: <event>
+///  data: <data>
+///  <blank line>
+/// @param event is the event name or 0 for the default "message" event.
+/// @param data is the event data.  It must be a single line.
+/// @param length is strlen(data).
+/// @return true if queued, false if there was no room.
+bool EventSubscriber::append(const char* event, const char* data, size_t length){
+    size_t eventLength = event ? strlen(event) : 0;
+    size_t needed = (event ? 7 + eventLength + 1 : 0) + 6 + length + 2;
+
+    // Shuffle down what's left to make room at the end.
+    if(start > 0){
+        memmove(buffer, buffer + start, end - start);
+        end -= start;
+        start = 0;
+    }
+    if(end + needed > EVENT_BUFFER_SIZE){
+        ++dropped;
+        return false;
+    }
+
+    char* there = buffer + end;
+    if(event){
+        memcpy(there, "event: ", 7);
+        there += 7;
+        memcpy(there, event, eventLength);
+        there += eventLength;
+        *there++ = '\n';
+    }
+    memcpy(there, "data: ", 6);
+    there += 6;
+    memcpy(there, data, length);
+    there += length;
+    *there++ = '\n';
+    *there++ = '\n';
+    end = there - buffer;
+    return true;
+}
+
+/// @brief Hands over queued events.  With nothing queued it waits, or sends
+/// a heartbeat comment if the stream has been quiet for a while.
+size_t EventSubscriber::produce(uint8_t* data, size_t max){
+    size_t len = end - start;
+    if(len == 0){
+        if(nowMs() - lastSent < EVENT_HEARTBEAT_MS) return WAIT;
+        len = sizeof(heartbeat) - 1;
+        memcpy(data, heartbeat, len);
+        lastSent = nowMs();
+        return len;
+    }
+    if(len > max) len = max;
+    memcpy(data, buffer + start, len);
+    start += len;
+    lastSent = nowMs();
+    return len;
+}
+
+/// @brief The client has gone.
+void EventSubscriber::finished(){
+    if(channel){
+        channel->unsubscribe(this);
+        channel = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+// EventChannel
+
+/// @brief Creates a channel.
+/// @param server is the server that sends the events.
+/// @param path is the URL clients subscribe to e.g. "/events".
+EventChannel::EventChannel(Webserver& server, const char* path)
+: server(server)
+, path(path)
+, subscribers(0)
+, subscriberCount(0)
+, publishedCount(0)
+{}
+
+void EventChannel::addRoutes(Router& router){
+    router.exact("GET", path, this);
+}
+
+/// @brief Subscribes the client.  The response never ends; it's streamed
+/// for as long as the client stays connected.
+void EventChannel::process(HttpRequest& request, HttpResponse& response){
+    char* buffer = (char*)response.getBlock()->allocate(EVENT_BUFFER_SIZE);
+    EventSubscriber* subscriber = buffer ? new(response.getBlock()) EventSubscriber(this, buffer) : 0;
+    if(!subscriber){
+        response.setStatus(503, "Service Unavailable");
+        response.addStandardHeaders(HttpResponse::SERVER);
+        return;
+    }
+
+    subscriber->next = subscribers;
+    subscribers = subscriber;
+    ++subscriberCount;
+    printf("Event subscriber %d on %s\n", subscriberCount, path);
+
+    response.setStatus(200, "OK");
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
+    response.addHeader("Content-Type", "text/event-stream");
+    response.addHeader("Cache-Control", "no-cache");
+    response.setBody(subscriber);
+}
+
+/// @brief Sends an event to every subscriber.
+/// @param event is the event name (the browser's addEventListener type), or 0
+/// for an unnamed "message" event.
+/// @param data is the event data, typically JSON.  It must be a single line.
+void EventChannel::publish(const char* event, const char* data){
+    if(!subscribers) return;
+    size_t length = strlen(data);
+    for(EventSubscriber* s = subscribers; s; s = s->next){
+        s->append(event, data, length);
+    }
+    ++publishedCount;
+    server.resumeBodies();
+}
+
+/// @brief Removes a subscriber whose client has gone.
+void EventChannel::unsubscribe(EventSubscriber* subscriber){
+    for(EventSubscriber** link = &subscribers; *link; link = &(*link)->next){
+        if(*link == subscriber){
+            *link = subscriber->next;
+            --subscriberCount;
+            if(subscriber->dropped) printf("Event subscriber dropped %u events\n", (unsigned)subscriber->dropped);
+            return;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef EVENT_CHANNEL_HPP
+#define EVENT_CHANNEL_HPP
+
+#include "webserver.hpp"
+
+// Events waiting to go to one subscriber.  If a subscriber can't keep up and
+// this fills, further events for it are dropped until there's room.
+#ifndef EVENT_BUFFER_SIZE
+#define EVENT_BUFFER_SIZE 512
+#endif
+
+// A comment line is sent to an idle subscriber this often so proxies and
+// NAT don't time out the connection.
+#ifndef EVENT_HEARTBEAT_MS
+#define EVENT_HEARTBEAT_MS 15000
+#endif
+
+class EventChannel;
+
+// One client's event stream.  It is the response body of the subscribing
+// request, so lives in the transaction's block for as long as the client
+// stays connected.
+class EventSubscriber: public BodyProducer {
+    friend class EventChannel;
+
+    EventChannel* channel;
+    EventSubscriber* next;  // next subscriber to the channel.
+    char* buffer;           // events not yet sent.
+    size_t start;           // offset of the first unsent byte.
+    size_t end;             // offset past the last unsent byte.
+    uint32_t lastSent;      // ms since boot something was last produced.
+    uint32_t dropped;       // events lost because the buffer was full.
+
+    bool append(const char* event, const char* data, size_t length);
+
+    public:
+    EventSubscriber(EventChannel* channel, char* buffer);
+    virtual size_t produce(uint8_t* buffer, size_t max);
+    virtual void finished();
+};
+
+// A Server-Sent Events (text/event-stream) endpoint.  Browsers subscribe with
+// new EventSource(path) and the connection is kept open; each publish() is
+// queued to every subscriber and sent as soon as its connection has room.
+// This replaces each client polling for updates with one small write per
+// update.
+//
+// publish() must be called from the same core/loop as the network (e.g. the
+// main loop between cyw43_arch_poll() calls), not from the other core or an
+// interrupt.
+class EventChannel: public WebApp {
+    Webserver& server;
+    const char* path;
+    EventSubscriber* subscribers;
+    int subscriberCount;
+    uint32_t publishedCount;
+
+    public:
+    EventChannel(Webserver& server, const char* path);
+
+    virtual void addRoutes(Router& router);
+    virtual void process(HttpRequest& request, HttpResponse& response);
+
+    void publish(const char* event, const char* data);
+    void unsubscribe(EventSubscriber* subscriber);
+
+    int subscribed() const { return subscriberCount;}
+    uint32_t published() const { return publishedCount;}
+};
+
+#endif
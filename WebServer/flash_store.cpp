@@ -0,0 +1,160 @@
+#include <stddef.h>
+#include <string.h>
+#include "flash_store.hpp"
+#include "crc32.hpp"
+#include "pico/flash.h"
+#include "pico/printf.h"
+
+#define FLASH_STORE_MAGIC 0x464C5354   // "FLST"
+
+// How long to wait for core 1 to get out of the way of a flash write.
+#define FLASH_STORE_LOCKOUT_MS 100
+
+/// @brief Finds the current image, if there is one.
+FlashStore::FlashStore()
+: current(0)
+, readers{0, 0}
+, writing(false)
+, target(0)
+{
+    for(int i=0; i<2; ++i){
+        const Header* h = headerAt(i);
+        if(isValid(h) && (!current || (int32_t)(h->sequence - current->sequence) > 0)){
+            current = h;
+        }
+    }
+}
+
+/// @brief Gets one of the two header records (memory mapped).
+const FlashStore::Header* FlashStore::headerAt(int index){
+    return (const Header*)(XIP_BASE + FLASH_STORE_OFFSET + index * FLASH_SECTOR_SIZE);
+}
+
+/// @brief Offset of a slot from the start of flash.
+uint32_t FlashStore::slotOffset(int slot){
+    return FLASH_STORE_OFFSET + 2 * FLASH_SECTOR_SIZE + slot * FLASH_STORE_SLOT_SIZE;
+}
+
+/// @brief Gets a slot's contents (memory mapped).
+const uint8_t* FlashStore::slotAt(int slot){
+    return (const uint8_t*)(XIP_BASE + slotOffset(slot));
+}
+
+/// @brief Checks a header record is complete and describes a whole image.
+bool FlashStore::isValid(const Header* header){
+    return header->magic == FLASH_STORE_MAGIC
+        && header->slot < 2
+        && header->length <= FLASH_STORE_SLOT_SIZE
+        && header->check == Crc32::of(header, offsetof(Header, check));
+}
+
+struct FlashWrite {
+    uint32_t offset;
+    const uint8_t* data;
+    size_t length;
+};
+
+// Runs with the other core locked out and interrupts off.
+static void eraseAndProgramUnsafe(void* param){
+    FlashWrite* write = (FlashWrite*)param;
+    flash_range_erase(write->offset, FLASH_SECTOR_SIZE);
+    flash_range_program(write->offset, write->data, write->length);
+}
+
+/// @brief Erases a sector and programs data into it.
+/// @param offset is the sector's offset from the start of flash.
+/// @param data is what to write, in RAM.
+/// @param length is a multiple of FLASH_PAGE_SIZE up to FLASH_SECTOR_SIZE.
+/// @return true if written.
+bool FlashStore::eraseAndProgram(uint32_t offset, const uint8_t* data, size_t length){
+    assert(offset % FLASH_SECTOR_SIZE == 0);
+    assert(length % FLASH_PAGE_SIZE == 0 && length <= FLASH_SECTOR_SIZE);
+    FlashWrite write = {offset, data, length};
+    int rc = flash_safe_execute(eraseAndProgramUnsafe, &write, FLASH_STORE_LOCKOUT_MS);
+    if(rc != PICO_OK){
+        printf("Flash write at %08lx failed %d\n", (unsigned long)offset, rc);
+        return false;
+    }
+    return true;
+}
+
+/// @brief Starts sending the current image.
+/// @return the slot being read, for endRead(), or -1 if there's no image.
+int FlashStore::startRead(){
+    if(!current) return -1;
+    ++readers[current->slot];
+    return current->slot;
+}
+
+/// @brief Finished sending an image.
+/// @param slot is the value startRead() returned.
+void FlashStore::endRead(int slot){
+    if(slot >= 0 && readers[slot] > 0) --readers[slot];
+}
+
+/// @brief Gets ready to write a new image into the slot not in use.
+/// @return false if a write is already going on, or the slot is still being
+/// read from (it held the image before last).
+bool FlashStore::startWrite(){
+    if(writing) return false;
+    target = current ? 1 - current->slot : 0;
+    if(readers[target] > 0) return false;
+    writing = true;
+    return true;
+}
+
+/// @brief Writes the next sector of the new image.
+/// @param offset is where it goes in the image, a multiple of FLASH_SECTOR_SIZE.
+/// @param sector is FLASH_SECTOR_SIZE bytes in RAM.
+/// @return true if written.
+bool FlashStore::writeSector(uint32_t offset, const uint8_t* sector){
+    assert(writing);
+    if(offset + FLASH_SECTOR_SIZE > FLASH_STORE_SLOT_SIZE) return false;
+    return eraseAndProgram(slotOffset(target) + offset, sector, FLASH_SECTOR_SIZE);
+}
+
+/// @brief Checks what was written and makes it the current image.
+/// @param length is the image length.
+/// @param crc is the Crc32 of the image as received.
+/// @param contentType is kept with the image, e.g. "text/html".
+/// @return true if the new image is now current, false if it didn't read
+/// back correctly (the old image stays current).
+bool FlashStore::finishWrite(size_t length, uint32_t crc, const char* contentType){
+    assert(writing);
+    writing = false;
+    if(length > FLASH_STORE_SLOT_SIZE || Crc32::of(slotAt(target), length) != crc){
+        printf("Flash image failed verification\n");
+        return false;
+    }
+
+    // Header goes in the sector that isn't the current header.
+    union {
+        Header header;
+        uint8_t page[FLASH_PAGE_SIZE];
+    } buffer;
+    static_assert(sizeof(Header) <= FLASH_PAGE_SIZE, "header must fit a flash page");
+    memset(buffer.page, 0xFF, sizeof(buffer.page));
+    Header& h = buffer.header;
+    h.magic = FLASH_STORE_MAGIC;
+    h.sequence = current ? current->sequence + 1 : 1;
+    h.slot = target;
+    h.length = length;
+    h.crc = crc;
+    strncpy(h.contentType, contentType ? contentType : "application/octet-stream", FLASH_STORE_TYPE_MAX - 1);
+    h.contentType[FLASH_STORE_TYPE_MAX - 1] = 0;
+    h.check = Crc32::of(&h, offsetof(Header, check));
+
+    int index = h.sequence & 1;
+    if(!eraseAndProgram(FLASH_STORE_OFFSET + index * FLASH_SECTOR_SIZE, buffer.page, FLASH_PAGE_SIZE)){
+        return false;
+    }
+    if(!isValid(headerAt(index))) return false;
+    current = headerAt(index);
+    printf("Flash image %lu: %lu bytes in slot %d\n", (unsigned long)h.sequence, (unsigned long)length, target);
+    return true;
+}
+
+/// @brief Gives up on a new image.  The current one is unaffected.
+void FlashStore::cancelWrite(){
+    writing = false;
+}
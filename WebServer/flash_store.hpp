@@ -0,0 +1,79 @@
+#ifndef FLASH_STORE_HPP
+#define FLASH_STORE_HPP
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+
+// Largest image that can be stored.  Two of these, plus two sectors for the
+// headers, are reserved at the top of flash so keep the firmware clear of it.
+#ifndef FLASH_STORE_SLOT_SIZE
+#define FLASH_STORE_SLOT_SIZE (256 * 1024)
+#endif
+
+#define FLASH_STORE_SIZE (2 * FLASH_SECTOR_SIZE + 2 * FLASH_STORE_SLOT_SIZE)
+
+// Offset of the region from the start of flash.
+#ifndef FLASH_STORE_OFFSET
+#define FLASH_STORE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_STORE_SIZE)
+#endif
+
+// Longest content type kept with an image.
+#define FLASH_STORE_TYPE_MAX 48
+
+// Keeps one image (a web page, effect data...) in flash that can be replaced
+// over the network.  There are two slots: a new image is written to the one
+// not in use while the current one carries on being served, and only once it
+// has been written and checked does a header record switch to it.  Headers
+// alternate between two sectors with a sequence number, so losing power at
+// any point leaves either the old image or the new one, never a mixture.
+//
+// Erasing and programming stop flash being read, so they go through
+// flash_safe_execute(): if core 1 is running it must have called
+// flash_safe_execute_core_init() first.
+class FlashStore {
+    struct Header {
+        uint32_t magic;
+        uint32_t sequence;      // highest valid sequence is current.
+        uint32_t slot;          // 0 or 1.
+        uint32_t length;
+        uint32_t crc;           // Crc32 of the image.
+        char contentType[FLASH_STORE_TYPE_MAX];
+        uint32_t check;         // Crc32 of the fields above.
+    };
+
+    const Header* current;      // in flash, 0 if no image.
+    int readers[2];             // responses being sent from each slot.
+    bool writing;
+    int target;                 // slot being written.
+
+    static const Header* headerAt(int index);
+    static const uint8_t* slotAt(int slot);
+    static uint32_t slotOffset(int slot);
+    static bool isValid(const Header* header);
+
+    public:
+    FlashStore();
+
+    bool hasImage() const { return current != 0;}
+    const uint8_t* data() const { return current ? slotAt(current->slot) : 0;}
+    size_t length() const { return current ? current->length : 0;}
+    uint32_t crc() const { return current ? current->crc : 0;}
+    const char* contentType() const { return current ? current->contentType : 0;}
+    uint32_t sequence() const { return current ? current->sequence : 0;}
+
+    // Reading.  Keeps the slot from being overwritten while it's sent.
+    int startRead();
+    void endRead(int slot);
+
+    // Writing a new image.
+    bool startWrite();
+    bool writeSector(uint32_t offset, const uint8_t* sector);
+    bool finishWrite(size_t length, uint32_t crc, const char* contentType);
+    void cancelWrite();
+    static size_t capacity() { return FLASH_STORE_SLOT_SIZE;}
+
+    // Also used for other small records kept in flash (e.g. WifiStation's).
+    static bool eraseAndProgram(uint32_t offset, const uint8_t* data, size_t length);
+};
+
+#endif
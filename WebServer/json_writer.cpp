@@ -0,0 +1,244 @@
+#include <string.h>
+#include "json_writer.hpp"
+#include "block_malloc.hpp"
+
+// Somewhere to point at if a Block has no room for the buffer.
+static char noBuffer[1];
+
+/// @brief Creates a writer that writes into a buffer.
+/// @param buffer is where the JSON goes.
+/// @param size is the size of buffer, including room for the NUL.
+/// @param state is where a previous writer got to, to carry on its document.
+JsonWriter::JsonWriter(char* buffer, size_t size, const State& state)
+: buffer(buffer)
+, pos(buffer)
+, end(buffer + (size ? size - 1 : 0))
+, overflow(size == 0)
+, state(state)
+{
+    if(size == 0){
+        this->buffer = pos = end = noBuffer;
+    }
+}
+
+/// @brief Creates a writer with a buffer taken from a block.
+/// @param block is where to allocate the buffer, e.g. response.getBlock().
+/// @param size is the most the JSON can take, including the NUL.
+JsonWriter::JsonWriter(Block* block, size_t size)
+: buffer(size ? (char*)block->allocate(size) : 0)
+, pos(buffer)
+, end(buffer ? buffer + size - 1 : 0)
+, overflow(buffer == 0)
+{
+    if(!buffer){
+        buffer = pos = end = noBuffer;
+    }
+}
+
+// Once something hasn't fitted nothing more is written, so the text is
+// complete up to where it stopped.
+void JsonWriter::put(char c){
+    if(pos < end && !overflow) *pos++ = c;
+    else overflow = true;
+}
+
+void JsonWriter::put(const char* text, size_t length){
+    if(overflow || length > (size_t)(end - pos)){
+        overflow = true;
+        return;
+    }
+    memcpy(pos, text, length);
+    pos += length;
+}
+
+/// @brief Puts a comma before the next item of an object or array if it
+/// isn't the first.
+void JsonWriter::separate(){
+    if(state.afterKey){
+        state.afterKey = false;
+        return;
+    }
+    if(state.depth > 0){
+        uint32_t bit = 1u << state.depth;
+        if(state.hasItems & bit) put(',');
+        state.hasItems |= bit;
+    }
+}
+
+void JsonWriter::open(char c){
+    separate();
+    put(c);
+    if(state.depth == 31){
+        overflow = true;
+        return;
+    }
+    ++state.depth;
+    state.hasItems &= ~(1u << state.depth);
+}
+
+void JsonWriter::close(char c){
+    if(state.depth > 0) --state.depth;
+    put(c);
+}
+
+/// @brief Writes an object's key.  Its value is written next.
+/// @param name is the key.  It isn't escaped so must be plain text.
+JsonWriter& JsonWriter::key(const char* name){
+    separate();
+    put('"');
+    put(name, strlen(name));
+    put('"');
+    put(':');
+    state.afterKey = true;
+    return *this;
+}
+
+/// @brief Writes a string, escaped as needed.
+/// @param text is the string, or 0 for null.
+JsonWriter& JsonWriter::value(const char* text){
+    if(!text) return null();
+    static const char hexDigits[] = "0123456789abcdef";
+    separate();
+    put('"');
+    for(const char* p = text; *p; ++p){
+        unsigned char c = *p;
+        if(c == '"' || c == '\\'){
+            put('\\');
+            put(c);
+        } else if(c >= 0x20){
+            put(c);
+        } else if(c == '\n'){
+            put("\\n", 2);
+        } else if(c == '\r'){
+            put("\\r", 2);
+        } else if(c == '\t'){
+            put("\\t", 2);
+        } else {
+            char escape[6] = {'\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xF]};
+            put(escape, sizeof(escape));
+        }
+    }
+    put('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool b){
+    separate();
+    if(b) put("true", 4);
+    else put("false", 5);
+    return *this;
+}
+
+JsonWriter& JsonWriter::null(){
+    separate();
+    put("null", 4);
+    return *this;
+}
+
+/// @brief Writes ready made JSON (e.g. a stored fragment) as the next value.
+JsonWriter& JsonWriter::raw(const char* json){
+    separate();
+    put(json, strlen(json));
+    return *this;
+}
+
+/// @brief Writes digits without going through printf.  32 bit division is
+/// cheap on the Pico so that's used when the number fits.
+void JsonWriter::writeUnsigned(uint32_t n){
+    char digits[10];
+    int i = sizeof(digits);
+    do {
+        digits[--i] = '0' + n % 10;
+        n /= 10;
+    } while(n);
+    put(digits + i, sizeof(digits) - i);
+}
+
+void JsonWriter::writeUnsigned64(uint64_t n){
+    if(n <= 0xFFFFFFFFu){
+        writeUnsigned((uint32_t)n);
+        return;
+    }
+    char digits[20];
+    int i = sizeof(digits);
+    do {
+        digits[--i] = '0' + n % 10;
+        n /= 10;
+    } while(n);
+    put(digits + i, sizeof(digits) - i);
+}
+
+JsonWriter& JsonWriter::value(long long n){
+    separate();
+    if(n < 0){
+        put('-');
+        writeUnsigned64(0 - (unsigned long long)n);
+    } else {
+        writeUnsigned64(n);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(unsigned long long n){
+    separate();
+    writeUnsigned64(n);
+    return *this;
+}
+
+/// @brief Writes a number with a fixed number of decimal places, which is
+/// all sensor readings need and much cheaper than %g.
+/// @param f is the number.  NaN and infinity (not valid JSON) become null, as
+/// does anything beyond +-1e18 which won't fit the fixed point.
+/// @param decimals is the number of decimal places, 0 to 6.
+JsonWriter& JsonWriter::value(float f, int decimals){
+    if(f != f || f > 1e18f || f < -1e18f) return null();
+    static const uint32_t scales[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+    if(decimals < 0) decimals = 0;
+    if(decimals > 6) decimals = 6;
+
+    separate();
+    bool negative = f < 0;
+    if(negative) f = -f;
+
+    uint32_t scale = scales[decimals];
+    float rounded = f * scale + 0.5f;
+    if(rounded >= 1.8e19f){     // too many decimals for the size; lose some.
+        rounded = f + 0.5f;
+        scale = 1;
+        decimals = 0;
+    }
+    uint64_t scaled = (uint64_t)rounded;
+    uint64_t whole = scaled / scale;
+    uint32_t fraction = (uint32_t)(scaled - whole * scale);
+    if(negative && scaled) put('-');
+    writeUnsigned64(whole);
+    if(decimals){
+        put('.');
+        char digits[6];
+        for(int i = decimals - 1; i >= 0; --i){
+            digits[i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        put(digits, decimals);
+    }
+    return *this;
+}
+
+/// @brief Writes a number as a string of hex digits (upper case), e.g. for
+/// values too wide for JavaScript numbers.
+/// @param n is the number.
+/// @param digits is the number of low order digits to write, up to 16.
+JsonWriter& JsonWriter::hex(uint64_t n, int digits){
+    static const char hexDigits[] = "0123456789ABCDEF";
+    if(digits > 16) digits = 16;
+    char text[18];
+    text[0] = '"';
+    for(int i = digits; i > 0; --i){
+        text[i] = hexDigits[n & 0xF];
+        n >>= 4;
+    }
+    text[digits + 1] = '"';
+    separate();
+    put(text, digits + 2);
+    return *this;
+}
@@ -0,0 +1,83 @@
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include "pico/stdlib.h"
+
+class Block;
+
+// Writes JSON straight into a buffer, putting in the commas and colons, with
+// no heap or stdio use.  The buffer can be the caller's, taken from a Block
+// (e.g. the response's) or the one a BodyProducer is given; in the last case
+// the writer's State is kept between calls to produce() so the document can
+// carry on where it left off, e.g.
+//
+//   JsonWriter json(response.getBlock(), 128);
+//   json.beginObject()
+//       .field("temperature", 21.5f)
+//       .key("hours").beginArray().value(1).value(2).endArray()
+//       .endObject();
+//   response.setBody(json.c_str());
+//
+// If the buffer fills, writing stops and overflowed() is set.  The text is
+// always NUL terminated so one byte of the buffer is kept for that.
+class JsonWriter {
+    public:
+    // Where the writer is up to in the document.
+    struct State {
+        uint8_t depth;      // objects and arrays open.
+        bool afterKey;      // a key has been written, its value is next.
+        uint32_t hasItems;  // bit n set once the container at depth n has an item.
+
+        State() : depth(0), afterKey(false), hasItems(0) {}
+    };
+
+    private:
+    char* buffer;
+    char* pos;
+    char* end;          // last byte, kept for the NUL.
+    bool overflow;
+    State state;
+
+    void put(char c);
+    void put(const char* text, size_t length);
+    void separate();
+    void open(char c);
+    void close(char c);
+    void writeUnsigned(uint32_t n);
+    void writeUnsigned64(uint64_t n);
+
+    public:
+    JsonWriter(char* buffer, size_t size, const State& state = State());
+    JsonWriter(Block* block, size_t size);
+
+    JsonWriter& beginObject() { open('{'); return *this;}
+    JsonWriter& endObject() { close('}'); return *this;}
+    JsonWriter& beginArray() { open('['); return *this;}
+    JsonWriter& endArray() { close(']'); return *this;}
+    JsonWriter& key(const char* name);
+
+    JsonWriter& value(const char* text);
+    JsonWriter& value(bool b);
+    JsonWriter& value(int n) { return value((long long)n);}
+    JsonWriter& value(unsigned n) { return value((unsigned long long)n);}
+    JsonWriter& value(long n) { return value((long long)n);}
+    JsonWriter& value(unsigned long n) { return value((unsigned long long)n);}
+    JsonWriter& value(long long n);
+    JsonWriter& value(unsigned long long n);
+    JsonWriter& value(float f, int decimals = 2);
+    JsonWriter& value(double d, int decimals = 2) { return value((float)d, decimals);}
+    JsonWriter& hex(uint64_t n, int digits);
+    JsonWriter& null();
+    JsonWriter& raw(const char* json);
+
+    /// @brief Writes a key and its value.
+    template<typename T> JsonWriter& field(const char* name, T v) { return key(name).value(v);}
+
+    const char* c_str() { *pos = 0; return buffer;}
+    size_t length() const { return pos - buffer;}
+    size_t remaining() const { return end - pos;}
+    bool overflowed() const { return overflow;}
+    const State& getState() const { return state;}
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include <string.h>
+#include "metrics.hpp"
+
+////////////////////////////////////////////////////////////////////
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram()
+: total(0)
+{
+    memset(counts, 0, sizeof(counts));
+}
+
+/// @brief Counts a time in its bucket.
+/// @param us is the time in microseconds.
+void LatencyHistogram::record(uint32_t us){
+    // Bucket k holds up to 2^(4 + 2k) so it follows from the number of bits
+    // in us - 1 without searching the bounds.
+    int bits = (us > 1) ? 32 - __builtin_clz(us - 1) : 0;
+    int k = (bits <= 4) ? 0 : (bits - 3) / 2;
+    if(k > METRICS_BUCKETS) k = METRICS_BUCKETS;
+    ++counts[k];
+    total += us;
+}
+
+/// @brief Number of times recorded.
+uint32_t LatencyHistogram::count() const {
+    uint32_t n = 0;
+    for(int i=0; i<=METRICS_BUCKETS; ++i) n += counts[i];
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////
+// RouteMetrics
+
+RouteMetrics::RouteMetrics()
+: aborted(0)
+, bytes(0)
+{
+    memset(responses, 0, sizeof(responses));
+}
+
+/// @brief Whether any request has been seen for the route.
+bool RouteMetrics::isUsed() const {
+    if(aborted) return true;
+    for(int i=0; i<5; ++i){
+        if(responses[i]) return true;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+// ServerMetrics
+
+ServerMetrics::ServerMetrics()
+: stallCount(0)
+, connectionHighWater(0)
+{}
+
+/// @brief Finds where a route's statistics are kept.
+/// @param routeIndex is the route's index from Router::find(), 0 for none.
+/// @return the slot.
+int ServerMetrics::slot(int routeIndex){
+    return (routeIndex <= METRICS_MAX_ROUTES) ? routeIndex : METRICS_MAX_ROUTES + 1;
+}
+
+/// @brief Records a response about to be sent.
+/// @param slot is the route's slot.
+/// @param status is the HTTP status code.
+/// @param parseUs is the time spent parsing the request.
+/// @param handlerUs is the time taken to produce the response.
+void ServerMetrics::responded(int slot, int status, uint32_t parseUs, uint32_t handlerUs){
+    RouteMetrics& r = routes[slot];
+    int statusClass = status / 100 - 1;
+    if(statusClass < 0 || statusClass > 4) statusClass = 4;
+    ++r.responses[statusClass];
+    r.parse.record(parseUs);
+    r.handler.record(handlerUs);
+}
+
+/// @brief Tracks the number of open connections.
+/// @param inUse is the number open now.
+void ServerMetrics::connections(int inUse){
+    if(inUse > connectionHighWater) connectionHighWater = inUse;
+}
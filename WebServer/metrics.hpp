@@ -0,0 +1,77 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include "pico/stdlib.h"
+
+// Latency histogram buckets.  Bucket k counts times up to 16us * 4^k so ten
+// buckets cover 16us to 4s; anything slower only shows in the +Inf bucket.
+#define METRICS_BUCKETS 10
+
+// Routes with statistics of their own (see Router::find()'s index).  Any
+// routes beyond these are counted together.
+#ifndef METRICS_MAX_ROUTES
+#define METRICS_MAX_ROUTES 16
+#endif
+
+// Counts of times falling in fixed log scale buckets, as for a Prometheus
+// histogram but stored per bucket rather than cumulatively.
+class LatencyHistogram {
+    uint32_t counts[METRICS_BUCKETS + 1];  // last is +Inf.
+    uint64_t total;                         // us.
+
+    public:
+    LatencyHistogram();
+    void record(uint32_t us);
+
+    /// @brief Upper bound of a bucket in us.
+    static uint32_t bound(int bucket) { return 16u << (2 * bucket);}
+    uint32_t bucket(int i) const { return counts[i];}
+    uint32_t count() const;
+    uint64_t sum() const { return total;}
+};
+
+// What happened to the requests for one route.
+struct RouteMetrics {
+    uint32_t responses[5];      // by status class, 1xx to 5xx.
+    uint32_t aborted;           // connection lost before the response was all acknowledged.
+    uint64_t bytes;             // response bytes acknowledged.
+    LatencyHistogram parse;     // time spent parsing the request.
+    LatencyHistogram handler;   // routing to the response being ready, including the AsyncWorker.
+    LatencyHistogram ack;       // response head sent to the last byte being acknowledged.
+
+    RouteMetrics();
+    bool isUsed() const;
+};
+
+// Statistics the Webserver keeps when given one with setMetrics(), served in
+// Prometheus text format by MetricsWebapp.  Slot 0 is for requests that
+// didn't match a route (404s and requests that couldn't be parsed), slots 1
+// to METRICS_MAX_ROUTES are the routes with those indices and the last slot
+// is every route after that.
+//
+// Only used from the network loop (core 0), so there's no locking.
+class ServerMetrics {
+    RouteMetrics routes[METRICS_MAX_ROUTES + 2];
+    uint32_t stallCount;        // sends refused for lack of buffers (ERR_MEM).
+    int connectionHighWater;    // most connections open at once.
+
+    public:
+    ServerMetrics();
+
+    static int slot(int routeIndex);
+    static int slotCount() { return METRICS_MAX_ROUTES + 2;}
+    static bool isOverflowSlot(int slot) { return slot == METRICS_MAX_ROUTES + 1;}
+
+    void responded(int slot, int status, uint32_t parseUs, uint32_t handlerUs);
+    void acknowledged(int slot, uint32_t us) { routes[slot].ack.record(us);}
+    void sent(int slot, size_t bytes) { routes[slot].bytes += bytes;}
+    void aborted(int slot) { ++routes[slot].aborted;}
+    void sendStalled() { ++stallCount;}
+    void connections(int inUse);
+
+    const RouteMetrics& route(int slot) const { return routes[slot];}
+    uint32_t sendStalls() const { return stallCount;}
+    int connectionsHighWater() const { return connectionHighWater;}
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include <string.h>
+#include "metrics_webapp.hpp"
+#include "pico/printf.h"
+
+// Longest line of output.  Route paths are cut short to fit.
+#define METRICS_LINE_MAX 160
+
+struct MetricFamily {
+    const char* name;
+    const char* type;
+    const char* help;
+};
+
+// Server wide figures, sent in this order.  The cache ones come last so they
+// can be left off if there's no cache.
+enum Scalar {
+    BLOCKS_IN_USE,
+    BLOCKS_CAPACITY,
+    BLOCKS_HIGH_WATER,
+    BLOCK_ALLOCATIONS,
+    BLOCK_FAILURES,
+    BLOCKS_CHAINED,
+    CONNECTIONS_IN_USE,
+    CONNECTIONS_MAX,
+    CONNECTIONS_HIGH_WATER,
+    SEND_STALLS,
+    CACHE_HITS,
+    CACHE_MISSES,
+    CACHE_STORES,
+    SCALAR_COUNT
+};
+
+static const MetricFamily scalarFamilies[SCALAR_COUNT] = {
+    {"webserver_blocks_in_use", "gauge", "Memory blocks in use."},
+    {"webserver_blocks_capacity", "gauge", "Memory blocks in the pool."},
+    {"webserver_blocks_high_water", "gauge", "Most memory blocks in use at once."},
+    {"webserver_block_allocations_total", "counter", "Memory blocks handed out."},
+    {"webserver_block_failures_total", "counter", "Memory block requests that found the pool empty."},
+    {"webserver_blocks_chained_total", "counter", "Memory blocks added to a chain for a large request or response."},
+    {"webserver_connections_in_use", "gauge", "Open client connections."},
+    {"webserver_connections_max", "gauge", "Client connections that can be open at once (MAX_CLIENTS)."},
+    {"webserver_connections_high_water", "gauge", "Most client connections open at once."},
+    {"webserver_send_stalls_total", "counter", "Sends refused by the TCP stack for lack of buffers (ERR_MEM)."},
+    {"webserver_cache_hits_total", "counter", "GETs answered from the response cache."},
+    {"webserver_cache_misses_total", "counter", "Cacheable GETs that had to be handled."},
+    {"webserver_cache_stores_total", "counter", "Responses stored in the response cache."},
+};
+
+// Per route figures.
+enum RouteFamily {
+    RESPONSES,
+    ABORTED,
+    BYTES,
+    PARSE,
+    HANDLER,
+    ACK,
+    ROUTE_FAMILY_COUNT
+};
+
+static const MetricFamily routeFamilies[ROUTE_FAMILY_COUNT] = {
+    {"http_responses_total", "counter", "Responses by route and status class."},
+    {"http_aborted_total", "counter", "Connections lost before the response was acknowledged."},
+    {"http_response_bytes_total", "counter", "Response bytes acknowledged by clients."},
+    {"http_parse_seconds", "histogram", "Time spent parsing requests."},
+    {"http_handler_seconds", "histogram", "Time from a complete request to its response being ready."},
+    {"http_ack_seconds", "histogram", "Time from sending the response head to the last byte being acknowledged."},
+};
+
+// Generates the exposition a line at a time.  The server wide figures are
+// taken when the request arrives; the per route ones are read as they go.
+class MetricsProducer: public BodyProducer {
+    const ServerMetrics* metrics;   // 0 if the server isn't keeping any.
+    const Router& router;
+    uint64_t values[SCALAR_COUNT];
+    int scalars;        // how many of values to send.
+
+    int family;         // scalars first then the route families.
+    int step;           // 0 HELP, 1 TYPE, 2 samples.
+    int slot;           // route slot being sent.
+    int item;           // sample within the slot.
+
+    char line[METRICS_LINE_MAX];
+    size_t lineLength;
+    size_t lineSent;
+
+    bool nextLine();
+    bool routeLine(RouteFamily which);
+    void labels(int slot, char* text, size_t size);
+    void histogramLine(const char* name, const char* labels, const LatencyHistogram& h, int i);
+
+    public:
+    MetricsProducer(Webserver& server);
+    virtual size_t produce(uint8_t* buffer, size_t max);
+};
+
+MetricsProducer::MetricsProducer(Webserver& server)
+: metrics(server.getMetrics())
+, router(server.routes())
+, family(0)
+, step(0)
+, slot(0)
+, item(0)
+, lineLength(0)
+, lineSent(0)
+{
+    const BlockPool& pool = server.pool();
+    values[BLOCKS_IN_USE] = pool.inUse();
+    values[BLOCKS_CAPACITY] = pool.capacity();
+    values[BLOCKS_HIGH_WATER] = pool.highWater();
+    values[BLOCK_ALLOCATIONS] = pool.allocations();
+    values[BLOCK_FAILURES] = pool.failures();
+    values[BLOCKS_CHAINED] = pool.chained();
+    values[CONNECTIONS_IN_USE] = server.connectionsInUse();
+    values[CONNECTIONS_MAX] = MAX_CLIENTS;
+    values[CONNECTIONS_HIGH_WATER] = metrics ? metrics->connectionsHighWater() : 0;
+    values[SEND_STALLS] = metrics ? metrics->sendStalls() : 0;
+
+    const ResponseCache* cache = server.responseCache();
+    if(cache){
+        values[CACHE_HITS] = cache->hits();
+        values[CACHE_MISSES] = cache->misses();
+        values[CACHE_STORES] = cache->stores();
+        scalars = SCALAR_COUNT;
+    } else {
+        scalars = CACHE_HITS;
+    }
+}
+
+size_t MetricsProducer::produce(uint8_t* buffer, size_t max){
+    size_t n = 0;
+    while(n < max){
+        if(lineSent == lineLength && !nextLine()) break;
+        size_t len = lineLength - lineSent;
+        if(len > max - n) len = max - n;
+        memcpy(buffer + n, line + lineSent, len);
+        lineSent += len;
+        n += len;
+    }
+    return n;
+}
+
+/// @brief Puts the next line of output in line.
+/// @return false once everything has been sent.
+bool MetricsProducer::nextLine(){
+    int families = scalars + (metrics ? ROUTE_FAMILY_COUNT : 0);
+    while(family < families){
+        bool isScalar = family < scalars;
+        const MetricFamily& f = isScalar ? scalarFamilies[family] : routeFamilies[family - scalars];
+        int written = 0;
+        if(step == 0){
+            written = snprintf(line, sizeof(line), "# HELP %s %s\n", f.name, f.help);
+            step = 1;
+        } else if(step == 1){
+            written = snprintf(line, sizeof(line), "# TYPE %s %s\n", f.name, f.type);
+            step = 2;
+            slot = 0;
+            item = 0;
+        } else if(isScalar){
+            written = snprintf(line, sizeof(line), "%s %llu\n", f.name, (unsigned long long)values[family]);
+            ++family;
+            step = 0;
+        } else if(routeLine((RouteFamily)(family - scalars))){
+            return true;
+        } else {
+            ++family;
+            step = 0;
+            continue;
+        }
+        lineLength = (written < (int)sizeof(line)) ? written : sizeof(line) - 1;
+        lineSent = 0;
+        return true;
+    }
+    return false;
+}
+
+/// @brief Writes the label set for a route slot e.g. verb="GET",route="/adcdata".
+void MetricsProducer::labels(int slot, char* text, size_t size){
+    if(slot == 0){
+        snprintf(text, size, "route=\"none\"");
+    } else if(ServerMetrics::isOverflowSlot(slot)){
+        snprintf(text, size, "route=\"other\"");
+    } else {
+        const char* verb = router.routeVerb(slot);
+        snprintf(text, size, "verb=\"%s\",route=\"%.80s%s\"", verb ? verb : "*",
+            router.routePath(slot), router.isPrefix(slot) ? "*" : "");
+    }
+}
+
+/// @brief Writes one sample of a histogram.
+/// @param i is the bucket, METRICS_BUCKETS for +Inf, then one more for the
+/// sum and another for the count.
+void MetricsProducer::histogramLine(const char* name, const char* labels, const LatencyHistogram& h, int i){
+    int written;
+    if(i < METRICS_BUCKETS){
+        uint32_t cumulative = 0;
+        for(int b=0; b<=i; ++b) cumulative += h.bucket(b);
+        uint32_t bound = LatencyHistogram::bound(i);
+        written = snprintf(line, sizeof(line), "%s_bucket{%s,le=\"%lu.%06lu\"} %lu\n", name, labels,
+            (unsigned long)(bound / 1000000), (unsigned long)(bound % 1000000), (unsigned long)cumulative);
+    } else if(i == METRICS_BUCKETS){
+        written = snprintf(line, sizeof(line), "%s_bucket{%s,le=\"+Inf\"} %lu\n", name, labels, (unsigned long)h.count());
+    } else if(i == METRICS_BUCKETS + 1){
+        uint64_t us = h.sum();
+        written = snprintf(line, sizeof(line), "%s_sum{%s} %llu.%06llu\n", name, labels,
+            (unsigned long long)(us / 1000000), (unsigned long long)(us % 1000000));
+    } else {
+        written = snprintf(line, sizeof(line), "%s_count{%s} %lu\n", name, labels, (unsigned long)h.count());
+    }
+    lineLength = (written < (int)sizeof(line)) ? written : sizeof(line) - 1;
+    lineSent = 0;
+}
+
+/// @brief Writes the next sample of a per route family, skipping routes with
+/// no requests and zero status classes.
+/// @return false once all the routes have been done.
+bool MetricsProducer::routeLine(RouteFamily which){
+    const char* name = routeFamilies[which].name;
+    int items = (which == RESPONSES) ? 5 : (which == ABORTED || which == BYTES) ? 1 : METRICS_BUCKETS + 3;
+
+    for(; slot < ServerMetrics::slotCount(); ++slot, item = 0){
+        const RouteMetrics& r = metrics->route(slot);
+        if(!r.isUsed()) continue;
+        if(which == RESPONSES){
+            while(item < items && r.responses[item] == 0) ++item;
+        }
+        if(item >= items) continue;
+
+        char text[METRICS_LINE_MAX / 2 + 32];
+        labels(slot, text, sizeof(text));
+        int i = item++;
+        int written;
+        switch(which){
+        case RESPONSES:
+            written = snprintf(line, sizeof(line), "%s{%s,code=\"%dxx\"} %lu\n", name, text, i + 1,
+                (unsigned long)r.responses[i]);
+            break;
+        case ABORTED:
+            written = snprintf(line, sizeof(line), "%s{%s} %lu\n", name, text, (unsigned long)r.aborted);
+            break;
+        case BYTES:
+            written = snprintf(line, sizeof(line), "%s{%s} %llu\n", name, text, (unsigned long long)r.bytes);
+            break;
+        default:
+            histogramLine(name, text,
+                which == PARSE ? r.parse : which == HANDLER ? r.handler : r.ack, i);
+            return true;
+        }
+        lineLength = (written < (int)sizeof(line)) ? written : sizeof(line) - 1;
+        lineSent = 0;
+        return true;
+    }
+    return false;
+}
+
+/// @brief Creates the webapp.
+/// @param server is the server to report on.  Give it a ServerMetrics with
+/// setMetrics() for the per route figures.
+/// @param path is the URL to serve them on.
+MetricsWebapp::MetricsWebapp(Webserver& server, const char* path)
+: server(server)
+, path(path)
+{}
+
+void MetricsWebapp::addRoutes(Router& router){
+    router.exact("GET", path, this);
+}
+
+void MetricsWebapp::process(HttpRequest&, HttpResponse& response){
+    MetricsProducer* producer = new(response.getBlock()) MetricsProducer(server);
+    if(!producer){
+        response.setStatus(503, "Service Unavailable");
+        return;
+    }
+    response.setStatus(200, "OK");
+    response.addStandardHeaders(HttpResponse::SERVER);
+    response.addHeader("Content-Type", "text/plain; version=0.0.4");
+    response.addHeader("Cache-Control", "no-store");
+    response.setBody(producer);
+}
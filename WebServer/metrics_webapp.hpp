@@ -0,0 +1,29 @@
+#ifndef METRICS_WEBAPP_HPP
+#define METRICS_WEBAPP_HPP
+
+#include "webserver.hpp"
+
+// Serves the Webserver's ServerMetrics, along with its block pool, connection
+// and response cache figures, in the Prometheus text exposition format so
+// they can be scraped e.g.
+//
+//   scrape_configs:
+//     - job_name: picow
+//       static_configs:
+//         - targets: ['picow:80']
+//
+// Per route series are labelled with the route's verb and path, and only
+// appear once the route has had a request.  The text is generated a line at a
+// time as it is sent so it needs no buffer however many routes there are.
+class MetricsWebapp: public WebApp {
+    Webserver& server;
+    const char* path;
+
+    public:
+    MetricsWebapp(Webserver& server, const char* path = "/metrics");
+
+    virtual void addRoutes(Router& router);
+    virtual void process(HttpRequest& request, HttpResponse& response);
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include "params.hpp"
+#include "webserver.hpp"
+#include "pico/printf.h"
+
+/// @brief Creates a schema and builds its name lookup table.
+/// @param specs is the table of parameters.  It must stay valid (usually static).
+/// @param count is the number of entries in specs.
+/// @param size is the size of the struct the parameters are decoded into.
+ParamSchema::ParamSchema(const ParamSpec* specs, int count, size_t size)
+: specs(specs)
+, count(count)
+, size(size)
+{
+    for(int i=0; i<PARAM_HASH_SIZE; ++i) table[i] = 0;
+
+    if(count >= PARAM_HASH_SIZE){
+        printf("ParamSchema: %d parameters is too many, only %d used\n", count, PARAM_HASH_SIZE - 1);
+        this->count = count = PARAM_HASH_SIZE - 1;
+    }
+
+    for(int i=0; i<count; ++i){
+        uint32_t slot = hash(specs[i].name) & (PARAM_HASH_SIZE - 1);
+        while(table[slot]) slot = (slot + 1) & (PARAM_HASH_SIZE - 1);
+        table[slot] = (int8_t)(i + 1);
+    }
+}
+
+/// @brief FNV-1a hash of a parameter name.
+uint32_t ParamSchema::hash(const char* name){
+    uint32_t h = 2166136261u;
+    while(*name){
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/// @brief Finds the spec for a parameter name.
+/// @param name is the parameter name.
+/// @return the spec or 0 if the schema doesn't have it.
+const ParamSpec* ParamSchema::lookup(const char* name) const {
+    uint32_t slot = hash(name) & (PARAM_HASH_SIZE - 1);
+    while(table[slot]){
+        const ParamSpec* spec = specs + table[slot] - 1;
+        if(strcmp(spec->name, name) == 0) return spec;
+        slot = (slot + 1) & (PARAM_HASH_SIZE - 1);
+    }
+    return 0;
+}
+
+/// @brief Writes a number into a field of the type given by the spec.
+/// @param spec describes the field.
+/// @param value is the value to store.
+/// @param field is the start of the field.
+void ParamSchema::store(const ParamSpec& spec, float value, uint8_t* field){
+    switch(spec.type){
+    case ParamType::INT:   *(int32_t*)field = (int32_t)value; break;
+    case ParamType::FLOAT: *(float*)field = value; break;
+    case ParamType::RGB:   *(uint32_t*)field = (uint32_t)value; break;
+    case ParamType::BOOL:  *(bool*)field = value != 0; break;
+    }
+}
+
+/// @brief Decodes and checks a parameter value.
+/// @param spec describes the parameter.
+/// @param text is the value from the query string.
+/// @param field is where to store the decoded value.
+/// @return true if the value was valid, false if not (field unchanged).
+bool ParamSchema::decode(const ParamSpec& spec, const char* text, uint8_t* field){
+    char* end = 0;
+    switch(spec.type){
+    case ParamType::INT: {
+        // Decimal, as atoi() was, so a leading 0 isn't octal; hex only with 0x.
+        bool hex = text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+        long v = strtol(text, &end, hex ? 16 : 10);
+        if(end == text || *end || v < spec.min || v > spec.max) return false;
+        *(int32_t*)field = (int32_t)v;
+        return true;
+    }
+    case ParamType::FLOAT: {
+        float v = strtof(text, &end);
+        if(end == text || *end || !(v >= spec.min && v <= spec.max)) return false;
+        *(float*)field = v;
+        return true;
+    }
+    case ParamType::RGB: {
+        if(*text == '#') ++text;
+        unsigned long v = strtoul(text, &end, 16);
+        if(end == text || *end || v > 0xFFFFFF) return false;
+        *(uint32_t*)field = (uint32_t)v;
+        return true;
+    }
+    case ParamType::BOOL:
+        if(*text == 0 || strcmp(text, "true") == 0 || strcmp(text, "on") == 0 || strcmp(text, "1") == 0){
+            *(bool*)field = true;
+            return true;
+        }
+        if(strcmp(text, "false") == 0 || strcmp(text, "off") == 0 || strcmp(text, "0") == 0){
+            *(bool*)field = false;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+/// @brief Decodes a request's parameters into a new struct.  Fields for
+/// parameters that aren't given get their defaults.
+/// @param request is the request with the parameters.
+/// @param block is where to allocate the struct (and any error message).
+/// @param error is set to a message describing the first bad parameter.
+/// @param status is set to 400 if a parameter is invalid, 500 if there's no memory.
+/// @return the struct or 0 if a parameter is invalid or there's no memory.
+void* ParamSchema::bind(HttpRequest& request, Block* block, const char*& error, int& status) const {
+    uint8_t* data = (uint8_t*)block->allocate(size);
+    if(!data){
+        error = "No memory for parameters\r\n";
+        status = 500;
+        return 0;
+    }
+
+    for(int i=0; i<count; ++i){
+        store(specs[i], specs[i].value, data + specs[i].offset);
+    }
+
+    BlockListIter<Parameter> iter = request.Parameters().iter();
+    Parameter* p;
+    while((p = iter.next())){
+        const ParamSpec* spec = lookup(p->name());
+        if(!spec) continue;
+        if(!decode(*spec, p->value(), data + spec->offset)){
+            // Only the schema's name, the value is the client's and isn't echoed.
+            size_t len = strlen(spec->name) + 32;
+            char* message = (char*)block->allocate(len);
+            if(message){
+                snprintf(message, len, "Invalid value for \"%s\"\r\n", spec->name);
+                error = message;
+            } else {
+                error = "Invalid parameter\r\n";
+            }
+            status = 400;
+            return 0;
+        }
+    }
+    return data;
+}
@@ -0,0 +1,72 @@
+#ifndef PARAMS_HPP
+#define PARAMS_HPP
+
+#include <stddef.h>
+#include "pico/stdlib.h"
+
+class HttpRequest;
+class Block;
+
+// Size of a schema's name lookup table.  Must be a power of 2 and larger
+// than the number of parameters in any schema.
+#ifndef PARAM_HASH_SIZE
+#define PARAM_HASH_SIZE 32
+#endif
+
+// How a query parameter is decoded and the type of field it is stored in.
+enum class ParamType : uint8_t {
+    INT,    // int32_t, decimal (or 0x hex).
+    FLOAT,  // float.
+    RGB,    // uint32_t, hex colour with optional leading #.
+    BOOL    // bool, true/false, on/off or 1/0.  A bare ?name is true.
+};
+
+// One query parameter.  A webapp declares a static table of these
+// describing a struct, e.g.
+//
+//   struct Settings { int32_t rate; float hue;};
+//   static const ParamSpec specs[] = {
+//       {"rate", ParamType::INT,   1, 1000, 1, offsetof(Settings, rate)},
+//       {"hue",  ParamType::FLOAT, 0, 1,    0, offsetof(Settings, hue)},
+//   };
+//   static const ParamSchema schema(specs, 2, sizeof(Settings));
+//
+// INT and FLOAT values outside min..max are rejected.  An RGB default is
+// given as a number e.g. 0xFF8000 (it is held exactly as a float).
+struct ParamSpec {
+    const char* name;
+    ParamType type;
+    float min;
+    float max;
+    float value;        // default if the parameter isn't given.
+    uint16_t offset;    // offsetof the field in the struct.
+};
+
+// Decodes a request's query parameters into a struct in a single pass over
+// the parameters.  Names are found through a small hash table built when the
+// schema is constructed, so each parameter costs one hash and (normally) one
+// string compare however many the schema has.  Parameters that aren't in the
+// schema are ignored.
+//
+// Give the schema to Router::exact or Router::prefix and the server binds the
+// parameters before calling the app, answering 400 Bad Request itself if any
+// are invalid (or 500 if there's no memory for them).  The app gets the struct from request.params<Settings>().
+class ParamSchema {
+    const ParamSpec* specs;
+    int count;
+    size_t size;
+    int8_t table[PARAM_HASH_SIZE];    // index into specs + 1, 0 if empty.
+
+    static uint32_t hash(const char* name);
+    static bool decode(const ParamSpec& spec, const char* text, uint8_t* field);
+    static void store(const ParamSpec& spec, float value, uint8_t* field);
+
+    public:
+    ParamSchema(const ParamSpec* specs, int count, size_t size);
+
+    const ParamSpec* lookup(const char* name) const;
+    void* bind(HttpRequest& request, Block* block, const char*& error, int& status) const;
+    size_t structSize() const { return size;}
+};
+
+#endif
@@ -0,0 +1,10 @@
+// Host stand-in for lwip/pbuf.h. The POSIX server hands plain buffers to the
+// application so pbufs are only ever seen as an opaque type.
+#ifndef HOST_LWIP_PBUF_H
+#define HOST_LWIP_PBUF_H
+
+#include "lwip/err.h"
+
+struct pbuf;
+
+#endif
@@ -0,0 +1,14 @@
+// Host stand-in for lwip/tcp.h. Enough for server.hpp to be included by the
+// portable sources; the lwIP TcpServer itself is not built on the host.
+#ifndef HOST_LWIP_TCP_H
+#define HOST_LWIP_TCP_H
+
+#include "lwip/err.h"
+#include "lwip/pbuf.h"
+
+struct tcp_pcb;
+
+#define TCP_WRITE_FLAG_COPY 0x01
+#define TCP_WRITE_FLAG_MORE 0x02
+
+#endif
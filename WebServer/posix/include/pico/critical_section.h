@@ -0,0 +1,15 @@
+// Host stand-in for pico/critical_section.h using a pthread mutex.
+#ifndef HOST_PICO_CRITICAL_SECTION_H
+#define HOST_PICO_CRITICAL_SECTION_H
+
+#include <pthread.h>
+
+typedef struct {
+    pthread_mutex_t mutex;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t* crit) { pthread_mutex_init(&crit->mutex, 0); }
+static inline void critical_section_enter_blocking(critical_section_t* crit) { pthread_mutex_lock(&crit->mutex); }
+static inline void critical_section_exit(critical_section_t* crit) { pthread_mutex_unlock(&crit->mutex); }
+
+#endif
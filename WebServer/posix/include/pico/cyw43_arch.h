@@ -0,0 +1,11 @@
+// Host stand-in for pico/cyw43_arch.h. There is no radio on the host and the
+// POSIX server is single threaded so the lwIP locking calls do nothing.
+#ifndef HOST_PICO_CYW43_ARCH_H
+#define HOST_PICO_CYW43_ARCH_H
+
+static inline void cyw43_arch_lwip_begin() {}
+static inline void cyw43_arch_lwip_end() {}
+static inline void cyw43_arch_lwip_check() {}
+static inline void cyw43_arch_poll() {}
+
+#endif
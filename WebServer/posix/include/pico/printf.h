@@ -0,0 +1,5 @@
+// Host stand-in for pico/printf.h - plain stdio on Linux.
+#ifndef HOST_PICO_PRINTF_H
+#define HOST_PICO_PRINTF_H
+#include <stdio.h>
+#endif
@@ -0,0 +1,54 @@
+// Host stand-in for the Pico SDK's pico/stdlib.h so the portable parts of the
+// web server (webserver, block_malloc, block_list, webapps) build on Linux.
+// Only what those files use is provided.
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <time.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+/// @brief Microseconds from a monotonic clock, as the Pico timer would give.
+static inline uint64_t time_us_64() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static inline uint32_t time_us_32() { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time() { return time_us_64(); }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000u); }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline uint get_core_num() { return 0; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + (uint64_t)ms * 1000u; }
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+
+static inline void sleep_ms(uint32_t ms) {
+    struct timespec ts = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, 0);
+}
+
+/// @brief The Pico waits for an event from the other core; here just nap.
+static inline bool best_effort_wfe_or_timeout(absolute_time_t t) {
+    struct timespec ts = { 0, 100000L };
+    nanosleep(&ts, 0);
+    return time_reached(t);
+}
+
+// newlib extension used by the firmware, not present in glibc.
+static inline char* itoa(int value, char* str, int base) {
+    if(base == 16) sprintf(str, "%x", value);
+    else sprintf(str, "%d", value);
+    return str;
+}
+
+#endif
@@ -0,0 +1,77 @@
+// Host stand-in for pico/util/queue.h: a fixed size ring of elements copied
+// in and out, safe between threads.
+#ifndef HOST_PICO_UTIL_QUEUE_H
+#define HOST_PICO_UTIL_QUEUE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    uint8_t* data;
+    uint element_size;
+    uint element_count;
+    uint rptr;
+    uint count;
+} queue_t;
+
+static inline void queue_init(queue_t* q, uint element_size, uint element_count) {
+    pthread_mutex_init(&q->mutex, 0);
+    pthread_cond_init(&q->changed, 0);
+    q->data = (uint8_t*)calloc(element_count, element_size);
+    q->element_size = element_size;
+    q->element_count = element_count;
+    q->rptr = 0;
+    q->count = 0;
+}
+
+// Called with the mutex held.
+static inline void queue_put_locked(queue_t* q, const void* data) {
+    uint wptr = (q->rptr + q->count) % q->element_count;
+    memcpy(q->data + wptr * q->element_size, data, q->element_size);
+    ++q->count;
+    pthread_cond_broadcast(&q->changed);
+}
+
+// Called with the mutex held.
+static inline void queue_get_locked(queue_t* q, void* data) {
+    memcpy(data, q->data + q->rptr * q->element_size, q->element_size);
+    q->rptr = (q->rptr + 1) % q->element_count;
+    --q->count;
+    pthread_cond_broadcast(&q->changed);
+}
+
+static inline bool queue_try_add(queue_t* q, const void* data) {
+    pthread_mutex_lock(&q->mutex);
+    bool ok = q->count < q->element_count;
+    if(ok) queue_put_locked(q, data);
+    pthread_mutex_unlock(&q->mutex);
+    return ok;
+}
+
+static inline bool queue_try_remove(queue_t* q, void* data) {
+    pthread_mutex_lock(&q->mutex);
+    bool ok = q->count > 0;
+    if(ok) queue_get_locked(q, data);
+    pthread_mutex_unlock(&q->mutex);
+    return ok;
+}
+
+static inline void queue_add_blocking(queue_t* q, const void* data) {
+    pthread_mutex_lock(&q->mutex);
+    while(q->count == q->element_count) pthread_cond_wait(&q->changed, &q->mutex);
+    queue_put_locked(q, data);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+static inline void queue_remove_blocking(queue_t* q, void* data) {
+    pthread_mutex_lock(&q->mutex);
+    while(q->count == 0) pthread_cond_wait(&q->changed, &q->mutex);
+    queue_get_locked(q, data);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+#endif
@@ -0,0 +1,417 @@
+// Host load generator for the web server.
+//
+// By default it starts the Webserver (with the Teapot and 404 apps) on a
+// PosixTcpServer in this process and hammers it from a number of client
+// threads.  With --target it drives any HTTP server instead e.g. a Pico W on
+// the bench.
+//
+// Two kinds of client are run side by side:
+//   one-shot   - new connection per request, "Connection: close"
+//   keep-alive - reuses its connection for as long as the server allows,
+//                optionally pipelining several requests per write.
+//
+// The in-process server also has /stream?size=N&chunked=1 which generates an
+// N byte body through a BodyProducer, to exercise large and chunked bodies,
+// and serves ../form.html as a gzipped static asset at / and /form.html.
+// /metrics gives the server's statistics in Prometheus format and /trace its
+// recent trace records.
+//
+// Reports requests/sec, p50/p99/max latency, errors, connections opened and,
+// when the server is in process, the BlockPool high-water mark.
+//
+// e.g. loadtest --clients 4 --keepalive 4 --duration 5 --path /coffee
+
+#include <errno.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "posix_server.hpp"
+#include "webserver.hpp"
+#include "teapot.hpp"
+#include "static_asset.hpp"
+#include "metrics_webapp.hpp"
+#include "trace_webapp.hpp"
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;              // 0 => run server in process.
+    int oneShotClients = 4;
+    int keepAliveClients = 4;
+    int durationS = 5;
+    int padding = 0;                // extra header bytes per request.
+    int pipeline = 1;               // requests per write for keep-alive clients.
+    std::vector<std::string> paths;
+    bool serverLog = false;
+};
+
+// Per client thread results.
+struct ClientStats {
+    std::vector<uint32_t> latencies;    // microseconds per request
+    unsigned long errors = 0;
+    unsigned long connections = 0;
+    unsigned long bytes = 0;
+};
+
+static std::atomic<bool> running(true);
+
+// Generates a body of a given size a piece at a time.
+class PatternProducer : public BodyProducer {
+    int size;
+    int produced;
+    bool chunked;
+
+    public:
+    PatternProducer(int size, bool chunked) : size(size), produced(0), chunked(chunked) {}
+    virtual int contentLength() { return chunked ? -1 : size;}
+    virtual size_t produce(uint8_t* buffer, size_t max){
+        size_t len = 0;
+        while(len < max && produced < size){
+            buffer[len++] = 'a' + (produced++ % 26);
+        }
+        return len;
+    }
+};
+
+// Serves /stream?size=N[&chunked=1] from a PatternProducer.
+class StreamApp : public WebApp {
+    struct Params {
+        int32_t size;
+        bool chunked;
+    };
+    static const ParamSpec specs[];
+    static const ParamSchema schema;
+
+    public:
+    virtual void addRoutes(Router& router){
+        router.exact("GET", "/stream", this, 0, &schema);
+    }
+    virtual void process(HttpRequest& request, HttpResponse& response){
+        const Params& params = request.params<Params>();
+        response.addHeader("Content-Type", "text/plain");
+        response.setBody(new(response.getBlock()) PatternProducer(params.size, params.chunked));
+    }
+};
+
+const ParamSpec StreamApp::specs[] = {
+    {"size",    ParamType::INT,  0, 16 * 1024 * 1024, 0, offsetof(Params, size)},
+    {"chunked", ParamType::BOOL, 0, 0,                0, offsetof(Params, chunked)},
+};
+
+const ParamSchema StreamApp::schema(specs, 2, sizeof(Params));
+
+static int connectTo(const Options& opts){
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = 0;
+    std::string port = std::to_string(opts.port);
+    if(getaddrinfo(opts.host.c_str(), port.c_str(), &hints, &res) != 0) return -1;
+    int fd = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if(fd >= 0 && ::connect(fd, res->ai_addr, res->ai_addrlen) != 0){
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if(fd >= 0){
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct timeval tv = {5, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    return fd;
+}
+
+static bool sendAll(int fd, const std::string& data){
+    size_t sent = 0;
+    while(sent < data.size()){
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Minimal HTTP/1.1 response reader.  Copes with Content-Length, chunked and
+// read-until-close bodies.  Any bytes read past the end of this response are
+// left in pending for the next one.
+class ResponseReader {
+    int fd;
+    std::string pending;
+
+    bool fill(){
+        char buffer[4096];
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if(n <= 0) return false;
+        pending.append(buffer, n);
+        return true;
+    }
+
+    bool readLine(std::string& line){
+        size_t pos;
+        while((pos = pending.find("\r\n")) == std::string::npos){
+            if(!fill()) return false;
+        }
+        line = pending.substr(0, pos);
+        pending.erase(0, pos + 2);
+        return true;
+    }
+
+    bool skip(size_t count){
+        while(pending.size() < count){
+            if(!fill()) return false;
+        }
+        pending.erase(0, count);
+        return true;
+    }
+
+    public:
+    ResponseReader(int fd) : fd(fd) {}
+
+    // Reads one response.  status is the HTTP status, closed is set if the
+    // connection can't be reused.  Returns false on a transport error.
+    bool read(int& status, bool& closed, unsigned long& bytes){
+        std::string line;
+        if(!readLine(line)) return false;
+        bytes += line.size() + 2;
+        if(line.compare(0, 5, "HTTP/") != 0) return false;
+        size_t sp = line.find(' ');
+        status = (sp == std::string::npos) ? 0 : atoi(line.c_str() + sp + 1);
+
+        long contentLength = -1;
+        bool chunked = false;
+        closed = false;
+        while(true){
+            if(!readLine(line)) return false;
+            bytes += line.size() + 2;
+            if(line.empty()) break;
+            std::string lower(line);
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            if(lower.compare(0, 15, "content-length:") == 0) contentLength = atol(line.c_str() + 15);
+            if(lower.compare(0, 18, "transfer-encoding:") == 0 && lower.find("chunked") != std::string::npos) chunked = true;
+            if(lower.compare(0, 11, "connection:") == 0 && lower.find("close") != std::string::npos) closed = true;
+        }
+
+        if(chunked){
+            while(true){
+                if(!readLine(line)) return false;
+                long size = strtol(line.c_str(), 0, 16);
+                if(!skip(size + 2)) return false;
+                bytes += line.size() + size + 4;
+                if(size == 0) break;
+            }
+        } else if(contentLength >= 0){
+            if(!skip(contentLength)) return false;
+            bytes += contentLength;
+        } else { // body runs to end of connection.
+            while(fill()) {}
+            bytes += pending.size();
+            pending.clear();
+            closed = true;
+        }
+        return true;
+    }
+};
+
+static std::string buildRequest(const Options& opts, const std::string& path, bool keepAlive){
+    std::string req = "GET " + path + " HTTP/1.1\r\n";
+    req += "Host: " + opts.host + "\r\n";
+    req += "User-Agent: loadtest\r\n";
+    req += "Accept: */*\r\n";
+    if(opts.padding > 0){
+        req += "X-Padding: " + std::string(opts.padding, 'x') + "\r\n";
+    }
+    req += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    req += "\r\n";
+    return req;
+}
+
+static void runClient(const Options& opts, bool keepAlive, int id, ClientStats& stats){
+    int fd = -1;
+    ResponseReader* reader = 0;
+    size_t next = id;
+    int depth = keepAlive ? std::max(opts.pipeline, 1) : 1;
+    while(running){
+        std::string request;
+        for(int i=0; i<depth; ++i){
+            const std::string& path = opts.paths[next++ % opts.paths.size()];
+            request += buildRequest(opts, path, keepAlive);
+        }
+
+        uint64_t start = time_us_64();
+        if(fd < 0){
+            fd = connectTo(opts);
+            if(fd < 0){
+                ++stats.errors;
+                sleep_ms(1);
+                continue;
+            }
+            ++stats.connections;
+            delete reader;
+            reader = new ResponseReader(fd);
+        }
+
+        // Each pipelined response is timed from when the batch was sent.
+        bool closed = false;
+        bool ok = sendAll(fd, request);
+        for(int i=0; i<depth; ++i){
+            int status = 0;
+            if(ok && !closed && reader->read(status, closed, stats.bytes) && status > 0 && status < 500){
+                stats.latencies.push_back((uint32_t)(time_us_64() - start));
+            } else {
+                ++stats.errors;
+                ok = false;
+            }
+        }
+
+        if(!ok || closed || !keepAlive){
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if(fd >= 0) ::close(fd);
+    delete reader;
+}
+
+static void usage(){
+    fprintf(stderr,
+        "usage: loadtest [options]\n"
+        "  --target host:port  drive an external server (default: in process)\n"
+        "  --clients N         one-shot clients (default 4)\n"
+        "  --keepalive N       keep-alive clients (default 4)\n"
+        "  --duration S        seconds to run (default 5)\n"
+        "  --path P            request path, repeat for a mix (default /coffee)\n"
+        "  --padding N         add an N byte header to each request\n"
+        "  --pipeline N        keep-alive clients send N requests at a time\n"
+        "  --log               leave the in-process server's printf output on\n");
+}
+
+static bool parseArgs(int argc, char** argv, Options& opts){
+    for(int i=1; i<argc; ++i){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--target" && hasValue){
+            std::string target = argv[++i];
+            size_t colon = target.rfind(':');
+            if(colon == std::string::npos) return false;
+            opts.host = target.substr(0, colon);
+            opts.port = (uint16_t)atoi(target.c_str() + colon + 1);
+        } else if(arg == "--clients" && hasValue){
+            opts.oneShotClients = atoi(argv[++i]);
+        } else if(arg == "--keepalive" && hasValue){
+            opts.keepAliveClients = atoi(argv[++i]);
+        } else if(arg == "--duration" && hasValue){
+            opts.durationS = atoi(argv[++i]);
+        } else if(arg == "--path" && hasValue){
+            opts.paths.push_back(argv[++i]);
+        } else if(arg == "--padding" && hasValue){
+            opts.padding = atoi(argv[++i]);
+        } else if(arg == "--pipeline" && hasValue){
+            opts.pipeline = atoi(argv[++i]);
+        } else if(arg == "--log"){
+            opts.serverLog = true;
+        } else {
+            return false;
+        }
+    }
+    if(opts.paths.empty()) opts.paths.push_back("/coffee");
+    return true;
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p){
+    if(sorted.empty()) return 0;
+    size_t idx = (size_t)(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+int main(int argc, char** argv){
+    Options opts;
+    if(!parseArgs(argc, argv, opts)){
+        usage();
+        return 1;
+    }
+
+    // The server printf()s on every request; keep that out of the way of the
+    // report unless asked for.
+    bool inProcess = opts.port == 0;
+    if(inProcess && !opts.serverLog){
+        freopen("/dev/null", "w", stdout);
+    }
+
+    static Webserver webserver;
+    static Teapot teapot;
+    static StreamApp streamApp;
+    static StaticAssetWebapp staticPages(webAssets, webAssetCount, "/form.html");
+    static ServerMetrics metrics;
+    static MetricsWebapp metricsApp(webserver);
+    static TraceWebapp traceApp;
+    PosixTcpServer server(&webserver);
+    std::thread serverThread;
+    if(inProcess){
+        webserver.addApplication(&teapot);
+        webserver.addApplication(&streamApp);
+        webserver.addApplication(&staticPages);
+        webserver.addApplication(&metricsApp);
+        webserver.addApplication(&traceApp);
+        webserver.setMetrics(&metrics);
+        if(!server.open(0)){
+            fprintf(stderr, "Unable to open server\n");
+            return 1;
+        }
+        opts.port = server.port();
+        serverThread = std::thread([&server]{ server.run(); });
+    }
+
+    int total = opts.oneShotClients + opts.keepAliveClients;
+    std::vector<ClientStats> stats(total);
+    std::vector<std::thread> clients;
+    uint64_t start = time_us_64();
+    for(int i=0; i<total; ++i){
+        bool keepAlive = i >= opts.oneShotClients;
+        clients.emplace_back(runClient, std::cref(opts), keepAlive, i, std::ref(stats[i]));
+    }
+
+    sleep_ms(opts.durationS * 1000);
+    running = false;
+    for(auto& t : clients) t.join();
+    double elapsed = (time_us_64() - start) / 1e6;
+
+    if(inProcess){
+        server.stop();
+        serverThread.join();
+    }
+
+    std::vector<uint32_t> all;
+    unsigned long errors = 0, connections = 0, bytes = 0;
+    for(const ClientStats& s : stats){
+        all.insert(all.end(), s.latencies.begin(), s.latencies.end());
+        errors += s.errors;
+        connections += s.connections;
+        bytes += s.bytes;
+    }
+    std::sort(all.begin(), all.end());
+
+    fprintf(stderr, "clients:       %d one-shot, %d keep-alive\n", opts.oneShotClients, opts.keepAliveClients);
+    fprintf(stderr, "duration:      %.2f s\n", elapsed);
+    fprintf(stderr, "requests:      %zu ok, %lu errors\n", all.size(), errors);
+    fprintf(stderr, "connections:   %lu\n", connections);
+    fprintf(stderr, "throughput:    %.1f req/s, %.1f KB/s\n", all.size() / elapsed, bytes / elapsed / 1024);
+    fprintf(stderr, "latency (us):  p50 %u  p99 %u  max %u\n",
+        percentile(all, 0.50), percentile(all, 0.99), all.empty() ? 0 : all.back());
+    if(inProcess){
+        const BlockPool& pool = webserver.pool();
+        fprintf(stderr, "block pool:    %d in use, high water %d of %d\n",
+            pool.inUse(), pool.highWater(), pool.capacity());
+        fprintf(stderr, "               %u allocations, %u failures, %u chained, longest chain %d\n",
+            pool.allocations(), pool.failures(), pool.chained(), pool.longestChain());
+    }
+    return errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,389 @@
+// Linux epoll implementation of the Connection / ServerApplication interfaces.
+// Mirrors TcpServer in ../server.cpp so that a ServerApplication sees the same
+// sequence of callbacks as it would from lwIP on a Pico W.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "posix_server.hpp"
+
+#define DEBUG_printf(...)
+#define POLL_TIME_S 5
+#define RECEIVE_SIZE 1460   // deliver data in TCP segment sized pieces like lwIP.
+#define MAX_EVENTS 32
+#define SEND_BUFFER_SIZE (8 * 1460)  // matches TCP_SND_BUF in lwipopts.h
+
+
+static void setNonBlocking(int fd){
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/////////////////////////////////////////////////////////////
+// Client
+
+/// @brief Opens a connection.
+/// @param pServer is the server the connection is to.
+/// @param fd is the accepted socket.
+void PosixTcpServer::PosixConnection::open(PosixTcpServer* pServer, int fd){
+    this->server = pServer;
+    this->fd = fd;
+    this->closing = false;
+    this->output.clear();
+    this->unreported = 0;
+    this->lastPoll = time_us_64();
+}
+
+/// @brief Forget the socket - it has been closed or aborted.
+void PosixTcpServer::PosixConnection::markAsClosed(){
+    fd = -1;
+    closing = false;
+    output.clear();
+    unreported = 0;
+}
+
+/// @brief closes the connection. As with tcp_close any queued data is still
+/// sent but the application gets no further callbacks.
+/// @return ERR_OK
+err_t PosixTcpServer::PosixConnection::close(){
+    if(fd >= 0) {
+        closing = true;
+        flush();
+    }
+    return ERR_OK;
+}
+
+/// @brief Queues data to send to the client.
+/// @param data is the data to send.
+/// @param len is the number of bytes to send
+/// @param moreToCome is ignored - the data is always copied and coalesced.
+/// @return ERR_OK, ERR_MEM if there's no room or ERR_CONN if the connection is not open.
+err_t PosixTcpServer::PosixConnection::send(uint8_t* data, size_t len, bool moreToCome){
+    if(fd < 0 || closing) return ERR_CONN;
+    if(len > sendBufferSpace()) return ERR_MEM;
+    output.insert(output.end(), data, data + len);
+    return ERR_OK;
+}
+
+/// @brief Queues data that doesn't change until sent.  The socket copies it
+/// anyway so this is the same as send().
+err_t PosixTcpServer::PosixConnection::sendStatic(const uint8_t* data, size_t len, bool moreToCome){
+    return send(const_cast<uint8_t*>(data), len, moreToCome);
+}
+
+/// @brief Finds how much can be sent.  As with lwIP, space is only given
+/// back once sent() has reported the data.
+/// @return bytes free in the emulated send buffer.
+size_t PosixTcpServer::PosixConnection::sendBufferSpace(){
+    size_t used = output.size() + unreported;
+    return (used < SEND_BUFFER_SIZE) ? SEND_BUFFER_SIZE - used : 0;
+}
+
+/// @brief aborts the connection, sending a reset to the client.
+/// @return ERR_ABRT
+err_t PosixTcpServer::PosixConnection::abort(){
+    if(fd >= 0){
+        struct linger lin = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+        ::close(fd);
+    }
+    markAsClosed();
+    return ERR_ABRT;
+}
+
+/// @brief Reads whatever the socket has and passes it to the application.
+void PosixTcpServer::PosixConnection::readable(){
+    uint8_t buffer[RECEIVE_SIZE];
+    while(fd >= 0 && !closing){
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if(n > 0){
+            err_t err = app()->receive(this, buffer, (uint16_t)n);
+            if(err != ERR_OK){
+                DEBUG_printf("receive returned %d\n", err);
+            }
+        } else if(n == 0){  // Remote closed the connection.
+            app()->closed(this);
+            close();
+        } else if(errno == EAGAIN || errno == EWOULDBLOCK){
+            break;
+        } else if(errno != EINTR){ // Reset etc.
+            app()->closed(this);
+            ::close(fd);
+            markAsClosed();
+        }
+    }
+}
+
+/// @brief Writes as much queued output as the socket will take and finishes
+/// closing the socket once everything has gone.
+void PosixTcpServer::PosixConnection::flush(){
+    size_t written = 0;
+    while(fd >= 0 && written < output.size()){
+        ssize_t n = ::send(fd, output.data() + written, output.size() - written, MSG_NOSIGNAL);
+        if(n > 0){
+            written += n;
+        } else if(n < 0 && errno == EINTR){
+            continue;
+        } else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            break;
+        } else { // Connection has gone.
+            if(!closing) app()->closed(this);
+            ::close(fd);
+            markAsClosed();
+            return;
+        }
+    }
+    output.erase(output.begin(), output.begin() + written);
+    if(!closing) unreported += written;
+
+    if(fd >= 0 && closing && output.empty()){
+        ::shutdown(fd, SHUT_WR);
+        ::close(fd);
+        markAsClosed();
+    }
+}
+
+/// @brief Tells the application about data that has been sent.  lwIP reports
+/// at most 64K at a time, so do the same.
+void PosixTcpServer::PosixConnection::reportSent(){
+    while(fd >= 0 && !closing && unreported > 0){
+        u16_t len = (unreported > 0xFFFF) ? 0xFFFF : (u16_t)unreported;
+        unreported -= len;
+        app()->sent(this, len);
+    }
+}
+
+/// @brief Calls the application's poll callback every POLL_TIME_S.
+/// @param now is the current time in microseconds.
+void PosixTcpServer::PosixConnection::tick(uint64_t now){
+    if(fd >= 0 && !closing && (now - lastPoll) >= POLL_TIME_S * 1000000ull){
+        lastPoll = now;
+        app()->poll(this);
+    }
+}
+
+
+/////////////////////////////////////////////////////////////
+//  PosixTcpServer
+
+PosixTcpServer::PosixTcpServer(ServerApplication* app)
+: app(app)
+, listenFd(-1)
+, epollFd(-1)
+, boundPort(0)
+, listening(true)
+, complete(false)
+{}
+
+PosixTcpServer::~PosixTcpServer(){
+    close();
+}
+
+// Find an unused client descriptor.  If found it is opened on fd and
+// a pointer is returned.
+PosixTcpServer::PosixConnection* PosixTcpServer::allocateClient(int fd){
+    for(int i=0; i<MAX_CLIENTS;++i){
+        if(clients[i].getFd() < 0){
+            clients[i].open(this, fd);
+            return clients+i;
+        }
+    }
+    return 0; // no spare
+}
+
+// Whether a client is free for a new connection.
+bool PosixTcpServer::freeClient(){
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        if(clients[i].getFd() < 0) return true;
+    }
+    return false;
+}
+
+/// @brief Makes sure there is a free client, closing the one idle longest if
+/// need be (and it's been idle long enough).  As TcpServer::makeRoom().
+/// @return true if a client is free.
+bool PosixTcpServer::makeRoom(){
+    PosixConnection* oldest = 0;
+    uint32_t longest = 0;
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        if(clients[i].getFd() < 0) return true;
+        if(clients[i].isClosing()) continue;
+        uint32_t idle = app->idleTime(clients + i);
+        if(idle >= SERVER_EVICT_IDLE_MS && idle > longest){
+            oldest = clients + i;
+            longest = idle;
+        }
+    }
+    if(!oldest) return false;
+
+    DEBUG_printf("Closing connection idle for %u ms\n", longest);
+    app->closed(oldest);
+    oldest->close();
+    return oldest->getFd() < 0;
+}
+
+// Stop or start hearing about new connections.  While all the clients are
+// busy new connections wait in the kernel's backlog, as they wait in
+// TcpServer's on the Pico.
+void PosixTcpServer::listen(bool on){
+    if(on == listening) return;
+    listening = on;
+    struct epoll_event ev = {};
+    ev.events = on ? (uint32_t)EPOLLIN : 0u;
+    ev.data.ptr = 0;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, listenFd, &ev);
+}
+
+// Whether there's a connection in the backlog to accept.
+bool PosixTcpServer::connectionWaiting(){
+    struct pollfd pfd = {listenFd, POLLIN, 0};
+    return ::poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+// Accept any waiting clients while there's room for them.
+void PosixTcpServer::accept(){
+    while(true){
+        // Only close an idle client for a connection that is waiting.
+        if(!freeClient()){
+            if(!connectionWaiting()) return;
+            if(!makeRoom()){
+                listen(false);
+                return;
+            }
+        }
+        int fd = ::accept(listenFd, 0, 0);
+        if(fd < 0) return;
+
+        setNonBlocking(fd);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        PosixConnection* connection = allocateClient(fd);
+        if(!connection){
+            DEBUG_printf("No free connection, resetting client\n");
+            struct linger lin = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+            ::close(fd);
+            continue;
+        }
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = connection;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+        app->connected(connection);
+    }
+}
+
+// Update epoll so we hear about the socket becoming writable only while there
+// is output queued for it.  A closing connection's input is no longer read,
+// so only its output is watched; otherwise unread input would wake the loop
+// over and over until the output has gone (hang ups and errors still do).
+void PosixTcpServer::watch(PosixConnection* connection){
+    struct epoll_event ev = {};
+    ev.events = (connection->isClosing() ? 0u : (uint32_t)EPOLLIN)
+        | (connection->hasOutput() ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.ptr = connection;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection->getFd(), &ev);
+}
+
+/// @brief Opens a server socket to listen on the given port.
+/// @param port is the port number to listen on, 0 picks a free port.
+/// @param backlog is the listen backlog.
+/// @return true if successful, false otherwise.
+bool PosixTcpServer::open(uint16_t port, int backlog){
+    listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if(listenFd < 0) {
+        perror("socket");
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if(::bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+        perror("bind");
+        return false;
+    }
+    if(::listen(listenFd, backlog) < 0){
+        perror("listen");
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd, (struct sockaddr*)&addr, &len);
+    boundPort = ntohs(addr.sin_port);
+
+    setNonBlocking(listenFd);
+    epollFd = epoll_create1(0);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = 0;    // null marks the listening socket.
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+
+    return true;
+}
+
+/// @brief Close the server and any client connections.
+/// @return ERR_OK
+err_t PosixTcpServer::close(){
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        if(clients[i].getFd() >= 0){
+            ::close(clients[i].getFd());
+            clients[i].markAsClosed();
+        }
+    }
+    if(listenFd >= 0){
+        ::close(listenFd);
+        listenFd = -1;
+    }
+    if(epollFd >= 0){
+        ::close(epollFd);
+        epollFd = -1;
+    }
+    complete = true;
+    return ERR_OK;
+}
+
+/// @brief Runs the event loop until stop() or close() is called.
+void PosixTcpServer::run(){
+    struct epoll_event events[MAX_EVENTS];
+    while(!complete){
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, 100);
+        for(int i=0; i<n; ++i){
+            PosixConnection* connection = static_cast<PosixConnection*>(events[i].data.ptr);
+            if(connection == 0){
+                accept();
+            } else if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+                connection->readable();
+            }
+        }
+
+        // Push out anything the callbacks sent, tell the app and give it
+        // its periodic poll.
+        uint64_t now = time_us_64();
+        for(int i=0; i<MAX_CLIENTS; ++i){
+            PosixConnection* connection = clients + i;
+            if(connection->getFd() < 0) continue;
+            connection->flush();
+            connection->reportSent();
+            connection->tick(now);
+            if(connection->getFd() >= 0) watch(connection);
+        }
+        // Connections waiting in the backlog can have a client once one
+        // closes or has been idle long enough to be closed.
+        if(!listening && connectionWaiting() && makeRoom()) listen(true);
+        app->service();
+    }
+}
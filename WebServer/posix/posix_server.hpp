@@ -0,0 +1,90 @@
+#ifndef POSIX_SERVER_HPP
+#define POSIX_SERVER_HPP
+
+// Linux implementation of the TcpServer interfaces using epoll and non-blocking
+// sockets.  It drives a ServerApplication (e.g. Webserver) with the same
+// callback sequence lwIP gives on the Pico so the application code can be
+// exercised and measured on a host.
+//
+// Like lwIP in poll mode everything runs on the thread that calls run(), and
+// data passed to send() is queued and written out after the current callback
+// returns.  sent() is reported once the kernel has taken the bytes.  The
+// send buffer is limited to the same size as lwIP's TCP_SND_BUF so an
+// application that ignores flow control fails here too.
+
+#include <atomic>
+#include <vector>
+
+#include "server.hpp"
+
+class PosixTcpServer {
+
+    // Internal class to track connections to the server.
+    class PosixConnection:
+    public Connection {
+        PosixTcpServer* server;
+        int fd;
+        bool closing;                   // app has closed, flush then shut.
+        std::vector<uint8_t> output;    // data waiting for the socket.
+        size_t unreported;              // written but not yet passed to sent()
+        uint64_t lastPoll;
+
+        public:
+        PosixConnection()
+            : server(0)
+            , fd(-1)
+            , closing(false)
+            , unreported(0)
+            , lastPoll(0)
+            {}
+
+        void open(PosixTcpServer* server, int fd);
+        int getFd() const { return fd;}
+        bool isClosing() const { return closing;}
+        bool hasOutput() const { return !output.empty();}
+        void markAsClosed();
+
+        void readable();
+        void flush();
+        void reportSent();
+        void tick(uint64_t now);
+
+        inline ServerApplication* app() {return server->getApp();}
+
+        virtual err_t close();
+        virtual bool isOpen() { return fd >= 0 && !closing;}
+        virtual err_t send(uint8_t* data, size_t len, bool moreToCome=false);
+        virtual err_t sendStatic(const uint8_t* data, size_t len, bool moreToCome=false);
+        virtual size_t sendBufferSpace();
+        virtual err_t abort();
+    };
+
+    ServerApplication* app;         // Server application using this TCP server.
+    int listenFd;                   // For listening for incoming connections.
+    int epollFd;
+    uint16_t boundPort;
+    bool listening;                 // false while all clients are busy.
+    std::atomic<bool> complete;     // Set true to terminate loop.
+    PosixConnection clients[MAX_CLIENTS];  // Max number of connections
+
+    PosixConnection* allocateClient(int fd);
+    bool freeClient();
+    bool makeRoom();
+    void listen(bool on);
+    bool connectionWaiting();
+    void accept();
+    void watch(PosixConnection* connection);
+
+    public:
+
+    PosixTcpServer(ServerApplication* app);
+    ~PosixTcpServer();
+    ServerApplication* getApp() {return app;}
+    bool open(uint16_t port, int backlog = 16);
+    uint16_t port() const { return boundPort;}
+    err_t close();
+    void run();
+    void stop() { complete = true;}   // safe to call from another thread.
+};
+
+#endif
@@ -0,0 +1,206 @@
+// Host check of SdWebapp.
+//
+// Formats a FAT volume on a RAM block device with the real SdFat, writes a
+// few files and serves them through the Webserver on a PosixTcpServer in this
+// process, then checks the responses: whole files, Range requests, ETag with
+// If-None-Match and If-Range, a directory listing and paths that try to climb
+// out of the served directory with "..".
+//
+// Prints each check and exits non-zero if any failed.
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <thread>
+
+#include "posix_server.hpp"
+#include "webserver.hpp"
+#include "sd_webapp.hpp"
+
+#define RAM_DISK_SECTORS (32 * 1024 * 1024 / 512)
+#define LOG_SIZE 3000
+
+// A card in memory.
+class RamDisk : public BlockDeviceInterface {
+    uint8_t* data;
+
+    public:
+    RamDisk() : data(new uint8_t[RAM_DISK_SECTORS * 512]()) {}
+    ~RamDisk() { delete[] data;}
+
+    virtual bool isBusy() { return false;}
+    virtual uint32_t sectorCount() { return RAM_DISK_SECTORS;}
+    virtual bool syncDevice() { return true;}
+    virtual bool readSector(uint32_t sector, uint8_t* dst) { return readSectors(sector, dst, 1);}
+    virtual bool readSectors(uint32_t sector, uint8_t* dst, size_t ns){
+        if(sector + ns > RAM_DISK_SECTORS) return false;
+        memcpy(dst, data + (size_t)sector * 512, ns * 512);
+        return true;
+    }
+    virtual bool writeSector(uint32_t sector, const uint8_t* src) { return writeSectors(sector, src, 1);}
+    virtual bool writeSectors(uint32_t sector, const uint8_t* src, size_t ns){
+        if(sector + ns > RAM_DISK_SECTORS) return false;
+        memcpy(data + (size_t)sector * 512, src, ns * 512);
+        return true;
+    }
+};
+
+struct Response {
+    int status = 0;
+    std::string headers;    // lower cased.
+    std::string body;
+
+    std::string header(const char* name) const {
+        std::string key = std::string("\r\n") + name + ":";
+        size_t pos = headers.find(key);
+        if(pos == std::string::npos) return "";
+        pos += key.size();
+        while(headers[pos] == ' ') ++pos;
+        return headers.substr(pos, headers.find("\r\n", pos) - pos);
+    }
+};
+
+static uint16_t serverPort;
+static int failures = 0;
+static std::string logData;
+
+/// @brief Makes one request on a new connection and reads the response to
+/// the end of the connection.
+static Response get(const std::string& path, const std::string& extraHeaders = ""){
+    Response response;
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(serverPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    struct timeval tv = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if(::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+        ::close(fd);
+        return response;
+    }
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: test\r\n" + extraHeaders + "Connection: close\r\n\r\n";
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+    std::string all;
+    char buffer[4096];
+    ssize_t n;
+    while((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) all.append(buffer, n);
+    ::close(fd);
+
+    size_t end = all.find("\r\n\r\n");
+    if(all.compare(0, 5, "HTTP/") != 0 || end == std::string::npos) return response;
+    response.status = atoi(all.c_str() + all.find(' ') + 1);
+    response.headers = all.substr(0, end + 2);
+    for(char& c : response.headers) c = tolower(c);     // all the values checked are lower case.
+    response.body = all.substr(end + 4);
+    return response;
+}
+
+static void check(bool ok, const char* what){
+    printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+    if(!ok) ++failures;
+}
+
+/// @brief Writes a file on the volume.
+static bool writeFile(FsVolume& volume, const char* path, const std::string& contents){
+    FsFile file;
+    if(!file.open(&volume, path, O_WRONLY | O_CREAT | O_TRUNC)) return false;
+    bool ok = file.write(contents.data(), contents.size()) == contents.size();
+    return file.close() && ok;
+}
+
+int main(){
+    static RamDisk disk;
+    static FsVolume volume;
+    static uint8_t sector[512];
+    FatFormatter formatter;
+    if(!formatter.format(&disk, sector) || !volume.begin(&disk)){
+        fprintf(stderr, "Unable to format the RAM disk\n");
+        return 1;
+    }
+    for(int i = 0; i < LOG_SIZE; ++i) logData += (i % 64 == 63) ? '\n' : (char)('0' + i % 10);
+    if(!volume.mkdir("/flight") || !writeFile(volume, "/flight/0042.csv", logData)
+        || !writeFile(volume, "/flight/empty.txt", "") || !writeFile(volume, "/flight/v1..2.txt", "v1..2")
+        || !writeFile(volume, "/secret.txt", "secret")){
+        fprintf(stderr, "Unable to write the test files\n");
+        return 1;
+    }
+
+    static Webserver webserver;
+    static SdWebapp logs(volume, "/logs", "/flight");
+    webserver.addApplication(&logs);
+    PosixTcpServer server(&webserver);
+    if(!server.open(0)){
+        fprintf(stderr, "Unable to open server\n");
+        return 1;
+    }
+    serverPort = server.port();
+    std::thread serverThread([&server]{ server.run(); });
+
+    Response whole = get("/logs/0042.csv");
+    std::string etag = whole.header("etag");
+    check(whole.status == 200 && whole.body == logData, "GET whole file");
+    check(whole.header("content-type") == "text/csv", "content type from extension");
+    check(!etag.empty() && whole.header("accept-ranges") == "bytes", "ETag and Accept-Ranges");
+
+    Response range = get("/logs/0042.csv", "Range: bytes=100-199\r\n");
+    check(range.status == 206 && range.body == logData.substr(100, 100)
+        && range.header("content-range") == "bytes 100-199/3000", "Range bytes=100-199");
+
+    Response open = get("/logs/0042.csv", "Range: bytes=2990-\r\n");
+    check(open.status == 206 && open.body == logData.substr(2990)
+        && open.header("content-range") == "bytes 2990-2999/3000", "Range bytes=2990-");
+
+    Response suffix = get("/logs/0042.csv", "Range: bytes=-500\r\n");
+    check(suffix.status == 206 && suffix.body == logData.substr(2500), "Range bytes=-500");
+
+    Response clipped = get("/logs/0042.csv", "Range: bytes=1000-99999\r\n");
+    check(clipped.status == 206 && clipped.body == logData.substr(1000)
+        && clipped.header("content-range") == "bytes 1000-2999/3000", "Range past the end is clipped");
+
+    Response beyond = get("/logs/0042.csv", "Range: bytes=3000-\r\n");
+    check(beyond.status == 416 && beyond.header("content-range") == "bytes */3000", "Range beyond the end is 416");
+
+    Response several = get("/logs/0042.csv", "Range: bytes=0-9,20-29\r\n");
+    check(several.status == 200 && several.body == logData, "several ranges send the whole file");
+
+    Response empty = get("/logs/empty.txt", "Range: bytes=0-\r\n");
+    check(empty.status == 416, "Range of an empty file is 416");
+
+    Response unchanged = get("/logs/0042.csv", "If-None-Match: " + etag + "\r\n");
+    check(unchanged.status == 304 && unchanged.body.empty(), "If-None-Match with the ETag is 304");
+
+    Response changed = get("/logs/0042.csv", "If-None-Match: \"0-00000000\"\r\n");
+    check(changed.status == 200 && changed.body == logData, "If-None-Match with another ETag is 200");
+
+    Response resumed = get("/logs/0042.csv", "Range: bytes=1500-\r\nIf-Range: " + etag + "\r\n");
+    check(resumed.status == 206 && resumed.body == logData.substr(1500), "If-Range with the ETag resumes");
+
+    Response stale = get("/logs/0042.csv", "Range: bytes=1500-\r\nIf-Range: \"0-00000000\"\r\n");
+    check(stale.status == 200 && stale.body == logData, "If-Range with another ETag sends it all");
+
+    Response listing = get("/logs/");
+    check(listing.status == 200 && listing.body.find("{\"name\":\"0042.csv\",\"size\":3000,\"dir\":false}") != std::string::npos
+        && listing.body.find("secret") == std::string::npos, "directory listing");
+
+    // SdFat won't open "..", so these also check nothing else maps them somewhere.
+    check(get("/logs/../secret.txt").status == 404, "/logs/../secret.txt is 404");
+    check(get("/logs/%2e%2e/secret.txt").status == 404, "/logs/%2e%2e/secret.txt is 404");
+    check(get("/logs/..%2fsecret.txt").status == 404, "/logs/..%2fsecret.txt is 404");
+    check(get("/logs/sub/../../secret.txt").status == 404, "/logs/sub/../../secret.txt is 404");
+    check(get("/logs/..").status == 404, "/logs/.. is 404");
+    Response dots = get("/logs/v1..2.txt");
+    check(dots.status == 200 && dots.body == "v1..2", ".. inside a name is allowed");
+    check(get("/logsecret.txt").status == 404, "/logsecret.txt is 404");
+    check(get("/logs/missing.csv").status == 404, "missing file is 404");
+
+    server.stop();
+    serverThread.join();
+
+    printf("%s\n", failures ? "FAILED" : "all ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+// Receives and prints the SensorFrames multicast by the boards (see
+// ../udp_publisher.hpp), e.g.
+//
+//   sensorlisten --count 10
+//
+// Frames lost on the way show up as gaps in each source's sequence and are
+// counted.  --group can be a unicast address (or 0.0.0.0) to skip joining a
+// group, e.g. when a board is set to send straight to this machine.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <string>
+
+#include "sensor_frame.hpp"
+
+struct Options {
+    std::string group = SENSOR_GROUP;
+    uint16_t port = SENSOR_PORT;
+    long count = 0;         // frames to print, 0 for ever.
+};
+
+// Last sequence seen from each source (by source and address).
+struct Sender {
+    in_addr_t address;
+    uint8_t source;
+    uint32_t sequence;
+};
+
+static const char* sourceName(uint8_t source){
+    switch(source){
+    case SENSOR_SOURCE_WEATHER: return "weather";
+    case SENSOR_SOURCE_BCDCLOCK: return "bcdclock";
+    case SENSOR_SOURCE_FUSION: return "fusion";
+    default: return "unknown";
+    }
+}
+
+// Names of the reading ids, as set in Weather/main.cpp and BcdClock/main.cpp.
+static const char* readingName(uint8_t source, uint8_t id){
+    static const char* const weather[] = {0, "pressure", "humidity", "lux", "temperature", "temp2", "temp3"};
+    static const char* const clock[] = {0, "movement", "light"};
+    if(source == SENSOR_SOURCE_WEATHER && id < sizeof(weather) / sizeof(weather[0])) return weather[id];
+    if(source == SENSOR_SOURCE_BCDCLOCK && id < sizeof(clock) / sizeof(clock[0])) return clock[id];
+    return 0;
+}
+
+static void printReading(uint8_t source, const SensorReading& reading){
+    const char* name = readingName(source, reading.id);
+    if(name){
+        printf(" %s=", name);
+    } else {
+        printf(" %u=", reading.id);
+    }
+    switch(reading.type){
+    case SENSOR_F32: printf("%g", reading.f); break;
+    case SENSOR_I32: printf("%d", (int)reading.i); break;
+    case SENSOR_U32: printf("%u", (unsigned)reading.u); break;
+    case SENSOR_U64: printf("0x%llx", (unsigned long long)reading.u64); break;
+    }
+}
+
+static void usage(){
+    fprintf(stderr,
+        "usage: sensorlisten [options]\n"
+        "  --group ADDRESS   multicast group to join (default " SENSOR_GROUP ")\n"
+        "  --port N          UDP port (default %d)\n"
+        "  --count N         exit after N frames\n", SENSOR_PORT);
+}
+
+static bool parseArgs(int argc, char** argv, Options& opts){
+    for(int i=1; i<argc; ++i){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--group" && hasValue){
+            opts.group = argv[++i];
+        } else if(arg == "--port" && hasValue){
+            opts.port = atoi(argv[++i]);
+        } else if(arg == "--count" && hasValue){
+            opts.count = atol(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv){
+    Options opts;
+    if(!parseArgs(argc, argv, opts)){
+        usage();
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0){
+        perror("socket");
+        return 1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opts.port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if(bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+        perror("bind");
+        return 1;
+    }
+
+    ip_mreq mreq = {};
+    if(inet_pton(AF_INET, opts.group.c_str(), &mreq.imr_multiaddr) != 1){
+        fprintf(stderr, "Bad group address %s\n", opts.group.c_str());
+        return 1;
+    }
+    if(IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr))){
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if(setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0){
+            perror("IP_ADD_MEMBERSHIP");
+        }
+    }
+
+    Sender senders[16];
+    int senderCount = 0;
+    unsigned long frames = 0;
+    unsigned long lost = 0;
+    unsigned long bad = 0;
+
+    uint8_t buffer[2048];
+    while(opts.count == 0 || (long)frames < opts.count){
+        sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t n = recvfrom(fd, buffer, sizeof(buffer), 0, (sockaddr*)&from, &fromLength);
+        if(n < 0){
+            perror("recvfrom");
+            break;
+        }
+
+        SensorFrameReader reader;
+        if(!reader.parse(buffer, n)){
+            ++bad;
+            continue;
+        }
+        ++frames;
+
+        Sender* sender = 0;
+        for(int i=0; i<senderCount; ++i){
+            if(senders[i].address == from.sin_addr.s_addr && senders[i].source == reader.source()){
+                sender = &senders[i];
+                break;
+            }
+        }
+        if(sender){
+            uint32_t gap = reader.sequence() - sender->sequence - 1;
+            if(gap != 0 && gap < 0x80000000u){
+                lost += gap;
+            }
+        } else if(senderCount < (int)(sizeof(senders) / sizeof(senders[0]))){
+            sender = &senders[senderCount++];
+            sender->address = from.sin_addr.s_addr;
+            sender->source = reader.source();
+        }
+        if(sender){
+            sender->sequence = reader.sequence();
+        }
+
+        char host[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host));
+        printf("%s %s #%u %.3fs", host, sourceName(reader.source()),
+            (unsigned)reader.sequence(), reader.time() / 1e6);
+        SensorReading reading;
+        while(reader.next(reading)){
+            printReading(reader.source(), reading);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    printf("%lu frames, %lu lost, %lu not understood\n", frames, lost, bad);
+    close(fd);
+    return 0;
+}
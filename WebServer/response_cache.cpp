@@ -0,0 +1,211 @@
+#include <string.h>
+#include "response_cache.hpp"
+#include "webserver.hpp"
+
+static uint32_t nowMs(){
+    return to_ms_since_boot(get_absolute_time());
+}
+
+CacheEntry::CacheEntry()
+: state(State::FREE)
+, users(0)
+, keyLength(0)
+, headLength(0)
+, bodyLength(0)
+, hash(0)
+, ttl(0)
+, expires(0)
+, generation(0)
+, generationSeen(0)
+, data(0)
+{}
+
+ResponseCache::ResponseCache()
+: hitCount(0)
+, missCount(0)
+, storeCount(0)
+{
+    for(int i=0; i<RESPONSE_CACHE_ENTRIES; ++i){
+        entries[i].data = arena + i * RESPONSE_CACHE_SLOT_SIZE;
+    }
+}
+
+/// @brief Writes the key for a request: verb, path and the (decoded) query
+/// parameters in the order given e.g. "GET /data?units=C".
+/// @param request is the request.
+/// @param key is where to write it, RESPONSE_CACHE_KEY_MAX long.
+/// @return the length including the NUL, or 0 if the key is too long.
+size_t ResponseCache::makeKey(HttpRequest& request, char* key){
+    char* there = key;
+    char* end = key + RESPONSE_CACHE_KEY_MAX - 1;
+    const char* parts[2] = {request.verb(), request.path()};
+    for(int i=0; i<2; ++i){
+        size_t len = strlen(parts[i]);
+        if(there + len + 1 > end) return 0;
+        memcpy(there, parts[i], len);
+        there += len;
+        if(i == 0) *there++ = ' ';
+    }
+
+    char separator = '?';
+    BlockListIter<Parameter> iter = request.Parameters().iter();
+    Parameter* p;
+    while((p = iter.next())){
+        size_t nameLength = strlen(p->name());
+        size_t valueLength = p->value() ? strlen(p->value()) : 0;
+        if(there + 2 + nameLength + valueLength > end) return 0;
+        *there++ = separator;
+        memcpy(there, p->name(), nameLength);
+        there += nameLength;
+        *there++ = '=';
+        memcpy(there, p->value(), valueLength);
+        there += valueLength;
+        separator = '&';
+    }
+    *there++ = 0;
+    return there - key;
+}
+
+/// @brief FNV-1a hash of a key.
+uint32_t ResponseCache::hash(const char* key, size_t length){
+    uint32_t h = 2166136261u;
+    for(size_t i=0; i<length; ++i){
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/// @brief Finds the entry in a given state with a key.
+CacheEntry* ResponseCache::match(const char* key, size_t length, uint32_t hash, CacheEntry::State state){
+    for(int i=0; i<RESPONSE_CACHE_ENTRIES; ++i){
+        CacheEntry& e = entries[i];
+        if(e.state == state && e.hash == hash && e.keyLength == length && memcmp(e.data, key, length) == 0){
+            return &e;
+        }
+    }
+    return 0;
+}
+
+/// @brief Whether a stored response can still be used.
+bool ResponseCache::isFresh(const CacheEntry& entry, uint32_t now) const {
+    if((int32_t)(entry.expires - now) <= 0) return false;
+    return entry.generation == 0 || *entry.generation == entry.generationSeen;
+}
+
+/// @brief Picks a slot for a new response: a free one, else a stale one,
+/// else the one closest to expiring.  Slots being sent aren't touched.
+/// @return the slot or 0 if all are in use.
+CacheEntry* ResponseCache::victim(){
+    uint32_t now = nowMs();
+    CacheEntry* best = 0;
+    for(int i=0; i<RESPONSE_CACHE_ENTRIES; ++i){
+        CacheEntry& e = entries[i];
+        if(e.state == CacheEntry::State::FREE) return &e;
+        if(e.state != CacheEntry::State::READY || e.users > 0) continue;
+        if(!isFresh(e, now)) return &e;
+        if(!best || (int32_t)(e.expires - best->expires) < 0) best = &e;
+    }
+    return best;
+}
+
+/// @brief Looks for a stored response to a request.  A hit is held until
+/// release() so the slot isn't reused while it's being sent.
+/// @param request is the (complete) GET request.
+/// @return the entry or 0 if there's no fresh response.
+CacheEntry* ResponseCache::find(HttpRequest& request){
+    char key[RESPONSE_CACHE_KEY_MAX];
+    size_t length = makeKey(request, key);
+    if(length == 0) return 0;
+
+    CacheEntry* entry = match(key, length, hash(key, length), CacheEntry::State::READY);
+    if(entry && !isFresh(*entry, nowMs())){
+        if(entry->users == 0) entry->state = CacheEntry::State::FREE;
+        entry = 0;
+    }
+    if(!entry){
+        ++missCount;
+        return 0;
+    }
+    ++entry->users;
+    ++hitCount;
+    return entry;
+}
+
+/// @brief Takes a slot for a response that's about to be sent.  The body is
+/// then added as it goes with append() and the entry made available with
+/// commit().
+/// @param request is the request being answered.
+/// @param ttl is how long the response is good for in ms.
+/// @param generation is a counter that changes when the data does, or 0.
+/// @param generationSeen is the value of *generation the response was made from.
+/// @param head is the status line and headers, less the ones framing the body.
+/// @param headLength is the length of head.
+/// @return the entry or 0 if there's no room or the response is already being stored.
+CacheEntry* ResponseCache::reserve(HttpRequest& request, uint32_t ttl, const uint32_t* generation, uint32_t generationSeen,
+                                   const char* head, size_t headLength){
+    char key[RESPONSE_CACHE_KEY_MAX];
+    size_t length = makeKey(request, key);
+    if(length == 0 || length + headLength > RESPONSE_CACHE_SLOT_SIZE) return 0;
+    uint32_t h = hash(key, length);
+    if(match(key, length, h, CacheEntry::State::FILLING)) return 0;
+
+    // Replace an older copy of the same response if there is one.
+    CacheEntry* entry = match(key, length, h, CacheEntry::State::READY);
+    if(entry && entry->users > 0) return 0;
+    if(!entry) entry = victim();
+    if(!entry) return 0;
+
+    entry->state = CacheEntry::State::FILLING;
+    entry->users = 1;
+    entry->hash = h;
+    entry->keyLength = length;
+    entry->headLength = headLength;
+    entry->bodyLength = 0;
+    entry->ttl = ttl;
+    entry->generation = generation;
+    entry->generationSeen = generationSeen;
+    memcpy(entry->data, key, length);
+    memcpy(entry->data + length, head, headLength);
+    return entry;
+}
+
+/// @brief Adds the next piece of body to an entry being filled.
+/// @return true if added, false if the body is too big for the slot.
+bool ResponseCache::append(CacheEntry* entry, const uint8_t* data, size_t length){
+    assert(entry->state == CacheEntry::State::FILLING);
+    size_t used = entry->keyLength + entry->headLength + entry->bodyLength;
+    if(used + length > RESPONSE_CACHE_SLOT_SIZE) return false;
+    memcpy(entry->data + used, data, length);
+    entry->bodyLength += length;
+    return true;
+}
+
+/// @brief The whole body has been added so the entry can be used.  The
+/// filling transaction still has to release() it.
+void ResponseCache::commit(CacheEntry* entry){
+    assert(entry->state == CacheEntry::State::FILLING);
+    entry->state = CacheEntry::State::READY;
+    entry->expires = nowMs() + entry->ttl;
+    ++storeCount;
+}
+
+/// @brief Gives up filling an entry e.g. the body didn't fit.
+void ResponseCache::abandon(CacheEntry* entry){
+    assert(entry->state == CacheEntry::State::FILLING);
+    entry->state = CacheEntry::State::FREE;
+    entry->users = 0;
+}
+
+/// @brief Finished with an entry from find() (or a committed one from reserve()).
+void ResponseCache::release(CacheEntry* entry){
+    if(entry->users > 0) --entry->users;
+}
+
+/// @brief Drops every stored response e.g. after a setting has changed.
+/// Entries in use are dropped once released.
+void ResponseCache::clear(){
+    for(int i=0; i<RESPONSE_CACHE_ENTRIES; ++i){
+        if(entries[i].state == CacheEntry::State::READY) entries[i].expires = nowMs();
+    }
+}
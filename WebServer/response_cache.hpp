@@ -0,0 +1,91 @@
+#ifndef RESPONSE_CACHE_HPP
+#define RESPONSE_CACHE_HPP
+
+#include "pico/stdlib.h"
+
+// Number of responses kept, each in its own slot of the arena.  A slot holds
+// the key, the head and the body so bodies much over 1K aren't cached.
+#ifndef RESPONSE_CACHE_ENTRIES
+#define RESPONSE_CACHE_ENTRIES 6
+#endif
+#ifndef RESPONSE_CACHE_SLOT_SIZE
+#define RESPONSE_CACHE_SLOT_SIZE 1536
+#endif
+
+// Longest key (verb, path and query) that can be cached.
+#define RESPONSE_CACHE_KEY_MAX 128
+
+class HttpRequest;
+class ResponseCache;
+
+// A cached response.  Its slot holds the key (NUL terminated), then the
+// status line and headers apart from those framing the body, then the body.
+class CacheEntry {
+    friend class ResponseCache;
+
+    enum class State : uint8_t {
+        FREE,
+        FILLING,    // the response is being sent and copied in as it goes.
+        READY
+    };
+
+    State state;
+    uint8_t users;              // transactions reading (or filling) the slot.
+    uint16_t keyLength;         // including the NUL.
+    uint16_t headLength;
+    uint16_t bodyLength;
+    uint32_t hash;              // of the key.
+    uint32_t ttl;               // ms the response is good for, once stored.
+    uint32_t expires;           // ms since boot when READY.
+    const uint32_t* generation; // changes when the data behind it does, or 0.
+    uint32_t generationSeen;    // *generation when the response was made.
+    uint8_t* data;              // the slot.
+
+    public:
+    CacheEntry();
+    const char* head() const { return (const char*)data + keyLength;}
+    size_t headSize() const { return headLength;}
+    const uint8_t* body() const { return data + keyLength + headLength;}
+    size_t bodySize() const { return bodyLength;}
+};
+
+// Keeps rendered responses to idempotent GETs so several clients polling the
+// same endpoint don't each run the handler.  A WebApp opts in per response
+// with HttpResponse::cacheFor(), giving how long the response stays good and
+// optionally a counter that its data source bumps when the data changes.  A
+// hit sends the stored head and body straight from the arena; the handler
+// isn't called.
+//
+// Only used from the network loop (core 0), so there's no locking.
+class ResponseCache {
+    CacheEntry entries[RESPONSE_CACHE_ENTRIES];
+    uint8_t arena[RESPONSE_CACHE_ENTRIES * RESPONSE_CACHE_SLOT_SIZE];
+
+    uint32_t hitCount;
+    uint32_t missCount;
+    uint32_t storeCount;
+
+    static size_t makeKey(HttpRequest& request, char* key);
+    static uint32_t hash(const char* key, size_t length);
+    CacheEntry* match(const char* key, size_t length, uint32_t hash, CacheEntry::State state);
+    bool isFresh(const CacheEntry& entry, uint32_t now) const;
+    CacheEntry* victim();
+
+    public:
+    ResponseCache();
+
+    CacheEntry* find(HttpRequest& request);
+    CacheEntry* reserve(HttpRequest& request, uint32_t ttl, const uint32_t* generation, uint32_t generationSeen,
+                        const char* head, size_t headLength);
+    bool append(CacheEntry* entry, const uint8_t* data, size_t length);
+    void commit(CacheEntry* entry);
+    void abandon(CacheEntry* entry);
+    void release(CacheEntry* entry);
+    void clear();
+
+    uint32_t hits() const { return hitCount;}
+    uint32_t misses() const { return missCount;}
+    uint32_t stores() const { return storeCount;}
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <string.h>
+#include "router.hpp"
+#include "pico/printf.h"
+
+Router::Router(){
+    clear();
+}
+
+/// @brief Removes all the routes.
+void Router::clear(){
+    nodes[0].c = 0;
+    nodes[0].child = 0;
+    nodes[0].sibling = 0;
+    nodes[0].routes = 0;
+    nodeCount = 1;
+    routeCount = 1;
+    overflowed = false;
+}
+
+/// @brief Finds the child of a node for a given character.
+/// @param node is the parent node.
+/// @param c is the next character of the path.
+/// @return the child node or 0 if there isn't one.
+uint16_t Router::child(uint16_t node, char c) const {
+    uint16_t n = nodes[node].child;
+    while(n && nodes[n].c != c){
+        n = nodes[n].sibling;
+    }
+    return n;
+}
+
+/// @brief Finds a route ending at a node that matches the verb.
+/// @param node is the node to look at.
+/// @param verb is the request verb.
+/// @param prefix selects prefix or exact routes.
+/// @return the route or 0 if none.
+const Router::Route* Router::routeAt(uint16_t node, const char* verb, bool prefix) const {
+    for(uint16_t r = nodes[node].routes; r; r = routes[r].next){
+        const Route* route = routes + r;
+        if(route->prefix == prefix && (route->verb == 0 || strcmp(route->verb, verb) == 0)){
+            return route;
+        }
+    }
+    return 0;
+}
+
+/// @brief Adds a route, replacing any existing one for the same verb and path.
+/// @return true if added, false if the router is full.
+bool Router::add(const char* verb, const char* path, WebApp* app, int tag, const ParamSchema* schema, bool prefix){
+    uint16_t node = 0;
+    for(const char* p = path; *p; ++p){
+        uint16_t next = child(node, *p);
+        if(!next){
+            if(nodeCount == ROUTER_MAX_NODES) {
+                printf("Router out of nodes adding %s\n", path);
+                overflowed = true;
+                return false;
+            }
+            next = nodeCount++;
+            nodes[next].c = *p;
+            nodes[next].child = 0;
+            nodes[next].routes = 0;
+            nodes[next].sibling = nodes[node].child;
+            nodes[node].child = next;
+        }
+        node = next;
+    }
+
+    for(uint16_t r = nodes[node].routes; r; r = routes[r].next){
+        Route* route = routes + r;
+        bool sameVerb = (route->verb == verb) || (route->verb && verb && strcmp(route->verb, verb) == 0);
+        if(route->prefix == prefix && sameVerb){
+            route->app = app;
+            route->tag = tag;
+            route->schema = schema;
+            return true;
+        }
+    }
+
+    if(routeCount == ROUTER_MAX_ROUTES) {
+        printf("Router out of routes adding %s\n", path);
+        overflowed = true;
+        return false;
+    }
+    Route* route = routes + routeCount;
+    route->verb = verb;
+    route->path = path;
+    route->app = app;
+    route->tag = tag;
+    route->schema = schema;
+    route->prefix = prefix;
+    route->next = nodes[node].routes;
+    nodes[node].routes = routeCount++;
+    return true;
+}
+
+/// @brief Adds a route for requests with exactly this path.
+/// @param verb is the verb e.g. "GET", or 0 for any.
+/// @param path is the path e.g. "/digits".  It must stay valid (usually a literal).
+/// @param app is the app to handle the request.
+/// @param tag is passed to the app in the request to identify the route.
+/// @param schema describes the query parameters to bind, 0 for none.
+/// @return true if added, false if the router is full.
+bool Router::exact(const char* verb, const char* path, WebApp* app, int tag, const ParamSchema* schema){
+    return add(verb, path, app, tag, schema, false);
+}
+
+/// @brief Adds a route for requests whose path starts with this one.
+/// @param verb is the verb e.g. "GET", or 0 for any.
+/// @param path is the start of the path e.g. "/files/".
+/// @param app is the app to handle the request.
+/// @param tag is passed to the app in the request to identify the route.
+/// @param schema describes the query parameters to bind, 0 for none.
+/// @return true if added, false if the router is full.
+bool Router::prefix(const char* verb, const char* path, WebApp* app, int tag, const ParamSchema* schema){
+    return add(verb, path, app, tag, schema, true);
+}
+
+/// @brief Finds the app for a request: the longest matching route with an
+/// exact match beating a prefix one.
+/// @param verb is the request verb.
+/// @param path is the request path (without any query).
+/// @param tag is set to the route's tag.
+/// @param schema is set to the route's parameter schema (possibly 0).
+/// @param index if given is set to the route's number, 0 if none matches.
+/// @return the app or 0 if no route matches.
+WebApp* Router::find(const char* verb, const char* path, int& tag, const ParamSchema*& schema, int* index) const {
+    const Route* best = routeAt(0, verb, true);
+    uint16_t node = 0;
+    const char* p = path;
+    while(*p){
+        node = child(node, *p++);
+        if(!node) break;
+        const Route* route = routeAt(node, verb, true);
+        if(route) best = route;
+    }
+
+    if(node && *p == 0){ // walked the whole path
+        const Route* route = routeAt(node, verb, false);
+        if(route) best = route;
+    }
+
+    if(index) *index = best ? best - routes : 0;
+    if(!best) return 0;
+    tag = best->tag;
+    schema = best->schema;
+    return best->app;
+}
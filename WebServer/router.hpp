@@ -0,0 +1,79 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include "pico/stdlib.h"
+#include "params.hpp"
+
+class WebApp;
+
+// Number of trie nodes shared by all routes - one per distinct path character.
+#ifndef ROUTER_MAX_NODES
+#define ROUTER_MAX_NODES 256
+#endif
+
+// Number of routes (verb + path) that can be registered.
+#ifndef ROUTER_MAX_ROUTES
+#define ROUTER_MAX_ROUTES 48
+#endif
+
+// Maps a verb and path to the WebApp that handles it.  Routes are either
+// exact (the whole path) or prefix (the path starts with it).  Paths are held
+// in a trie built as apps are added at startup so a lookup walks the path
+// once however many apps or routes there are.  The longest matching route
+// wins, and an exact route beats a prefix route of the same path, so /adc
+// and /adcdata (or /digits and /digitshsv) don't get mixed up.
+//
+// Each route carries a tag which is passed on in the request (see
+// HttpRequest::route()) so an app with several routes can switch on it rather
+// than comparing paths again.  A route can also carry a ParamSchema so the
+// server decodes and checks the query parameters before the app sees them.
+class Router {
+
+    // Children of a node are kept as a list (first child, next sibling) to
+    // keep nodes small.  Index 0 is the root, so 0 also means "none".
+    struct Node {
+        char c;
+        uint16_t child;
+        uint16_t sibling;
+        uint16_t routes;    // first route ending at this node
+    };
+
+    struct Route {
+        const char* verb;   // 0 for any verb.
+        const char* path;
+        WebApp* app;
+        int tag;
+        const ParamSchema* schema;  // 0 if the app reads parameters itself.
+        bool prefix;
+        uint16_t next;      // next route ending at the same node.
+    };
+
+    Node nodes[ROUTER_MAX_NODES];
+    Route routes[ROUTER_MAX_ROUTES];    // routes[0] unused so 0 means none.
+    uint16_t nodeCount;
+    uint16_t routeCount;
+    bool overflowed;
+
+    uint16_t child(uint16_t node, char c) const;
+    const Route* routeAt(uint16_t node, const char* verb, bool prefix) const;
+    bool add(const char* verb, const char* path, WebApp* app, int tag, const ParamSchema* schema, bool prefix);
+
+    public:
+    Router();
+    void clear();
+
+    bool exact(const char* verb, const char* path, WebApp* app, int tag = 0, const ParamSchema* schema = 0);
+    bool prefix(const char* verb, const char* path, WebApp* app, int tag = 0, const ParamSchema* schema = 0);
+    WebApp* find(const char* verb, const char* path, int& tag, const ParamSchema*& schema, int* index = 0) const;
+
+    bool hasOverflowed() const { return overflowed;}
+    int nodesUsed() const { return nodeCount;}
+    int routesUsed() const { return routeCount - 1;}
+
+    // Routes are numbered from 1 in the order they were added (see find()).
+    const char* routeVerb(int index) const { return routes[index].verb;}
+    const char* routePath(int index) const { return routes[index].path;}
+    bool isPrefix(int index) const { return routes[index].prefix;}
+};
+
+#endif
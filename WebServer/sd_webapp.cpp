@@ -0,0 +1,415 @@
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include "sd_webapp.hpp"
+#include "json_writer.hpp"
+#include "pico/printf.h"
+
+// Longest file name on the card (FAT and exFAT allow 255).
+#define SD_NAME_MAX 256
+
+static uint32_t nowMs(){
+    return to_ms_since_boot(get_absolute_time());
+}
+
+struct MimeType {
+    const char* extension;
+    const char* type;
+};
+
+static const MimeType mimeTypes[] = {
+    {".html", "text/html"},
+    {".htm", "text/html"},
+    {".css", "text/css"},
+    {".js", "application/javascript"},
+    {".json", "application/json"},
+    {".txt", "text/plain"},
+    {".log", "text/plain"},
+    {".csv", "text/csv"},
+    {".svg", "image/svg+xml"},
+    {".png", "image/png"},
+    {".jpg", "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".gif", "image/gif"},
+    {".ico", "image/x-icon"},
+    {".wav", "audio/wav"},
+    {".gz", "application/gzip"},
+};
+
+/// @brief Works out a file's content type from its extension (in any case,
+/// as FAT names are often upper case).
+/// @param path is the file's path or name.
+/// @return the type, application/octet-stream if the extension isn't known.
+const char* SdWebapp::mimeType(const char* path){
+    const char* dot = strrchr(path, '.');
+    if(dot && !strchr(dot, '/')){
+        for(size_t i=0; i<sizeof(mimeTypes)/sizeof(mimeTypes[0]); ++i){
+            if(strcasecmp(dot, mimeTypes[i].extension) == 0) return mimeTypes[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+enum RangeResult {
+    NO_RANGE,       // send the whole file.
+    RANGE,          // send first to last.
+    BAD_RANGE       // nothing of the file is in the range, 416.
+};
+
+/// @brief Parses a Range header for a single range of bytes e.g. "bytes=100-",
+/// "bytes=100-199" or "bytes=-500" (the last 500).  Several ranges, other
+/// units and anything malformed are ignored and the whole file is sent.
+/// @param header is the header's value.
+/// @param size is the size of the file.
+/// @param first is set to the first byte to send.
+/// @param last is set to the last byte to send.
+static RangeResult parseRange(const char* header, uint64_t size, uint64_t& first, uint64_t& last){
+    if(strncmp(header, "bytes=", 6) != 0) return NO_RANGE;
+    const char* p = header + 6;
+    if(strchr(p, ',')) return NO_RANGE;
+    char* end;
+
+    if(*p == '-'){
+        uint64_t n = strtoull(p + 1, &end, 10);
+        if(end == p + 1) return NO_RANGE;
+        if(n == 0 || size == 0) return BAD_RANGE;
+        first = (n < size) ? size - n : 0;
+        last = size - 1;
+        return RANGE;
+    }
+
+    first = strtoull(p, &end, 10);
+    if(end == p || *end != '-') return NO_RANGE;
+    p = end + 1;
+    if(*p >= '0' && *p <= '9'){
+        last = strtoull(p, &end, 10);
+        if(last < first) return NO_RANGE;
+        if(last >= size) last = size - 1;
+    } else {
+        last = size - 1;
+    }
+    if(first >= size) return BAD_RANGE;
+    return RANGE;
+}
+
+// Sends a file (or part of one) a piece at a time as the connection has room.
+// Reads keep to whole sectors where they can so SdFat reads straight into
+// the send buffer rather than through its cache.
+class SdFileProducer: public BodyProducer {
+    SdWebapp& app;
+    SdWebapp::Handle* handle;
+    uint64_t position;
+    uint64_t remaining;
+    uint64_t length;
+
+    public:
+    SdFileProducer(SdWebapp& app, SdWebapp::Handle* handle, uint64_t first, uint64_t length)
+    : app(app), handle(handle), position(first), remaining(length), length(length) {}
+
+    virtual int contentLength() { return (length <= 0x7FFFFFFF) ? (int)length : -1;}
+    virtual size_t produce(uint8_t* buffer, size_t max);
+    virtual void finished() {
+        if(handle){
+            app.release(handle);
+            handle = 0;
+        }
+    }
+};
+
+size_t SdFileProducer::produce(uint8_t* buffer, size_t max){
+    if(remaining == 0 || !handle) return 0;
+    size_t n = (remaining < max) ? (size_t)remaining : max;
+
+    // Up to the next sector boundary then whole sectors.
+    size_t toBoundary = SD_SECTOR_SIZE - (size_t)(position % SD_SECTOR_SIZE);
+    if(n > toBoundary){
+        n = toBoundary + (n - toBoundary) / SD_SECTOR_SIZE * SD_SECTOR_SIZE;
+    }
+
+    int got = handle->file.read(buffer, n);
+    if(got <= 0){   // card error; stopping short closes the connection.
+        remaining = 0;
+        return 0;
+    }
+    position += got;
+    remaining -= got;
+    return got;
+}
+
+// Lists a directory as a JSON array of {"name":...,"size":...,"dir":...}, an
+// entry at a time.
+class SdDirectoryProducer: public BodyProducer {
+    SdWebapp& app;
+    SdWebapp::Handle* handle;
+    FsFile entry;
+    JsonWriter::State state;
+    bool started;
+    bool done;
+
+    char line[SD_NAME_MAX * 2 + 64];    // room for a name that's all escapes.
+    size_t lineLength;
+    size_t lineSent;
+
+    bool nextLine();
+
+    public:
+    SdDirectoryProducer(SdWebapp& app, SdWebapp::Handle* handle)
+    : app(app), handle(handle), started(false), done(false), lineLength(0), lineSent(0) {}
+
+    virtual size_t produce(uint8_t* buffer, size_t max);
+    virtual void finished() {
+        if(handle){
+            app.release(handle);
+            handle = 0;
+        }
+    }
+};
+
+size_t SdDirectoryProducer::produce(uint8_t* buffer, size_t max){
+    size_t n = 0;
+    while(n < max){
+        if(lineSent == lineLength && !nextLine()) break;
+        size_t len = lineLength - lineSent;
+        if(len > max - n) len = max - n;
+        memcpy(buffer + n, line + lineSent, len);
+        lineSent += len;
+        n += len;
+    }
+    return n;
+}
+
+/// @brief Puts the next entry (skipping hidden ones) in line.
+/// @return false once the listing is complete.
+bool SdDirectoryProducer::nextLine(){
+    if(done || !handle) return false;
+    char name[SD_NAME_MAX];
+    JsonWriter json(line, sizeof(line), state);
+    if(!started){
+        json.beginArray();
+        started = true;
+    }
+    while(true){
+        if(!entry.openNext(&handle->file, O_RDONLY)){
+            json.endArray();
+            done = true;
+            break;
+        }
+        bool hidden = entry.isHidden();
+        if(!hidden){
+            entry.getName(name, sizeof(name));
+            json.beginObject()
+                .field("name", (const char*)name)
+                .field("size", (unsigned long long)entry.fileSize())
+                .field("dir", entry.isDir())
+                .endObject();
+        }
+        entry.close();
+        if(!hidden) break;
+    }
+    state = json.getState();
+    lineLength = json.length();
+    lineSent = 0;
+    return true;
+}
+
+/// @brief Creates the webapp.
+/// @param volume is the card, e.g. an SdFs that has been begun.
+/// @param prefix is the URL path the files are served under e.g. "/logs".
+/// @param directory is the directory on the card that prefix maps to.
+SdWebapp::SdWebapp(FsVolume& volume, const char* prefix, const char* directory)
+: volume(volume)
+, prefix(prefix)
+, directory(directory)
+{
+    for(int i=0; i<SD_FILE_CACHE; ++i){
+        handles[i].path[0] = 0;
+        handles[i].openedAt = 0;
+        handles[i].lastUsed = 0;
+        handles[i].inUse = false;
+    }
+}
+
+void SdWebapp::addRoutes(Router& router){
+    router.prefix("GET", prefix, this);
+}
+
+/// @brief Works out the path on the card for a URL path.
+/// @param urlPath is the request's (decoded) path, starting with prefix.
+/// @param path is where to put the card's path.
+/// @param size is the size of path.
+/// @return false if the URL isn't under prefix, tries to climb out of the
+/// directory or is too long.
+bool SdWebapp::mapPath(const char* urlPath, char* path, size_t size){
+    const char* rest = urlPath + strlen(prefix);
+    if(*rest && *rest != '/') return false;     // e.g. /logsfoo for /logs
+
+    // No ".." anywhere as a path segment.
+    for(const char* p = rest; (p = strstr(p, "..")) != 0; p += 2){
+        bool segmentStart = (p == rest) || p[-1] == '/';
+        bool segmentEnd = p[2] == 0 || p[2] == '/';
+        if(segmentStart && segmentEnd) return false;
+    }
+
+    size_t dirLength = strlen(directory);
+    if(dirLength && directory[dirLength - 1] == '/' && *rest == '/') ++rest;
+    int written = snprintf(path, size, "%s%s", directory, rest);
+    return written > 0 && (size_t)written < size;
+}
+
+/// @brief Gets an open handle for a path, reusing a cached one if it is free
+/// and recent, otherwise reopening the least recently used free handle.
+/// @param path is the path on the card.
+/// @param busy is set true if there was no free handle.
+/// @return the handle, marked in use, or 0 if busy or there's no such path.
+SdWebapp::Handle* SdWebapp::findHandle(const char* path, bool& busy){
+    uint32_t now = nowMs();
+    Handle* spare = 0;
+    busy = false;
+    for(int i=0; i<SD_FILE_CACHE; ++i){
+        Handle* h = handles + i;
+        if(h->inUse) continue;
+        if(h->file.isOpen() && strcmp(h->path, path) == 0 && now - h->openedAt < SD_FILE_CACHE_MS){
+            if(h->file.isDir()) h->file.rewind();
+            h->inUse = true;
+            h->lastUsed = now;
+            return h;
+        }
+
+        // Prefer one that isn't open, otherwise the one unused longest.
+        if(!spare || (spare->file.isOpen() &&
+            (!h->file.isOpen() || (int32_t)(h->lastUsed - spare->lastUsed) < 0))){
+            spare = h;
+        }
+    }
+
+    if(!spare){
+        busy = true;
+        return 0;
+    }
+    if(spare->file.isOpen()) spare->file.close();
+    spare->path[0] = 0;
+    if(!spare->file.open(&volume, path, O_RDONLY)) return 0;
+
+    strcpy(spare->path, path);      // fits, mapPath checked.
+    spare->openedAt = now;
+    spare->lastUsed = now;
+    spare->inUse = true;
+    return spare;
+}
+
+/// @brief Lets a handle be used by another response.  It stays open for a
+/// while in case the same file is asked for again.
+void SdWebapp::release(Handle* handle){
+    handle->inUse = false;
+    handle->lastUsed = nowMs();
+}
+
+void SdWebapp::process(HttpRequest& request, HttpResponse& response){
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
+
+    char path[SD_PATH_MAX];
+    if(!mapPath(request.path(), path, sizeof(path))){
+        response.setStatus(404, "Not Found");
+        return;
+    }
+
+    bool busy;
+    Handle* handle = findHandle(path, busy);
+    if(!handle){
+        if(busy){
+            response.setStatus(503, "Service Unavailable");
+            response.addHeader("Retry-After", "1");
+        } else {
+            response.setStatus(404, "Not Found");
+        }
+        return;
+    }
+
+    if(handle->file.isDir()){
+        sendDirectory(response, handle);
+    } else {
+        sendFile(request, response, handle);
+    }
+}
+
+void SdWebapp::sendFile(HttpRequest& request, HttpResponse& response, Handle* handle){
+    FsFile& file = handle->file;
+    uint64_t size = file.fileSize();
+
+    // Changes whenever the file is written.
+    uint16_t date = 0;
+    uint16_t clock = 0;
+    file.getModifyDateTime(&date, &clock);
+    char* etag = (char*)response.getBlock()->allocate(40);
+    if(etag){
+        snprintf(etag, 40, "\"%llx-%04x%04x\"", (unsigned long long)size, date, clock);
+        response.addHeader("ETag", etag);
+        const char* match = request.header("If-None-Match");
+        if(match && (strstr(match, etag) || strcmp(match, "*") == 0)){
+            release(handle);
+            response.setStatus(304, "Not Modified");
+            return;
+        }
+    }
+    response.addHeader("Cache-Control", "no-cache");   // revalidate with ETag
+    response.addHeader("Accept-Ranges", "bytes");
+
+    // A range is only good for the version the client already has part of.
+    uint64_t first = 0;
+    uint64_t last = size ? size - 1 : 0;
+    bool partial = false;
+    const char* range = request.header("Range");
+    const char* ifRange = request.header("If-Range");
+    if(range && (!ifRange || (etag && strcmp(ifRange, etag) == 0))){
+        RangeResult result = parseRange(range, size, first, last);
+        if(result == BAD_RANGE){
+            release(handle);
+            char* contentRange = (char*)response.getBlock()->allocate(32);
+            if(contentRange){
+                snprintf(contentRange, 32, "bytes */%llu", (unsigned long long)size);
+                response.addHeader("Content-Range", contentRange);
+            }
+            response.setStatus(416, "Range Not Satisfiable");
+            return;
+        }
+        partial = (result == RANGE);
+    }
+
+    char* contentRange = partial ? (char*)response.getBlock()->allocate(64) : 0;
+    SdFileProducer* producer = (partial && !contentRange) ? 0
+        : new(response.getBlock()) SdFileProducer(*this, handle, first, size ? last - first + 1 : 0);
+    if(!producer){
+        release(handle);
+        response.setStatus(503, "Service Unavailable");
+        return;
+    }
+    if(!file.seekSet(first)){
+        producer->finished();
+        response.setStatus(500, "Internal Server Error");
+        return;
+    }
+
+    if(partial){
+        snprintf(contentRange, 64, "bytes %llu-%llu/%llu",
+            (unsigned long long)first, (unsigned long long)last, (unsigned long long)size);
+        response.setStatus(206, "Partial Content");
+        response.addHeader("Content-Range", contentRange);
+    } else {
+        response.setStatus(200, "OK");
+    }
+    response.addHeader("Content-Type", mimeType(handle->path));
+    response.setBody(producer);
+}
+
+void SdWebapp::sendDirectory(HttpResponse& response, Handle* handle){
+    SdDirectoryProducer* producer = new(response.getBlock()) SdDirectoryProducer(*this, handle);
+    if(!producer){
+        release(handle);
+        response.setStatus(503, "Service Unavailable");
+        return;
+    }
+    response.setStatus(200, "OK");
+    response.addHeader("Content-Type", "application/json");
+    response.addHeader("Cache-Control", "no-store");
+    response.setBody(producer);
+}
@@ -0,0 +1,76 @@
+#ifndef SD_WEBAPP_HPP
+#define SD_WEBAPP_HPP
+
+#include "webserver.hpp"
+
+// SdFat expects these from Arduino.  Chip select comes from the SdSpiConfig.
+#ifndef SS
+#define SS (-1)
+#endif
+#include "../SDFat_Pico/Print.h"
+#include "../SDFat_Pico/SdFat-pico/src/SdFat.h"
+
+// Files kept open between requests so that repeated and resumed downloads
+// don't have to find the file again each time.
+#ifndef SD_FILE_CACHE
+#define SD_FILE_CACHE 4
+#endif
+
+// How long an open file is reused before it is opened again, so that changes
+// (e.g. a log still being written) are picked up.
+#ifndef SD_FILE_CACHE_MS
+#define SD_FILE_CACHE_MS 2000
+#endif
+
+// Longest path on the card, including the directory served.
+#define SD_PATH_MAX 128
+
+// Reads from the card are whole sectors where possible.
+#define SD_SECTOR_SIZE 512
+
+// Serves the files in a directory of an SdFat volume under a URL prefix, e.g.
+//
+//   SdFs sd;       // begun with the board's SdSpiConfig
+//   SdWebapp logs(sd, "/logs", "/flight");
+//
+// serves /flight/0042.csv as /logs/0042.csv and lists /flight as JSON for
+// /logs/.  Files are read a sector or two at a time as the connection has room
+// for them so they can be any size.  Single byte ranges (Range: bytes=...) are
+// supported for resuming downloads, with an ETag made from the size and
+// modification time for If-Range and If-None-Match.
+//
+// Card reads happen in the network loop, so a slow card holds up the other
+// connections for as long as each read takes.
+class SdWebapp: public WebApp {
+    public:
+    // An open file or directory.  Each is used by one response at a time.
+    struct Handle {
+        FsFile file;
+        char path[SD_PATH_MAX];
+        uint32_t openedAt;      // ms since boot.
+        uint32_t lastUsed;      // ms since boot, for choosing one to reuse.
+        bool inUse;
+    };
+
+    private:
+    FsVolume& volume;
+    const char* prefix;
+    const char* directory;
+    Handle handles[SD_FILE_CACHE];
+
+    bool mapPath(const char* urlPath, char* path, size_t size);
+    Handle* findHandle(const char* path, bool& busy);
+    void sendFile(HttpRequest& request, HttpResponse& response, Handle* handle);
+    void sendDirectory(HttpResponse& response, Handle* handle);
+
+    public:
+    SdWebapp(FsVolume& volume, const char* prefix, const char* directory = "/");
+
+    static const char* mimeType(const char* path);
+    void release(Handle* handle);
+
+    virtual void addRoutes(Router& router);
+    virtual void process(HttpRequest& request, HttpResponse& response);
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include <string.h>
+#include "sensor_frame.hpp"
+
+static void put32(uint8_t* p, uint32_t v){
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void put64(uint8_t* p, uint64_t v){
+    put32(p, (uint32_t)v);
+    put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t get32(const uint8_t* p){
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get64(const uint8_t* p){
+    return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+/// @brief Size of a reading's value.
+/// @return 0 if the type isn't known.
+static size_t valueSize(uint8_t type){
+    switch(type){
+    case SENSOR_F32:
+    case SENSOR_I32:
+    case SENSOR_U32:
+        return 4;
+    case SENSOR_U64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/// @brief Starts an empty frame.
+/// @param source is the kind of device sending it.
+SensorFrame::SensorFrame(SensorSource source)
+: length(SENSOR_FRAME_HEADER)
+, overflow(false)
+{
+    memset(data, 0, SENSOR_FRAME_HEADER);
+    data[0] = 'P';
+    data[1] = 'S';
+    data[2] = SENSOR_FRAME_VERSION;
+    data[3] = source;
+}
+
+/// @brief Makes room for a reading's value after its id and type.
+/// @return where the value goes or 0 if it doesn't fit.
+uint8_t* SensorFrame::reserve(uint8_t id, SensorType type, size_t size){
+    if(length + 2 + size > SENSOR_FRAME_MAX || data[16] == 255){
+        overflow = true;
+        return 0;
+    }
+    uint8_t* p = data + length;
+    p[0] = id;
+    p[1] = type;
+    length += 2 + size;
+    ++data[16];
+    return p + 2;
+}
+
+SensorFrame& SensorFrame::add(uint8_t id, float value){
+    uint8_t* p = reserve(id, SENSOR_F32, 4);
+    if(p){
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        put32(p, bits);
+    }
+    return *this;
+}
+
+SensorFrame& SensorFrame::add(uint8_t id, int32_t value){
+    uint8_t* p = reserve(id, SENSOR_I32, 4);
+    if(p) put32(p, (uint32_t)value);
+    return *this;
+}
+
+SensorFrame& SensorFrame::add(uint8_t id, uint32_t value){
+    uint8_t* p = reserve(id, SENSOR_U32, 4);
+    if(p) put32(p, value);
+    return *this;
+}
+
+SensorFrame& SensorFrame::add(uint8_t id, uint64_t value){
+    uint8_t* p = reserve(id, SENSOR_U64, 8);
+    if(p) put64(p, value);
+    return *this;
+}
+
+/// @brief Fills in the header fields known only when the frame is sent.
+/// @param sequence is the sender's frame count.
+/// @param time is the sender's time in us since boot.
+void SensorFrame::stamp(uint32_t sequence, uint64_t time){
+    put32(data + 4, sequence);
+    put64(data + 8, time);
+}
+
+SensorFrameReader::SensorFrameReader()
+: data(0)
+, length(0)
+, pos(0)
+{}
+
+/// @brief Checks a received frame and gets ready to read its readings.
+/// @param data is the datagram.  It must stay put while it is read.
+/// @param length is the size of the datagram.
+/// @return false if it isn't a frame of this version or is short.
+bool SensorFrameReader::parse(const uint8_t* data, size_t length){
+    this->data = 0;
+    if(length < SENSOR_FRAME_HEADER || data[0] != 'P' || data[1] != 'S'
+        || data[2] != SENSOR_FRAME_VERSION){
+        return false;
+    }
+
+    // Every reading must be complete; anything after the last isn't read.
+    size_t p = SENSOR_FRAME_HEADER;
+    for(int i=0; i<data[16]; ++i){
+        if(p + 2 > length) return false;
+        size_t size = valueSize(data[p + 1]);
+        if(size == 0 || p + 2 + size > length) return false;
+        p += 2 + size;
+    }
+
+    this->data = data;
+    this->length = p;
+    pos = SENSOR_FRAME_HEADER;
+    return true;
+}
+
+/// @brief Gets the next reading.
+/// @return false once count() readings have been read.
+bool SensorFrameReader::next(SensorReading& reading){
+    if(!data || pos + 2 > length) return false;
+    reading.id = data[pos];
+    reading.type = data[pos + 1];
+    size_t size = valueSize(reading.type);
+    if(size == 0 || pos + 2 + size > length) return false;
+
+    const uint8_t* value = data + pos + 2;
+    if(size == 8){
+        reading.u64 = get64(value);
+    } else {
+        reading.u64 = 0;
+        reading.u = get32(value);   // same bits for f and i.
+    }
+    pos += 2 + size;
+    return true;
+}
+
+uint32_t SensorFrameReader::sequence() const {
+    return get32(data + 4);
+}
+
+uint64_t SensorFrameReader::time() const {
+    return get64(data + 8);
+}
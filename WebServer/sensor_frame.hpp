@@ -0,0 +1,106 @@
+#ifndef SENSOR_FRAME_HPP
+#define SENSOR_FRAME_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A set of readings packed for sending in one UDP datagram.  Everything is
+// little endian and byte packed:
+//
+//   offset  size  field
+//   0       2     magic 'P' 'S'
+//   2       1     version, SENSOR_FRAME_VERSION
+//   3       1     source, which kind of device sent it (SensorSource)
+//   4       4     sequence, one more than the sender's last frame
+//   8       8     time, us since the sender booted
+//   16      1     count of readings
+//   17            readings, each an id (1 byte, meaning set by the source),
+//                 a SensorType (1 byte) and the value (4 or 8 bytes)
+//
+// Readers skip frames with a different version; new types of reading need a
+// new version as a reader can't otherwise tell how long they are.
+#define SENSOR_FRAME_VERSION 1
+#define SENSOR_FRAME_HEADER 17
+
+// Where frames go by default: an administratively scoped (site local)
+// multicast group, so every listener on the LAN gets each frame from one send.
+#ifndef SENSOR_GROUP
+#define SENSOR_GROUP "239.255.80.83"
+#endif
+
+#ifndef SENSOR_PORT
+#define SENSOR_PORT 4583
+#endif
+
+// Largest frame, well inside one Ethernet frame.
+#ifndef SENSOR_FRAME_MAX
+#define SENSOR_FRAME_MAX 256
+#endif
+
+enum SensorSource : uint8_t {
+    SENSOR_SOURCE_WEATHER = 1,
+    SENSOR_SOURCE_BCDCLOCK = 2,
+    SENSOR_SOURCE_FUSION = 3
+};
+
+enum SensorType : uint8_t {
+    SENSOR_F32 = 1,     // float
+    SENSOR_I32 = 2,
+    SENSOR_U32 = 3,
+    SENSOR_U64 = 4
+};
+
+struct SensorReading {
+    uint8_t id;
+    uint8_t type;       // SensorType
+    union {
+        float f;
+        int32_t i;
+        uint32_t u;
+        uint64_t u64;
+    };
+};
+
+// Builds a frame.  Readings that don't fit are left out and overflowed() is
+// set.  The sequence and time are filled in when it is sent (stamp()).
+class SensorFrame {
+    uint8_t data[SENSOR_FRAME_MAX];
+    size_t length;
+    bool overflow;
+
+    uint8_t* reserve(uint8_t id, SensorType type, size_t size);
+
+    public:
+    SensorFrame(SensorSource source);
+
+    SensorFrame& add(uint8_t id, float value);
+    SensorFrame& add(uint8_t id, int32_t value);
+    SensorFrame& add(uint8_t id, uint32_t value);
+    SensorFrame& add(uint8_t id, uint64_t value);
+    void stamp(uint32_t sequence, uint64_t time);
+
+    const uint8_t* bytes() const { return data;}
+    size_t size() const { return length;}
+    int count() const { return data[16];}
+    bool overflowed() const { return overflow;}
+};
+
+// Decodes a received frame.
+class SensorFrameReader {
+    const uint8_t* data;
+    size_t length;
+    size_t pos;     // next reading.
+
+    public:
+    SensorFrameReader();
+
+    bool parse(const uint8_t* data, size_t length);
+    bool next(SensorReading& reading);
+
+    SensorSource source() const { return (SensorSource)data[3];}
+    uint32_t sequence() const;
+    uint64_t time() const;
+    int count() const { return data[16];}
+};
+
+#endif
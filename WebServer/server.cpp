@@ -14,9 +14,20 @@
 #include <stdlib.h>
 
 #include "server.hpp"
+#include "trace.hpp"
 
 #define TCP_PORT 4242
+
+// printf()s from opening the server.  Off unless asked for as they're slow
+// enough to hold up the network loop; the trace ring has the rest.
+#ifndef SERVER_DEBUG
+#define SERVER_DEBUG 0
+#endif
+#if SERVER_DEBUG
 #define DEBUG_printf printf
+#else
+#define DEBUG_printf(...) ((void)0)
+#endif
 #define POLL_TIME_S 5
 
 
@@ -31,6 +42,9 @@
 void TcpServer::ServerConnection::open(TcpServer* pServer, struct tcp_pcb *client_pcb){
     this->client_pcb = client_pcb;
     this->server = pServer;
+    queuedLength = 0;
+    queuedMore = false;
+    aborted = false;
     tcp_arg(client_pcb, this);           
     tcp_sent(client_pcb, TcpServer::ServerConnection::sent);
     tcp_recv(client_pcb, TcpServer::ServerConnection::received);
@@ -43,6 +57,7 @@ void TcpServer::ServerConnection::open(TcpServer* pServer, struct tcp_pcb *clien
 err_t TcpServer::ServerConnection::close(){
     err_t err = ERR_OK;
     if(client_pcb) {
+        flush();    // a last chance for anything queued.
         tcp_arg(client_pcb, NULL);
         tcp_poll(client_pcb, NULL, 0);
         tcp_sent(client_pcb, NULL);
@@ -50,8 +65,9 @@ err_t TcpServer::ServerConnection::close(){
         tcp_err(client_pcb, NULL);
         err = tcp_close(client_pcb);
         if (err != ERR_OK) {
-            DEBUG_printf("close failed %d, calling abort\n", err);
+            TRACE_ERROR(TRACE_CLOSE_FAILED, err, 0);
             tcp_abort(client_pcb);
+            aborted = true;
             err = ERR_ABRT;
         }
     }
@@ -59,14 +75,29 @@ err_t TcpServer::ServerConnection::close(){
     return err;
 }
 
+/// @brief What an lwIP callback must return once the app has had its say:
+/// ERR_ABRT if the pcb was aborted meanwhile (e.g. a close() that failed over
+/// to tcp_abort()), whatever the app returned, as lwIP must not touch it again.
+err_t TcpServer::ServerConnection::callbackResult(err_t err){
+    return aborted ? ERR_ABRT : err;
+}
+
+/// @brief Forgets the connection's pcb (lwIP has closed or freed it) and
+/// anything still queued for it.
+void TcpServer::ServerConnection::markAsClosed(){
+    client_pcb = 0;
+    queuedLength = 0;
+}
+
 // Callback for when data is sent.
 // tpcb	The connection pcb for which data has been acknowledged
 // len	The amount of bytes acknowledged
 // ERR_OK: try to send some data by calling tcp_output Only return ERR_ABRT if you have called tcp_abort from within the callback function!
 err_t TcpServer::ServerConnection::sent(void *arg, struct tcp_pcb *tpcb, u16_t len) {
     TcpServer::ServerConnection* connection = static_cast<TcpServer::ServerConnection*>(arg);
-    DEBUG_printf("tcp_server_sent %u\n", len);
-    return connection->app()->sent(connection, len);
+    TRACE_DEBUG(TRACE_TCP_SENT, len, 0);
+    connection->flush();    // acknowledged data has made room.
+    return connection->callbackResult(connection->app()->sent(connection, len));
 }
 
 // Callback for data received.
@@ -96,13 +127,21 @@ err_t TcpServer::ServerConnection::received(void *arg, struct tcp_pcb *tpcb, str
 
     // Process data...
     if (p->tot_len > 0) {
-        DEBUG_printf("tcp_server_recv %d, err %d\n", p->tot_len, err);
+        TRACE_DEBUG(TRACE_TCP_RECEIVE, p->tot_len, err);
 
         // Receive the buffer and shovel the data to the app.
         struct pbuf *here = p;
         while(here){
-            err = connection->app()->receive(connection, here->payload, here->len);
+            err = connection->callbackResult(connection->app()->receive(connection, here->payload, here->len));
+            if(err == ERR_ABRT){        // lwIP won't free the data of an aborted pcb.
+                pbuf_free(p);
+                return ERR_ABRT;
+            }
             if(err != ERR_OK) return err;
+            if(!connection->isOpen()) { // app has closed the connection, drop the rest.
+                pbuf_free(p);
+                return ERR_OK;
+            }
             here = here->next;
         }
          tcp_recved(tpcb, p->tot_len);
@@ -122,7 +161,8 @@ err_t TcpServer::ServerConnection::received(void *arg, struct tcp_pcb *tpcb, str
 err_t TcpServer::ServerConnection::poll(void *arg, struct tcp_pcb *tpcb) {
     TcpServer::ServerConnection* connection = static_cast<TcpServer::ServerConnection*>(arg);
     // DEBUG_printf("tcp_server_poll_fn\n");
-    return connection->app()->poll(connection);
+    connection->flush();
+    return connection->callbackResult(connection->app()->poll(connection));
 }
 
 // Callback for TCP error
@@ -136,32 +176,90 @@ void TcpServer::ServerConnection::error(void *arg, err_t err) {
     connection->markAsClosed();
 }
 
-/// @brief Sends data from the server back to client.
+/// @brief Sends data from the server back to client.  If lwIP has no room
+/// the data is queued and sent as acknowledgements make room.
 /// @param data is the data to send.
 /// @param len is the number of bytes to send
 /// @param moreToCome if true signals there's more data to come.
-/// @return error status, hopefully ERR_OK.
+/// @return error status, hopefully ERR_OK.  ERR_MEM if there's no room to
+/// queue it either.
 err_t TcpServer::ServerConnection::send(uint8_t* data, size_t len, bool moreToCome)
 {
-    DEBUG_printf("Writing %ld bytes to client\n", len);
     // this method is callback from lwIP, so cyw43_arch_lwip_begin is not required, however you
     // can use this method to cause an assertion in debug mode, if this method is called when
     // cyw43_arch_lwip_begin IS needed
     cyw43_arch_lwip_check();
+    if(queuedLength) return queue(data, len, moreToCome);   // keep the order.
+
     u8_t apiflags = TCP_WRITE_FLAG_COPY;
     if(moreToCome) apiflags |= TCP_WRITE_FLAG_MORE;
     err_t err = tcp_write(client_pcb, data, len, apiflags);
-    if (err != ERR_OK) {
-        DEBUG_printf("Failed to write data %d\n", err);
-        return err;
-    }
+    TRACE_DEBUG(TRACE_TCP_WRITE, len, err);
+    if(err == ERR_MEM) return queue(data, len, moreToCome);
+    return err;
+}
+
+/// @brief Keeps a copy of data lwIP had no room for.
+/// @return ERR_OK if queued, ERR_MEM if the queue is full.
+err_t TcpServer::ServerConnection::queue(const uint8_t* data, size_t len, bool moreToCome){
+    if(len > SEND_QUEUE_SIZE - queuedLength) return ERR_MEM;
+    memcpy(queued + queuedLength, data, len);
+    queuedLength += len;
+    queuedMore = moreToCome;
+    TRACE_DEBUG(TRACE_SEND_QUEUED, len, queuedLength);
     return ERR_OK;
 }
 
+/// @brief Passes as much of the send queue to lwIP as it has room for.
+/// Called as data is acknowledged, on poll and from TcpServer::service().
+void TcpServer::ServerConnection::flush(){
+    if(!client_pcb || queuedLength == 0) return;
+    if(tcp_sndqueuelen(client_pcb) >= TCP_SND_QUEUELEN) return;
+    size_t len = tcp_sndbuf(client_pcb);
+    if(len == 0) return;
+    if(len > queuedLength) len = queuedLength;
+
+    u8_t apiflags = TCP_WRITE_FLAG_COPY;
+    if(len < queuedLength || queuedMore) apiflags |= TCP_WRITE_FLAG_MORE;
+    err_t err = tcp_write(client_pcb, queued, len, apiflags);
+    TRACE_DEBUG(TRACE_TCP_WRITE, len, err);
+    if(err != ERR_OK) return;   // still no room, try again later.
+
+    queuedLength -= len;
+    memmove(queued, queued + len, queuedLength);
+    tcp_output(client_pcb);
+}
+
+/// @brief Sends data that stays put (e.g. const data in flash) without lwIP
+/// taking a copy.  The data must not change until it has been acknowledged.
+/// @param data is the data to send.
+/// @param len is the number of bytes to send
+/// @param moreToCome if true signals there's more data to come.
+/// @return error status, hopefully ERR_OK.
+err_t TcpServer::ServerConnection::sendStatic(const uint8_t* data, size_t len, bool moreToCome)
+{
+    cyw43_arch_lwip_check();
+    if(queuedLength) return ERR_MEM;    // can't go ahead of queued data.
+    u8_t apiflags = moreToCome ? TCP_WRITE_FLAG_MORE : 0;
+    err_t err = tcp_write(client_pcb, data, len, apiflags);
+    TRACE_DEBUG(TRACE_TCP_WRITE, len, err);
+    return err;
+}
+
+/// @brief Finds how much can be sent without send() running out of room.
+/// @return bytes free in the TCP send buffer, 0 if the send queue is full
+/// or data is waiting to go in it.
+size_t TcpServer::ServerConnection::sendBufferSpace(){
+    if(!client_pcb || queuedLength) return 0;
+    if(tcp_sndqueuelen(client_pcb) >= TCP_SND_QUEUELEN) return 0;
+    return tcp_sndbuf(client_pcb);
+}
+
 /// @brief aborts the connection.
 /// @return ERR_ABRT
 err_t TcpServer::ServerConnection::abort(){
     tcp_abort(client_pcb);
+    aborted = true;
     markAsClosed();
     return ERR_ABRT;
 }
@@ -175,7 +273,13 @@ TcpServer::TcpServer(ServerApplication* app)
 , server_pcb(0)  
 , complete(false)
 , errorStatus(ERR_OK)
-{}
+, arrivals(0)
+{
+    for(int i=0; i<SERVER_BACKLOG; ++i){
+        waiting[i].server = this;
+        waiting[i].pcb = 0;
+    }
+}
 
 
 
@@ -192,26 +296,122 @@ TcpServer::ServerConnection* TcpServer::allocateClient(TcpServer* pServer, struc
 }
 
 
-// Callback when client connects
+/// @brief Holds a connection until a client slot is free.  Its data is left
+/// with lwIP (refused) until then.
+/// @return false if the backlog is full.
+bool TcpServer::hold(struct tcp_pcb *client_pcb){
+    for(int i=0; i<SERVER_BACKLOG; ++i){
+        Waiting& w = waiting[i];
+        if(!w.pcb){
+            w.pcb = client_pcb;
+            w.arrival = arrivals++;
+            tcp_arg(client_pcb, &w);
+            tcp_recv(client_pcb, TcpServer::waitingReceived);
+            tcp_err(client_pcb, TcpServer::waitingError);
+            tcp_poll(client_pcb, TcpServer::waitingPoll, 1);
+            TRACE_INFO(TRACE_CONNECTION_WAITING, i, 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Gives free client slots to waiting connections, oldest first,
+/// closing idle connections to make room if need be.  Not called from a
+/// client's callbacks as it may reuse the slot that has just closed.  lwIP
+/// passes on data refused while waiting on its next timer.
+void TcpServer::admitWaiting(){
+    while(true){
+        Waiting* next = 0;
+        for(int i=0; i<SERVER_BACKLOG; ++i){
+            if(waiting[i].pcb && (!next || (int32_t)(waiting[i].arrival - next->arrival) < 0)){
+                next = waiting + i;
+            }
+        }
+        if(!next || !makeRoom()) return;
+
+        ServerConnection* connection = allocateClient(this, next->pcb);
+        if(!connection) return;
+        next->pcb = 0;
+        TRACE_INFO(TRACE_CONNECTION_ADMITTED, connection - clients, 0);
+        app->connected(connection);
+    }
+}
+
+/// @brief Makes sure there is a free client slot, closing the connection
+/// that has been idle longest if need be (and it's been idle long enough).
+/// @return true if a slot is free.
+bool TcpServer::makeRoom(){
+    ServerConnection* oldest = 0;
+    uint32_t longest = 0;
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        if(!clients[i].isOpen()) return true;
+        uint32_t idle = app->idleTime(clients + i);
+        if(idle >= SERVER_EVICT_IDLE_MS && idle > longest){
+            oldest = clients + i;
+            longest = idle;
+        }
+    }
+    if(!oldest) return false;
+
+    TRACE_INFO(TRACE_CONNECTION_EVICTED, oldest - clients, longest);
+    app->closed(oldest);
+    oldest->close();
+    return true;
+}
+
+// Callback when client connects.  The new connection waits its turn behind
+// any already waiting, which is no wait at all if a client slot is free.
 err_t TcpServer::accept(void *arg, struct tcp_pcb *client_pcb, err_t err) {
     TcpServer* server = static_cast<TcpServer*>(arg);
 
     if (err != ERR_OK || client_pcb == NULL) {
-        DEBUG_printf("Failure in accept\n");
+        TRACE_ERROR(TRACE_ACCEPT_FAILED, err, 0);
         return ERR_VAL;
     }
-    DEBUG_printf("Client connected\n");
 
-    TcpServer::ServerConnection* connection = server->allocateClient(server, client_pcb);
-    if(connection) {
-        server->app->connected(connection);
-        return ERR_OK;
+    server->admitWaiting();
+    if(!server->hold(client_pcb)){
+        TRACE_ERROR(TRACE_CONNECTION_REFUSED, SERVER_BACKLOG, 0);
+        return ERR_MEM;     // lwIP resets the connection.
     }
+    server->admitWaiting();
+    return ERR_OK;
+}
 
-    return ERR_MEM;
+// Callback for data arriving on a waiting connection.  Refusing it leaves it
+// with lwIP, which offers it again later.
+err_t TcpServer::waitingReceived(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    Waiting* w = static_cast<Waiting*>(arg);
+    if(p) return ERR_MEM;
+
+    // Client gave up before there was room.
+    w->pcb = 0;
+    tcp_arg(tpcb, NULL);
+    tcp_recv(tpcb, NULL);
+    tcp_err(tpcb, NULL);
+    tcp_poll(tpcb, NULL, 0);
+    if(tcp_close(tpcb) != ERR_OK){
+        TRACE_ERROR(TRACE_CLOSE_FAILED, err, 0);
+        tcp_abort(tpcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
 }
 
+// Callback every half second for a waiting connection, in case the network
+// loop doesn't call service().
+err_t TcpServer::waitingPoll(void *arg, struct tcp_pcb *tpcb) {
+    Waiting* w = static_cast<Waiting*>(arg);
+    w->server->admitWaiting();
+    return ERR_OK;
+}
 
+// Callback for a waiting connection being reset.  lwIP has freed the pcb.
+void TcpServer::waitingError(void *arg, err_t err) {
+    Waiting* w = static_cast<Waiting*>(arg);
+    w->pcb = 0;
+}
 
 /// @brief Opens a server connection to listen on the given port.
 /// @param port is the port number to listen on.
@@ -231,7 +431,8 @@ bool TcpServer::open(uint16_t port) {
         return false;
     }
 
-    server_pcb = tcp_listen_with_backlog(pcb, 1);
+    // The backlog only applies if lwIP is built with TCP_LISTEN_BACKLOG.
+    server_pcb = tcp_listen_with_backlog(pcb, SERVER_BACKLOG);
     if (!server_pcb) {
         DEBUG_printf("failed to listen\n");
         if (pcb) {
@@ -253,6 +454,16 @@ bool TcpServer::open(uint16_t port) {
 /// @return ERR_OK
 err_t TcpServer::close() {
     err_t err = ERR_OK;
+    for(int i=0; i<SERVER_BACKLOG; ++i){
+        if(waiting[i].pcb){
+            tcp_arg(waiting[i].pcb, NULL);
+            tcp_recv(waiting[i].pcb, NULL);
+            tcp_err(waiting[i].pcb, NULL);
+            tcp_poll(waiting[i].pcb, NULL, 0);
+            tcp_abort(waiting[i].pcb);
+            waiting[i].pcb = 0;
+        }
+    }
     for(int i=0; i<MAX_CLIENTS; ++i){
         if(clients[i].isOpen()){
             clients[i].close();
@@ -270,10 +481,22 @@ err_t TcpServer::close() {
     return err;
 }
 
+/// @brief Does the work that isn't triggered by lwIP: admitting waiting
+/// connections, retrying queued sends and the application's own service().
+/// Call on every pass of the network loop if not using run().
+void TcpServer::service(){
+    admitWaiting();
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        clients[i].flush();
+    }
+    app->service();
+}
+
 /// @brief Runs the main polling loop of the application.
 void TcpServer::run(){
      while(!complete) {
         cyw43_arch_poll();
+        service();
     }
 }
 
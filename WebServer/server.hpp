@@ -9,6 +9,23 @@
 
 #define MAX_CLIENTS 8
 
+// Connections accepted while all MAX_CLIENTS are busy are held (their data
+// left with lwIP) until one closes.  More than this are refused.
+#ifndef SERVER_BACKLOG
+#define SERVER_BACKLOG 4
+#endif
+
+// A connection idle between requests for at least this long can be closed to
+// make room for a new one.
+#ifndef SERVER_EVICT_IDLE_MS
+#define SERVER_EVICT_IDLE_MS 1000
+#endif
+
+// Bytes per connection kept back to retry when lwIP has no room for a send.
+#ifndef SEND_QUEUE_SIZE
+#define SEND_QUEUE_SIZE 512
+#endif
+
 // Interface to describe a TCP connection from the application's point of view.
 class Connection{
     void* _appState;
@@ -17,6 +34,8 @@ class Connection{
     void* getAppState() const { return _appState;}
     
     virtual err_t send(uint8_t* data, size_t len, bool moreToCome=false) = 0;
+    virtual err_t sendStatic(const uint8_t* data, size_t len, bool moreToCome=false) = 0;
+    virtual size_t sendBufferSpace() = 0;
     virtual err_t close() = 0;
     virtual bool isOpen() = 0;
     virtual err_t abort() = 0;
@@ -32,6 +51,15 @@ class ServerApplication {
     virtual err_t poll(Connection* connection) = 0;
     virtual void error(Connection* connection, err_t err) = 0;
     virtual err_t sent(Connection* connection, u16_t bytesSent) = 0;
+
+    /// @brief Says how long a connection has been waiting for its next
+    /// request, for choosing one to close when all are in use.
+    /// @return ms idle, or 0 if it is busy and mustn't be closed.
+    virtual uint32_t idleTime(Connection* connection) { return 0;}
+
+    /// @brief Called on every pass of the network loop for work that isn't
+    /// triggered by a connection e.g. finishing requests handled on the other core.
+    virtual void service() {}
 };
 
 class TcpServer {
@@ -41,6 +69,13 @@ class TcpServer {
     public Connection {
         TcpServer* server;
         struct tcp_pcb *client_pcb;
+        uint8_t queued[SEND_QUEUE_SIZE];    // sends lwIP had no room for.
+        uint16_t queuedLength;
+        bool queuedMore;                    // moreToCome for the queued data.
+        bool aborted;                       // tcp_abort()ed since open().
+
+        err_t queue(const uint8_t* data, size_t len, bool moreToCome);
+        err_t callbackResult(err_t err);
    
         // Callback functions for managing client connection
         static err_t poll(void *arg, struct tcp_pcb *tpcb);
@@ -52,18 +87,24 @@ class TcpServer {
 
         ServerConnection() 
             : server(0),
-            client_pcb(0)
+            client_pcb(0),
+            queuedLength(0),
+            queuedMore(false),
+            aborted(false)
             {}
 
         //TcpServer* getServer() { return server;}
-        void markAsClosed() {client_pcb = 0;}
+        void markAsClosed();
         void open(TcpServer* server, struct tcp_pcb *client_pcb);
+        void flush();
 
         inline ServerApplication* app() {return server->getApp();}
 
         virtual err_t close();
         virtual bool isOpen() { return client_pcb != 0;}
         virtual err_t send(uint8_t* data, size_t len, bool moreToCome=false);
+        virtual err_t sendStatic(const uint8_t* data, size_t len, bool moreToCome=false);
+        virtual size_t sendBufferSpace();
         virtual err_t abort();
      };   
 
@@ -73,10 +114,25 @@ class TcpServer {
     err_t errorStatus;
     ServerConnection clients[MAX_CLIENTS];  // Max number of connections
 
+    // A connection waiting for a free client slot.
+    struct Waiting {
+        TcpServer* server;
+        struct tcp_pcb *pcb;    // 0 if unused.
+        uint32_t arrival;       // to admit them in order.
+    };
+    Waiting waiting[SERVER_BACKLOG];
+    uint32_t arrivals;
+
     ServerConnection* allocateClient(TcpServer* pServer, struct tcp_pcb *client_pcb);
+    bool hold(struct tcp_pcb *client_pcb);
+    void admitWaiting();
+    bool makeRoom();
 
     // Callback functions for LWIP
     static err_t accept(void *arg, struct tcp_pcb *client_pcb, err_t err);
+    static err_t waitingReceived(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+    static err_t waitingPoll(void *arg, struct tcp_pcb *tpcb);
+    static void waitingError(void *arg, err_t err);
 
     public:
 
@@ -84,7 +140,9 @@ class TcpServer {
     ServerApplication* getApp() {return app;}
     bool open(uint16_t port);
     err_t close();
+    void service();
     void run();
+    bool isRunning() const { return !complete;}
 };
 
 #endif
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "static_asset.hpp"
+
+/// @brief Creates a webapp to serve a table of assets.
+/// @param assets is the table, by default the one generated by web_assets().
+/// @param count is the number of assets in the table.
+/// @param indexPath if not null is the path of the asset to serve for "/".
+StaticAssetWebapp::StaticAssetWebapp(const StaticAsset* assets, int count, const char* indexPath)
+: assets(assets)
+, count(count)
+, index(0)
+{
+    if(indexPath) {
+        index = find(indexPath);
+    }
+}
+
+/// @brief Looks up an asset by its path.
+/// @param path is the asset's path.
+/// @return the asset or 0 if none.
+const StaticAsset* StaticAssetWebapp::find(const char* path){
+    for(int i=0; i<count; ++i){
+        if(strcmp(assets[i].path, path) == 0) return assets + i;
+    }
+    return 0;
+}
+
+// Each asset's route is tagged with its index in the table.
+void StaticAssetWebapp::addRoutes(Router& router){
+    for(int i=0; i<count; ++i){
+        router.exact("GET", assets[i].path, this, i);
+    }
+    if(index){
+        int i = index - assets;
+        router.exact("GET", "/", this, i);
+        router.prefix("GET", "/index", this, i);
+    }
+}
+
+void StaticAssetWebapp::process(HttpRequest& request, HttpResponse& response){
+    const StaticAsset* asset = assets + request.route();
+
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
+    response.addHeader("ETag", asset->etag);
+    response.addHeader("Cache-Control", "no-cache"); // revalidate with ETag
+
+    // Already have it?  The header may list several ETags or be *.
+    const char* match = request.header("If-None-Match");
+    if(match && (strstr(match, asset->etag) || strcmp(match, "*") == 0)){
+        response.setStatus(304, "Not Modified");
+        return;
+    }
+
+    // Every browser accepts gzip.  There's no room to keep uncompressed
+    // copies for clients that don't.
+    response.setStatus(200, "OK");
+    response.addHeader("Content-Type", asset->mimeType);
+    response.addHeader("Content-Encoding", "gzip");
+    response.addHeader("Vary", "Accept-Encoding");
+    response.setStaticBody(asset->data, asset->length);
+}
@@ -0,0 +1,37 @@
+#ifndef STATIC_ASSET_HPP
+#define STATIC_ASSET_HPP
+
+#include "webserver.hpp"
+
+// A gzip compressed file held in flash.  Tables of these are generated at
+// build time by web_assets.cmake.
+struct StaticAsset {
+    const char* path;       // URL path e.g. "/form.html"
+    const char* mimeType;   // e.g. "text/html"
+    const uint8_t* data;    // gzip compressed content.
+    uint32_t length;        // bytes in data.
+    const char* etag;       // strong ETag including quotes.
+};
+
+// Generated by web_assets() in the project's CMakeLists.txt.
+extern const StaticAsset webAssets[];
+extern const int webAssetCount;
+
+// Serves StaticAssets straight from flash.  The compressed data is sent with
+// Content-Encoding: gzip and is handed to lwIP without being copied.  Clients
+// that already have the current version (If-None-Match) get a 304.
+// Optionally one asset is also served as the index page for "/" and "/index".
+class StaticAssetWebapp: public WebApp {
+    const StaticAsset* assets;
+    int count;
+    const StaticAsset* index;
+
+    const StaticAsset* find(const char* path);
+
+    public:
+    StaticAssetWebapp(const StaticAsset* assets = webAssets, int count = webAssetCount, const char* indexPath = 0);
+    virtual void addRoutes(Router& router);
+    virtual void process(HttpRequest& request, HttpResponse& response);
+};
+
+#endif
@@ -20,15 +20,13 @@ static const char*teapot =
 
 
 
-bool Teapot::matches(const char* verb, const char* path){
-    bool accept = (strcmp(verb,"GET") == 0) && (strncmp(path, "/coffee",7) == 0);
-    if(accept) printf("TEAPOT!\n"); else  printf("Not a teapot\n");
-    return accept;
+void Teapot::addRoutes(Router& router){
+    router.exact("GET", "/coffee", this);
 }
 
 void Teapot::process( HttpRequest& request, HttpResponse& response){
     response.setStatus(418,"I'm a teapot");
-    response.addHeader("Server", "PicoW");
+    response.addStandardHeaders(HttpResponse::SERVER);
     response.addHeader("Content-Type", "text/html");
     response.setBody(teapot);
 }
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "trace.hpp"
+#include "pico/printf.h"
+
+TraceRing traceRings[2];
+
+static const char* const eventNames[TRACE_EVENT_COUNT] = {
+    "none",
+    "accept-failed",
+    "connected",
+    "closed",
+    "connection-error",
+    "received",
+    "request",
+    "parse-failed",
+    "response",
+    "sent",
+    "send-stalled",
+    "send-failed",
+    "no-memory",
+    "pipeline-overflow",
+    "async-busy",
+    "idle-close",
+    "tcp-write",
+    "tcp-receive",
+    "tcp-sent",
+    "close-failed",
+    "connection-waiting",
+    "connection-admitted",
+    "connection-refused",
+    "connection-evicted",
+    "send-queued",
+    "udp-send-failed",
+};
+
+/// @brief Creates a reader that starts with whatever is in the rings now.
+TraceReader::TraceReader()
+: lostCount(0)
+{
+    for(int c=0; c<2; ++c){
+        uint32_t head = traceRings[c].head;
+        tail[c] = (head > TRACE_RING_SIZE - 1) ? head - (TRACE_RING_SIZE - 1) : 0;
+        end[c] = tail[c];
+    }
+}
+
+/// @brief Lets the reader go as far as the records written so far.
+void TraceReader::mark(){
+    for(int c=0; c<2; ++c){
+        end[c] = traceRings[c].head;
+    }
+}
+
+/// @brief Copies the next record from a ring without moving on.
+/// @return false if there isn't one before the mark.
+bool TraceReader::peek(int core, TraceRecord& record){
+    const TraceRing& ring = traceRings[core];
+    while(tail[core] != end[core]){
+        // The writer may be overwriting the oldest slot so only the
+        // TRACE_RING_SIZE - 1 records before head are safe to read.
+        uint32_t head = ring.head;
+        if(head - tail[core] > TRACE_RING_SIZE - 1){
+            uint32_t oldest = head - (TRACE_RING_SIZE - 1);
+            if((int32_t)(end[core] - oldest) < 0) oldest = end[core];
+            lostCount += oldest - tail[core];
+            tail[core] = oldest;
+            continue;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        memcpy(&record, &ring.records[tail[core] & (TRACE_RING_SIZE - 1)], sizeof(record));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        // Still intact once copied?
+        if(ring.head - tail[core] <= TRACE_RING_SIZE - 1) return true;
+    }
+    return false;
+}
+
+/// @brief Gets the oldest unread record from either core.
+/// @param record is set to the record.
+/// @param core is set to the core that wrote it.
+/// @return false if there are no more up to the mark.
+bool TraceReader::next(TraceRecord& record, int& core){
+    TraceRecord r[2];
+    bool have0 = peek(0, r[0]);
+    bool have1 = peek(1, r[1]);
+    if(!have0 && !have1) return false;
+    core = (have0 && (!have1 || (int32_t)(r[0].time - r[1].time) <= 0)) ? 0 : 1;
+    record = r[core];
+    ++tail[core];
+    return true;
+}
+
+/// @brief Decodes a record as a line of text e.g.
+///   "   12.345678 0 received 3 512\n"
+/// @param record is the record.
+/// @param core is the core that wrote it.
+/// @param text is where to put the text.
+/// @param size is the size of text.
+/// @return the length of the text.
+size_t TraceReader::format(const TraceRecord& record, int core, char* text, size_t size){
+    int written;
+    if(record.event < TRACE_EVENT_COUNT){
+        written = snprintf(text, size, "%5lu.%06lu %d %s %lu %lu\n",
+            (unsigned long)(record.time / 1000000), (unsigned long)(record.time % 1000000), core,
+            eventNames[record.event], (unsigned long)record.a, (unsigned long)record.b);
+    } else {
+        written = snprintf(text, size, "%5lu.%06lu %d event%lu %lu %lu\n",
+            (unsigned long)(record.time / 1000000), (unsigned long)(record.time % 1000000), core,
+            (unsigned long)record.event, (unsigned long)record.a, (unsigned long)record.b);
+    }
+    if(written < 0) return 0;
+    return ((size_t)written < size) ? written : size - 1;
+}
+
+/// @brief Prints the records written since the last drain.  Call when
+/// there's nothing more pressing to do e.g. from the network loop.
+/// @param reader keeps track of what has been printed.
+void traceDrain(TraceReader& reader){
+    char text[64];
+    TraceRecord record;
+    int core;
+    uint32_t lost = reader.lost();
+    reader.mark();
+    while(reader.next(record, core)){
+        TraceReader::format(record, core, text, sizeof(text));
+        printf("%s", text);
+    }
+    if(reader.lost() != lost){
+        printf("trace: %lu records lost\n", (unsigned long)(reader.lost() - lost));
+    }
+}
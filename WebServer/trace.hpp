@@ -0,0 +1,132 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "pico/stdlib.h"
+
+// Tracing levels.  Records at or below TRACE_LEVEL are compiled in, the rest
+// compile to nothing (their arguments aren't evaluated).
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_ERROR 1     // failures e.g. out of memory, send failed.
+#define TRACE_LEVEL_INFO 2      // one or two records per connection or request.
+#define TRACE_LEVEL_DEBUG 3     // every receive, send and acknowledgement.
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+// Records kept per core.  Must be a power of 2; older records are overwritten.
+#ifndef TRACE_RING_SIZE
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+#define TRACE_RING_SIZE 128
+#else
+#define TRACE_RING_SIZE 2   // nothing is written.
+#endif
+#endif
+
+// What a record is about.  The meaning of the two arguments is given for each;
+// "slot" is the connection's index in the Webserver, "client" its index in
+// the TcpServer.  Apps can use ids from
+// TRACE_USER up, which are shown by number.
+enum TraceEvent : uint32_t {
+    TRACE_NONE,
+    TRACE_ACCEPT_FAILED,    // err, 0
+    TRACE_CONNECTED,        // slot, 0
+    TRACE_CLOSED,           // slot, 0
+    TRACE_CONNECTION_ERROR, // slot, err
+    TRACE_RECEIVED,         // slot, bytes
+    TRACE_REQUEST,          // slot, route index
+    TRACE_PARSE_FAILED,     // slot, status sent
+    TRACE_RESPONSE,         // slot, status
+    TRACE_SENT,             // slot, bytes acknowledged
+    TRACE_SEND_STALLED,     // slot, bytes that didn't fit
+    TRACE_SEND_FAILED,      // slot, err
+    TRACE_NO_MEMORY,        // slot, 0 for a request or 1 for a response
+    TRACE_PIPELINE_OVERFLOW,// slot, bytes dropped
+    TRACE_ASYNC_BUSY,       // slot, 0
+    TRACE_IDLE_CLOSE,       // slot, 1 if part way through a request
+    TRACE_TCP_WRITE,        // bytes, err
+    TRACE_TCP_RECEIVE,      // bytes, err
+    TRACE_TCP_SENT,         // bytes, 0
+    TRACE_CLOSE_FAILED,     // err, 0
+    TRACE_CONNECTION_WAITING,   // backlog index, 0
+    TRACE_CONNECTION_ADMITTED,  // client index, 0
+    TRACE_CONNECTION_REFUSED,   // backlog size, 0
+    TRACE_CONNECTION_EVICTED,   // client index, ms idle
+    TRACE_SEND_QUEUED,      // bytes, bytes now queued
+    TRACE_UDP_SEND_FAILED,  // err, bytes
+    TRACE_EVENT_COUNT,
+    TRACE_USER = 64
+};
+
+struct TraceRecord {
+    uint32_t time;  // time_us_32()
+    uint32_t event;
+    uint32_t a;
+    uint32_t b;
+};
+
+// Each core writes only to its own ring so writing needs no lock: the record
+// is filled in and then head moves on.  Not for use from interrupt handlers.
+struct TraceRing {
+    volatile uint32_t head;  // records written, ever.
+    TraceRecord records[TRACE_RING_SIZE];
+};
+
+extern TraceRing traceRings[2];
+
+/// @brief Adds a record to the calling core's ring.  Use the TRACE_ macros
+/// rather than calling this so the record can be compiled out.
+static inline void traceRecord(uint32_t event, uint32_t a, uint32_t b){
+    TraceRing& ring = traceRings[get_core_num()];
+    uint32_t head = ring.head;
+    TraceRecord& r = ring.records[head & (TRACE_RING_SIZE - 1)];
+    r.time = time_us_32();
+    r.event = event;
+    r.a = a;
+    r.b = b;
+    __atomic_thread_fence(__ATOMIC_RELEASE);   // record before head, for the other core.
+    ring.head = head + 1;
+}
+
+#if TRACE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_ERROR(event, a, b) traceRecord((event), (uint32_t)(a), (uint32_t)(b))
+#else
+#define TRACE_ERROR(event, a, b) ((void)0)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_INFO(event, a, b) traceRecord((event), (uint32_t)(a), (uint32_t)(b))
+#else
+#define TRACE_INFO(event, a, b) ((void)0)
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(event, a, b) traceRecord((event), (uint32_t)(a), (uint32_t)(b))
+#else
+#define TRACE_DEBUG(event, a, b) ((void)0)
+#endif
+
+// Reads records from both rings in time order without disturbing them, so
+// several readers can each see everything.  A reader only goes as far as the
+// heads were at the last mark() so it finishes even while records are still
+// being added (e.g. by sending what it reads).  Records overwritten before
+// they were read are counted as lost.
+class TraceReader {
+    uint32_t tail[2];   // next record to read from each ring.
+    uint32_t end[2];    // heads at mark().
+    uint32_t lostCount;
+
+    bool peek(int core, TraceRecord& record);
+
+    public:
+    TraceReader();
+    void mark();
+    bool next(TraceRecord& record, int& core);
+    uint32_t lost() const { return lostCount;}
+
+    static size_t format(const TraceRecord& record, int core, char* text, size_t size);
+};
+
+void traceDrain(TraceReader& reader);
+
+#endif
@@ -0,0 +1,63 @@
+#include <string.h>
+#include "trace_webapp.hpp"
+
+// Longest decoded record.
+#define TRACE_LINE_MAX 64
+
+// Decodes records a line at a time as there is room to send them.  Stops at
+// the records there were when the request arrived, so the records made by
+// sending this response are left for next time.
+class TraceProducer: public BodyProducer {
+    TraceReader& reader;
+    char line[TRACE_LINE_MAX];
+    size_t lineLength;
+    size_t lineSent;
+
+    public:
+    TraceProducer(TraceReader& reader)
+    : reader(reader), lineLength(0), lineSent(0) {
+        reader.mark();
+    }
+
+    virtual size_t produce(uint8_t* buffer, size_t max){
+        size_t n = 0;
+        while(n < max){
+            if(lineSent == lineLength){
+                TraceRecord record;
+                int core;
+                if(!reader.next(record, core)) break;
+                lineLength = TraceReader::format(record, core, line, sizeof(line));
+                lineSent = 0;
+            }
+            size_t len = lineLength - lineSent;
+            if(len > max - n) len = max - n;
+            memcpy(buffer + n, line + lineSent, len);
+            lineSent += len;
+            n += len;
+        }
+        return n;
+    }
+};
+
+/// @brief Creates the webapp.
+/// @param path is the URL to serve the trace on.
+TraceWebapp::TraceWebapp(const char* path)
+: path(path)
+{}
+
+void TraceWebapp::addRoutes(Router& router){
+    router.exact("GET", path, this);
+}
+
+void TraceWebapp::process(HttpRequest& request, HttpResponse& response){
+    TraceProducer* producer = new(response.getBlock()) TraceProducer(reader);
+    if(!producer){
+        response.setStatus(503, "Service Unavailable");
+        return;
+    }
+    response.setStatus(200, "OK");
+    response.addStandardHeaders(HttpResponse::SERVER);
+    response.addHeader("Content-Type", "text/plain");
+    response.addHeader("Cache-Control", "no-store");
+    response.setBody(producer);
+}
@@ -0,0 +1,28 @@
+#ifndef TRACE_WEBAPP_HPP
+#define TRACE_WEBAPP_HPP
+
+#include "webserver.hpp"
+#include "trace.hpp"
+
+// Serves the trace records written since the last request as text, one per
+// line, oldest first e.g.
+//
+//   curl http://picow/trace
+//      12.345678 0 connected 2 3
+//      12.345901 0 request 2 5
+//      12.346120 0 response 2 200
+//
+// Each line is the time in seconds, the core, the event and its two
+// arguments (see TraceEvent).  The records are decoded as they are sent.
+class TraceWebapp: public WebApp {
+    TraceReader reader;
+    const char* path;
+
+    public:
+    TraceWebapp(const char* path = "/trace");
+
+    virtual void addRoutes(Router& router);
+    virtual void process(HttpRequest& request, HttpResponse& response);
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include <string.h>
+#include "udp_publisher.hpp"
+#include "trace.hpp"
+
+/// @brief Creates a publisher.  Call open() once the network is up.
+/// @param intervalMs is how often due() says it's time for a frame.
+UdpPublisher::UdpPublisher(uint32_t intervalMs)
+: pcb(0)
+, port(0)
+, intervalMs(intervalMs)
+, next(nil_time)
+, sequence(0)
+, failures(0)
+{}
+
+UdpPublisher::~UdpPublisher(){
+    close();
+}
+
+/// @brief Gets ready to send.
+/// @param address is where frames go, a multicast group or a single host.
+/// @param port is the UDP port listeners use.
+/// @param ttl is how many routers multicast frames may cross, 1 for the LAN.
+/// @return false if the address isn't valid or there's no pcb for it.
+bool UdpPublisher::open(const char* address, uint16_t port, uint8_t ttl){
+    close();
+    if(!ipaddr_aton(address, &group)) return false;
+    pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if(!pcb) return false;
+#if LWIP_MULTICAST_TX_OPTIONS
+    udp_set_multicast_ttl(pcb, ttl);
+#endif
+    this->port = port;
+    next = get_absolute_time();
+    return true;
+}
+
+void UdpPublisher::close(){
+    if(pcb){
+        udp_remove(pcb);
+        pcb = 0;
+    }
+}
+
+/// @brief Says whether it's time for the next frame, once per interval.  If
+/// the caller falls behind, frames are skipped rather than sent in a burst.
+bool UdpPublisher::due(){
+    if(!pcb || !time_reached(next)) return false;
+    next = delayed_by_ms(next, intervalMs);
+    if(time_reached(next)){
+        next = make_timeout_time_ms(intervalMs);
+    }
+    return true;
+}
+
+/// @brief Stamps a frame with the next sequence number and the time and sends it.
+/// The sequence moves on even if sending fails so listeners see the gap.
+/// @param frame is the frame to send.
+/// @return ERR_OK or lwIP's error.
+err_t UdpPublisher::publish(SensorFrame& frame){
+    if(!pcb) return ERR_CONN;
+    frame.stamp(sequence++, time_us_64());
+
+    err_t err = ERR_MEM;
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, frame.size(), PBUF_RAM);
+    if(p){
+        memcpy(p->payload, frame.bytes(), frame.size());
+        err = udp_sendto(pcb, p, &group, port);
+        pbuf_free(p);
+    }
+    if(err != ERR_OK){
+        ++failures;
+        TRACE_ERROR(TRACE_UDP_SEND_FAILED, err, frame.size());
+    }
+    return err;
+}
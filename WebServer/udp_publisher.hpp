@@ -0,0 +1,53 @@
+#ifndef UDP_PUBLISHER_HPP
+#define UDP_PUBLISHER_HPP
+
+#include "pico/stdlib.h"
+#include "lwip/udp.h"
+#include "sensor_frame.hpp"
+
+// Default time between frames.
+#ifndef SENSOR_INTERVAL_MS
+#define SENSOR_INTERVAL_MS 1000
+#endif
+
+// Sends SensorFrames by UDP, normally to a multicast group, so any number of
+// listeners can follow the readings without each holding a connection, e.g.
+//
+//   UdpPublisher sensors;
+//   sensors.open();
+//   ...
+//   if(sensors.due()){
+//       SensorFrame frame(SENSOR_SOURCE_WEATHER);
+//       frame.add(1, pressure).add(2, humidity);
+//       sensors.publish(frame);
+//   }
+//
+// Uses lwIP so call from the network core.  WebServer/posix/sensor_listen.cpp
+// receives and prints the frames on Linux.
+class UdpPublisher {
+    struct udp_pcb* pcb;
+    ip_addr_t group;
+    uint16_t port;
+    uint32_t intervalMs;
+    absolute_time_t next;
+    uint32_t sequence;      // frames published.
+    uint32_t failures;      // frames lwIP couldn't send.
+
+    public:
+    UdpPublisher(uint32_t intervalMs = SENSOR_INTERVAL_MS);
+    ~UdpPublisher();
+
+    bool open(const char* address = SENSOR_GROUP, uint16_t port = SENSOR_PORT, uint8_t ttl = 1);
+    void close();
+    bool isOpen() const { return pcb != 0;}
+
+    void setInterval(uint32_t ms) { intervalMs = ms;}
+    bool due();
+    absolute_time_t nextDue() const { return pcb ? next : at_the_end_of_time;}
+    err_t publish(SensorFrame& frame);
+
+    uint32_t published() const { return sequence;}
+    uint32_t failed() const { return failures;}
+};
+
+#endif
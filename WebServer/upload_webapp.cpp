@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+#include "upload_webapp.hpp"
+#include "crc32.hpp"
+#include "pico/printf.h"
+
+// Collects an upload into a sector sized buffer and writes each sector to
+// the store as it fills.
+class UploadConsumer: public BodyConsumer {
+    FlashStore& store;
+    uint8_t* sector;    // FLASH_SECTOR_SIZE, from the request's block.
+    size_t fill;        // bytes in sector.
+    uint32_t offset;    // of sector in the image.
+    bool writing;       // store.startWrite() succeeded and not yet finished.
+
+    public:
+    Crc32 crc;
+    int status;         // HTTP status if the upload has failed, else 0.
+    const char* message;
+
+    UploadConsumer(FlashStore& store)
+    : store(store), sector(0), fill(0), offset(0), writing(false), status(0), message(0) {}
+
+    bool start(size_t length, uint8_t* buffer);
+    void fail(int code, const char* text);
+    bool flush();
+    bool finish(size_t length, const char* contentType);
+    virtual bool consume(const uint8_t* data, size_t length);
+    virtual void finished();
+};
+
+/// @brief Checks an upload can go ahead.
+/// @param length is the Content-Length.
+/// @param buffer is the sector buffer or 0 if there was no memory for it.
+/// @return true if it can, else status and message are set.
+bool UploadConsumer::start(size_t length, uint8_t* buffer){
+    if(!buffer){
+        fail(503, "No memory for upload\r\n");
+    } else if(length > FlashStore::capacity()){
+        fail(413, "Upload too large\r\n");
+    } else if(!store.startWrite()){
+        fail(409, "Another upload is in progress or the previous image is still being read\r\n");
+    } else {
+        sector = buffer;
+        writing = true;
+    }
+    return writing;
+}
+
+void UploadConsumer::fail(int code, const char* text){
+    status = code;
+    message = text;
+    if(writing){
+        store.cancelWrite();
+        writing = false;
+    }
+}
+
+bool UploadConsumer::consume(const uint8_t* data, size_t length){
+    if(!writing) return false;
+    crc.update(data, length);
+    while(length){
+        size_t n = FLASH_SECTOR_SIZE - fill;
+        if(n > length) n = length;
+        memcpy(sector + fill, data, n);
+        fill += n;
+        data += n;
+        length -= n;
+        if(fill == FLASH_SECTOR_SIZE && !flush()) return false;
+    }
+    return true;
+}
+
+/// @brief Writes what's in the sector buffer, padded out with erased bytes.
+bool UploadConsumer::flush(){
+    if(fill == 0) return true;
+    memset(sector + fill, 0xFF, FLASH_SECTOR_SIZE - fill);
+    if(!store.writeSector(offset, sector)){
+        fail(500, "Flash write failed\r\n");
+        return false;
+    }
+    offset += FLASH_SECTOR_SIZE;
+    fill = 0;
+    return true;
+}
+
+/// @brief Writes the last of the image and makes it current.
+bool UploadConsumer::finish(size_t length, const char* contentType){
+    if(!writing || !flush()) return false;
+    writing = false;
+    if(!store.finishWrite(length, crc.value(), contentType)){
+        status = 500;
+        message = "Flash image failed verification\r\n";
+        return false;
+    }
+    return true;
+}
+
+/// @brief The request has gone, possibly part way through the upload.
+void UploadConsumer::finished(){
+    if(writing){
+        store.cancelWrite();
+        writing = false;
+    }
+}
+
+// Sends the image from flash.  It's copied as it goes rather than handed to
+// lwIP so nothing refers to the slot once the response is done with.
+class FlashImageProducer: public BodyProducer {
+    FlashStore& store;
+    int slot;
+    const uint8_t* data;
+    size_t length;
+    size_t sent;
+
+    public:
+    FlashImageProducer(FlashStore& store, int slot)
+    : store(store), slot(slot), data(store.data()), length(store.length()), sent(0) {}
+
+    virtual int contentLength() { return length;}
+    virtual size_t produce(uint8_t* buffer, size_t max){
+        size_t n = length - sent;
+        if(n > max) n = max;
+        memcpy(buffer, data + sent, n);
+        sent += n;
+        return n;
+    }
+    virtual void finished() {
+        store.endRead(slot);
+        slot = -1;
+    }
+};
+
+/// @brief Creates the webapp.
+/// @param store is where the image is kept.
+/// @param path is the URL to upload to and download from e.g. "/asset".
+UploadWebapp::UploadWebapp(FlashStore& store, const char* path)
+: store(store)
+, path(path)
+{}
+
+void UploadWebapp::addRoutes(Router& router){
+    router.exact("GET", path, this, DOWNLOAD);
+    router.exact("PUT", path, this, UPLOAD);
+    router.exact("POST", path, this, UPLOAD);
+}
+
+/// @brief Takes an upload straight to flash rather than into memory.
+BodyConsumer* UploadWebapp::receiveBody(HttpRequest& request){
+    if(request.route() != UPLOAD) return 0;
+    Block* block = request.getBlock();
+    UploadConsumer* consumer = new(block) UploadConsumer(store);
+    if(consumer){
+        consumer->start(request.expectedBodyLength(), (uint8_t*)block->allocate(FLASH_SECTOR_SIZE));
+    }
+    return consumer;
+}
+
+void UploadWebapp::process(HttpRequest& request, HttpResponse& response){
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
+    if(request.route() == UPLOAD){
+        upload(request, response);
+    } else {
+        download(request, response);
+    }
+}
+
+void UploadWebapp::upload(HttpRequest& request, HttpResponse& response){
+    response.addHeader("Content-Type", "text/plain");
+
+    UploadConsumer* consumer = static_cast<UploadConsumer*>(request.bodyConsumer());
+    if(!consumer){
+        response.setStatus(400, "Bad Request");
+        response.setBody("No image sent\r\n");
+        return;
+    }
+
+    // Check what arrived is what was sent before switching to it.
+    const char* expected = request.header("X-CRC32");
+    if(consumer->status == 0 && expected && strtoul(expected, 0, 16) != consumer->crc.value()){
+        consumer->fail(422, "CRC mismatch, image discarded\r\n");
+    }
+    if(consumer->status == 0){
+        const char* contentType = request.header("Content-Type");
+        consumer->finish(request.bodyLength(), contentType);
+    }
+    if(consumer->status != 0){
+        printf("Upload failed: %s", consumer->message);
+        response.setStatus(consumer->status, "Upload Failed");
+        response.setBody(consumer->message);
+        return;
+    }
+
+    char* body = (char*)response.getBlock()->allocate(80);
+    if(body){
+        snprintf(body, 80, "{\"length\":%u,\"crc32\":\"%08lx\",\"sequence\":%lu}\r\n",
+            (unsigned)store.length(), (unsigned long)store.crc(), (unsigned long)store.sequence());
+    }
+    response.setStatus(201, "Created");
+    response.addHeader("Content-Type", "application/json");
+    response.setBody(body);
+}
+
+void UploadWebapp::download(HttpRequest& request, HttpResponse& response){
+    if(!store.hasImage()){
+        response.setStatus(404, "Not Found");
+        return;
+    }
+
+    char* etag = (char*)response.getBlock()->allocate(12);
+    if(etag){
+        snprintf(etag, 12, "\"%08lx\"", (unsigned long)store.crc());
+        response.addHeader("ETag", etag);
+        response.addHeader("Cache-Control", "no-cache"); // revalidate with ETag
+        const char* match = request.header("If-None-Match");
+        if(match && (strstr(match, etag) || strcmp(match, "*") == 0)){
+            response.setStatus(304, "Not Modified");
+            return;
+        }
+    }
+
+    int slot = store.startRead();
+    FlashImageProducer* producer = new(response.getBlock()) FlashImageProducer(store, slot);
+    if(!producer){
+        store.endRead(slot);
+        response.setStatus(503, "Service Unavailable");
+        return;
+    }
+    response.setStatus(200, "OK");
+    response.addHeader("Content-Type", store.contentType());
+    response.setBody(producer);
+}
@@ -0,0 +1,36 @@
+#ifndef UPLOAD_WEBAPP_HPP
+#define UPLOAD_WEBAPP_HPP
+
+#include "webserver.hpp"
+#include "flash_store.hpp"
+
+// Replaces the image in a FlashStore over the network and serves the current
+// image.  The upload is streamed to flash a sector at a time as it arrives so
+// it can be far bigger than any block; its CRC is worked out on the way and
+// checked against X-CRC32 if the client sends one, e.g.
+//
+//   curl -T dashboard.html -H "Content-Type: text/html" \
+//        -H "X-CRC32: $(crc32 dashboard.html)" http://picow/asset
+//
+// PUT and POST both upload; GET returns the image with its content type.
+class UploadWebapp: public WebApp {
+    enum Route {
+        DOWNLOAD,
+        UPLOAD
+    };
+
+    FlashStore& store;
+    const char* path;
+
+    void upload(HttpRequest& request, HttpResponse& response);
+    void download(HttpRequest& request, HttpResponse& response);
+
+    public:
+    UploadWebapp(FlashStore& store, const char* path);
+
+    virtual void addRoutes(Router& router);
+    virtual BodyConsumer* receiveBody(HttpRequest& request);
+    virtual void process(HttpRequest& request, HttpResponse& response);
+};
+
+#endif
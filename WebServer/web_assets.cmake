@@ -0,0 +1,122 @@
+# Build step to embed web pages etc. in flash as gzip compressed assets for
+# StaticAssetWebapp (see static_asset.hpp).
+#
+# In a project's CMakeLists.txt:
+#
+#   include(../WebServer/web_assets.cmake)
+#   web_assets(<target> <url> <file> [<url> <file> ...])
+#
+# e.g. web_assets(neopixel /form.html ${CMAKE_CURRENT_LIST_DIR}/form.html)
+#
+# This generates <target>_web_assets.cpp in the build directory, defining
+# webAssets[] and webAssetCount, and adds it to the target.  Each target gets
+# its own file so several in one directory don't overwrite each other's.  It is regenerated whenever
+# one of the files changes.  The ETag for each asset is taken from the SHA1
+# of the uncompressed file so it only changes when the content does.
+#
+# The same file is run as a script (cmake -P) to do the generation.
+
+if(NOT CMAKE_SCRIPT_MODE_FILE)
+
+set(WEB_ASSETS_SCRIPT ${CMAKE_CURRENT_LIST_FILE})
+
+function(web_assets target)
+    set(output ${CMAKE_CURRENT_BINARY_DIR}/${target}_web_assets.cpp)
+    set(files)
+    set(assets)
+    set(args ${ARGN})
+    list(LENGTH args count)
+    math(EXPR last "${count} - 1")
+    foreach(i RANGE 0 ${last} 2)
+        math(EXPR j "${i} + 1")
+        list(GET args ${i} url)
+        list(GET args ${j} file)
+        get_filename_component(file ${file} ABSOLUTE)
+        list(APPEND files ${file})
+        list(APPEND assets "${url}|${file}")
+    endforeach()
+    string(REPLACE ";" "|" assets "${assets}")
+
+    add_custom_command(OUTPUT ${output}
+        COMMAND ${CMAKE_COMMAND} "-DOUTPUT=${output}" "-DASSETS=${assets}" -P ${WEB_ASSETS_SCRIPT}
+        DEPENDS ${files} ${WEB_ASSETS_SCRIPT}
+        COMMENT "Compressing web assets for ${target}"
+        VERBATIM)
+    target_sources(${target} PRIVATE ${output})
+endfunction()
+
+else()
+
+# Script mode: -DOUTPUT=<file.cpp> -DASSETS=<url>|<file>|<url>|<file>...
+cmake_minimum_required(VERSION 3.18)    # for file(ARCHIVE_CREATE)
+
+string(REPLACE "|" ";" ASSETS "${ASSETS}")
+list(LENGTH ASSETS count)
+math(EXPR last "${count} - 1")
+get_filename_component(workDir ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${workDir})
+
+set(data "")
+set(table "")
+set(index 0)
+foreach(i RANGE 0 ${last} 2)
+    math(EXPR j "${i} + 1")
+    list(GET ASSETS ${i} url)
+    list(GET ASSETS ${j} file)
+
+    get_filename_component(ext ${file} LAST_EXT)
+    string(TOLOWER "${ext}" ext)
+    if(ext STREQUAL ".html" OR ext STREQUAL ".htm")
+        set(mime "text/html")
+    elseif(ext STREQUAL ".css")
+        set(mime "text/css")
+    elseif(ext STREQUAL ".js")
+        set(mime "application/javascript")
+    elseif(ext STREQUAL ".json")
+        set(mime "application/json")
+    elseif(ext STREQUAL ".svg")
+        set(mime "image/svg+xml")
+    elseif(ext STREQUAL ".png")
+        set(mime "image/png")
+    elseif(ext STREQUAL ".ico")
+        set(mime "image/x-icon")
+    else()
+        set(mime "text/plain")
+    endif()
+
+    file(SHA1 ${file} hash)
+    string(SUBSTRING ${hash} 0 16 etag)
+
+    set(gz ${OUTPUT}.${index}.gz)
+    file(ARCHIVE_CREATE OUTPUT ${gz} PATHS ${file} FORMAT raw COMPRESSION GZip)
+    file(READ ${gz} hex HEX)
+    file(REMOVE ${gz})
+
+    # Zero the gzip timestamp so the output only depends on the content.
+    string(SUBSTRING ${hex} 0 8 head)
+    string(SUBSTRING ${hex} 16 -1 tail)
+    set(hex "${head}00000000${tail}")
+
+    string(LENGTH ${hex} hexLength)
+    math(EXPR length "${hexLength} / 2")
+    # 16 bytes to a line.
+    set(bytes "")
+    foreach(pos RANGE 0 ${hexLength} 32)
+        string(SUBSTRING ${hex} ${pos} 32 line)
+        if(line)
+            string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," line ${line})
+            string(APPEND bytes "    ${line}\n")
+        endif()
+    endforeach()
+
+    string(APPEND data "// ${url} from ${file}\nstatic const uint8_t asset${index}[${length}] = {\n${bytes}};\n\n")
+    string(APPEND table "    {\"${url}\", \"${mime}\", asset${index}, ${length}, \"\\\"${etag}\\\"\"},\n")
+    math(EXPR index "${index} + 1")
+endforeach()
+
+file(WRITE ${OUTPUT}.tmp
+"// Generated by web_assets.cmake - do not edit.\n\n#include \"static_asset.hpp\"\n\n${data}const StaticAsset webAssets[] = {\n${table}};\n\nconst int webAssetCount = ${index};\n")
+configure_file(${OUTPUT}.tmp ${OUTPUT} COPYONLY)
+file(REMOVE ${OUTPUT}.tmp)
+
+endif()
@@ -11,13 +11,14 @@ static const char* body =
 
 
 
-bool Webapp404::matches(const char* verb, const char* path){
-    return true;
+// The webserver falls back to this when nothing else matches so it has no
+// routes of its own.
+void Webapp404::addRoutes(Router& router){
 }
 
 void Webapp404::process( HttpRequest& request, HttpResponse& response){
     response.setStatus(404,"Not Found");
-    response.addHeader("Server", "PicoW");
+    response.addStandardHeaders(HttpResponse::SERVER);
     response.addHeader("Content-Type", "text/html");
     response.setBody(body);
 }
@@ -1,6 +1,9 @@
 
+#include <string.h>
+#include <strings.h>
 #include "webserver.hpp"
 #include "webapp404.hpp"
+#include "trace.hpp"
 
 
 static BlockPool blockPool;  // big lump of static memory to allocate from.
@@ -33,54 +36,53 @@ float Parameter::asFloat(){
 }
 
 ////////////////////////////////////////////////////////////////////
-// Header
-
-// Build up a string ready for transmission.
-const char* Header::toSend(Block* block){
-    int size = strlen(_name) + strlen(_value) + 5; // +5 for: CR LF : <sp> 0
-    char* buffer = (char*)block->allocate(size);
-    char* there = buffer;
-    const char* here = _name;
-    while(*here){
-        *there++ = *here++;
-    }
-    *there++ = ':';
-    *there++ = ' ';
-    here = _value;
-    while(*here){
-        *there++ = *here++;
-    }
-    *there++ = '\r';
-    *there++ = '\n';
-    *there = 0;
-    printf("Header toSend:%s\n",buffer);
-    return buffer;
-}
-
-////////////////////////////////////////////////////////////////////
-
-// Convert 2 hex digits into a character for URL decode
-static char decode(char msHex, char lsHex){
-    int val=0;
-    if(msHex >= 'a' && msHex <= 'f') val = (msHex - 'a' + 10) * 16;
-    else if(msHex >= 'A' && msHex <= 'F') val = (msHex - 'A' + 10) * 16;
-    else if(msHex >= '0' && msHex <= '9') val = (msHex - '0') * 16;
-    
-    if(lsHex >= 'a' && lsHex <= 'f') val += (lsHex - 'a' + 10);
-    else if(lsHex >= 'A' && lsHex <= 'F') val += (lsHex - 'A' + 10);
-    else if(lsHex >= '0' && lsHex <= '9') val += (lsHex - '0');
-
-    return (char)val;
+// HttpRequest
+
+// Canned responses for requests that can't be parsed. These are sent as-is
+// and the connection closed.
+static const char* badRequest =
+    "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+static const char* noMemory =
+    "HTTP/1.1 500 Internal Server Error\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+static const char* tooLarge =
+    "HTTP/1.1 413 Payload Too Large\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+static const char* headerTooLarge =
+    "HTTP/1.1 431 Request Header Fields Too Large\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+static const char* notImplemented =
+    "HTTP/1.1 501 Not Implemented\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+
+// Interim response for clients that wait to be asked for the body (Expect: 100-continue).
+static const char* continueResponse = "HTTP/1.1 100 Continue\r\n\r\n";
+
+// Convert a hex digit to its value for URL decode.
+static int hexValue(char c){
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if(c >= '0' && c <= '9') return c - '0';
+    return 0;
 }
 
 HttpRequest::HttpRequest(Block* block)
 : block(block)
-, _complete(false)
 , _verb(0) 
 , _path(0)
 , _protocol(0)
 , _body(0)
+, consumer(0)
+, discarding(false)
+, _bodyLength(0)
+, contentLength(0)
+, state(State::VERB)
+, hexDigits(0)
+, hexChar(0)
+, chunkStart(0)
+, tokenStart(0)
+, there(0)
+, chunkEnd(0)
+, pendingName(0)
 , parseMessage(0)
+, _route(0)
+, _params(0)
 {
 
 }    
@@ -88,212 +90,322 @@ HttpRequest::HttpRequest(Block* block)
 HttpRequest::~HttpRequest(){
 }
 
- 
-int HttpRequest::parseInitialLine(char*& here, char*& there, int length) {
- 
-   // First, the HTTP verb - GET, POST etc.    
-    this->_verb = there;
-    while(length > 0 && !isspace(*here)){
-        *there++ = *here++;
-        --length;
-    }
-    *there++ = 0;
-
-    // Skip spaces
-    while(length > 0 && isspace(*here)){
-        ++here; --length;
-    }
-
-    // Get path expression
-    this->_path = there;
-    char* query = 0;
-    while(!isspace(*here) && length){
-        if(*here == '%' && length > 2) { // URL encoded
-            ++here; // skip %
-            char msHex = *here++;
-            char lsHex = *here++;
-            length -= 3;
-            *there++ = decode(msHex, lsHex);
-        } else if (*here == '?'){ // start of query string.
-            ++here;         // skip '?'
-            --length;
-            query = here;
-            break;          // go into next loop to parse query string
-        } else { // Just normal char in 
-            *there++ = *here++;
-            --length;
-        }
+/// @brief Looks up a request header by name.
+/// @param name is the header name, matched without regard to case.
+/// @return the header value or 0 if not present.
+const char* HttpRequest::header(const char* name){
+    BlockListIter<Header> iter = _headers.iter();
+    Header* h;
+    while( (h = iter.next()) != 0){
+        if(strcasecmp(h->name(), name) == 0) return h->value();
     }
-    *there++ = 0;  // terminate path;
- 
-    if(query){
-        char* key = there;
-        char* value = 0;
-        while(!isspace(*here) && length){
-            if(*here == '%' && length > 2) { // URL encoded
-                ++here; // skip %
-                char msHex = *here++;
-                char lsHex = *here++;
-                length -= 3;
-                *there++ = decode(msHex, lsHex);
-            } else if (*here == '=' && length){  // start of value
-                ++here;
-                *there++ = 0;
-                --length;
-                value = there;
-            } else if (*here == '&' && length){  // start of another param.
-                ++here; // skip &
-                *there++ = 0;
-                --length;
-                Parameter* p = new(block) Parameter(key, value);
-                this->_Parameters.add(block, p);
-                key = there;    // start of new key
-                value = 0;
-            } else {
-                *there++ = *here++;
-                --length;
-            }
-        }
-        *there++ = 0; // terminate last value
-        // Process last key/value pair
-        Parameter* p = new(block) Parameter(key, value);
-        this->_Parameters.add(block, p);
-    }
-
-    // skip spaces
-    if(length > 0 && isspace(*here)){
-        ++here; --length;
-    }
-
-     // here should now point to HTTP/1.1
-    // Can optionally validate, get version etc.
-    // Copy until CRLF skipping any spaces.
-    this->_protocol = there;   
-    while(length){
-        if(*here == '\r') {
-            ++here; --length;
-        } else if(*here == '\n') {
-            ++here; --length;
-            break;
-        } else if(isspace(*here)){
-            ++here; --length;
-        } else {
-            *there++ = *here++;
-            --length;
-        }
+    return 0;
+}
+
+/// @brief Marks the parse as failed.
+/// @param message is the complete response to send back to the client.
+void HttpRequest::fail(const char* message){
+    parseMessage = message;
+    state = State::FAILED;
+}
+
+/// @brief Makes room when the current chunk of token storage is full.  If
+/// nothing else has been allocated from the block since the chunk was, the
+/// chunk is just extended.  Otherwise the partial token is moved to a fresh
+/// chunk; completed tokens stay where they are.
+/// @return true if there is now room, false if out of memory or the token
+/// can never fit.
+bool HttpRequest::grow(){
+    size_t len = there - tokenStart;
+    if(len + 1 >= BLOCK_SIZE) {
+        fail(headerTooLarge);
+        return false;
     }
-    *there++ = 0;
-    // Ok, so the first line should be parsed!
 
-    printf("verb: %s\n", _verb);
-    printf("path: %s\n", _path);
-    printf("protocol: %s\n", _protocol);
+    // Try doubling in place, then just a little more.
+    if(chunkStart){
+        size_t chunkSize = chunkEnd - chunkStart;
+        size_t step = (len > TOKEN_CHUNK) ? len : TOKEN_CHUNK;
+        if(block->extend(chunkStart, chunkSize, chunkSize + step) ||
+           block->extend(chunkStart, chunkSize, chunkSize + (step = TOKEN_CHUNK))){
+            chunkEnd += step;
+            return true;
+        }
+    }
 
-    return length;
+    // A long token has already outgrown its chunk at least once so leave it
+    // plenty of room to avoid moving it again.
+    size_t size = (len + ((len > TOKEN_CHUNK) ? len : TOKEN_CHUNK) + 3) & ~3;
+    if(size > BLOCK_SIZE) size = BLOCK_SIZE;
+    char* chunk = (char*)block->allocate(size);
+    if(chunk == 0){
+        fail(noMemory);
+        return false;
+    }
+    if(len) memcpy(chunk, tokenStart, len);
+    chunkStart = chunk;
+    tokenStart = chunk;
+    there = chunk + len;
+    chunkEnd = chunk + size;
+    return true;
 }
 
+/// @brief Appends a character to the token being built.
+/// @return false if the parse has failed.
+inline bool HttpRequest::append(char c){
+    if(there == chunkEnd && !grow()) return false;
+    *there++ = c;
+    return true;
+}
 
-/// @brief Parses a single header line of an HTTP request.
-/// e.g.:
-/// Accept-Encoding: gzip, deflate
-/// Accept-Language: en-GB,en-US;q=0.9,en;q=0.8
-/// @param here 
-/// @param there 
-/// @param length 
-/// @return 
-int HttpRequest::parseHeaderLine(char*& here, char*& there, int length){
+/// @brief Terminates the current token and starts the next one after it.
+/// @return the completed token or 0 if the parse has failed.
+char* HttpRequest::endToken(){
+    if(hexDigits){      // %xx escape cut short by the end of the token.
+        fail(badRequest);
+        return 0;
+    }
+    if(!append(0)) return 0;
+    char* token = tokenStart;
+    tokenStart = there;
+    return token;
+}
 
-    if(length == 0) return 0;
-    char*key = there;
-    char*val = 0;
-    while(length){
-        if(*here == ':'){
-            ++here; --length;    // skip :
-             break;
-        } else {
-            *there++ = *here++;
-            --length;
-        }
+/// @brief Appends a character of the path or query string, undoing any
+/// URL (%xx) encoding.  An escape may be split between receive calls but
+/// not between tokens, endToken() fails the request if one is incomplete.
+/// @return false if the parse has failed.
+bool HttpRequest::appendDecoded(char c){
+    if(hexDigits){
+        hexChar = (char)((hexChar << 4) | hexValue(c));
+        if(--hexDigits == 0) return append(hexChar);
+        return true;
     }
-    *there++ = 0;          // terminate key
-    
-    // Skip space(s)
-    while(length && isspace(*here)) {
-        ++here; --length;
+    if(c == '%'){
+        hexDigits = 2;
+        hexChar = 0;
+        return true;
     }
+    return append(c);
+}
 
-    // Copy value until CRLF
-    if(length){
-        val = there;
-        while(length && *here!='\r' && *here!='\n'){
-            *there++ = *here++;
-            --length;
-        }
-        *there++ = 0;
+/// @brief Adds a query parameter from the pending key and the current token.
+/// @param hasValue is true if there was an = so the current token is the value.
+/// @return false if the parse has failed.
+bool HttpRequest::addParameter(bool hasValue){
+    const char* value = "";
+    if(hasValue){
+        value = endToken();
+    } else {
+        pendingName = endToken();
+    }
+    if(!pendingName || !value) return false;
+    Parameter* p = new(block) Parameter(pendingName, value);
+    if(!p) {
+        fail(noMemory);
+        return false;
     }
+    _Parameters.add(block, p);
+    pendingName = 0;
+    return true;
+}
 
-    if(key && val) {
-        Header* header = new(block) Header(key, val);
-        this->_headers.add(block, header);
+/// @brief Adds a header from the pending name and the current token, picking
+/// out the ones that affect parsing.
+/// @return false if the parse has failed.
+bool HttpRequest::addHeader(){
+    // Drop any trailing white space from the value.
+    while(there > tokenStart && (there[-1] == ' ' || there[-1] == '\t')) --there;
+    char* value = endToken();
+    if(!value) return false;
+
+    Header* header = new(block) Header(pendingName, value);
+    if(!header) {
+        fail(noMemory);
+        return false;
     }
-    // Skip over trailing CRLF
-    while(length && (*here == '\r' || *here == '\n')){
-        ++here; --length;
+    _headers.add(block, header);
+
+    if(strcasecmp(pendingName, "Content-Length") == 0){
+        contentLength = strtoul(value, 0, 10);
+    } else if(strcasecmp(pendingName, "Transfer-Encoding") == 0 && strcasecmp(value, "identity") != 0){
+        fail(notImplemented);  // chunked request bodies not supported.
+        return false;
     }
+    pendingName = 0;
+    return true;
+}
 
-    return length;
+/// @brief Called at the blank line after the headers.  Sets up to receive
+/// a body if there is one.
+void HttpRequest::headersComplete(){
+    if(contentLength == 0){
+        state = State::COMPLETE;
+        return;
+    }
+    next(State::HEADERS_DONE);
 }
 
-/// @brief Parses the body of the HTTP request.
-/// @param here 
-/// @param there 
-/// @param length 
-/// @return 
-int HttpRequest::parseBody(char*& here, char*& there, int length){
-    if(length){
-        _body = there;
-        while(length) {
-            *there++ = *here++;
-            --length;
-        }
-        *there = 0;
+/// @brief Says where the body goes once the headers are in.
+/// @param consumer takes the body as it arrives, or 0 to collect the body in
+/// the request's block.
+void HttpRequest::receiveBody(BodyConsumer* consumer){
+    assert(state == State::HEADERS_DONE);
+    _bodyLength = 0;
+    if(consumer){
+        this->consumer = consumer;
+        state = State::BODY;
+        return;
+    }
+    if(contentLength >= BLOCK_SIZE){
+        fail(tooLarge);
+        return;
+    }
+    _body = (char*)block->allocate(contentLength + 1);
+    if(_body == 0){
+        fail(noMemory);
+        return;
     }
-    return length;
+    state = State::BODY;
 }
 
+// Parses as much of a request as is available.  Data may arrive split at any
+// point across any number of calls (one per pbuf); the parser state carries
+// over between them.  Only the tokens (verb, path, parameters, headers) are
+// stored - as NUL terminated strings in block memory - so the raw request
+// is never copied as a whole.
 // GET /set?brt=43&rgb=%23ff38d4 HTTP/1.1
 // GET /wonky%20donkey HTTP/1.1
-void HttpRequest::parse(void* data, uint16_t length){
-
-    // Total size of strings from request (including nulls)
-    // will always be less or equal to the size of the request.
-    // Each string has a delimiter in the request and some may
-    // shrink due to URL encoding.
-    char* there = (char*)block->allocate(length);
-    if(there == 0){
-        parseMessage = "HTTP/1.1 500 Internal Server Error\r\n";
-        return;
-    }
+/// @param data is the next piece of the request.
+/// @param length is the number of bytes in data.
+/// @return the number of bytes used.  Less than length if the request
+/// completed (or failed) before the end of the data.
+size_t HttpRequest::parse(const void* data, size_t length){
+    const char* here = (const char*)data;
+    const char* end = here + length;
+
+    while(here < end && state != State::COMPLETE && state != State::FAILED && state != State::HEADERS_DONE){
+
+        // Body is copied (or passed on) in bulk rather than per character.
+        if(state == State::BODY){
+            size_t count = contentLength - _bodyLength;
+            if(count > (size_t)(end - here)) count = end - here;
+            if(consumer){
+                if(!discarding && !consumer->consume((const uint8_t*)here, count)) discarding = true;
+            } else {
+                memcpy(_body + _bodyLength, here, count);
+            }
+            _bodyLength += count;
+            here += count;
+            if(_bodyLength == contentLength){
+                if(_body) _body[_bodyLength] = 0;
+                state = State::COMPLETE;
+            }
+            continue;
+        }
+
+        char c = *here++;
+        switch(state){
 
-    // Now copy data from here to there, adding delimiters as
-    // necessary and noting where the fields are.
-    char* here = (char*)data;
+            case State::VERB:
+            if(c == ' '){
+                if(there == tokenStart) { fail(badRequest); break;}
+                _verb = endToken();
+                next(State::PATH);
+            } else if(c == '\r' || c == '\n'){
+                if(there != tokenStart) fail(badRequest); // else blank line before request, ignore
+            } else {
+                append(c);
+            }
+            break;
 
-    length = parseInitialLine(here, there, length);
+            case State::PATH:
+            if(c == ' ' || c == '?'){
+                if(there == tokenStart && c == ' ') break; // extra spaces
+                _path = endToken();
+                next((c == '?') ? State::QUERY_KEY : State::PROTOCOL);
+            } else if(c == '\r' || c == '\n'){
+                fail(badRequest);
+            } else {
+                appendDecoded(c);
+            }
+            break;
 
-    // Look for headers - terminate on CRLF.
-    while(length > 0 && *here != '\r' && *here != '\n'){
-        length = parseHeaderLine(here, there, length);
-    }
+            case State::QUERY_KEY:
+            if(c == '='){
+                pendingName = endToken();
+                next(State::QUERY_VALUE);
+            } else if(c == '&'){
+                addParameter(false);
+            } else if(c == ' '){
+                if(there != tokenStart || hexDigits) addParameter(false);
+                next(State::PROTOCOL);
+            } else if(c == '\r' || c == '\n'){
+                fail(badRequest);
+            } else {
+                appendDecoded(c);
+            }
+            break;
 
-    // Skip over any CRLF.
-    while((length > 0) && (*here == '\r' || *here =='\n')){
-        ++here; --length;
-    }
+            case State::QUERY_VALUE:
+            if(c == '&' || c == ' '){
+                addParameter(true);
+                next((c == ' ') ? State::PROTOCOL : State::QUERY_KEY);
+            } else if(c == '\r' || c == '\n'){
+                fail(badRequest);
+            } else {
+                appendDecoded(c);
+            }
+            break;
+
+            case State::PROTOCOL:
+            if(c == '\n'){
+                _protocol = endToken();
+                next(State::HEADER_START);
+            } else if(c != '\r' && c != ' '){
+                append(c);
+            }
+            break;
 
-    length = parseBody(here, there, length);
+            case State::HEADER_START:
+            if(c == '\n'){
+                headersComplete();
+            } else if(c != '\r'){
+                append(c);
+                next(State::HEADER_NAME);
+            }
+            break;
 
-    _complete = true;
+            case State::HEADER_NAME:
+            if(c == ':'){
+                pendingName = endToken();
+                next(State::HEADER_VALUE_START);
+            } else if(c == '\r' || c == '\n'){
+                fail(badRequest);
+            } else {
+                append(c);
+            }
+            break;
+
+            case State::HEADER_VALUE_START:
+            if(c == ' ' || c == '\t') break;  // skip leading space
+            state = State::HEADER_VALUE;
+            // fall through
+
+            case State::HEADER_VALUE:
+            if(c == '\n'){
+                if(addHeader()) next(State::HEADER_START);
+            } else if(c != '\r'){
+                append(c);
+            }
+            break;
+
+            default:
+            break;
+        }
+    }
+
+    return here - (const char*)data;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -304,6 +416,16 @@ HttpResponse::HttpResponse(Block* block)
 , statusCode(200)
 , statusMsg("OK")
 , body(0)
+, producer(0)
+, staticBody(0)
+, staticLength(0)
+, standardHeaders(0)
+, deferred(false)
+, cached(0)
+, cacheTtl(0)
+, cacheGeneration(0)
+, cacheGenerationSeen(0)
+, headerLength(0)
 {}
 
 void HttpResponse::setStatus(int code, const char* msg){
@@ -318,36 +440,178 @@ void HttpResponse::addHeader(const char* key, const char* value){
     
 void HttpResponse::setBody(const char* payload){
     this->body = payload;
+    this->producer = 0;
+    this->staticBody = 0;
+}
+
+/// @brief Sets a producer to generate the body as it is sent.
+/// @param producer generates the body.
+void HttpResponse::setBody(BodyProducer* producer){
+    this->body = 0;
+    this->producer = producer;
+    this->staticBody = 0;
+}
+
+/// @brief Sets a body that is sent without being copied e.g. const data in
+/// flash.  It must not change until the response has been sent.
+/// @param data is the body.
+/// @param length is the number of bytes in data.
+void HttpResponse::setStaticBody(const uint8_t* data, size_t length){
+    this->body = 0;
+    this->producer = 0;
+    this->staticBody = data;
+    this->staticLength = length;
+}
+
+/// @brief Lets the Webserver's ResponseCache keep this response so the
+/// same GET (path and query) is answered without calling the app again.  Only
+/// 200 responses with a text or producer body that fit a cache slot are kept.
+/// @param ms is how long the response stays good for.
+/// @param generation is a counter the data source changes whenever the data
+/// does (e.g. History::changes()), making the response stale straight away.
+/// 0 to rely on the time alone.
+void HttpResponse::cacheFor(uint32_t ms, const uint32_t* generation){
+    cacheTtl = ms;
+    cacheGeneration = generation;
+    cacheGenerationSeen = generation ? *generation : 0;
+}
+
+/// @brief Answers with a response from the cache.
+/// @param entry is the stored response.
+void HttpResponse::setCached(const CacheEntry* entry){
+    cached = entry;
+    statusCode = 200;
+    statusMsg = "OK";
+    body = 0;
+    producer = 0;
+    staticBody = 0;
 }
 
-const char* HttpResponse::protocolLine(){
-    const char* p = "HTTP/1.1 ";
-    size_t len = strlen(p) + 3 + 1 + strlen(statusMsg) + 1;
-    char* buff = (char*) block->allocate(len);
+/// @brief Adds some of the standard headers (see StandardHeader).  These
+/// are kept as ready made text rather than stored as Headers.
+/// @param which is the headers to add e.g. HttpResponse::SERVER | HttpResponse::CORS
+void HttpResponse::addStandardHeaders(unsigned which){
+    standardHeaders |= which;
+}
+
+// Ready made header text.
+struct HeadText {
+    const char* text;
+    size_t length;
+};
+#define HEAD_TEXT(s) {s, sizeof(s) - 1}
+
+static const HeadText protocolText = HEAD_TEXT("HTTP/1.1 ");
+static const HeadText standardText[] = {
+    HEAD_TEXT("Server: PicoW\r\n"),
+    HEAD_TEXT("Access-Control-Allow-Origin: *\r\n"),
+};
+static const HeadText contentLengthText = HEAD_TEXT("Content-Length: ");
+static const HeadText chunkedText = HEAD_TEXT("Transfer-Encoding: chunked\r\n");
+static const HeadText keepAliveText = HEAD_TEXT("Connection: keep-alive\r\n");
+static const HeadText closeText = HEAD_TEXT("Connection: close\r\n");
+
+// Longest decimal number written into a head.
+#define HEAD_NUMBER_MAX 10
+
+/// @brief Copies ready made text into the head.
+static inline char* put(char* there, const HeadText& text){
+    memcpy(there, text.text, text.length);
+    return there + text.length;
+}
+
+/// @brief Copies a string into the head.
+static inline char* put(char* there, const char* text, size_t length){
+    memcpy(there, text, length);
+    return there + length;
+}
 
-    if(buff) {
-        char* there = buff;
-        const char* here = p;
-        while(*here){
-            *there++ = *here++;
+/// @brief Writes a number in decimal.
+static char* putNumber(char* there, unsigned value){
+    char digits[HEAD_NUMBER_MAX];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while(value && count < HEAD_NUMBER_MAX);
+    while(count) *there++ = digits[--count];
+    return there;
+}
+
+/// @brief Formats the status line and all the headers, including the ones
+/// that frame the body, into a single buffer so they go in one write.
+/// @param contentLength is the value for a Content-Length header, -1 for none.
+/// @param chunked adds Transfer-Encoding: chunked.
+/// @param close selects Connection: close rather than keep-alive.
+/// @param length is set to the length of the head.
+/// @return the head (not NUL terminated) or 0 if out of memory.
+const char* HttpResponse::head(int contentLength, bool chunked, bool close, size_t& length){
+    if(statusCode < 100 || statusCode > 999) statusCode = 500;
+    size_t msgLength = strlen(statusMsg);
+
+    // Work out how much room is needed...
+    size_t size = 0;
+    BlockListIter<Header> iter = _headers.iter();
+    Header* h;
+    if(cached){
+        size = cached->headSize();
+    } else {
+        size = protocolText.length + 4 + msgLength + 2;
+        for(unsigned i=0; i<sizeof(standardText)/sizeof(standardText[0]); ++i){
+            if(standardHeaders & (1 << i)) size += standardText[i].length;
         }
-        if(statusCode > 999) statusCode = 999; // 3 digits 
-        itoa(statusCode, there, 10 );
-        while(*there) ++there; //Find trailing zero
+        while((h = iter.next()) != 0){
+            size += strlen(h->name()) + 2 + strlen(h->value()) + 2;
+        }
+    }
+    if(contentLength >= 0) size += contentLengthText.length + HEAD_NUMBER_MAX + 2;
+    if(chunked) size += chunkedText.length;
+    size += (close ? closeText : keepAliveText).length + 2;
+
+    char* buffer = (char*)block->allocate(size);
+    if(!buffer) return 0;
+
+    // ...then fill it in.
+    char* there = buffer;
+    if(cached){
+        there = put(there, cached->head(), cached->headSize());
+    } else {
+        there = put(there, protocolText);
+        there = putNumber(there, statusCode);
         *there++ = ' ';
-        here = statusMsg;
-        while(*here){
-            *there++ = *here++;
+        there = put(there, statusMsg, msgLength);
+        *there++ = '\r';
+        *there++ = '\n';
+        for(unsigned i=0; i<sizeof(standardText)/sizeof(standardText[0]); ++i){
+            if(standardHeaders & (1 << i)) there = put(there, standardText[i]);
         }
+        iter = _headers.iter();
+        while((h = iter.next()) != 0){
+            there = put(there, h->name(), strlen(h->name()));
+            *there++ = ':';
+            *there++ = ' ';
+            there = put(there, h->value(), strlen(h->value()));
+            *there++ = '\r';
+            *there++ = '\n';
+        }
+    }
+    headerLength = there - buffer;  // what the cache keeps.
+
+    if(contentLength >= 0){
+        there = put(there, contentLengthText);
+        there = putNumber(there, contentLength);
         *there++ = '\r';
         *there++ = '\n';
-        *there++ = 0;
     }
-   
-    printf("Protocol line:%s\n", buff);
-    return buff;
+    if(chunked) there = put(there, chunkedText);
+    there = put(there, close ? closeText : keepAliveText);
+    *there++ = '\r';
+    *there++ = '\n';
+
+    length = there - buffer;
+    assert(length <= size);
+    return buffer;
 }
- 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // HttpTransaction
@@ -356,7 +620,22 @@ const char* HttpResponse::protocolLine(){
 HttpTransaction::HttpTransaction(Block* block)
 : _block(block)
 , _request(block)
-, _response(block){
+, _response(block)
+, bytesToSend(0)
+, bodyPending(false)
+, chunked(false)
+, truncated(false)
+, bodyStatic(false)
+, staged(0)
+, stagedLength(0)
+, bodyData(0)
+, bodyLength(0)
+, bodySent(0)
+, bodyRemaining(0)
+, chunkBuffer(0)
+, cache(0)
+, cacheEntry(0)
+, cacheFilling(false){
     assert(block);
 }
 
@@ -369,29 +648,302 @@ void* HttpTransaction::operator new(size_t size, Block* block){
     return block->allocate(size);
 }
 
+// Room before producer data for the chunk size line, up to 4 hex digits + CRLF.
+#define CHUNK_HEADER 6
+// Chunk header plus CRLF after the data.
+#define CHUNK_FRAMING (CHUNK_HEADER + 2)
+static const char* lastChunk = "0\r\n\r\n";
+
+/// @brief Gets ready to send the response body once the head has been queued.
+/// @param chunked is true to send a producer's output with chunked encoding.
+/// @return true if ready, false if there is no memory for the body buffer.
+bool HttpTransaction::startBody(bool chunked){
+    this->chunked = chunked;
+    truncated = false;
+    staged = 0;
+    stagedLength = 0;
+    bodySent = 0;
+
+    BodyProducer* producer = _response.getProducer();
+    if(producer){
+        bodyPending = true;
+        bodyRemaining = producer->contentLength();
+        chunkBuffer = (uint8_t*)_block->allocate(BODY_CHUNK + CHUNK_FRAMING);
+        return chunkBuffer != 0;
+    }
+
+    const CacheEntry* cached = _response.getCached();
+    bodyStatic = _response.getStaticBody() != 0;
+    if(cached){
+        // Copied as it's sent as the slot may be reused once this is done.
+        bodyData = cached->body();
+        bodyLength = cached->bodySize();
+    } else if(bodyStatic){
+        bodyData = _response.getStaticBody();
+        bodyLength = _response.getStaticLength();
+    } else {
+        const char* text = _response.getBody();
+        bodyData = (const uint8_t*)text;
+        bodyLength = text ? strlen(text) : 0;
+    }
+    bodyPending = bodyLength > 0;
+    return true;
+}
+
+/// @brief Stages the next piece of the body ready to send.
+/// @param space is the room there is to send it.
+/// @return true if there is a staged piece that fits in space.
+bool HttpTransaction::stageBody(size_t space){
+    if(stagedLength > 0) return stagedLength <= space;
+    if(!bodyPending) return false;
+
+    BodyProducer* producer = _response.getProducer();
+    if(producer == 0){
+        // Static data isn't copied so can go in one piece.
+        size_t len = bodyLength - bodySent;
+        if(len > space) len = space;
+        if(!bodyStatic && len > BODY_CHUNK) len = BODY_CHUNK;
+        staged = bodyData + bodySent;
+        stagedLength = len;
+        bodySent += len;
+        bodyPending = bodySent < bodyLength;
+        if(cacheFilling) cacheBody(staged, len);
+        if(cacheFilling && !bodyPending) cacheEnd(true);
+        return len > 0;
+    }
+
+    // Only ask for as much as will fit, allowing for the framing (which also
+    // leaves room for the last chunk if the producer has finished).
+    size_t framing = chunked ? CHUNK_FRAMING : 0;
+    size_t wanted = BODY_MIN_PIECE;
+    if(!chunked && (size_t)bodyRemaining < wanted) wanted = bodyRemaining;
+    if(space < framing + wanted) return false;
+    size_t max = space - framing;
+    if(max > BODY_CHUNK) max = BODY_CHUNK;
+    if(!chunked && (size_t)bodyRemaining < max) max = bodyRemaining;
+
+    uint8_t* data = chunkBuffer + CHUNK_HEADER;
+    size_t len = (max > 0) ? producer->produce(data, max) : 0;
+    if(len == BodyProducer::WAIT) return false;
+
+    if(cacheFilling){
+        cacheBody(data, len);
+    }
+
+    if(!chunked){
+        bodyRemaining -= len;
+        if(len == 0){
+            truncated = bodyRemaining > 0;
+            bodyPending = false;
+            if(cacheFilling) cacheEnd(!truncated);
+            return false;
+        }
+        staged = data;
+        stagedLength = len;
+        bodyPending = bodyRemaining > 0;
+        if(cacheFilling && !bodyPending) cacheEnd(true);
+        return true;
+    }
+
+    if(len == 0){
+        if(cacheFilling) cacheEnd(true);
+        staged = (const uint8_t*)lastChunk;
+        stagedLength = strlen(lastChunk);
+        bodyPending = false;
+        return true;
+    }
+
+    // Write the chunk size in hex immediately before the data.
+    static const char* hex = "0123456789abcdef";
+    uint8_t* start = data;
+    *--start = '\n';
+    *--start = '\r';
+    size_t n = len;
+    do {
+        *--start = hex[n & 0xF];
+        n >>= 4;
+    } while(n);
+    data[len] = '\r';
+    data[len + 1] = '\n';
+    staged = start;
+    stagedLength = (data - start) + len + 2;
+    return true;
+}
+
+/// @brief Sends a response from the cache.
+/// @param cache is the cache.
+/// @param entry is the stored response, held until finished().
+void HttpTransaction::sendCached(ResponseCache* cache, CacheEntry* entry){
+    this->cache = cache;
+    cacheEntry = entry;
+    cacheFilling = false;
+    _response.setCached(entry);
+}
+
+/// @brief Copies the body into the cache as it is sent.  Called once the
+/// body has been started.
+/// @param cache is the cache.
+/// @param entry is the reserved slot, which already has the head.
+void HttpTransaction::fillCache(ResponseCache* cache, CacheEntry* entry){
+    this->cache = cache;
+    cacheEntry = entry;
+    cacheFilling = true;
+    if(!bodyPending) cacheEnd(true);   // nothing to come.
+}
+
+/// @brief Adds a piece of body to the entry being filled.
+void HttpTransaction::cacheBody(const uint8_t* data, size_t length){
+    if(!cache->append(cacheEntry, data, length)) cacheEnd(false);
+}
+
+/// @brief Stops filling the cache entry.
+/// @param complete is true if the whole body went in, false to throw it away.
+void HttpTransaction::cacheEnd(bool complete){
+    if(complete){
+        cache->commit(cacheEntry);
+        cache->release(cacheEntry);
+    } else {
+        cache->abandon(cacheEntry);
+    }
+    cacheEntry = 0;
+    cacheFilling = false;
+}
+
+/// @brief Lets any body producer know the response is done with.  Safe to
+/// call more than once.
+void HttpTransaction::finished(){
+    BodyProducer* producer = _response.getProducer();
+    if(producer){
+        _response.setBody((BodyProducer*)0);
+        producer->finished();
+    }
+    BodyConsumer* consumer = _request.bodyConsumer();
+    if(consumer){
+        _request.releaseConsumer();
+        consumer->finished();
+    }
+    if(cacheEntry){
+        if(cacheFilling) cacheEnd(false);
+        else cache->release(cacheEntry);
+        cacheEntry = 0;
+    }
+    bodyPending = false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+static uint32_t nowMs(){
+    return to_ms_since_boot(get_absolute_time());
+}
+
+/// @brief Looks for a token in a comma separated header value e.g. "keep-alive, Upgrade".
+/// @param value is the header value.
+/// @param token is the token to look for, case is ignored.
+/// @return true if found.
+static bool hasToken(const char* value, const char* token){
+    size_t len = strlen(token);
+    while(*value){
+        while(*value == ' ' || *value == '\t' || *value == ',') ++value;
+        const char* end = value;
+        while(*end && *end != ',') ++end;
+        const char* last = end;
+        while(last > value && (last[-1] == ' ' || last[-1] == '\t')) --last;
+        if((size_t)(last - value) == len && strncasecmp(value, token, len) == 0) return true;
+        value = end;
+    }
+    return false;
+}
+
+/// @brief Determines whether the client wants the connection kept open
+/// after the response.  HTTP/1.1 defaults to keep-alive, HTTP/1.0 to close.
+/// @param request is the (complete) request.
+/// @return true if the connection should be kept open.
+static bool wantsKeepAlive(HttpRequest& request){
+    const char* protocol = request.protocol();
+    bool keepAlive = protocol && strcmp(protocol, "HTTP/1.1") == 0;
+    const char* connection = request.header("Connection");
+    if(connection){
+        if(hasToken(connection, "close")) {
+            keepAlive = false;
+        } else if(hasToken(connection, "keep-alive")) {
+            keepAlive = true;
+        }
+    }
+    return keepAlive;
+}
+
+/// @brief Whether a complete (or rejected) request is being answered.
+bool HttpConnection::isResponding(){
+    return tx && (tx->request().isComplete() || tx->request().failureMessage());
+}
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 Webserver::Webserver()
-:appCount(0)
+: worker(0)
+, cache(0)
+, metrics(0)
 {
-    for(int i=0; i<MAX_APPS; ++i){
-        apps[i] = 0;
+}
+
+/// @brief Identifies a connection in trace records.
+/// @return its index, or -1 if there isn't one.
+int Webserver::slotOf(const HttpConnection* hc) const {
+    return hc ? hc - httpConnections : -1;
+}
+
+/// @brief Finds a free HttpConnection for a new connection.
+/// @param connection is the new connection.
+/// @return the HttpConnection or 0 if none free.
+HttpConnection* Webserver::allocateConnection(Connection* connection){
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        HttpConnection* hc = httpConnections + i;
+        if(!hc->inUse){
+            *hc = HttpConnection();
+            hc->connection = connection;
+            hc->lastActivity = nowMs();
+            hc->inUse = true;
+            return hc;
+        }
     }
+    return 0;
 }
 
+/// @brief Frees any memory held for the connection and marks it unused.
+/// @param hc is the connection to release.
+void Webserver::releaseConnection(HttpConnection* hc){
+    assert(hc);
+    // Gone before the client had all of the response?
+    if(metrics && (hc->deferred || (hc->isResponding() && !hc->tx->sendComplete()))){
+        metrics->aborted(hc->metricsSlot);
+    }
+
+    if(hc->deferred){
+        // The worker still has the transaction; complete() frees it.
+    } else if(hc->tx){
+        hc->tx->finished();
+        hc->tx->getBlock()->free();
+    }
+    if(hc->pendingBlock){
+        hc->pendingBlock->free();
+    }
+    hc->connection->setAppState(0);
+    *hc = HttpConnection();
+}
 
 void Webserver::connected(Connection* connection){
-    printf("connected\n");
-    connection->setAppState(0); // no existing transaction as new connection
+    // There are as many HttpConnections as client connections so there should
+    // always be one.  If not receive() closes the connection.
+    HttpConnection* hc = allocateConnection(connection);
+    connection->setAppState(hc);
+    if(metrics) metrics->connections(connectionsInUse());
+    TRACE_INFO(TRACE_CONNECTED, slotOf(hc), 0);
 }
 
 void Webserver::closed(Connection* connection){
-    printf("closed\n");
-    HttpTransaction* tx = (HttpTransaction*)connection->getAppState();
-    if(tx) {
-        Block* block = tx->getBlock();
-        block->free();
-        connection->setAppState(0);
+    HttpConnection* hc = static_cast<HttpConnection*>(connection->getAppState());
+    TRACE_INFO(TRACE_CLOSED, slotOf(hc), 0);
+    if(hc) {
+        releaseConnection(hc);
     }
 }
 
@@ -404,139 +956,532 @@ void Webserver::closed(Connection* connection){
 //
 // Some content here
 err_t Webserver::receive(Connection* connection, void* data, uint16_t length){
-    printf("Received %d ======================\n",length);
-    char* text = (char*)data;
-    for(int i=0; i<length; ++i){
-        putchar(text[i]);
+    HttpConnection* hc = static_cast<HttpConnection*>(connection->getAppState());
+    TRACE_DEBUG(TRACE_RECEIVED, slotOf(hc), length);
+    if(hc == 0){
+        connection->close();
+        return ERR_OK;
     }
-    printf("==================================\n");
+    hc->lastActivity = nowMs();
 
-    // check for existing transaction
-    HttpTransaction* tx = static_cast<HttpTransaction*>(connection->getAppState());
-    if(tx == 0){
-        Block* block = blockPool.allocate();
-        if(block == 0){
-            printf("No memory to handle request");
-            const char* header = "HTTP/1.1 500 No memory\r\n";
-            connection->send((uint8_t*)header, strlen(header));
-            return ERR_OK;
+    if(hc->overflowed) return ERR_OK;   // closing once queued requests are answered.
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t used = 0;
+    if(!hc->isResponding() && hc->pendingEnd == hc->pendingStart){
+        used = consume(hc, bytes, length);
+    }
+
+    // Anything left is a pipelined request to handle once the current
+    // response has gone.  If there's no room for it then stop reading and
+    // close once what is queued has been answered - the client will retry
+    // anything unanswered.
+    if(hc->inUse && used < length){
+        if(!queuePending(hc, bytes + used, length - used)){
+            TRACE_ERROR(TRACE_PIPELINE_OVERFLOW, slotOf(hc), length - used);
+            hc->overflowed = true;
         }
+    }
+    return ERR_OK;
+}
 
-        printf("Create transaction\n");
-        tx = new(block) HttpTransaction(block);
-        connection->setAppState(tx);
+/// @brief Parses data into the connection's current request and, once it is
+/// complete, dispatches it.  At most one request is taken from the data.
+/// @param hc is the connection the data arrived on.
+/// @param data is the received data.
+/// @param length is the number of bytes in data.
+/// @return the number of bytes used.  Any remainder belongs to the next request.
+size_t Webserver::consume(HttpConnection* hc, const uint8_t* data, size_t length){
+    Connection* connection = hc->connection;
+    if(hc->tx == 0){
+        Block* block = blockPool.allocateSmall();
+        if(block == 0){
+            TRACE_ERROR(TRACE_NO_MEMORY, slotOf(hc), 0);
+            connection->send((uint8_t*)noMemory, strlen(noMemory));
+            releaseConnection(hc);
+            connection->close();
+            return length;
+        }
 
-        printf("Parsing request\n");
-        tx->request().parse(data, length);
-    } else {
-        // There's an existing request and some more data here.
+        hc->tx = new(block) HttpTransaction(block);
     }
-    
+    HttpTransaction* tx = hc->tx;
+
+    // There may be more of the request to come in later segments so this
+    // just moves the parse on.
+    size_t used = parse(hc, data, length);
+    if(tx->request().isWaitingForBody()){
+        startBody(hc);
+        used += parse(hc, data + used, length - used);
+    }
+    if(used > 0) hc->requestStarted = true;
+
     // bail out if request parsing failed.
     const char* fail = tx->request().failureMessage();
     if(fail){
-        connection->send((uint8_t*)fail, strlen(fail));
-        return ERR_OK;
+        size_t len = strlen(fail);
+        int status = atoi(fail + 9);    // "HTTP/1.1 400 ..."
+        if(metrics) metrics->responded(0, status, hc->parseTime, 0);
+        TRACE_ERROR(TRACE_PARSE_FAILED, slotOf(hc), status);
+        hc->metricsSlot = 0;
+        hc->responseTime = time_us_32();
+        hc->closeAfterResponse = true;
+        tx->setSendSize(len);   // connection closed once sent.
+        err_t err = connection->send((uint8_t*)fail, len);
+        if(err != ERR_OK){
+            TRACE_ERROR(TRACE_SEND_FAILED, slotOf(hc), err);
+            releaseConnection(hc);
+            connection->close();
+        }
+        return length;          // anything else is discarded.
     }
 
-    // If request is complete then process & send result
     if(tx->request().isComplete()){
-        
-        // Find a webapp to process the request (404 is default)
-        WebApp* app = &webapp404;
-        for(int i=0; i<appCount; ++i){
-            if(apps[i]->matches(tx->request().verb(), tx->request().path())) {
-                app = apps[i];
-                break;
+        dispatch(hc);
+    }
+    return used;
+}
+
+/// @brief Moves the parse of the connection's request on, timing it.
+/// @param hc is the connection.
+/// @param data is the received data.
+/// @param length is the number of bytes in data.
+/// @return the number of bytes used.
+size_t Webserver::parse(HttpConnection* hc, const uint8_t* data, size_t length){
+    uint32_t start = time_us_32();
+    size_t used = hc->tx->request().parse(data, length);
+    hc->parseTime += time_us_32() - start;
+    return used;
+}
+
+/// @brief Called once a request's headers are in if it has a body.  Asks the
+/// app that will handle it where the body goes and, if the client is waiting
+/// to be asked for the body, sends 100 Continue.
+/// @param hc is the connection with the request.
+void Webserver::startBody(HttpConnection* hc){
+    HttpRequest& request = hc->tx->request();
+    int tag = 0;
+    const ParamSchema* schema = 0;
+    WebApp* app = router.find(request.verb(), request.path(), tag, schema);
+    request.setRoute(tag);
+    request.receiveBody(app ? app->receiveBody(request) : 0);
+    if(request.failureMessage()) return;
+
+    const char* expect = request.header("Expect");
+    if(expect && strcasecmp(expect, "100-continue") == 0){
+        size_t len = strlen(continueResponse);
+        if(hc->connection->send((uint8_t*)continueResponse, len) == ERR_OK){
+            hc->interimBytes += len;
+        }
+    }
+}
+
+/// @brief Passes a complete request to the matching webapp and sends the response.
+/// @param hc is the connection with the complete request.
+void Webserver::dispatch(HttpConnection* hc){
+    HttpTransaction* tx = hc->tx;
+    hc->dispatchTime = time_us_32();
+    if(!wantsKeepAlive(tx->request())){
+        hc->closeAfterResponse = true;
+    }
+
+    // A recent enough answer to the same GET can be sent without the app.
+    if(cache && strcmp(tx->request().verb(), "GET") == 0){
+        CacheEntry* entry = cache->find(tx->request());
+        if(entry){
+            if(metrics){
+                // Still counted against the route it answers.
+                int tag = 0, index = 0;
+                const ParamSchema* schema = 0;
+                router.find(tx->request().verb(), tx->request().path(), tag, schema, &index);
+                hc->metricsSlot = ServerMetrics::slot(index);
             }
+            tx->sendCached(cache, entry);
+            sendResponse(hc);
+            return;
         }
-        app->process(tx->request(), tx->response());
-    
-        sendResponse(tx, connection);
     }
 
-    return ERR_OK;
+    // Find a webapp to process the request (404 is default)
+    int tag = 0;
+    int index = 0;
+    const ParamSchema* schema = 0;
+    WebApp* app = router.find(tx->request().verb(), tx->request().path(), tag, schema, &index);
+    if(app == 0){
+        app = &webapp404;
+    }
+    tx->request().setRoute(tag);
+    hc->metricsSlot = ServerMetrics::slot(index);
+    TRACE_INFO(TRACE_REQUEST, slotOf(hc), index);
+
+    if(schema){
+        const char* error = 0;
+        int status = 400;
+        void* params = schema->bind(tx->request(), tx->getBlock(), error, status);
+        if(!params){
+            tx->response().setStatus(status, (status == 400) ? "Bad Request" : "Internal Server Error");
+            tx->response().addStandardHeaders(HttpResponse::SERVER);
+            tx->response().addHeader("Content-Type", "text/plain");
+            tx->response().setBody(error);
+            sendResponse(hc);
+            return;
+        }
+        tx->request().setParams(params);
+    }
+    app->process(tx->request(), tx->response());
+
+    // The app wants to finish off the request away from the network callbacks.
+    if(tx->response().isDeferred()){
+        if(!worker){
+            app->processAsync(tx->request(), tx->response());
+        } else if(worker->submit(AsyncJob{app, tx, hc})){
+            hc->deferred = true;
+            return;     // sent by complete() once the worker is done.
+        } else {
+            TRACE_ERROR(TRACE_ASYNC_BUSY, slotOf(hc), 0);
+            tx->response().setStatus(503, "Service Unavailable");
+            tx->response().addStandardHeaders(HttpResponse::SERVER);
+            tx->response().addHeader("Retry-After", "1");
+            tx->response().setBody((const char*)0);
+        }
+    }
 
+    sendResponse(hc);
 }
 
-size_t Webserver::sendResponse(HttpTransaction* tx, Connection* connection){
+/// @brief Sends the response to a request the worker has finished with.  If
+/// the client has gone in the meantime the transaction is just freed.
+/// @param job is the finished request.
+void Webserver::complete(const AsyncJob& job){
+    HttpConnection* hc = job.hc;
+    if(hc->inUse && hc->deferred && hc->tx == job.tx){
+        hc->deferred = false;
+        sendResponse(hc);
+    } else {
+        job.tx->finished();
+        job.tx->getBlock()->free();
+    }
+}
+
+/// @brief Sends any responses the worker has finished.  Called from the
+/// network loop.
+void Webserver::service(){
+    if(!worker) return;
+    AsyncJob job;
+    while(worker->completed(job)){
+        complete(job);
+    }
+}
+
+/// @brief Keeps pipelined data until the current response has been sent.
+/// @param hc is the connection the data arrived on.
+/// @param data is the data to keep.
+/// @param length is the number of bytes to keep.
+/// @return true if kept, false if there is no room.
+bool Webserver::queuePending(HttpConnection* hc, const uint8_t* data, size_t length){
+    if(hc->pendingBlock == 0){
+        Block* block = (length <= BLOCK_SMALL_SIZE) ? blockPool.allocateSmall() : blockPool.allocate();
+        if(block == 0) return false;
+        hc->pendingBlock = block;
+        hc->pending = (uint8_t*)block->allocate(block->size());
+        hc->pendingStart = 0;
+        hc->pendingEnd = 0;
+    }
+
+    // Shuffle down what's left to make room at the end.
+    if(hc->pendingStart > 0){
+        size_t len = hc->pendingEnd - hc->pendingStart;
+        memmove(hc->pending, hc->pending + hc->pendingStart, len);
+        hc->pendingStart = 0;
+        hc->pendingEnd = len;
+    }
+
+    // Move up to a full size block if a small one has run out of room.
+    if(hc->pendingEnd + length > hc->pendingBlock->size() && hc->pendingBlock->size() < BLOCK_SIZE){
+        Block* block = blockPool.allocate();
+        if(block == 0) return false;
+        uint8_t* pending = (uint8_t*)block->allocate(BLOCK_SIZE);
+        memcpy(pending, hc->pending, hc->pendingEnd);
+        hc->pendingBlock->free();
+        hc->pendingBlock = block;
+        hc->pending = pending;
+    }
+
+    if(hc->pendingEnd + length > hc->pendingBlock->size()) return false;
+    memcpy(hc->pending + hc->pendingEnd, data, length);
+    hc->pendingEnd += length;
+    return true;
+}
+
+/// @brief Called once a response has been completely sent.  Either closes the
+/// connection or recycles the transaction and starts on any pipelined request.
+/// @param hc is the connection whose response has gone.
+void Webserver::finishTransaction(HttpConnection* hc){
+    Connection* connection = hc->connection;
+    if(metrics) metrics->acknowledged(hc->metricsSlot, time_us_32() - hc->responseTime);
+    if(hc->closeAfterResponse){
+        releaseConnection(hc);
+        connection->close();
+        return;
+    }
+
+    // Reuse the block for the next request rather than going back to the pool.
+    hc->tx->finished();
+    Block* block = hc->tx->getBlock();
+    block->reset();
+    hc->tx = new(block) HttpTransaction(block);
+    hc->requestStarted = false;
+    hc->parseTime = 0;
+
+    if(hc->pendingEnd > hc->pendingStart){
+        size_t used = consume(hc, hc->pending + hc->pendingStart, hc->pendingEnd - hc->pendingStart);
+        if(!hc->inUse) return;  // consume closed the connection.
+        hc->pendingStart += used;
+    }
+
+    if(hc->overflowed && !hc->isResponding()){
+        releaseConnection(hc);
+        connection->close();
+        return;
+    }
+
+    // Nothing left waiting so give the memory back.
+    if(hc->pendingBlock && hc->pendingEnd == hc->pendingStart){
+        hc->pendingBlock->free();
+        hc->pendingBlock = 0;
+        hc->pending = 0;
+        hc->pendingStart = 0;
+        hc->pendingEnd = 0;
+    }
+}
+
+/// @brief Sends the response head and starts on the body.
+/// @param hc is the connection with the processed transaction.
+/// @return the number of bytes queued so far.
+size_t Webserver::sendResponse(HttpConnection* hc){
+    assert(hc);
+    HttpTransaction* tx = hc->tx;
+    Connection* connection = hc->connection;
     assert(tx);
     assert(tx->getBlock());
     assert(connection);
 
-    size_t bytesToSend = 0;
-    size_t len;
-
-    const char* value = tx->response().protocolLine();
-    len = strlen(value);
-    connection->send((uint8_t*)value, len);
-    bytesToSend += len;
+    // The client needs to be able to find the end of the body on a connection
+    // that stays open: either the length is known up front or the body is
+    // chunked.  HTTP/1.0 clients don't understand chunked so for them the
+    // connection is closed to mark the end.
+    HttpResponse& response = tx->response();
+    BodyProducer* producer = response.getProducer();
+    int length;
+    if(producer){
+        length = producer->contentLength();
+    } else if(response.getCached()){
+        length = response.getCached()->bodySize();
+    } else if(response.getStaticBody()){
+        length = response.getStaticLength();
+    } else {
+        length = response.getBody() ? strlen(response.getBody()) : 0;
+    }
 
-    BlockListIter<Header> iter = tx->response().headers().iter();
-    Header* h;
-    while( (h = iter.next()) != 0){
-        value = h->toSend(tx->getBlock());
-        len = strlen(value);
-        connection->send((uint8_t*)value, len);
-        bytesToSend += len;
-   }
-    
-    // Blank line after any headers.
-    value = "\r\n";
-    len = strlen(value);
-    connection->send((uint8_t*)value, len);
-    bytesToSend += len;
+    // 1xx, 204 and 304 responses never have a body.
+    int status = response.getStatus();
+    if(metrics) metrics->responded(hc->metricsSlot, status, hc->parseTime, time_us_32() - hc->dispatchTime);
+    TRACE_INFO(TRACE_RESPONSE, slotOf(hc), status);
+    bool hasBody = status >= 200 && status != 204 && status != 304;
+
+    bool chunked = false;
+    int contentLength = -1;
+    if(!hasBody){
+        tx->finished();
+        response.setBody((const char*)0);
+    } else if(length >= 0){
+        contentLength = length;
+    } else if(strcmp(tx->request().protocol(), "HTTP/1.1") == 0){
+        chunked = true;
+    } else {
+        hc->closeAfterResponse = true;
+    }
 
-    // Followed by (optional) body.
-    value = tx->response().getBody();
-    if(value){
-        len = strlen(value);
-        connection->send((uint8_t*)value, len);
-        bytesToSend += len;
+    size_t bytesToSend = 0;
+    const char* head = 0;
+    if(tx->startBody(chunked)){
+        head = response.head(contentLength, chunked, hc->closeAfterResponse, bytesToSend);
+    }
+    if(!head){
+        TRACE_ERROR(TRACE_NO_MEMORY, slotOf(hc), 1);
+        tx->finished();
+        hc->closeAfterResponse = true;
+        size_t len = strlen(noMemory);
+        tx->setSendSize(len);
+        err_t err = connection->send((uint8_t*)noMemory, len);
+        if(err != ERR_OK){
+            TRACE_ERROR(TRACE_SEND_FAILED, slotOf(hc), err);
+            releaseConnection(hc);
+            connection->close();
+            return 0;
+        }
+        return len;
     }
 
+    // The whole head goes in one write, flagged as having more to come if
+    // there's a body to follow it.
+    err_t err = connection->send((uint8_t*)head, bytesToSend, tx->isBodyPending());
+    if(err != ERR_OK){
+        TRACE_ERROR(TRACE_SEND_FAILED, slotOf(hc), err);
+        if(err == ERR_MEM && metrics) metrics->sendStalled();
+        releaseConnection(hc);
+        connection->close();
+        return 0;
+    }
     tx->setSendSize(bytesToSend);
+    hc->responseTime = time_us_32();
+
+    // Keep a copy of the response if the app allows it.  Static bodies are
+    // already cheap to send so aren't worth a slot.
+    if(cache && response.cacheTime() && status == 200 && !response.getCached() && !response.getStaticBody()
+        && strcmp(tx->request().verb(), "GET") == 0){
+        CacheEntry* entry = cache->reserve(tx->request(), response.cacheTime(),
+            response.getCacheGeneration(), response.getCacheGenerationSeen(), head, response.getHeaderLength());
+        if(entry) tx->fillCache(cache, entry);
+    }
+
+    // Followed by (optional) body.
+    sendBody(hc);
     return bytesToSend;
 }
 
+/// @brief Queues as much of the response body as the connection has room
+/// for.  Called once the head has been sent and then as sent() (or poll())
+/// finds there is room for more.
+/// @param hc is the connection sending the response.
+/// @return false if sending failed and the connection has been closed.
+bool Webserver::sendBody(HttpConnection* hc){
+    HttpTransaction* tx = hc->tx;
+    Connection* connection = hc->connection;
+    while(tx->stageBody(connection->sendBufferSpace())){
+        size_t len = tx->stagedSize();
+        err_t err = tx->isStagedStatic()
+            ? connection->sendStatic(tx->stagedData(), len, tx->isBodyPending())
+            : connection->send((uint8_t*)tx->stagedData(), len, tx->isBodyPending());
+        if(err == ERR_MEM){         // out of buffers for now, retry later.
+            if(metrics) metrics->sendStalled();
+            TRACE_DEBUG(TRACE_SEND_STALLED, slotOf(hc), len);
+            break;
+        }
+        if(err != ERR_OK){
+            TRACE_ERROR(TRACE_SEND_FAILED, slotOf(hc), err);
+            releaseConnection(hc);
+            connection->close();
+            return false;
+        }
+        tx->queued(len);
+        tx->unstage();
+    }
+
+    // A producer that stops short leaves the client waiting for the rest.
+    if(tx->isTruncated()){
+        hc->closeAfterResponse = true;
+    }
+    return true;
+}
+
+/// @brief Sends whatever it can of any response bodies that are waiting for
+/// data, e.g. after an EventChannel has published an event.  Call from the
+/// network loop, not from the other core.
+void Webserver::resumeBodies(){
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        HttpConnection* hc = httpConnections + i;
+        if(hc->inUse && hc->isResponding() && hc->tx->isBodyPending()){
+            sendBody(hc);
+        }
+    }
+}
 
+/// @brief Periodic callback used to close connections that have been idle
+/// for too long, or are taking too long to send their request.
 err_t Webserver::poll(Connection* connection){
+    HttpConnection* hc = static_cast<HttpConnection*>(connection->getAppState());
+    if(hc == 0) return ERR_OK;
+    if(hc->isResponding()){
+        // Retry a body that stalled for lack of buffers.
+        if(hc->tx->isBodyPending()) sendBody(hc);
+        return ERR_OK;
+    }
+
+    uint32_t limit = hc->requestStarted ? REQUEST_TIMEOUT_MS : KEEP_ALIVE_TIMEOUT_MS;
+    if(nowMs() - hc->lastActivity >= limit){
+        TRACE_INFO(TRACE_IDLE_CLOSE, slotOf(hc), hc->requestStarted);
+        releaseConnection(hc);
+        connection->close();
+    }
     return ERR_OK;
+}
 
+/// @brief Reports how long a connection has been waiting for its next request
+/// so the TcpServer can close the longest idle to make room for a new one.
+/// @return ms idle, 0 if part way through a request or response.
+uint32_t Webserver::idleTime(Connection* connection){
+    HttpConnection* hc = static_cast<HttpConnection*>(connection->getAppState());
+    if(hc == 0 || hc->requestStarted || hc->isResponding() || hc->deferred) return 0;
+    uint32_t idle = nowMs() - hc->lastActivity;
+    return idle ? idle : 1;
 }
 
 void Webserver::error(Connection* connection, err_t err){
-    printf("Error %d\n", err);
-    HttpTransaction* tx = static_cast<HttpTransaction*>(connection->getAppState());
-    if(tx){
-        Block* block = tx->getBlock();
-        block->free();
-        connection->setAppState(0);
+    HttpConnection* hc = static_cast<HttpConnection*>(connection->getAppState());
+    TRACE_ERROR(TRACE_CONNECTION_ERROR, slotOf(hc), err);
+    if(hc){
+        releaseConnection(hc);
         connection->close(); // if not already.
     }
 }
 
 err_t Webserver::sent(Connection* connection, u16_t bytesSent){
-    printf("sent %d\n", bytesSent);
-    HttpTransaction* tx = static_cast<HttpTransaction*>(connection->getAppState());
-    if(tx){
-        tx->sent(bytesSent);
-        if(tx->sendComplete()){
-            Block* block = tx->getBlock();
-            block->free();
-            connection->setAppState(0);
-            connection->close(); 
+    HttpConnection* hc = static_cast<HttpConnection*>(connection->getAppState());
+    TRACE_DEBUG(TRACE_SENT, slotOf(hc), bytesSent);
+
+    // Acknowledgement of a 100 Continue isn't part of any response.
+    if(hc && hc->interimBytes){
+        u16_t n = (bytesSent < hc->interimBytes) ? bytesSent : hc->interimBytes;
+        hc->interimBytes -= n;
+        bytesSent -= n;
+    }
+
+    if(hc && bytesSent && hc->isResponding() && !hc->deferred){
+        hc->lastActivity = nowMs();
+        hc->tx->sent(bytesSent);
+        if(metrics) metrics->sent(hc->metricsSlot, bytesSent);
+        if(hc->tx->isBodyPending() && !sendBody(hc)){
+            return ERR_OK;
+        }
+        if(hc->tx->sendComplete()){
+            finishTransaction(hc);
         }
     }
     return ERR_OK;
 }
 
-/// @brief Adds a WebApp to the server.
+/// @brief Adds a WebApp to the server.  The app registers its routes.
+/// Adding the same app again just re-registers the same routes.
 /// @param app is the app to add.
-/// @return true if added, false if no space.
+/// @return true if added, false if no space for its routes.
 bool Webserver::addApplication(WebApp* app){
     assert(app);
-    if(appCount == MAX_APPS) return false;
-    apps[appCount++] = app;
-    return true;
+    app->addRoutes(router);
+    return !router.hasOverflowed();
+}
+
+/// @brief Counts the open connections.
+int Webserver::connectionsInUse() const {
+    int n = 0;
+    for(int i=0; i<MAX_CLIENTS; ++i){
+        if(httpConnections[i].inUse) ++n;
+    }
+    return n;
+}
+
+/// @brief Gives access to the block pool e.g. for reporting memory usage.
+/// @return the pool transactions are allocated from.
+const BlockPool& Webserver::pool() const {
+    return blockPool;
 }
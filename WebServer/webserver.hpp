@@ -5,9 +5,16 @@
 #include "server.hpp"
 #include "block_malloc.hpp"
 #include "block_list.hpp"
+#include "router.hpp"
+#include "async_worker.hpp"
+#include "response_cache.hpp"
+#include "metrics.hpp"
 
-// Maximum number of applications that can be registered with this sever
-#define MAX_APPS (32)
+// Idle keep-alive connections are closed after this long.
+#define KEEP_ALIVE_TIMEOUT_MS 15000
+
+// A connection that hasn't completed its request after this long is closed.
+#define REQUEST_TIMEOUT_MS 30000
 
 class Parameter {
     const char* _name;
@@ -15,7 +22,7 @@ class Parameter {
 
     public:
     Parameter(const char* name, const char* value) : _name(name), _value(value) {}
-    void* operator new(size_t size, Block* block) { return block->allocate(size);}
+    void* operator new(size_t size, Block* block) noexcept { return block->allocate(size);}
     void operator delete  ( void* ptr ) noexcept {assert(false);} 
     const char* name() {return _name;}
     const char* value() {return _value;}
@@ -32,16 +39,56 @@ class Header {
 
     public:
     Header(const char* name, const char* value): _name(name), _value(value) {}
-    void* operator new(size_t size, Block* block) { return block->allocate(size);}
+    void* operator new(size_t size, Block* block) noexcept { return block->allocate(size);}
     void operator delete  ( void* ptr ) noexcept {assert(false);} 
     const char* name() {return _name;}
     const char* value() {return _value;}
-    
-    const char* toSend(Block* block);
+};
+
+// Token storage is taken from the block in chunks of at least this size.
+#define TOKEN_CHUNK 256
+
+// Receives a request body a piece at a time as it arrives, for bodies too big
+// to hold in memory e.g. uploads to flash.  Returned by WebApp::receiveBody()
+// once the headers are in.  The app's process() is called as usual once the
+// whole body has arrived and can ask the request for its bodyConsumer().
+class BodyConsumer {
+    public:
+    void* operator new(size_t size, Block* block) noexcept { return block->allocate(size);}
+    void operator delete  ( void* ptr ) noexcept {assert(false);}
+
+    /// @brief Takes the next piece of the body.
+    /// @param data is the piece.
+    /// @param length is the number of bytes in data.
+    /// @return true to carry on, false to have the rest of the body discarded
+    /// (e.g. a write has failed).  process() is still called.
+    virtual bool consume(const uint8_t* data, size_t length) = 0;
+
+    /// @brief Called when the request is finished with, either because it
+    /// has been answered or the connection has gone part way through.
+    virtual void finished() {}
 };
 
 class HttpRequest{
 
+    // Where the parser is up to.  Parsing can stop in any state and
+    // resume when the next piece of the request arrives.
+    enum class State {
+        VERB,
+        PATH,
+        QUERY_KEY,
+        QUERY_VALUE,
+        PROTOCOL,
+        HEADER_START,       // start of a header line or blank line
+        HEADER_NAME,
+        HEADER_VALUE_START, // skipping space after :
+        HEADER_VALUE,
+        HEADERS_DONE,       // waiting for receiveBody() to say where the body goes.
+        BODY,
+        COMPLETE,
+        FAILED
+    };
+
     Block* block;   // memory block(s) for this request
     char* _verb;     // GET etc.
     char* _path;     //  /wombles
@@ -49,19 +96,41 @@ class HttpRequest{
     BlockList<Parameter> _Parameters;
     BlockList<Header> _headers;
     char* _body;
-    bool _complete;
+    BodyConsumer* consumer; // takes the body instead of _body, if set.
+    bool discarding;        // consumer has given up, skip the rest of the body.
+    size_t _bodyLength;     // bytes of body received so far.
+    size_t contentLength;   // from Content-Length header.
+
+    State state;
+    int hexDigits;      // hex digits still to come for a %xx escape.
+    char hexChar;       // partly decoded %xx escape.
+    char* chunkStart;   // current chunk of token storage.
+    char* tokenStart;   // start of the token being built.
+    char* there;        // where the next character of the token goes.
+    char* chunkEnd;     // end of the current chunk of token storage.
+    char* pendingName;  // header name or query key waiting for its value.
 
     const char* parseMessage;
+    int _route;         // tag of the route that matched.
+    const void* _params;// parameters bound by the route's ParamSchema.
 
-    int parseInitialLine(char*& here, char*& there, int length);
-    int parseHeaderLine(char*& here, char*& there, int length);
-    int parseBody(char*& here, char*& there, int length);
+    void fail(const char* message);
+    void next(State s) { if(state != State::FAILED) state = s;}
+    bool grow();
+    bool append(char c);
+    bool appendDecoded(char c);
+    char* endToken();
+    bool addParameter(bool hasValue);
+    bool addHeader();
+    void headersComplete();
 
     public:
     HttpRequest(Block* block);
     ~HttpRequest();
  
-    bool isComplete() const { return _complete;}
+    bool isComplete() const { return state == State::COMPLETE;}
+    bool isWaitingForBody() const { return state == State::HEADERS_DONE;}
+    void receiveBody(BodyConsumer* consumer);
 
     const char* verb() { return _verb;}
     const char* path() { return _path;}
@@ -69,27 +138,112 @@ class HttpRequest{
     const char* failureMessage() {return parseMessage;}
     BlockList<Parameter>& Parameters() {return _Parameters;}
     BlockList<Header>& headers() {return _headers;}
+    const char* header(const char* name);
+    const char* body() { return _body;}
+    size_t bodyLength() const { return _bodyLength;}
+    size_t expectedBodyLength() const { return contentLength;}
+    BodyConsumer* bodyConsumer() { return consumer;}
+    void releaseConsumer() { consumer = 0;}
+    Block* getBlock() { return block;}
+    int route() const { return _route;}
+    void setRoute(int tag) { _route = tag;}
+    template<typename T> const T& params() const { return *static_cast<const T*>(_params);}
+    void setParams(const void* params) { _params = params;}
   
-    void parse(void* data, uint16_t length);
+    size_t parse(const void* data, size_t length);
+};
+
+// Largest piece of body queued in one send.  lwIP copies each send into
+// pbufs from its heap (MEM_SIZE) so this is kept well below that.
+#define BODY_CHUNK 1024
+
+// Smallest space a BodyProducer is offered, so it can write a whole record.
+#define BODY_MIN_PIECE 64
+
+// Generates a response body a piece at a time so that large bodies can be
+// sent without holding all of them in memory.  produce() is called whenever
+// there is room in the connection's send buffer.  Producers can be allocated
+// from the response's block (new(response.getBlock()) MyProducer(...)) in
+// which case they are never deleted, or owned by the webapp.
+class BodyProducer {
+    public:
+    // produce() result when there's nothing to send yet but the body isn't
+    // finished.  Sending resumes on Webserver::resumeBodies() or the next poll.
+    static const size_t WAIT = (size_t)-1;
+
+    void* operator new(size_t size, Block* block) noexcept { return block->allocate(size);}
+    void operator delete  ( void* ptr ) noexcept {assert(false);}
+
+    /// @brief Writes the next piece of the body.
+    /// @param buffer is where to write it.
+    /// @param max is the most that will fit in buffer.  This is at least
+    /// BODY_MIN_PIECE unless less than that remains of a body of known length.
+    /// @return the number of bytes written, 0 when the body is complete or
+    /// WAIT if there's nothing to send for now.
+    virtual size_t produce(uint8_t* buffer, size_t max) = 0;
+
+    /// @brief Total body length if known up front.
+    /// @return the length or -1 to send the body chunked.
+    virtual int contentLength() { return -1;}
+
+    /// @brief Called when the response is finished with, either because it
+    /// has been sent or the connection has gone.
+    virtual void finished() {}
 };
 
 class HttpResponse{
+    public:
+    // Headers that nearly every response has.  These are added as flags and
+    // written from ready made text when the head is sent.
+    enum StandardHeader {
+        SERVER = 0x01,  // Server: PicoW
+        CORS = 0x02     // Access-Control-Allow-Origin: *
+    };
+
+    private:
     Block* block;
     BlockList<Header> _headers;
     int statusCode;
     const char* statusMsg;
     const char* body;
+    BodyProducer* producer;
+    const uint8_t* staticBody;  // sent without copying.
+    size_t staticLength;
+    unsigned standardHeaders;   // StandardHeader flags.
+    bool deferred;              // to be completed by WebApp::processAsync().
+    const CacheEntry* cached;   // head and body come from the ResponseCache.
+    uint32_t cacheTtl;          // ms this response can be cached for, 0 if not.
+    const uint32_t* cacheGeneration;
+    uint32_t cacheGenerationSeen;
+    size_t headerLength;        // of the last head() less the body framing.
  
     public:
     HttpResponse(Block* block);
 
     void setStatus(int code, const char* msg);
     void addHeader(const char* key, const char* body);
+    void addStandardHeaders(unsigned which);
     void setBody(const char* payload);
+    void setBody(BodyProducer* producer);
+    void setStaticBody(const uint8_t* data, size_t length);
+    void defer() { deferred = true;}
+    bool isDeferred() const { return deferred;}
+    void cacheFor(uint32_t ms, const uint32_t* generation = 0);
+    void setCached(const CacheEntry* entry);
 
-    const char* protocolLine();
+    const char* head(int contentLength, bool chunked, bool close, size_t& length);
+    int getStatus() const { return statusCode;}
     BlockList<Header>& headers() {return _headers;}
     const char* getBody() { return body;}
+    BodyProducer* getProducer() { return producer;}
+    const uint8_t* getStaticBody() { return staticBody;}
+    size_t getStaticLength() const { return staticLength;}
+    Block* getBlock() { return block;}
+    const CacheEntry* getCached() const { return cached;}
+    uint32_t cacheTime() const { return cacheTtl;}
+    const uint32_t* getCacheGeneration() const { return cacheGeneration;}
+    uint32_t getCacheGenerationSeen() const { return cacheGenerationSeen;}
+    size_t getHeaderLength() const { return headerLength;}
 
  };
 
@@ -99,6 +253,27 @@ class HttpTransaction {
     HttpRequest _request;
     HttpResponse _response;
     size_t bytesToSend; // track outstanding response bytes.
+
+    // Body streaming state.  The body is queued a piece at a time as the
+    // connection has room for it.
+    bool bodyPending;       // more body still to queue.
+    bool chunked;           // body sent with chunked transfer encoding.
+    bool truncated;         // producer gave less than its content length.
+    bool bodyStatic;        // body data can be sent without copying.
+    const uint8_t* staged;  // next piece, waiting for room to send it.
+    size_t stagedLength;
+    const uint8_t* bodyData;// text or static body.
+    size_t bodyLength;
+    size_t bodySent;        // how much of bodyData has been staged.
+    int bodyRemaining;      // producer bytes still due if length known.
+    uint8_t* chunkBuffer;   // producer output (with room for chunk framing).
+
+    ResponseCache* cache;
+    CacheEntry* cacheEntry; // being sent from, or filled as the body goes.
+    bool cacheFilling;
+
+    void cacheBody(const uint8_t* data, size_t length);
+    void cacheEnd(bool complete);
  
     public:
     HttpTransaction(Block* block);
@@ -110,23 +285,111 @@ class HttpTransaction {
     Block* getBlock() { return _block;}
 
     void setSendSize(size_t byteCount) {bytesToSend = byteCount;}
+    void queued(size_t bytes) { bytesToSend += bytes;}
     void sent(size_t bytes) { bytesToSend -= bytes;}
-    bool sendComplete() { return bytesToSend == 0;}
+    bool sendComplete() { return bytesToSend == 0 && !bodyPending;}
+
+    bool startBody(bool chunked);
+    bool stageBody(size_t space);
+    const uint8_t* stagedData() const { return staged;}
+    size_t stagedSize() const { return stagedLength;}
+    void unstage() { staged = 0; stagedLength = 0;}
+    bool isBodyPending() const { return bodyPending;}
+    bool isStagedStatic() const { return bodyStatic && staged != 0;}
+    bool isTruncated() const { return truncated;}
+    void sendCached(ResponseCache* cache, CacheEntry* entry);
+    void fillCache(ResponseCache* cache, CacheEntry* entry);
+    void finished();
 };
 
 class WebApp {
     public:
-    virtual bool matches(const char* verb, const char* path) = 0;
+    virtual void addRoutes(Router& router) = 0;    // register the paths this app handles.
     virtual void process(HttpRequest& request, HttpResponse& response) = 0;
+
+    /// @brief Called when the headers of a request with a body have arrived,
+    /// before any of the body.  Normally the body is collected in the
+    /// request's block (so is limited to less than BLOCK_SIZE); an app can
+    /// take it as it arrives instead.  request.route() is set.
+    /// @return a consumer (e.g. allocated from request.getBlock()) or 0 to
+    /// have the body collected as usual.
+    virtual BodyConsumer* receiveBody(HttpRequest& request) { return 0;}
+
+    /// @brief Completes a request that process() deferred with response.defer().
+    /// Runs on the Webserver's AsyncWorker (usually core 1), so it may take its
+    /// time but mustn't call lwIP or touch other requests.  It can allocate
+    /// from response.getBlock() as usual.
+    virtual void processAsync(HttpRequest& request, HttpResponse& response) {}
 };
 
 
+// Per connection state so that a connection can carry a sequence of
+// requests (HTTP/1.1 persistent connections).  Only one transaction is
+// active at a time; any pipelined requests that arrive while it is being
+// answered are held in pending until the response has been sent.
+class HttpConnection {
+    public:
+    Connection* connection;
+    HttpTransaction* tx;        // request being parsed or answered, 0 if none.
+    Block* pendingBlock;        // holds pending, 0 if nothing pipelined.
+    uint8_t* pending;           // pipelined data waiting for tx to finish.
+    size_t pendingStart;        // offset of first unparsed pending byte.
+    size_t pendingEnd;          // offset past last pending byte.
+    uint32_t lastActivity;      // ms since boot of last data received or sent.
+    uint16_t interimBytes;      // 100 Continue not yet acknowledged.
+    uint16_t metricsSlot;       // ServerMetrics slot of the current request's route.
+    uint32_t parseTime;         // us spent parsing the current request.
+    uint32_t dispatchTime;      // time_us_32() when the request was complete.
+    uint32_t responseTime;      // time_us_32() when the response head was sent.
+    bool requestStarted;        // some of the next request has arrived.
+    bool closeAfterResponse;    // client (or server) wants connection closed.
+    bool overflowed;            // pipelined data dropped, close once pending done.
+    bool deferred;              // tx is with the AsyncWorker.
+    bool inUse;
+
+    HttpConnection()
+    : connection(0)
+    , tx(0)
+    , pendingBlock(0)
+    , pending(0)
+    , pendingStart(0)
+    , pendingEnd(0)
+    , lastActivity(0)
+    , interimBytes(0)
+    , metricsSlot(0)
+    , parseTime(0)
+    , dispatchTime(0)
+    , responseTime(0)
+    , requestStarted(false)
+    , closeAfterResponse(false)
+    , overflowed(false)
+    , deferred(false)
+    , inUse(false)
+    {}
+
+    bool isResponding();
+};
+
 class Webserver: public ServerApplication {
     
-    WebApp* apps[MAX_APPS];
-    uint appCount;
+    Router router;
+    HttpConnection httpConnections[MAX_CLIENTS];
+    AsyncWorker* worker;    // runs deferred requests, 0 to run them inline.
+    ResponseCache* cache;   // rendered GET responses, 0 for none.
+    ServerMetrics* metrics; // statistics, 0 to not keep any.
 
-    size_t sendResponse(HttpTransaction* tx, Connection* connection);
+    HttpConnection* allocateConnection(Connection* connection);
+    int slotOf(const HttpConnection* hc) const;
+    void releaseConnection(HttpConnection* hc);
+    size_t consume(HttpConnection* hc, const uint8_t* data, size_t length);
+    bool queuePending(HttpConnection* hc, const uint8_t* data, size_t length);
+    void startBody(HttpConnection* hc);
+    void dispatch(HttpConnection* hc);
+    void finishTransaction(HttpConnection* hc);
+    size_t sendResponse(HttpConnection* hc);
+    bool sendBody(HttpConnection* hc);
+    void complete(const AsyncJob& job);
+    size_t parse(HttpConnection* hc, const uint8_t* data, size_t length);
 
     public:
     Webserver();
@@ -137,8 +400,19 @@ class Webserver: public ServerApplication {
     virtual err_t poll(Connection* connection);
     virtual void error(Connection* connection, err_t err);
     virtual err_t sent(Connection* connection, u16_t bytesSent);
+    virtual uint32_t idleTime(Connection* connection);
+    virtual void service();
 
     bool addApplication(WebApp* app);
+    void setWorker(AsyncWorker* worker) { this->worker = worker;}
+    void setCache(ResponseCache* cache) { this->cache = cache;}
+    void setMetrics(ServerMetrics* metrics) { this->metrics = metrics;}
+    void resumeBodies();
+    const BlockPool& pool() const;
+    const Router& routes() const { return router;}
+    const ResponseCache* responseCache() const { return cache;}
+    const ServerMetrics* getMetrics() const { return metrics;}
+    int connectionsInUse() const;
 };
 
 #endif
\ No newline at end of file
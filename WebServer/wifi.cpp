@@ -1,9 +1,21 @@
  #include <stdio.h>
- 
+ #include <stddef.h>
+ #include <string.h>
+
  #include "pico/stdlib.h"
  #include "pico/cyw43_arch.h"
+ #include "lwip/dhcp.h"
+ #include "lwip/dns.h"
+ #include "lwip/etharp.h"
 
 #include "wifi.hpp"
+#include "flash_store.hpp"
+#include "crc32.hpp"
+
+#define WIFI_CACHE_MAGIC 0x57494649     // "WIFI"
+
+// How often the gateway is asked for its MAC address after a fast join.
+#define WIFI_ARP_INTERVAL_MS 250
 
  Wifi::Wifi() : _failed(false){
     if (cyw43_arch_init_with_country(CYW43_COUNTRY_UK)) {
@@ -14,15 +26,31 @@
  Wifi::~Wifi() {
     cyw43_arch_deinit();
   }
-  
+
  bool Wifi::connect(const char* ssid, const char* pass, uint32_t timeout){
     return cyw43_arch_wifi_connect_timeout_ms(ssid, pass, CYW43_AUTH_WPA2_AES_PSK, timeout) == 0;
 }
 
 
+static struct netif* stationNetif(){
+    return &cyw43_state.netif[CYW43_ITF_STA];
+}
+
+static bool isValid(const WifiStation::Cache* cache){
+    return cache->magic == WIFI_CACHE_MAGIC
+        && cache->check == Crc32::of(cache, offsetof(WifiStation::Cache, check));
+}
 
-WifiStation::WifiStation(){
+/// @brief Starts up as a station, picking up the last good join from flash.
+WifiStation::WifiStation() : delay(WIFI_BACKOFF_MIN_MS){
     cyw43_arch_enable_sta_mode();
+
+    const Cache* stored = (const Cache*)(XIP_BASE + WIFI_CACHE_OFFSET);
+    if(isValid(stored)){
+        cache = *stored;
+    } else {
+        memset(&cache, 0, sizeof(cache));
+    }
 }
 
 WifiStation::WifiStation(const char* hostname) : WifiStation() {
@@ -32,7 +60,165 @@ WifiStation::WifiStation(const char* hostname) : WifiStation() {
         netif_set_up(n);
         cyw43_arch_lwip_end();
 }
- 
+
+/// @brief Connects to a network, directly to the access point and with the
+/// address used last time if it's the same network, otherwise (or if that
+/// fails) by scanning and DHCP.
+/// @param ssid is the network name.
+/// @param pass is the WPA2 password.
+/// @param timeout is the most time to take in ms, both ways included.
+/// @return true once connected with an address.
+bool WifiStation::connect(const char* ssid, const char* pass, uint32_t timeout){
+    absolute_time_t start = get_absolute_time();
+
+    if(cache.magic != 0 && strcmp(cache.ssid, ssid) == 0){
+        if(fastJoin(ssid, pass, MIN(timeout, WIFI_FAST_JOIN_MS))){
+            printf("Wifi rejoined %s (channel %lu) in %lu ms\n", ssid, (unsigned long)cache.channel,
+                (unsigned long)(absolute_time_diff_us(start, get_absolute_time()) / 1000));
+            delay = WIFI_BACKOFF_MIN_MS;
+            return true;
+        }
+        printf("Wifi fast join failed, scanning\n");
+        cyw43_wifi_leave(&cyw43_state, CYW43_ITF_STA);
+        useDhcp();
+    }
+
+    uint32_t elapsed = absolute_time_diff_us(start, get_absolute_time()) / 1000;
+    if(elapsed >= timeout || !Wifi::connect(ssid, pass, timeout - elapsed)){
+        return false;
+    }
+    remember(ssid);
+    delay = WIFI_BACKOFF_MIN_MS;
+    return true;
+}
+
+/// @brief Joins the remembered access point with the remembered address and
+/// checks the gateway answers, so a stale address isn't kept.
+bool WifiStation::fastJoin(const char* ssid, const char* pass, uint32_t timeout){
+    absolute_time_t until = make_timeout_time_ms(timeout);
+    ip4_addr_t address, netmask, gateway;
+    ip4_addr_set_u32(&address, cache.address);
+    ip4_addr_set_u32(&netmask, cache.netmask);
+    ip4_addr_set_u32(&gateway, cache.gateway);
+    ip_addr_t dns = IPADDR4_INIT(cache.dns);
+
+    struct netif* n = stationNetif();
+    cyw43_arch_lwip_begin();
+    dhcp_stop(n);
+    netif_set_addr(n, &address, &netmask, &gateway);
+    dns_setserver(0, &dns);
+    cyw43_arch_lwip_end();
+
+    size_t passLength = pass ? strlen(pass) : 0;
+    int rc = cyw43_wifi_join(&cyw43_state, strlen(ssid), (const uint8_t*)ssid, passLength, (const uint8_t*)pass,
+        passLength ? CYW43_AUTH_WPA2_AES_PSK : CYW43_AUTH_OPEN, cache.bssid, cache.channel);
+    if(rc != 0 || !waitForLink(until)) return false;
+
+    // The lease may have moved to another network; the gateway would not be there.
+    absolute_time_t ask = get_absolute_time();
+    while(!time_reached(until)){
+        struct eth_addr* mac;
+        const ip4_addr_t* ip;
+        cyw43_arch_lwip_begin();
+        bool found = etharp_find_addr(n, &gateway, &mac, &ip) >= 0;
+        if(!found && time_reached(ask)){
+            etharp_request(n, &gateway);
+            ask = make_timeout_time_ms(WIFI_ARP_INTERVAL_MS);
+        }
+        cyw43_arch_lwip_end();
+        if(found) return true;
+
+        cyw43_arch_poll();
+        cyw43_arch_wait_for_work_until(ask);
+    }
+    return false;
+}
+
+/// @brief Waits for the link to be up with an address, as
+/// cyw43_arch_wifi_connect_until() does.
+/// @return false if the join failed or timed out.
+bool WifiStation::waitForLink(absolute_time_t until){
+    while(!time_reached(until)){
+        int status = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+        if(status == CYW43_LINK_UP) return true;
+        if(status < 0) return false;
+        cyw43_arch_poll();
+        cyw43_arch_wait_for_work_until(until);
+    }
+    return false;
+}
+
+/// @brief Goes back to getting an address by DHCP after a failed fast join.
+void WifiStation::useDhcp(){
+    struct netif* n = stationNetif();
+    cyw43_arch_lwip_begin();
+    netif_set_addr(n, IP4_ADDR_ANY4, IP4_ADDR_ANY4, IP4_ADDR_ANY4);
+    dhcp_start(n);
+    cyw43_arch_lwip_end();
+}
+
+/// @brief Records the access point and lease just connected with, writing
+/// flash only if they have changed.
+void WifiStation::remember(const char* ssid){
+    Cache c;
+    memset(&c, 0, sizeof(c));   // padding too, for the Crc32 and comparison.
+    c.magic = WIFI_CACHE_MAGIC;
+    strncpy(c.ssid, ssid, WIFI_SSID_MAX - 1);
+    if(cyw43_wifi_get_bssid(&cyw43_state, c.bssid) != 0){
+        return;
+    }
+
+    // channel_info_t: hardware, target and scan channel.
+    uint32_t channel[3];
+    if(cyw43_ioctl(&cyw43_state, CYW43_IOCTL_GET_CHANNEL, sizeof(channel), (uint8_t*)channel, CYW43_ITF_STA) == 0){
+        c.channel = channel[0];
+    } else {
+        c.channel = CYW43_CHANNEL_NONE;
+    }
+
+    struct netif* n = stationNetif();
+    cyw43_arch_lwip_begin();
+    c.address = ip4_addr_get_u32(netif_ip4_addr(n));
+    c.netmask = ip4_addr_get_u32(netif_ip4_netmask(n));
+    c.gateway = ip4_addr_get_u32(netif_ip4_gw(n));
+    c.dns = ip4_addr_get_u32(ip_2_ip4(dns_getserver(0)));
+    cyw43_arch_lwip_end();
+    c.check = Crc32::of(&c, offsetof(Cache, check));
+
+    if(memcmp(&c, &cache, sizeof(c)) != 0){
+        cache = c;
+        save();
+    }
+}
+
+/// @brief Writes the cache to its flash sector.
+void WifiStation::save(){
+    union {
+        Cache cache;
+        uint8_t page[FLASH_PAGE_SIZE];
+    } buffer;
+    static_assert(sizeof(Cache) <= FLASH_PAGE_SIZE, "cache must fit a flash page");
+    memset(buffer.page, 0xFF, sizeof(buffer.page));
+    buffer.cache = cache;
+    if(FlashStore::eraseAndProgram(WIFI_CACHE_OFFSET, buffer.page, FLASH_PAGE_SIZE)){
+        printf("Wifi remembered %s (channel %lu)\n", cache.ssid, (unsigned long)cache.channel);
+    }
+}
+
+/// @brief Forgets the last good join so the next connect scans.
+void WifiStation::forget(){
+    memset(&cache, 0, sizeof(cache));
+    save();
+}
+
+/// @brief How long to wait before the next connect: doubles after each failure
+/// up to WIFI_BACKOFF_MAX_MS and goes back to WIFI_BACKOFF_MIN_MS once connected.
+uint32_t WifiStation::backoff(){
+    uint32_t wait = delay;
+    delay = MIN(delay * 2, WIFI_BACKOFF_MAX_MS);
+    return wait;
+}
+
 void WifiStation::restart(){
     cyw43_arch_deinit();
     cyw43_arch_init_with_country(CYW43_COUNTRY_UK);
@@ -1,26 +1,86 @@
-
 #ifndef WIFI_H
 #define WIFI_H
 
 #include "pico/stdlib.h"
 
+// How long a join to the remembered access point (no scan, no DHCP) is given
+// before falling back to a full connect.
+#ifndef WIFI_FAST_JOIN_MS
+#define WIFI_FAST_JOIN_MS 5000
+#endif
+
+// Waits between failed connects, doubling from the first to the second.
+#ifndef WIFI_BACKOFF_MIN_MS
+#define WIFI_BACKOFF_MIN_MS 500
+#endif
+#ifndef WIFI_BACKOFF_MAX_MS
+#define WIFI_BACKOFF_MAX_MS 30000
+#endif
+
+// Flash sector holding the last good join, just below the FlashStore region
+// (see flash_store.hpp) so keep the firmware clear of both.
+#ifndef WIFI_CACHE_OFFSET
+#define WIFI_CACHE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_STORE_SIZE - FLASH_SECTOR_SIZE)
+#endif
+
+// Longest SSID (802.11), plus a terminator.
+#define WIFI_SSID_MAX 33
+
 class Wifi {
 
     protected:
     bool _failed;
     Wifi(); //
 
-    public: 
+    public:
     ~Wifi();
 
     bool connect(const char* ssid, const char* pass, uint32_t timeout = 30000);
  };
 
+// Remembers the access point (BSSID and channel) and DHCP lease of the last
+// good connection in flash.  After a power cut or AP reboot connect() first
+// joins that access point directly with the same address, which skips the
+// scan and DHCP and has the device serving again in a second or two.  If that
+// doesn't work it falls back to a normal scan and DHCP and remembers the
+// result.  The lease is reused as a static address, so give the device a
+// DHCP reservation, or call forget() if the network changes.
+//
+// Writing flash pauses core 1, which must have called
+// flash_safe_execute_core_init() if it is running.  If it hasn't the cache
+// isn't saved and every connect does a scan, as before.
  class WifiStation : public Wifi {
+    public:
+    struct Cache {
+        uint32_t magic;
+        char ssid[WIFI_SSID_MAX];
+        uint8_t bssid[6];
+        uint32_t channel;
+        uint32_t address;       // IPv4, network order.
+        uint32_t netmask;
+        uint32_t gateway;
+        uint32_t dns;
+        uint32_t check;         // Crc32 of the fields above.
+    };
+
+    private:
+    Cache cache;                // copy of flash, magic 0 if none.
+    uint32_t delay;             // next backoff().
+
+    bool fastJoin(const char* ssid, const char* pass, uint32_t timeout);
+    bool waitForLink(absolute_time_t until);
+    void useDhcp();
+    void remember(const char* ssid);
+    void save();
+
     public:
     WifiStation();
     WifiStation(const char* hostname);
+
+    bool connect(const char* ssid, const char* pass, uint32_t timeout = 30000);
     void restart();
+    uint32_t backoff();
+    void forget();
  };
 
  class WifiAccessPoint : public Wifi {
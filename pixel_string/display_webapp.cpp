@@ -3,65 +3,70 @@
 
 extern LedDisplay display;  
 
-bool DisplayWebapp::matches(const char* verb, const char* path){
-    bool accept = false;
-    if(strcmp(verb,"GET") == 0) {
-        accept = 
-            strncmp(path,"/set",4) == 0 ||
-            strncmp(path,"/rainbow_on",11) == 0 ||
-            strncmp(path,"/rainbow_off",12) == 0 ||
-            strncmp(path,"/chase_on",9) == 0 ||
-            strncmp(path,"/chase_off",10) == 0 ||
-            strncmp(path,"/rate",5) == 0 ||
-            strncmp(path,"/sparkle",8) == 0 ||
-            strncmp(path,"/colours",8) == 0 ||
-            false;
-            ;
-        if(accept) printf("Neopixel Webapp Accepting path %s\n", path);
-    }
-    return accept;
+struct DisplayParams {
+    float hue;
+    float sat;
+    float val;
+    float dv;
+};
+
+static const ParamSpec specs[] = {
+    {"h",  ParamType::FLOAT, 0, 1,  0, offsetof(DisplayParams, hue)},
+    {"s",  ParamType::FLOAT, 0, 1,  1, offsetof(DisplayParams, sat)},
+    {"v",  ParamType::FLOAT, 0, 1,  1, offsetof(DisplayParams, val)},
+    {"dv", ParamType::FLOAT, -1, 1, 0, offsetof(DisplayParams, dv)},
+};
+
+static const ParamSchema schema(specs, sizeof(specs)/sizeof(specs[0]), sizeof(DisplayParams));
+
+void DisplayWebapp::addRoutes(Router& router){
+    router.exact("GET", "/set", this, SET, &schema);
+    router.exact("GET", "/rainbow_on", this, RAINBOW_ON);
+    router.exact("GET", "/rainbow_off", this, RAINBOW_OFF);
+    router.exact("GET", "/chase_on", this, CHASE_ON);
+    router.exact("GET", "/chase_off", this, CHASE_OFF);
+    router.exact("GET", "/rate", this, RATE, &schema);
+    router.exact("GET", "/sparkle", this, SPARKLE);
+    router.exact("GET", "/colours", this, COLOURS);
 }
 
 void DisplayWebapp::process( HttpRequest& request, HttpResponse& response){
 
-    float hue = 0.0f;
-    float sat = 1.0f;
-    float val = 1.0f;
-    float dv = 0.0f;
+    const DisplayParams& params = request.params<DisplayParams>();
+    float hue = params.hue;
+    float sat = params.sat;
+    float val = params.val;
+    float dv = params.dv;
 
-    BlockListIter<Parameter> iter = request.Parameters().iter();
-    Parameter* p;
-    while(p = iter.next()){
-        //printf("Parameter %s -> %s\n", p->name(), p->value());
-        if(strcmp(p->name(), "dv") == 0) dv = p->asFloat();
-        if(strcmp(p->name(), "h") == 0) hue = p->asFloat();
-        if(strcmp(p->name(), "s") == 0) sat = p->asFloat();
-        if(strcmp(p->name(), "v") == 0) val = p->asFloat();
-    }
-
-    if(strncmp(request.path(),"/set",4) == 0) {
-         display.setHSV(hue, sat, val);
-    } else if (strncmp(request.path(),"/rainbow_on",11) == 0) {
+    switch(request.route()) {
+    case SET:
+        display.setHSV(hue, sat, val);
+        break;
+    case RAINBOW_ON:
         display.setRainbow(true);
-    } else if (strncmp(request.path(),"/rainbow_off",12) == 0) {
+        break;
+    case RAINBOW_OFF:
         display.setRainbow(false);
-    } else if (strncmp(request.path(),"/chase_on",9) == 0) {
+        break;
+    case CHASE_ON:
         display.setChase(true);
-    } else if (strncmp(request.path(),"/chase_off",10) == 0) {
+        break;
+    case CHASE_OFF:
         display.setChase(false);
-    } else if (strncmp(request.path(),"/rate",6) == 0) {
+        break;
+    case RATE:
         display.setHueChange(dv);
-    }  else if (strncmp(request.path(),"/sparkle",8) == 0) {
+        break;
+    case SPARKLE:
         display.setSparkle(true);
-    }  else if (strncmp(request.path(),"/colours",8) == 0) {
+        break;
+    case COLOURS:
         display.setSparkle(false);
-    } else {
-
+        break;
     }
   
 
     response.setStatus(200,"OK");
-    response.addHeader("Server", "PicoW");
-    response.addHeader("Access-Control-Allow-Origin","*");
+    response.addStandardHeaders(HttpResponse::SERVER | HttpResponse::CORS);
     
 }
@@ -4,8 +4,11 @@
 #include "../WebServer/webserver.hpp"
 
 class DisplayWebapp: public WebApp{
+    // Route tags.
+    enum {SET, RAINBOW_ON, RAINBOW_OFF, CHASE_ON, CHASE_OFF, RATE, SPARKLE, COLOURS};
+
    public:
-    virtual bool matches(const char* verb, const char* path);
+    virtual void addRoutes(Router& router);
     virtual void process(HttpRequest& request, HttpResponse& response);
 
 };
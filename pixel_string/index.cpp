@@ -48,16 +48,10 @@ static const char *page =
 
 // extern Letterbox letterbox;
 
-bool IndexPage::matches(const char *verb, const char *path)
+void IndexPage::addRoutes(Router &router)
 {
-    bool accept = (strcmp(verb, "GET") == 0) && (strncmp(path, "/", 1) == 0 ||
-                                                 strncmp(path, "/index", 6) == 0 ||
-                                                 false);
-
-    if (accept)
-        printf("Index Webapp Accepting path %s\n", path);
-
-    return accept;
+    router.exact("GET", "/", this);
+    router.prefix("GET", "/index", this);
 }
 
 void IndexPage::process(HttpRequest &request, HttpResponse &response)
@@ -65,7 +59,7 @@ void IndexPage::process(HttpRequest &request, HttpResponse &response)
     response.setStatus(200, "OK");
     response.addHeader("Server", "PicoW-Web");
     response.addHeader("Content-Type", "text/html");
-    response.addHeader("Access-Control-Allow-Origin", "*");
+    response.addStandardHeaders(HttpResponse::CORS);
 
     response.setBody(page);
 }
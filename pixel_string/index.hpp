@@ -5,7 +5,7 @@
 
 class IndexPage: public WebApp{
    public:
-    virtual bool matches(const char* verb, const char* path);
+    virtual void addRoutes(Router& router);
     virtual void process(HttpRequest& request, HttpResponse& response);
 
 };
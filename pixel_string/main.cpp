@@ -9,6 +9,8 @@ extern "C"
 #include "../WebServer/server.hpp"
 #include "../WebServer/webserver.hpp"
 #include "../WebServer/teapot.hpp"
+#include "../WebServer/metrics_webapp.hpp"
+#include "../WebServer/trace_webapp.hpp"
 #include "index.hpp"
 #include "display.hpp"
 #include "display_webapp.hpp"
@@ -18,6 +20,9 @@ Webserver webserver;
 Teapot teapot; // respondes to /coffee with 418...
 IndexPage indexPage;
 DisplayWebapp displayWebapp;
+ServerMetrics metrics;
+MetricsWebapp metricsPage(webserver); // /metrics for Prometheus.
+TraceWebapp tracePage;                // /trace for what the server has been doing.
 
 LedDisplay display;
 
@@ -68,6 +73,9 @@ int main()
             webserver.addApplication(&teapot);
             webserver.addApplication(&displayWebapp);
             webserver.addApplication(&indexPage);
+            webserver.addApplication(&metricsPage);
+            webserver.addApplication(&tracePage);
+            webserver.setMetrics(&metrics);
             
 
             TcpServer server(&webserver);
@@ -89,6 +97,7 @@ int main()
                     {
                         cyw43_arch_wait_for_work_until(next);
                         cyw43_arch_poll();
+                        server.service();
                     } while (absolute_time_diff_us(get_absolute_time(), next) > 0);
                 }
             }